@@ -92,10 +92,78 @@ LINK32=link.exe
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=.\arena.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\audioMixer.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\audioOut.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\d3dUtility.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\distanceField.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\gameWorld.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\jobSystem.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\level.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\mappedFile.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\memTrack.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\meshGen.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\particles.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\perfCounters.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\qualityGovernor.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\renderCache.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\soundBank.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\taskGraph.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\trajectory.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\virtualLego.cpp
 # End Source File
 # End Group
@@ -104,8 +172,92 @@ SOURCE=.\virtualLego.cpp
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=.\arena.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\audioMixer.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\audioOut.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\d3dUtility.h
 # End Source File
+# Begin Source File
+
+SOURCE=.\distanceField.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\fixedPoint.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\gameWorld.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\jobSystem.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\level.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\mappedFile.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\memTrack.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\meshGen.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\particles.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\perfCounters.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\qualityGovernor.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\renderCache.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\shapes.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simMath.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\soundBank.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\spscQueue.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\taskGraph.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\trajectory.h
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 
@@ -0,0 +1,137 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: arena.cpp
+// 
+// Desc: LinearArena and the debug allocation hook.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "arena.h"
+#include "memTrack.h"
+#include <cstdlib>
+#include <new>
+
+LinearArena::LinearArena(void)
+{
+	m_pBase     = NULL;
+	m_capacity  = 0;
+	m_used      = 0;
+	m_highWater = 0;
+	m_tag       = mem::TAG_UNTAGGED;
+}
+
+LinearArena::~LinearArena(void)
+{
+	release();
+}
+
+bool LinearArena::init(size_t capacity)
+{
+	release();
+	m_pBase = static_cast<unsigned char*>(::malloc(capacity));
+	if (m_pBase == NULL)
+		return false;
+	m_capacity = capacity;
+	m_tag      = mem::currentTag();
+	mem::charge(m_tag, mem::POOL_ARENA, m_capacity);
+	return true;
+}
+
+void LinearArena::release(void)
+{
+	if (m_pBase != NULL)
+		mem::release(m_tag, mem::POOL_ARENA, m_capacity);
+	::free(m_pBase);
+	m_pBase    = NULL;
+	m_capacity = 0;
+	m_used     = 0;
+}
+
+void* LinearArena::alloc(size_t bytes, size_t align)
+{
+	size_t start = (m_used + align - 1) & ~(align - 1);
+	// malloc only guarantees 16 byte alignment of the base
+	size_t misalign = (size_t)(m_pBase + start) & (align - 1);
+	if (misalign)
+		start += align - misalign;
+	// compared by subtraction so a huge bytes or align cannot wrap around
+	if (m_pBase == NULL || start < m_used || start > m_capacity || bytes > m_capacity - start)
+		return NULL;
+	m_used = start + bytes;
+	if (m_used > m_highWater)
+		m_highWater = m_used;
+	return m_pBase + start;
+}
+
+// -----------------------------------------------------------------------------
+// Allocation hook
+// -----------------------------------------------------------------------------
+
+#if defined(_DEBUG) || defined(ARK_ALLOC_HOOK)
+
+static thread_local unsigned long t_allocations = 0;
+
+// each block carries its size and tag in front, so delete can give the bytes
+// back to the tag that was charged; 16 bytes keep malloc's alignment
+struct BlockHeader
+{
+	size_t bytes;
+	int    tag;
+	int    pad;
+};
+static const size_t HEADER_BYTES = 16;
+
+static void* hookedAlloc(size_t bytes)
+{
+	++t_allocations;
+	void* p = ::malloc(HEADER_BYTES + bytes);
+	if (p == NULL)
+		return NULL;
+	BlockHeader* h = static_cast<BlockHeader*>(p);
+	h->bytes = bytes;
+	h->tag   = mem::currentTag();
+	mem::charge(h->tag, mem::POOL_HEAP, bytes);
+	return static_cast<unsigned char*>(p) + HEADER_BYTES;
+}
+
+static void hookedFree(void* p)
+{
+	if (p == NULL)
+		return;
+	BlockHeader* h = reinterpret_cast<BlockHeader*>(static_cast<unsigned char*>(p) - HEADER_BYTES);
+	mem::release(h->tag, mem::POOL_HEAP, h->bytes);
+	::free(h);
+}
+
+static void* throwingAlloc(size_t bytes)
+{
+	void* p = hookedAlloc(bytes);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t bytes)                                 { return throwingAlloc(bytes); }
+void* operator new[](size_t bytes)                               { return throwingAlloc(bytes); }
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept   { return hookedAlloc(bytes); }
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept { return hookedAlloc(bytes); }
+void  operator delete(void* p) noexcept                          { hookedFree(p); }
+void  operator delete[](void* p) noexcept                        { hookedFree(p); }
+void  operator delete(void* p, size_t) noexcept                  { hookedFree(p); }
+void  operator delete[](void* p, size_t) noexcept                { hookedFree(p); }
+void  operator delete(void* p, const std::nothrow_t&) noexcept   { hookedFree(p); }
+void  operator delete[](void* p, const std::nothrow_t&) noexcept { hookedFree(p); }
+
+NoAllocScope::NoAllocScope(void)  { m_start = t_allocations; }
+NoAllocScope::~NoAllocScope(void) {}
+unsigned long NoAllocScope::count(void) const { return t_allocations - m_start; }
+bool NoAllocScope::hookEnabled(void) { return true; }
+
+#else
+
+NoAllocScope::NoAllocScope(void)  { m_start = 0; }
+NoAllocScope::~NoAllocScope(void) {}
+unsigned long NoAllocScope::count(void) const { return 0; }
+bool NoAllocScope::hookEnabled(void) { return false; }
+
+#endif
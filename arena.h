@@ -0,0 +1,76 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: arena.h
+// 
+// Desc: Linear (bump) allocator for per-level storage, and a debug guard that
+//       catches heap allocations in code that must not allocate (the per-frame
+//       update). The guard only counts when the allocation hook is compiled in
+//       (_DEBUG or ARK_ALLOC_HOOK builds), and then also charges every heap
+//       block to the current mem::Scope.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __arenaH__
+#define __arenaH__
+
+#include <cstddef>
+
+class LinearArena
+{
+public:
+	LinearArena(void);
+	~LinearArena(void);
+
+	// reserves the whole block up front; the only heap allocation the arena
+	// makes, charged to the current mem::Scope
+	bool init(size_t capacity);
+	void release(void);
+
+	// NULL when the block is exhausted, or the request is too big to add up
+	void* alloc(size_t bytes, size_t align = 16);
+
+	template<class T> T* allocArray(size_t count)
+	{
+		if (count > (size_t)-1 / sizeof(T))
+			return NULL;
+		return static_cast<T*>(alloc(sizeof(T) * (count ? count : 1), alignof(T) > 16 ? alignof(T) : 16));
+	}
+
+	// drops everything carved so far in O(1); nothing is destructed
+	void reset(void) { m_used = 0; }
+
+	size_t used(void) const     { return m_used; }
+	size_t capacity(void) const { return m_capacity; }
+	size_t highWater(void) const { return m_highWater; }
+
+private:
+	LinearArena(const LinearArena&);
+	LinearArena& operator=(const LinearArena&);
+
+	unsigned char* m_pBase;
+	size_t         m_capacity;
+	size_t         m_used;
+	size_t         m_highWater;
+	int            m_tag;       // mem::Tag the block is charged to
+};
+
+//
+// Counts heap allocations made by the current thread while it is alive; the
+// caller decides what a non-zero count means (assert in the game, a failed
+// check in the tools). With the hook compiled out count() is always 0.
+//
+class NoAllocScope
+{
+public:
+	NoAllocScope(void);
+	~NoAllocScope(void);
+
+	unsigned long count(void) const;
+
+	static bool hookEnabled(void);
+
+private:
+	unsigned long m_start;
+};
+
+#endif // __arenaH__
@@ -0,0 +1,538 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: arkEnv.cpp
+// 
+// Desc: The batched training environment behind arkEnv.h.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "arkEnv.h"
+#include "level.h"
+#include "jobSystem.h"
+#include "mappedFile.h"
+#include "memTrack.h"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+static const size_t BLOCK_ALIGN = 64;
+static const int    ENV_GRAIN   = 8;     // worlds per job chunk
+
+// per world bookkeeping next to its sim::World
+struct EnvSlot
+{
+	uint64_t        rng;                 // episode seeds
+	int             frame;
+	int             live;                // alive bits set
+	unsigned short* targetCells;         // live targets per grid cell
+	unsigned char*  background;          // walls and live targets, stamped with balls every step
+};
+
+struct ArkEnv
+{
+	ArkEnvConfig     config;
+	sim::Level       level;
+	sim::World*      worlds;
+	EnvSlot*         slots;
+	int              envCount;
+	int              maxBalls;
+	int              targetCount;
+	int              aliveWords;
+
+	// occupancy grid
+	int              gridW, gridH;
+	sim::Vec2        gridOrigin;
+	sim::Scalar      gridInvCell;
+	unsigned char*   wallCells;          // the walls alone, shared by every world
+	int*             targetCell;         // grid cell of every target
+
+	LinearArena      arena;              // slots, grids and the owned block
+	JobSystem        jobs;
+	MappedFile       file;
+
+	ArkEnvHeader     layout;             // offsets, copied into every block
+	unsigned char*   ownBlock;
+	size_t           blockBytes;
+	ArkEnvBuffers    buffers;
+
+	const ArkAction* actions;            // for the step jobs
+};
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+static uint64_t splitMix(uint64_t& state)
+{
+	uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static size_t alignUp(size_t n)
+{
+	return (n + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1);
+}
+
+static int cellOf(const ArkEnv* env, const sim::Vec2& p)
+{
+	int x = sim::floorToInt((p.x - env->gridOrigin.x) * env->gridInvCell);
+	int z = sim::floorToInt((p.z - env->gridOrigin.z) * env->gridInvCell);
+	x = x < 0 ? 0 : (x >= env->gridW ? env->gridW - 1 : x);
+	z = z < 0 ? 0 : (z >= env->gridH ? env->gridH - 1 : z);
+	return z * env->gridW + x;
+}
+
+static void growBounds(sim::Aabb& b, const sim::Vec2& p)
+{
+	b.lo.x = p.x < b.lo.x ? p.x : b.lo.x;
+	b.lo.z = p.z < b.lo.z ? p.z : b.lo.z;
+	b.hi.x = p.x > b.hi.x ? p.x : b.hi.x;
+	b.hi.z = p.z > b.hi.z ? p.z : b.hi.z;
+}
+
+// the play area: walls, targets, the paddle's travel and the exit
+static sim::Aabb levelBounds(const sim::Level& level)
+{
+	sim::Aabb b(level.paddleStart, level.paddleStart);
+	size_t i;
+	for (i = 0; i < level.walls.size(); i++)   { growBounds(b, level.walls[i].lo);  growBounds(b, level.walls[i].hi); }
+	for (i = 0; i < level.bricks.size(); i++)  { growBounds(b, level.bricks[i].lo); growBounds(b, level.bricks[i].hi); }
+	for (i = 0; i < level.spheres.size(); i++) growBounds(b, level.spheres[i]);
+	for (i = 0; i < level.balls.size(); i++)   growBounds(b, level.balls[i].pos);
+	growBounds(b, sim::Vec2(level.exitX, level.paddleMinZ));
+	growBounds(b, sim::Vec2(level.paddleStart.x, level.paddleMaxZ));
+	return b;
+}
+
+// -----------------------------------------------------------------------------
+// Observations
+// -----------------------------------------------------------------------------
+
+static void rebuildTargets(ArkEnv* env, int i)
+{
+	const sim::World& w = env->worlds[i];
+	uint32_t* alive = env->buffers.alive + (size_t)i * env->aliveWords;
+	::memset(alive, 0, sizeof(uint32_t) * env->aliveWords);
+	env->slots[i].live = 0;
+	for (int t = 0; t < env->targetCount; t++) {
+		bool live = t < w.sphereCount() ? w.sphereAlive()[t] != 0 : w.brickAlive()[t - w.sphereCount()] != 0;
+		if (live) {
+			alive[t >> 5] |= 1u << (t & 31);
+			env->slots[i].live++;
+		}
+	}
+
+	if (env->gridW == 0)
+		return;
+	EnvSlot& s = env->slots[i];
+	int cells = env->gridW * env->gridH;
+	::memset(s.targetCells, 0, sizeof(unsigned short) * cells);
+	::memcpy(s.background, env->wallCells, cells);
+	for (int t = 0; t < env->targetCount; t++) {
+		if (alive[t >> 5] & (1u << (t & 31))) {
+			int c = env->targetCell[t];
+			s.targetCells[c]++;
+			s.background[c] = ARK_CELL_TARGET;
+		}
+	}
+}
+
+static void clearTarget(ArkEnv* env, int i, int t)
+{
+	uint32_t* alive = env->buffers.alive + (size_t)i * env->aliveWords;
+	alive[t >> 5] &= ~(1u << (t & 31));
+	EnvSlot& s = env->slots[i];
+	s.live--;
+	if (env->gridW == 0)
+		return;
+	int c = env->targetCell[t];
+	if (--s.targetCells[c] == 0)
+		s.background[c] = env->wallCells[c];
+}
+
+// everything but the alive bits, which follow the hit events
+static void writeState(ArkEnv* env, int i)
+{
+	const sim::World& w = env->worlds[i];
+	float*   balls  = env->buffers.balls + (size_t)i * env->maxBalls * 4;
+	uint8_t* active = env->buffers.ballActive + (size_t)i * env->maxBalls;
+	for (int b = 0; b < env->maxBalls; b++) {
+		const sim::Ball& ball = w.balls()[b];
+		active[b] = w.ballActive()[b];
+		balls[b * 4 + 0] = active[b] ? sim::toFloat(ball.pos.x) : 0.0f;
+		balls[b * 4 + 1] = active[b] ? sim::toFloat(ball.pos.z) : 0.0f;
+		balls[b * 4 + 2] = active[b] ? sim::toFloat(ball.vel.x) : 0.0f;
+		balls[b * 4 + 3] = active[b] ? sim::toFloat(ball.vel.z) : 0.0f;
+	}
+	float* paddle = env->buffers.paddle + (size_t)i * 4;
+	paddle[0] = sim::toFloat(w.paddle().pos.x);
+	paddle[1] = sim::toFloat(w.paddle().pos.z);
+	paddle[2] = sim::toFloat(w.paddle().vel.x);
+	paddle[3] = sim::toFloat(w.paddle().vel.z);
+	env->buffers.frame[i] = env->slots[i].frame;
+
+	if (env->gridW == 0)
+		return;
+	int cells = env->gridW * env->gridH;
+	uint8_t* grid = env->buffers.grid + (size_t)i * cells;
+	::memcpy(grid, env->slots[i].background, cells);
+	for (int b = 0; b < env->maxBalls; b++)
+		if (active[b])
+			grid[cellOf(env, w.balls()[b].pos)] = ARK_CELL_BALL;
+	grid[cellOf(env, w.paddle().pos)] = ARK_CELL_PADDLE;
+}
+
+// -----------------------------------------------------------------------------
+// Episodes
+// -----------------------------------------------------------------------------
+
+static void startEpisode(ArkEnv* env, int i)
+{
+	sim::World& w = env->worlds[i];
+	EnvSlot&    s = env->slots[i];
+	float u = (splitMix(s.rng) >> 40) * (1.0f / 16777216.0f);
+	w.movePaddle(env->level.paddleMinZ + sim::Scalar(u) * (env->level.paddleMaxZ - env->level.paddleMinZ));
+	w.resetLevel();   // parks the ball on the white ball
+	s.frame = 0;
+	rebuildTargets(env, i);
+	writeState(env, i);
+}
+
+static void stepWorld(ArkEnv* env, int i)
+{
+	sim::World&      w = env->worlds[i];
+	EnvSlot&         s = env->slots[i];
+	const ArkAction& a = env->actions[i];
+	const int        sphereCount = w.sphereCount();
+
+	// clamping can't place a NaN, and it would reach the ball through the paddle
+	if (std::isfinite(a.paddleZ))
+		w.movePaddle(sim::Scalar(a.paddleZ));
+	if (a.launch && !w.isPlaying())
+		w.launch();
+
+	float reward = 0.0f;
+	int   done   = ARK_DONE_NONE;
+	for (int f = 0; f < env->config.frameSkip && done == ARK_DONE_NONE; f++) {
+		w.step(sim::Scalar(env->config.dt));
+		s.frame++;
+
+		for (int e = 0; e < w.eventCount(); e++) {
+			const sim::Event& ev = w.events()[e];
+			if (ev.kind == sim::EVENT_TARGET_HIT || ev.kind == sim::EVENT_BRICK_HIT) {
+				reward += env->config.hitReward;
+				clearTarget(env, i, ev.kind == sim::EVENT_TARGET_HIT ? ev.index : sphereCount + ev.index);
+			}
+			else if (ev.kind == sim::EVENT_BALL_LOST && ev.index == 0) {
+				reward += env->config.lostReward;
+				done = ARK_DONE_LOST;
+			}
+		}
+
+		// a step with more hits than the world keeps events for falls back
+		// to reading the alive flags
+		if (done == ARK_DONE_NONE && s.live != w.liveTargets())
+			rebuildTargets(env, i);
+
+		if (done == ARK_DONE_NONE && w.liveTargets() == 0)
+			done = ARK_DONE_CLEARED;
+		else if (done == ARK_DONE_NONE && env->config.maxFrames > 0 && s.frame >= env->config.maxFrames)
+			done = ARK_DONE_TIME;
+	}
+
+	env->buffers.reward[i] = reward;
+	env->buffers.done[i]   = (uint8_t)done;
+	if (done != ARK_DONE_NONE)
+		startEpisode(env, i);
+	else
+		writeState(env, i);
+}
+
+static void stepRange(void* ctx, int begin, int end, int)
+{
+	ArkEnv* env = static_cast<ArkEnv*>(ctx);
+	for (int i = begin; i < end; i++)
+		stepWorld(env, i);
+}
+
+static void startRange(void* ctx, int begin, int end, int)
+{
+	ArkEnv* env = static_cast<ArkEnv*>(ctx);
+	for (int i = begin; i < end; i++)
+		startEpisode(env, i);
+}
+
+static void forEachWorld(ArkEnv* env, JobSystem::RangeFn fn)
+{
+	if (env->jobs.threadCount() > 1)
+		env->jobs.parallelFor(env->envCount, ENV_GRAIN, fn, env);
+	else
+		fn(env, 0, env->envCount, 0);
+}
+
+// -----------------------------------------------------------------------------
+// Block layout
+// -----------------------------------------------------------------------------
+
+static void planLayout(ArkEnv* env)
+{
+	ArkEnvHeader& h = env->layout;
+	::memset(&h, 0, sizeof(h));
+	h.magic       = ARK_ENV_MAGIC;
+	h.version     = ARK_ENV_VERSION;
+	h.envCount    = env->envCount;
+	h.maxBalls    = env->maxBalls;
+	h.targetCount = env->targetCount;
+	h.aliveWords  = env->aliveWords;
+	h.gridW       = env->gridW;
+	h.gridH       = env->gridH;
+
+	size_t n = env->envCount;
+	size_t at = alignUp(sizeof(ArkEnvHeader));
+	h.ballsOffset      = (uint32_t)at; at = alignUp(at + sizeof(float) * 4 * env->maxBalls * n);
+	h.ballActiveOffset = (uint32_t)at; at = alignUp(at + env->maxBalls * n);
+	h.paddleOffset     = (uint32_t)at; at = alignUp(at + sizeof(float) * 4 * n);
+	h.aliveOffset      = (uint32_t)at; at = alignUp(at + sizeof(uint32_t) * env->aliveWords * n);
+	if (env->gridW > 0) {
+		h.gridOffset   = (uint32_t)at; at = alignUp(at + (size_t)env->gridW * env->gridH * n);
+	}
+	h.rewardOffset     = (uint32_t)at; at = alignUp(at + sizeof(float) * n);
+	h.doneOffset       = (uint32_t)at; at = alignUp(at + n);
+	h.frameOffset      = (uint32_t)at; at = alignUp(at + sizeof(int32_t) * n);
+	env->blockBytes = at;
+}
+
+static void useBlock(ArkEnv* env, unsigned char* block)
+{
+	::memset(block, 0, env->blockBytes);
+	::memcpy(block, &env->layout, sizeof(ArkEnvHeader));
+
+	const ArkEnvHeader& h = env->layout;
+	ArkEnvBuffers& b = env->buffers;
+	b.header     = reinterpret_cast<ArkEnvHeader*>(block);
+	b.balls      = reinterpret_cast<float*>(block + h.ballsOffset);
+	b.ballActive = block + h.ballActiveOffset;
+	b.paddle     = reinterpret_cast<float*>(block + h.paddleOffset);
+	b.alive      = reinterpret_cast<uint32_t*>(block + h.aliveOffset);
+	b.grid       = h.gridOffset ? block + h.gridOffset : NULL;
+	b.reward     = reinterpret_cast<float*>(block + h.rewardOffset);
+	b.done       = block + h.doneOffset;
+	b.frame      = reinterpret_cast<int32_t*>(block + h.frameOffset);
+
+	for (int i = 0; i < env->envCount; i++) {
+		rebuildTargets(env, i);
+		writeState(env, i);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// C interface
+// -----------------------------------------------------------------------------
+
+void ark_env_default_config(ArkEnvConfig* c)
+{
+	c->levelPath  = NULL;
+	c->envCount   = 1;
+	c->threads    = 1;
+	c->dt         = 0.016f * 0.7f;   // EnterMsgLoop's scale at 60 Hz
+	c->frameSkip  = 1;
+	c->maxFrames  = 0;
+	c->gridW      = 0;
+	c->gridH      = 0;
+	c->hitReward  = 1.0f;
+	c->lostReward = -1.0f;
+}
+
+ArkEnv* ark_env_create(const ArkEnvConfig* config)
+{
+	mem::Scope tag(mem::TAG_ENV);
+	if (config == NULL || config->envCount < 1 || config->frameSkip < 1)
+		return NULL;
+
+	ArkEnv* env = new (std::nothrow) ArkEnv;
+	if (env == NULL)
+		return NULL;
+	env->config          = *config;
+	env->config.levelPath = NULL;
+	env->envCount        = config->envCount;
+	env->worlds          = NULL;
+	env->actions         = NULL;
+	env->ownBlock        = NULL;
+	if (config->levelPath) {
+		if (!sim::loadLevelFile(config->levelPath, env->level)) {
+			delete env;
+			return NULL;
+		}
+	}
+	else
+		sim::defaultLevel(env->level);
+
+	// every world gets exactly the arena a trial load says the level needs
+	size_t need;
+	{
+		sim::World trial;
+		if (!trial.init((size_t)64 << 20) || !trial.loadLevel(env->level.desc())) {
+			delete env;
+			return NULL;
+		}
+		need = trial.arena().highWater();
+	}
+	env->worlds = new (std::nothrow) sim::World[env->envCount];
+	if (env->worlds == NULL) {
+		delete env;
+		return NULL;
+	}
+	for (int i = 0; i < env->envCount; i++) {
+		if (!env->worlds[i].init(need) || !env->worlds[i].loadLevel(env->level.desc())) {
+			ark_env_destroy(env);
+			return NULL;
+		}
+	}
+
+	const sim::World& w0 = env->worlds[0];
+	env->maxBalls    = w0.ballCount();
+	env->targetCount = w0.sphereCount() + w0.brickCount();
+	env->aliveWords  = (env->targetCount + 31) / 32;
+	env->gridW       = config->gridW > 0 && config->gridH > 0 ? config->gridW : 0;
+	env->gridH       = env->gridW ? config->gridH : 0;
+	planLayout(env);
+
+	int    cells = env->gridW * env->gridH;
+	size_t bytes = sizeof(EnvSlot) * env->envCount + env->blockBytes + BLOCK_ALIGN * 8 +
+		(size_t)cells + sizeof(int) * env->targetCount +
+		((size_t)cells * (sizeof(unsigned short) + 1) + BLOCK_ALIGN) * env->envCount;
+	if (!env->arena.init(bytes)) {
+		ark_env_destroy(env);
+		return NULL;
+	}
+	env->slots    = env->arena.allocArray<EnvSlot>(env->envCount);
+	env->ownBlock = static_cast<unsigned char*>(env->arena.alloc(env->blockBytes, BLOCK_ALIGN));
+	for (int i = 0; i < env->envCount; i++) {
+		env->slots[i].rng         = 0;
+		env->slots[i].frame       = 0;
+		env->slots[i].targetCells = cells ? env->arena.allocArray<unsigned short>(cells) : NULL;
+		env->slots[i].background  = cells ? env->arena.allocArray<unsigned char>(cells) : NULL;
+	}
+
+	// the grid covers the play area with square cells
+	env->wallCells  = NULL;
+	env->targetCell = NULL;
+	if (cells) {
+		sim::Aabb area = levelBounds(env->level);
+		sim::Scalar cw = (area.hi.x - area.lo.x) / env->gridW, ch = (area.hi.z - area.lo.z) / env->gridH;
+		sim::Scalar cell = cw > ch ? cw : ch;
+		env->gridOrigin  = area.lo;
+		env->gridInvCell = cell > 0 ? 1 / cell : 1;
+		env->wallCells   = env->arena.allocArray<unsigned char>(cells);
+		env->targetCell  = env->arena.allocArray<int>(env->targetCount);
+		::memset(env->wallCells, ARK_CELL_EMPTY, cells);
+		for (int z = 0; z < env->gridH; z++) {
+			for (int x = 0; x < env->gridW; x++) {
+				sim::Vec2 p(area.lo.x + sim::Scalar(x + 0.5f) * cell, area.lo.z + sim::Scalar(z + 0.5f) * cell);
+				for (int k = 0; k < w0.wallCount(); k++) {
+					const sim::Aabb& wall = w0.walls()[k];
+					if (p.x >= wall.lo.x && p.x <= wall.hi.x && p.z >= wall.lo.z && p.z <= wall.hi.z)
+						env->wallCells[z * env->gridW + x] = ARK_CELL_WALL;
+				}
+				if (w0.field().isBaked()) {
+					sim::Vec2 n;
+					if (w0.field().sample(p, n) < 0)
+						env->wallCells[z * env->gridW + x] = ARK_CELL_WALL;
+				}
+			}
+		}
+		for (int t = 0; t < env->targetCount; t++) {
+			sim::Vec2 c;
+			if (t < w0.sphereCount())
+				c = w0.spheres()[t];
+			else {
+				const sim::Aabb& brick = w0.bricks()[t - w0.sphereCount()];
+				c = sim::Vec2((brick.lo.x + brick.hi.x) * sim::Scalar(0.5f), (brick.lo.z + brick.hi.z) * sim::Scalar(0.5f));
+			}
+			env->targetCell[t] = cellOf(env, c);
+		}
+	}
+	if (env->slots == NULL || env->ownBlock == NULL || (cells && env->targetCell == NULL)) {
+		ark_env_destroy(env);
+		return NULL;
+	}
+
+	if (config->threads > 1 && !env->jobs.start(config->threads)) {
+		ark_env_destroy(env);
+		return NULL;
+	}
+
+	useBlock(env, env->ownBlock);
+	ark_env_reset(env, 0);
+	return env;
+}
+
+void ark_env_destroy(ArkEnv* env)
+{
+	if (env == NULL)
+		return;
+	env->jobs.stop();
+	env->file.close();
+	delete [] env->worlds;
+	delete env;
+}
+
+size_t ark_env_buffer_bytes(const ArkEnv* env)
+{
+	return env->blockBytes;
+}
+
+int ark_env_bind(ArkEnv* env, void* block, size_t bytes)
+{
+	if (block == NULL || bytes < env->blockBytes || ((size_t)block & (BLOCK_ALIGN - 1)) != 0)
+		return 0;
+	uint64_t steps = env->buffers.header->steps;
+	useBlock(env, static_cast<unsigned char*>(block));
+	env->buffers.header->steps = steps;
+	return 1;
+}
+
+int ark_env_map(ArkEnv* env, const char* path)
+{
+	mem::Scope tag(mem::TAG_ENV);
+	// the view may be the block in use, so observations move home before it goes
+	if (env->file.isOpen()) {
+		ark_env_bind(env, env->ownBlock, env->blockBytes);
+		env->file.close();
+	}
+	if (!env->file.create(path, env->blockBytes))
+		return 0;
+	return ark_env_bind(env, env->file.data(), env->file.size());
+}
+
+const ArkEnvBuffers* ark_env_buffers(const ArkEnv* env)
+{
+	return &env->buffers;
+}
+
+const ArkEnvBuffers* ark_env_reset(ArkEnv* env, uint64_t seed)
+{
+	for (int i = 0; i < env->envCount; i++) {
+		uint64_t s = seed ^ ((uint64_t)i * 0xd1342543de82ef95ull);
+		env->slots[i].rng = splitMix(s);
+		env->buffers.reward[i] = 0.0f;
+		env->buffers.done[i]   = ARK_DONE_NONE;
+	}
+	forEachWorld(env, startRange);
+	std::atomic_thread_fence(std::memory_order_release);
+	env->buffers.header->steps = 0;
+	return &env->buffers;
+}
+
+const ArkEnvBuffers* ark_env_step(ArkEnv* env, const ArkAction* actions)
+{
+	env->actions = actions;
+	forEachWorld(env, stepRange);
+	env->actions = NULL;
+	std::atomic_thread_fence(std::memory_order_release);
+	env->buffers.header->steps++;
+	return &env->buffers;
+}
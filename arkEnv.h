@@ -0,0 +1,156 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: arkEnv.h
+// 
+// Desc: C interface for training paddle-control agents without a window. One
+//       environment steps a batch of independent worlds with the same level;
+//       every step takes one action per world and writes rewards, episode
+//       ends and observations straight into a single block of memory that the
+//       caller can own, share through a mapped file, or leave to the
+//       environment. Nothing is copied on the way out: the arrays in
+//       ArkEnvBuffers are the observation. Plain C, so it loads from ctypes,
+//       cffi or any other FFI as a shared library, e.g.
+//
+//           g++ -O2 -shared -fPIC -I. arkEnv.cpp level.cpp gameWorld.cpp distanceField.cpp jobSystem.cpp arena.cpp memTrack.cpp perfCounters.cpp mappedFile.cpp -pthread -o libarkenv.so
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __arkEnvH__
+#define __arkEnvH__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(ARK_ENV_EXPORTS)
+#define ARK_ENV_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define ARK_ENV_API __attribute__((visibility("default")))
+#else
+#define ARK_ENV_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARK_ENV_MAGIC   0x564e4541u   /* 'AENV' */
+#define ARK_ENV_VERSION 1
+
+/* done[] values */
+enum
+{
+	ARK_DONE_NONE = 0,
+	ARK_DONE_LOST,          /* the red ball went out; terminal */
+	ARK_DONE_CLEARED,       /* every target is down; terminal */
+	ARK_DONE_TIME           /* ran into maxFrames; truncated */
+};
+
+/* occupancy grid cells */
+enum
+{
+	ARK_CELL_EMPTY = 0,
+	ARK_CELL_WALL,
+	ARK_CELL_TARGET,        /* a live sphere or brick */
+	ARK_CELL_BALL,
+	ARK_CELL_PADDLE
+};
+
+typedef struct ArkEnvConfig
+{
+	const char* levelPath;      /* level file (see level.h); NULL for the built-in level */
+	int         envCount;       /* worlds stepped together */
+	int         threads;        /* worlds are split across this many threads; 1 steps them inline */
+	float       dt;             /* passed to World::step(); the game's is 0.0112 at 60 Hz */
+	int         frameSkip;      /* world steps per ark_env_step(), the action held throughout */
+	int         maxFrames;      /* episodes are cut after this many world steps; 0 never */
+	int         gridW, gridH;   /* occupancy grid over the level; 0 leaves it out */
+	float       hitReward;      /* per target or brick knocked down */
+	float       lostReward;     /* when the red ball goes out */
+} ArkEnvConfig;
+
+typedef struct ArkAction
+{
+	float paddleZ;              /* where the white ball should be, clamped to its range; NaN or inf leaves it where it is */
+	int   launch;               /* non-zero launches a parked ball, like VK_SPACE */
+} ArkAction;
+
+/*
+ * Start of the observation block. Offsets are in bytes from the start of the
+ * block and 64-byte aligned, so another process mapping the same file can
+ * find the arrays without linking this library.
+ */
+typedef struct ArkEnvHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t envCount;
+	uint32_t maxBalls;          /* ball slots per world; the red ball is slot 0 */
+	uint32_t targetCount;       /* spheres, then bricks */
+	uint32_t aliveWords;        /* 32-bit words of alive bits per world */
+	uint32_t gridW, gridH;
+	uint32_t ballsOffset;
+	uint32_t ballActiveOffset;
+	uint32_t paddleOffset;
+	uint32_t aliveOffset;
+	uint32_t gridOffset;        /* 0 without a grid */
+	uint32_t rewardOffset;
+	uint32_t doneOffset;
+	uint32_t frameOffset;
+	uint64_t steps;             /* ark_env_step() calls so far, stored after the arrays */
+} ArkEnvHeader;
+
+typedef struct ArkEnvBuffers
+{
+	ArkEnvHeader* header;
+	float*        balls;        /* envCount x maxBalls x (x, z, vx, vz); zeros for lost balls */
+	uint8_t*      ballActive;   /* envCount x maxBalls */
+	float*        paddle;       /* envCount x (x, z, vx, vz) */
+	uint32_t*     alive;        /* envCount x aliveWords; bit t % 32 of word t / 32 is target t */
+	uint8_t*      grid;         /* envCount x gridH x gridW ARK_CELL_ values, row z, column x; NULL without a grid */
+	float*        reward;       /* envCount, summed over the step's frames */
+	uint8_t*      done;         /* envCount, ARK_DONE_ values */
+	int32_t*      frame;        /* envCount, world steps into the current episode */
+} ArkEnvBuffers;
+
+typedef struct ArkEnv ArkEnv;
+
+ARK_ENV_API void    ark_env_default_config(ArkEnvConfig* config);
+
+/* NULL if the level can't be loaded or memory runs out */
+ARK_ENV_API ArkEnv* ark_env_create(const ArkEnvConfig* config);
+ARK_ENV_API void    ark_env_destroy(ArkEnv* env);
+
+/*
+ * Where observations go. By default the environment owns the block; bind()
+ * moves it into caller memory (64-byte aligned, at least buffer_bytes() long)
+ * and map() into a file that other processes can map too. Both return 0 on
+ * failure; bind() then leaves the previous block in use and map() the
+ * environment's own. The pointers in the buffers change with the block, and
+ * the current state is written to the new one. map() reuses an existing file,
+ * growing it when it is short but never truncating it, so a process that
+ * still maps the file keeps valid pages; bytes past buffer_bytes() are left
+ * as they were.
+ */
+ARK_ENV_API size_t               ark_env_buffer_bytes(const ArkEnv* env);
+ARK_ENV_API int                  ark_env_bind(ArkEnv* env, void* block, size_t bytes);
+ARK_ENV_API int                  ark_env_map(ArkEnv* env, const char* path);
+ARK_ENV_API const ArkEnvBuffers* ark_env_buffers(const ArkEnv* env);
+
+/*
+ * Starts an episode in every world. The seed decides where each world's
+ * white ball starts; the same seed replays the same episodes.
+ */
+ARK_ENV_API const ArkEnvBuffers* ark_env_reset(ArkEnv* env, uint64_t seed);
+
+/*
+ * One action per world. A world whose episode ended in this step reports its
+ * reward and done, and is already reset: its observation is the first one
+ * of the next episode.
+ */
+ARK_ENV_API const ArkEnvBuffers* ark_env_step(ArkEnv* env, const ArkAction* actions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __arkEnvH__ */
@@ -0,0 +1,263 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: audioMixer.cpp
+// 
+// Desc: AudioMixer voice management and mixing.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "audioMixer.h"
+#include "memTrack.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MIXER_SSE
+#include <emmintrin.h>
+#endif
+
+static const float SAMPLE_SCALE = 1.0f / 32768.0f;
+
+audio::AudioMixer::AudioMixer(void)
+	: m_dropped(0)
+{
+	m_bank       = NULL;
+	m_outputRate = 44100;
+	m_masterGain = 1.0f;
+	m_voices     = NULL;
+	m_voiceCount = 0;
+	m_active     = 0;
+	m_serial     = 0;
+	m_accL       = NULL;
+	m_accR       = NULL;
+	m_maxFrames  = 0;
+	m_stolen     = 0;
+	m_processed  = 0;
+}
+
+bool audio::AudioMixer::init(const SoundBank* bank, int outputRate, int maxVoices, int maxFrames, float masterGain)
+{
+	mem::Scope tag(mem::TAG_AUDIO);
+	maxFrames = (maxFrames + 3) & ~3;
+	if (!m_arena.init(sizeof(Voice) * maxVoices + sizeof(float) * 2 * maxFrames + 4 * 16))
+		return false;
+	m_voices = m_arena.allocArray<Voice>(maxVoices);
+	m_accL   = m_arena.allocArray<float>(maxFrames);
+	m_accR   = m_arena.allocArray<float>(maxFrames);
+	if (!m_voices || !m_accL || !m_accR)
+		return false;
+	for (int i = 0; i < maxVoices; i++)
+		m_voices[i].active = false;
+
+	m_bank       = bank;
+	m_outputRate = outputRate;
+	m_voiceCount = maxVoices;
+	m_maxFrames  = maxFrames;
+	m_masterGain = masterGain;
+	m_active     = 0;
+	return true;
+}
+
+bool audio::AudioMixer::play(int sound, float gain, float pitch, float pan)
+{
+	Command c;
+	c.type  = COMMAND_PLAY;
+	c.sound = sound;
+	c.gain  = gain;
+	c.pitch = pitch;
+	c.pan   = pan;
+	if (m_queue.push(c))
+		return true;
+	m_dropped.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+bool audio::AudioMixer::stopAll(void)
+{
+	Command c;
+	::memset(&c, 0, sizeof(c));
+	c.type = COMMAND_STOP_ALL;
+	if (m_queue.push(c))
+		return true;
+	m_dropped.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void audio::AudioMixer::drainCommands(void)
+{
+	Command c;
+	while (m_queue.pop(c)) {
+		m_processed++;
+		if (c.type == COMMAND_STOP_ALL) {
+			for (int i = 0; i < m_voiceCount; i++)
+				m_voices[i].active = false;
+			m_active = 0;
+		}
+		else {
+			startVoice(c);
+		}
+	}
+}
+
+void audio::AudioMixer::startVoice(const Command& c)
+{
+	if (m_bank == NULL || c.sound < 0 || c.sound >= m_bank->soundCount() || c.pitch <= 0.0f)
+		return;
+
+	// a free voice, or else the one quietest right now, the oldest among equals
+	Voice* v = NULL;
+	for (int i = 0; i < m_voiceCount && v == NULL; i++)
+		if (!m_voices[i].active) v = &m_voices[i];
+	if (v == NULL) {
+		v = &m_voices[0];
+		float vLevel = currentLevel(*v);
+		for (int i = 1; i < m_voiceCount; i++) {
+			const Voice& o = m_voices[i];
+			float level = currentLevel(o);
+			if (level < vLevel || (level == vLevel && o.serial - v->serial > 0x80000000u)) {
+				v      = &m_voices[i];
+				vLevel = level;
+			}
+		}
+		m_stolen++;
+		m_active--;
+	}
+
+	const Sound& s = m_bank->sound(c.sound);
+	double step = (double)c.pitch * s.sampleRate / m_outputRate;
+	float pan   = c.pan < -1.0f ? -1.0f : (c.pan > 1.0f ? 1.0f : c.pan);
+	float gain  = c.gain * m_masterGain * SAMPLE_SCALE;
+
+	v->sound    = &s;
+	v->pos      = 0;
+	v->step     = (uint64_t)(step * 4294967296.0);
+	v->end      = (uint64_t)(s.frames - 1) << 32;
+	v->gainL    = gain * (pan > 0.0f ? 1.0f - pan : 1.0f);
+	v->gainR    = gain * (pan < 0.0f ? 1.0f + pan : 1.0f);
+	v->serial   = m_serial++;
+	v->active   = true;
+	if (v->step == 0)
+		v->step = 1;
+	m_active++;
+}
+
+// how loud the voice is about to be: its gain times the peak of the samples
+// it plays over the next STEAL_WINDOW output frames. A sound well into its
+// decay counts as quiet however loud it started. Only run when stealing.
+static const int STEAL_WINDOW = 64;
+
+float audio::AudioMixer::currentLevel(const Voice& v) const
+{
+	const int16_t* d = v.sound->samples;
+	int from = (int)(v.pos >> 32);
+	int to   = (int)((v.pos + v.step * STEAL_WINDOW) >> 32);
+	int last = (int)(v.end >> 32);
+	if (to > last)
+		to = last;
+	int peak = 0;
+	for (int i = from; i <= to; i++) {
+		int a = d[i] < 0 ? -d[i] : d[i];
+		if (a > peak) peak = a;
+	}
+	return (float)peak * (v.gainL > v.gainR ? v.gainL : v.gainR);
+}
+
+// adds one voice into the accumulators; the SSE path interpolates four output
+// frames at a time with exactly the scalar arithmetic, so both give the same bits
+void audio::AudioMixer::mixVoice(Voice& v, int frames, bool simd)
+{
+	const int16_t* d = v.sound->samples;
+
+	// frames left before the voice runs out of samples
+	uint64_t left = (v.end - v.pos + v.step - 1) / v.step;
+	int n = left < (uint64_t)frames ? (int)left : frames;
+	int f = 0;
+
+#ifdef MIXER_SSE
+	if (simd) {
+		const __m128 gl    = _mm_set1_ps(v.gainL);
+		const __m128 gr    = _mm_set1_ps(v.gainR);
+		const __m128 scale = _mm_set1_ps(1.0f / 65536.0f);
+		for (; f + 4 <= n; f += 4) {
+			uint64_t p0 = v.pos, p1 = p0 + v.step, p2 = p1 + v.step, p3 = p2 + v.step;
+			int i0 = (int)(p0 >> 32), i1 = (int)(p1 >> 32), i2 = (int)(p2 >> 32), i3 = (int)(p3 >> 32);
+			__m128 s0 = _mm_setr_ps(d[i0], d[i1], d[i2], d[i3]);
+			__m128 s1 = _mm_setr_ps(d[i0 + 1], d[i1 + 1], d[i2 + 1], d[i3 + 1]);
+			__m128i fi = _mm_setr_epi32((int)((p0 >> 16) & 0xffff), (int)((p1 >> 16) & 0xffff),
+				(int)((p2 >> 16) & 0xffff), (int)((p3 >> 16) & 0xffff));
+			__m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(fi), scale);
+			__m128 s = _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(s1, s0), frac));
+			_mm_store_ps(m_accL + f, _mm_add_ps(_mm_load_ps(m_accL + f), _mm_mul_ps(s, gl)));
+			_mm_store_ps(m_accR + f, _mm_add_ps(_mm_load_ps(m_accR + f), _mm_mul_ps(s, gr)));
+			v.pos = p3 + v.step;
+		}
+	}
+#else
+	(void)simd;
+#endif
+
+	for (; f < n; f++) {
+		int   i    = (int)(v.pos >> 32);
+		float frac = (float)(int)((v.pos >> 16) & 0xffff) * (1.0f / 65536.0f);
+		float s0   = d[i];
+		float s    = s0 + (d[i + 1] - s0) * frac;
+		m_accL[f] = m_accL[f] + s * v.gainL;
+		m_accR[f] = m_accR[f] + s * v.gainR;
+		v.pos += v.step;
+	}
+
+	if (v.pos >= v.end) {
+		v.active = false;
+		m_active--;
+	}
+}
+
+void audio::AudioMixer::mix(int16_t* out, int frames, bool simd)
+{
+	drainCommands();
+
+	while (frames > 0) {
+		int n = frames < m_maxFrames ? frames : m_maxFrames;
+		::memset(m_accL, 0, sizeof(float) * n);
+		::memset(m_accR, 0, sizeof(float) * n);
+
+		for (int i = 0; i < m_voiceCount; i++)
+			if (m_voices[i].active)
+				mixVoice(m_voices[i], n, simd);
+
+		// clamp, round to nearest and interleave
+		int f = 0;
+#ifdef MIXER_SSE
+		if (simd) {
+			const __m128 lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f), k = _mm_set1_ps(32767.0f);
+			for (; f + 4 <= n; f += 4) {
+				__m128 l = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_load_ps(m_accL + f), k), lo), hi);
+				__m128 r = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_load_ps(m_accR + f), k), lo), hi);
+				__m128i a = _mm_cvtps_epi32(_mm_unpacklo_ps(l, r));
+				__m128i b = _mm_cvtps_epi32(_mm_unpackhi_ps(l, r));
+				_mm_storeu_si128((__m128i*)(out + 2 * f), _mm_packs_epi32(a, b));
+			}
+		}
+#endif
+		for (; f < n; f++) {
+			float l = m_accL[f] * 32767.0f, r = m_accR[f] * 32767.0f;
+			l = l < -32768.0f ? -32768.0f : (l > 32767.0f ? 32767.0f : l);
+			r = r < -32768.0f ? -32768.0f : (r > 32767.0f ? 32767.0f : r);
+			out[2 * f]     = (int16_t)std::lrint(l);
+			out[2 * f + 1] = (int16_t)std::lrint(r);
+		}
+
+		out    += 2 * n;
+		frames -= n;
+	}
+}
+
+void audio::AudioMixer::render(int16_t* out, int frames)
+{
+	mix(out, frames, true);
+}
+
+void audio::AudioMixer::renderScalar(int16_t* out, int frames)
+{
+	mix(out, frames, false);
+}
@@ -0,0 +1,103 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: audioMixer.h
+// 
+// Desc: Software mixer for the game's sound effects. The game thread posts
+//       play commands through a wait-free SpscQueue and never waits on audio;
+//       the audio thread drains the queue at the start of each render() and
+//       mixes every playing voice into a 16-bit stereo buffer. Voices are
+//       resampled from the bank's rate with linear interpolation and carry
+//       their own gain and pan; when all voices are busy the one that is
+//       quietest right now (then the oldest) is stolen. No locks and no allocation after init().
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __audioMixerH__
+#define __audioMixerH__
+
+#include "arena.h"
+#include "soundBank.h"
+#include "spscQueue.h"
+
+namespace audio
+{
+	struct Command
+	{
+		int   type;                 // CommandType
+		int   sound;                // SoundId
+		float gain;
+		float pitch;                // 1 plays at the recorded speed
+		float pan;                  // -1 left .. 1 right
+	};
+
+	enum CommandType
+	{
+		COMMAND_PLAY = 0,
+		COMMAND_STOP_ALL
+	};
+
+	// game thread to audio thread
+	typedef SpscQueue<Command, 256> CommandQueue;
+
+	class AudioMixer
+	{
+	public:
+		AudioMixer(void);
+
+		// maxFrames is the largest buffer render() is asked for at once
+		bool init(const SoundBank* bank, int outputRate, int maxVoices, int maxFrames, float masterGain);
+
+		// game thread; false when the queue is full and the command is dropped
+		bool play(int sound, float gain, float pitch, float pan);
+		bool stopAll(void);
+
+		// audio thread: 'frames' of interleaved stereo into out
+		void render(int16_t* out, int frames);
+		void renderScalar(int16_t* out, int frames);    // same output without SSE
+
+		// audio thread statistics
+		int           activeVoices(void) const  { return m_active; }
+		unsigned long stolenVoices(void) const  { return m_stolen; }
+		unsigned long commandsRun(void) const   { return m_processed; }
+		unsigned long droppedCommands(void) const { return m_dropped.load(std::memory_order_relaxed); }
+
+	private:
+		AudioMixer(const AudioMixer&);
+		AudioMixer& operator=(const AudioMixer&);
+
+		struct Voice
+		{
+			const Sound* sound;
+			uint64_t     pos;               // 32.32 fixed point frame position
+			uint64_t     step;              // per output frame
+			uint64_t     end;               // last position that has a next sample
+			float        gainL, gainR;
+			unsigned int serial;            // start order, for stealing
+			bool         active;
+		};
+
+		void drainCommands(void);
+		void startVoice(const Command& c);
+		float currentLevel(const Voice& v) const;
+		void mix(int16_t* out, int frames, bool simd);
+		void mixVoice(Voice& v, int frames, bool simd);
+
+		const SoundBank*          m_bank;
+		int                       m_outputRate;
+		float                     m_masterGain;
+		LinearArena               m_arena;
+		Voice*                    m_voices;
+		int                       m_voiceCount;
+		int                       m_active;
+		unsigned int              m_serial;
+		float*                    m_accL;           // maxFrames, 16-byte aligned
+		float*                    m_accR;
+		int                       m_maxFrames;
+		unsigned long             m_stolen;
+		unsigned long             m_processed;
+		std::atomic<unsigned long> m_dropped;
+		CommandQueue              m_queue;
+	};
+}
+
+#endif // __audioMixerH__
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: audioOut.cpp
+// 
+// Desc: waveOut implementation of AudioOutput.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "audioOut.h"
+#include "memTrack.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+
+AudioOutput::AudioOutput(void)
+	: m_quit(false)
+{
+	m_pMixer       = NULL;
+	m_bufferFrames = 0;
+	m_bufferCount  = 0;
+	m_pSamples     = NULL;
+#ifdef _WIN32
+	m_hWaveOut     = NULL;
+	m_hEvent       = NULL;
+	m_pHeaders     = NULL;
+#endif
+}
+
+AudioOutput::~AudioOutput(void)
+{
+	stop();
+}
+
+#ifdef _WIN32
+
+bool AudioOutput::start(audio::AudioMixer* mixer, int sampleRate, int bufferFrames, int bufferCount)
+{
+	mem::Scope tag(mem::TAG_AUDIO);
+	stop();
+	if (bufferCount > MAX_BUFFERS)
+		bufferCount = MAX_BUFFERS;
+
+	WAVEFORMATEX fmt;
+	::ZeroMemory(&fmt, sizeof(fmt));
+	fmt.wFormatTag      = WAVE_FORMAT_PCM;
+	fmt.nChannels       = 2;
+	fmt.nSamplesPerSec  = sampleRate;
+	fmt.wBitsPerSample  = 16;
+	fmt.nBlockAlign     = 4;
+	fmt.nAvgBytesPerSec = sampleRate * 4;
+
+	m_hEvent = ::CreateEventA(NULL, FALSE, FALSE, NULL);
+	HWAVEOUT hwo = NULL;
+	if (m_hEvent == NULL ||
+		::waveOutOpen(&hwo, WAVE_MAPPER, &fmt, (DWORD_PTR)m_hEvent, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+		stop();
+		return false;
+	}
+	m_hWaveOut = hwo;
+
+	m_pMixer       = mixer;
+	m_bufferFrames = bufferFrames;
+	m_bufferCount  = bufferCount;
+	m_pSamples     = new int16_t[bufferCount * bufferFrames * 2];
+	WAVEHDR* hdr   = new WAVEHDR[MAX_BUFFERS];
+	m_pHeaders     = hdr;
+
+	// prime every buffer; the thread refills them as they come back
+	for (int i = 0; i < bufferCount; i++) {
+		::ZeroMemory(&hdr[i], sizeof(WAVEHDR));
+		hdr[i].lpData         = (LPSTR)(m_pSamples + i * bufferFrames * 2);
+		hdr[i].dwBufferLength = bufferFrames * 4;
+		::waveOutPrepareHeader(hwo, &hdr[i], sizeof(WAVEHDR));
+		m_pMixer->render(m_pSamples + i * bufferFrames * 2, bufferFrames);
+		::waveOutWrite(hwo, &hdr[i], sizeof(WAVEHDR));
+	}
+
+	m_quit = false;
+	m_thread = std::thread(&AudioOutput::run, this);
+	return true;
+}
+
+void AudioOutput::run(void)
+{
+	HWAVEOUT hwo = (HWAVEOUT)m_hWaveOut;
+	WAVEHDR* hdr = (WAVEHDR*)m_pHeaders;
+	while (!m_quit) {
+		::WaitForSingleObject((HANDLE)m_hEvent, 100);
+		for (int i = 0; i < m_bufferCount; i++) {
+			if (hdr[i].dwFlags & WHDR_DONE) {
+				m_pMixer->render((int16_t*)hdr[i].lpData, m_bufferFrames);
+				::waveOutWrite(hwo, &hdr[i], sizeof(WAVEHDR));
+			}
+		}
+	}
+}
+
+void AudioOutput::stop(void)
+{
+	if (m_thread.joinable()) {
+		m_quit = true;
+		::SetEvent((HANDLE)m_hEvent);
+		m_thread.join();
+	}
+	if (m_hWaveOut != NULL) {
+		HWAVEOUT hwo = (HWAVEOUT)m_hWaveOut;
+		WAVEHDR* hdr = (WAVEHDR*)m_pHeaders;
+		::waveOutReset(hwo);
+		for (int i = 0; hdr && i < m_bufferCount; i++)
+			::waveOutUnprepareHeader(hwo, &hdr[i], sizeof(WAVEHDR));
+		::waveOutClose(hwo);
+		m_hWaveOut = NULL;
+	}
+	if (m_hEvent != NULL) {
+		::CloseHandle((HANDLE)m_hEvent);
+		m_hEvent = NULL;
+	}
+	delete [] (WAVEHDR*)m_pHeaders;
+	m_pHeaders = NULL;
+	delete [] m_pSamples;
+	m_pSamples    = NULL;
+	m_bufferCount = 0;
+}
+
+#else
+
+// no output device; callers render into their own buffers
+bool AudioOutput::start(audio::AudioMixer*, int, int, int)
+{
+	return false;
+}
+
+void AudioOutput::run(void)
+{
+}
+
+void AudioOutput::stop(void)
+{
+}
+
+#endif
@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: audioOut.h
+// 
+// Desc: Feeds an AudioMixer to the sound card. A thread of its own keeps a
+//       few waveOut buffers queued and renders each one again as soon as the
+//       device hands it back. Win32 only; start() fails elsewhere and the
+//       game simply runs silent.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __audioOutH__
+#define __audioOutH__
+
+#include "audioMixer.h"
+#include <atomic>
+#include <thread>
+
+class AudioOutput
+{
+public:
+	AudioOutput(void);
+	~AudioOutput(void);
+
+	// bufferCount buffers of bufferFrames stereo frames each
+	bool start(audio::AudioMixer* mixer, int sampleRate, int bufferFrames, int bufferCount);
+	void stop(void);
+
+private:
+	AudioOutput(const AudioOutput&);
+	AudioOutput& operator=(const AudioOutput&);
+
+	enum { MAX_BUFFERS = 8 };
+
+	void run(void);
+
+	audio::AudioMixer* m_pMixer;
+	std::thread        m_thread;
+	std::atomic<bool>  m_quit;
+	int                m_bufferFrames;
+	int                m_bufferCount;
+	int16_t*           m_pSamples;          // bufferCount * bufferFrames * 2
+#ifdef _WIN32
+	void*              m_hWaveOut;
+	void*              m_hEvent;
+	void*              m_pHeaders;          // WAVEHDR[MAX_BUFFERS]
+#endif
+};
+
+#endif // __audioOutH__
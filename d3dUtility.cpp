@@ -11,6 +11,7 @@
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "d3dUtility.h"
+#include "perfCounters.h"
 
 bool d3d::InitD3D(
 	HINSTANCE hInstance,
@@ -157,14 +158,19 @@ int d3d::EnterMsgLoop( bool (*ptr_display)(float timeDelta) )
 		{
 			::TranslateMessage(&msg);
 			::DispatchMessage(&msg);
+			perf::add(perf::INPUT_QUEUE_DEPTH);
 		}
 		else
         {	
+			perf::beginFrame();
+
 			double currTime  = (double)timeGetTime();
 			double timeDelta = (currTime - lastTime)*0.0007;
 			ptr_display((float)timeDelta);
 
 			lastTime = currTime;
+
+			perf::endFrame();
         }
     }
     return msg.wParam;
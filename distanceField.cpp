@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: distanceField.cpp
+// 
+// Desc: Shape distances, baking and sampling of DistanceField.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "distanceField.h"
+#include <cmath>
+
+// nodes per axis are capped like the target grid in gameWorld.cpp
+static const int MAX_FIELD_NODES = 1024;
+
+// distance from p to the point q on the boundary, pointing from q to p
+static sim::Scalar awayFrom(const sim::Vec2& p, const sim::Vec2& q, const sim::Vec2& fallback, sim::Vec2& g)
+{
+	sim::Vec2 d = p - q;
+	sim::Scalar len = sim::length(d);
+	g = len > 0 ? d * (1 / len) : fallback;
+	return len;
+}
+
+sim::Scalar sim::arenaDistance(const ArenaShape& s, const Vec2& p, Vec2& g)
+{
+	Scalar d;
+	switch (s.kind) {
+	case ARENA_BOX: {
+		// the box shrunk by the corner radius, then grown back as a distance
+		Vec2 lo(s.a.x + s.radius, s.a.z + s.radius), hi(s.b.x - s.radius, s.b.z - s.radius);
+		Vec2 q(clampf(p.x, lo.x, hi.x), clampf(p.z, lo.z, hi.z));
+		if (q.x != p.x || q.z != p.z) {
+			d = awayFrom(p, q, Vec2(1, 0), g) - s.radius;
+		}
+		else {
+			// inside: out through the nearest face
+			Scalar left = p.x - lo.x, right = hi.x - p.x, front = p.z - lo.z, back = hi.z - p.z;
+			d = left; g = Vec2(-1, 0);
+			if (right < d) { d = right; g = Vec2(1, 0); }
+			if (front < d) { d = front; g = Vec2(0, -1); }
+			if (back  < d) { d = back;  g = Vec2(0, 1); }
+			d = -d - s.radius;
+		}
+		break;
+	}
+	case ARENA_SEGMENT:
+		d = awayFrom(p, closestPointOnSegment(p, s.a, s.b), Vec2(1, 0), g) - s.radius;
+		break;
+	default:
+		d = awayFrom(p, s.a, Vec2(1, 0), g) - s.radius;
+		break;
+	}
+
+	if (s.inside) {
+		d = -d;
+		g = -g;
+	}
+	return d;
+}
+
+sim::DistanceField::DistanceField(void)
+{
+	m_nodes   = NULL;
+	m_w       = 0;
+	m_h       = 0;
+	m_origin  = Vec2(0, 0);
+	m_cell    = 1;
+	m_invCell = 1;
+}
+
+bool sim::DistanceField::bake(LinearArena& arena, const Aabb& area, Scalar cellSize, const ArenaShape* shapes, int count)
+{
+	clear();
+	Scalar extent = (area.hi.x - area.lo.x) > (area.hi.z - area.lo.z) ? (area.hi.x - area.lo.x) : (area.hi.z - area.lo.z);
+	if (extent / cellSize > MAX_FIELD_NODES - 1)
+		cellSize = extent / (MAX_FIELD_NODES - 1);
+
+	m_origin  = area.lo;
+	m_cell    = cellSize;
+	m_invCell = 1 / cellSize;
+	int w = ceilToInt((area.hi.x - area.lo.x) * m_invCell) + 1;
+	int h = ceilToInt((area.hi.z - area.lo.z) * m_invCell) + 1;
+	if (w < 2) w = 2;
+	if (h < 2) h = 2;
+	Node* nodes = arena.allocArray<Node>((size_t)w * h);
+	if (nodes == NULL)
+		return false;
+
+	// union of solids: the nearest one wins
+	for (int z = 0; z < h; z++) {
+		for (int x = 0; x < w; x++) {
+			Vec2 p(m_origin.x + x * m_cell, m_origin.z + z * m_cell);
+			Node& n = nodes[z * w + x];
+			n.d  = SCALAR_MAX;
+			n.gx = 0;
+			n.gz = 0;
+			n.pad = 0;
+			for (int i = 0; i < count; i++) {
+				Vec2  g;
+				Scalar d = arenaDistance(shapes[i], p, g);
+				if (d < n.d) {
+					n.d  = d;
+					n.gx = g.x;
+					n.gz = g.z;
+				}
+			}
+		}
+	}
+
+	m_nodes = nodes;
+	m_w     = w;
+	m_h     = h;
+	return true;
+}
+
+sim::Scalar sim::DistanceField::sample(const Vec2& p, Vec2& normal) const
+{
+	Scalar fx = clampf((p.x - m_origin.x) * m_invCell, 0, Scalar(m_w - 1));
+	Scalar fz = clampf((p.z - m_origin.z) * m_invCell, 0, Scalar(m_h - 1));
+	int x = truncToInt(fx), z = truncToInt(fz);
+	if (x > m_w - 2) x = m_w - 2;
+	if (z > m_h - 2) z = m_h - 2;
+	Scalar tx = fx - x, tz = fz - z;
+
+	const Node& n00 = m_nodes[z * m_w + x];
+	const Node& n10 = m_nodes[z * m_w + x + 1];
+	const Node& n01 = m_nodes[(z + 1) * m_w + x];
+	const Node& n11 = m_nodes[(z + 1) * m_w + x + 1];
+
+	Scalar w00 = (1 - tx) * (1 - tz), w10 = tx * (1 - tz);
+	Scalar w01 = (1 - tx) * tz,          w11 = tx * tz;
+	Scalar d  = n00.d  * w00 + n10.d  * w10 + n01.d  * w01 + n11.d  * w11;
+	Scalar gx = n00.gx * w00 + n10.gx * w10 + n01.gx * w01 + n11.gx * w11;
+	Scalar gz = n00.gz * w00 + n10.gz * w10 + n01.gz * w01 + n11.gz * w11;
+
+	Scalar len = scalarSqrt(gx * gx + gz * gz);
+	normal = len > 0 ? Vec2(gx / len, gz / len) : Vec2(-1, 0);
+	return d;
+}
@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: distanceField.h
+// 
+// Desc: Arena geometry baked into a 2D signed distance field over the play
+//       plane. Angled walls, rounded corners and inner obstacles all turn into
+//       the same grid of (distance, gradient) nodes, so a ball finds its
+//       contact with the whole arena from one bilinear sample instead of a
+//       loop over walls. Distances are negative inside solid geometry.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __distanceFieldH__
+#define __distanceFieldH__
+
+#include "arena.h"
+#include "shapes.h"
+
+namespace sim
+{
+	enum ArenaShapeKind
+	{
+		ARENA_BOX = 0,              // a = min corner, b = max corner, radius rounds the corners
+		ARENA_SEGMENT,              // a wall of any angle from a to b, radius thick on each side
+		ARENA_CIRCLE                // centre a
+	};
+
+	struct ArenaShape
+	{
+		int    kind;                // ArenaShapeKind
+		Vec2   a, b;
+		Scalar radius;
+		bool   inside;              // play happens inside the shape; everything else is solid
+	};
+
+	// exact signed distance from p to one shape, and its unit gradient
+	Scalar arenaDistance(const ArenaShape& s, const Vec2& p, Vec2& gradient);
+
+	class DistanceField
+	{
+	public:
+		DistanceField(void);
+
+		// samples the union of 'shapes' every cellSize over 'area'; the nodes
+		// come from 'arena' and live as long as it does
+		bool bake(LinearArena& arena, const Aabb& area, Scalar cellSize, const ArenaShape* shapes, int count);
+		void clear(void)                    { m_nodes = NULL; m_w = m_h = 0; }
+
+		bool  isBaked(void) const           { return m_nodes != NULL; }
+		int   width(void) const             { return m_w; }
+		int   height(void) const            { return m_h; }
+		Scalar cellSize(void) const         { return m_cell; }
+		size_t bytes(void) const            { return sizeof(Node) * m_w * m_h; }
+
+		// bilinear distance at p and the unit normal pointing away from the
+		// nearest solid; points off the field take the value at its border
+		Scalar sample(const Vec2& p, Vec2& normal) const;
+
+	private:
+		struct Node
+		{
+			Scalar d, gx, gz, pad;          // one aligned load per corner
+		};
+
+		Node*  m_nodes;
+		int    m_w, m_h;                    // nodes per axis
+		Vec2   m_origin;
+		Scalar m_cell;
+		Scalar m_invCell;
+	};
+
+	// ball against the whole arena, so it plugs into collide() like any other pair
+	template<> struct Collide<Sphere, DistanceField>
+	{
+		enum { IMPLEMENTED = 1 };
+
+		static bool test(const Sphere& a, const DistanceField& f, Manifold& m)
+		{
+			Vec2  n;
+			Scalar d = f.sample(a.center, n);
+			if (d > a.radius)
+				return false;
+			m.normal = n;
+			m.depth  = a.radius - d;
+			m.point  = a.center - n * d;
+			return true;
+		}
+	};
+}
+
+#endif // __distanceFieldH__
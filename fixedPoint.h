@@ -0,0 +1,154 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: fixedPoint.h
+// 
+// Desc: Fixed-point scalar for the simulation. Compiling with ARK_FIXED_POINT
+//       makes it sim::Scalar (see simMath.h), so the world steps in integer
+//       arithmetic only and a replay hashes the same at every optimization
+//       level, on every instruction set and with any float flags. Floats come
+//       in through the constructors, which round once, exactly, and go out
+//       through toFloat() for drawing.
+//
+//           ARK_FIXED_POINT=16   Q16.16 in 32 bits: +-32768, steps of 1.5e-5
+//           ARK_FIXED_POINT=32   Q32.32 in 64 bits; needs a 128-bit integer (gcc, clang)
+//
+//       Products round towards minus infinity and quotients towards zero,
+//       as the integer shift and division do; sums wrap. Add, subtract and
+//       multiply don't branch, so loops over arrays of Fixed vectorize like
+//       loops over integers where the compiler vectorizes a widening multiply
+//       (gcc at -O3; at -O2 it stays scalar, ~3.5x the float loop).
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __fixedPointH__
+#define __fixedPointH__
+
+#include <cstdint>
+
+namespace sim
+{
+#if ARK_FIXED_POINT == 32
+#ifndef __SIZEOF_INT128__
+#error Q32.32 needs a 128-bit integer type; build with ARK_FIXED_POINT=16
+#endif
+	typedef int64_t           FixedRaw;
+	typedef uint64_t          FixedURaw;
+	typedef __int128          FixedWide;
+	typedef unsigned __int128 FixedUWide;
+	const int FIXED_FRAC_BITS = 32;
+	const char* const FIXED_NAME = "Q32.32";
+#else
+	typedef int32_t           FixedRaw;
+	typedef uint32_t          FixedURaw;
+	typedef int64_t           FixedWide;
+	typedef uint64_t          FixedUWide;
+	const int FIXED_FRAC_BITS = 16;
+	const char* const FIXED_NAME = "Q16.16";
+#endif
+
+	const FixedRaw FIXED_ONE = (FixedRaw)1 << FIXED_FRAC_BITS;
+	const FixedRaw FIXED_MAX = (FixedRaw)((FixedURaw)~(FixedURaw)0 >> 1);
+	const FixedRaw FIXED_MIN = -FIXED_MAX - 1;
+
+	struct Fixed
+	{
+		FixedRaw raw;
+
+		// ints convert exactly and implicitly; a float or double only when
+		// written out, Scalar(0.5f), so no value is rounded out of sight. The
+		// template catches the rest, which would otherwise slip through int.
+		// All are constexpr, so constants like BALL_RADIUS need no start-up code.
+		Fixed() {}
+		constexpr Fixed(int i)             : raw((FixedRaw)i * FIXED_ONE) {}
+		constexpr explicit Fixed(float f)  : raw(fromDouble(f)) {}
+		constexpr explicit Fixed(double f) : raw(fromDouble(f)) {}
+		template<class T> Fixed(T) = delete;
+
+		static Fixed fromRaw(FixedRaw r) { Fixed f; f.raw = r; return f; }
+
+		// f * 2^FRAC_BITS is exact in a double for any float, so this rounds once
+		static constexpr FixedRaw fromDouble(double f)
+		{
+			return roundRaw(f * (double)FIXED_ONE);
+		}
+
+		static constexpr FixedRaw roundRaw(double v)
+		{
+			return v >= (double)FIXED_MAX ? FIXED_MAX :
+				(v <= (double)FIXED_MIN ? FIXED_MIN : (FixedRaw)(v < 0.0 ? v - 0.5 : v + 0.5));
+		}
+
+		Fixed operator-() const                 { return fromRaw((FixedRaw)(0 - (FixedURaw)raw)); }
+		Fixed& operator+=(const Fixed& b)       { raw = (FixedRaw)((FixedURaw)raw + (FixedURaw)b.raw); return *this; }
+		Fixed& operator-=(const Fixed& b)       { raw = (FixedRaw)((FixedURaw)raw - (FixedURaw)b.raw); return *this; }
+		Fixed& operator*=(const Fixed& b)       { raw = (FixedRaw)(((FixedWide)raw * b.raw) >> FIXED_FRAC_BITS); return *this; }
+	};
+
+	inline Fixed operator+(Fixed a, const Fixed& b) { return a += b; }
+	inline Fixed operator-(Fixed a, const Fixed& b) { return a -= b; }
+	inline Fixed operator*(Fixed a, const Fixed& b) { return a *= b; }
+
+	// x / 0 saturates instead of trapping
+	inline Fixed operator/(const Fixed& a, const Fixed& b)
+	{
+		if (b.raw == 0)
+			return Fixed::fromRaw(a.raw < 0 ? FIXED_MIN : FIXED_MAX);
+		FixedWide q = ((FixedWide)a.raw * FIXED_ONE) / b.raw;
+		if (q > FIXED_MAX) return Fixed::fromRaw(FIXED_MAX);
+		if (q < FIXED_MIN) return Fixed::fromRaw(FIXED_MIN);
+		return Fixed::fromRaw((FixedRaw)q);
+	}
+
+	// y[i] += x[i] * k over n values, the batched pos += vel * dt, on the raw
+	// integers with operator*'s rounding: the same bits as a loop over Fixed.
+	// simBench's "fixed" case times it against the same loop over floats.
+	inline void fixedMulAdd(Fixed* y, const Fixed* x, Fixed k, int n)
+	{
+		for (int i = 0; i < n; i++)
+			y[i].raw = (FixedRaw)((FixedURaw)y[i].raw + (FixedURaw)(FixedRaw)(((FixedWide)x[i].raw * k.raw) >> FIXED_FRAC_BITS));
+	}
+
+	inline bool operator==(const Fixed& a, const Fixed& b) { return a.raw == b.raw; }
+	inline bool operator!=(const Fixed& a, const Fixed& b) { return a.raw != b.raw; }
+	inline bool operator<(const Fixed& a, const Fixed& b)  { return a.raw < b.raw; }
+	inline bool operator<=(const Fixed& a, const Fixed& b) { return a.raw <= b.raw; }
+	inline bool operator>(const Fixed& a, const Fixed& b)  { return a.raw > b.raw; }
+	inline bool operator>=(const Fixed& a, const Fixed& b) { return a.raw >= b.raw; }
+
+	// floor(sqrt(v)), one result bit per round
+	template<class U>
+	inline U isqrt(U v)
+	{
+		U r   = 0;
+		U bit = (U)1 << (sizeof(U) * 8 - 2);
+		while (bit > v)
+			bit >>= 2;
+		while (bit != 0) {
+			if (v >= r + bit) {
+				v -= r + bit;
+				r  = (r >> 1) + bit;
+			}
+			else {
+				r >>= 1;
+			}
+			bit >>= 2;
+		}
+		return r;
+	}
+
+	// sqrt(a) = sqrt(a.raw * 2^FRAC_BITS) / 2^FRAC_BITS; negative is 0
+	inline Fixed scalarSqrt(const Fixed& a)
+	{
+		if (a.raw <= 0)
+			return Fixed::fromRaw(0);
+		return Fixed::fromRaw((FixedRaw)isqrt((FixedUWide)a.raw << FIXED_FRAC_BITS));
+	}
+
+	inline Fixed scalarAbs(const Fixed& a)    { return a.raw < 0 ? -a : a; }
+	inline int   floorToInt(const Fixed& a)   { return (int)(a.raw >> FIXED_FRAC_BITS); }
+	inline int   ceilToInt(const Fixed& a)    { return (int)((FixedRaw)((FixedURaw)a.raw + (FIXED_ONE - 1)) >> FIXED_FRAC_BITS); }
+	inline int   truncToInt(const Fixed& a)   { return (int)(a.raw / FIXED_ONE); }
+	inline float toFloat(const Fixed& a)      { return (float)((double)a.raw / (double)FIXED_ONE); }
+}
+
+#endif // __fixedPointH__
@@ -0,0 +1,607 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: gameWorld.cpp
+// 
+// Desc: Level loading, the broadphase grid and the per-frame update.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gameWorld.h"
+#include "jobSystem.h"
+#include "memTrack.h"
+#include "perfCounters.h"
+#include <cmath>
+#include <cstring>
+
+// grid cells per axis are capped so huge sparse levels don't explode the index
+static const int MAX_GRID_CELLS = 1024;
+
+// balls per job; a ball's detect or move is a few hundred ns
+static const int BALL_GRAIN = 32;
+
+// distance field spacing when the level doesn't give one; fine enough that
+// bilinear error stays well under a millimetre of the game's 0.21 radius balls
+static const sim::Scalar DEFAULT_FIELD_CELL = sim::Scalar(0.05f);
+
+sim::World::World(void)
+{
+	m_spheres      = NULL;
+	m_sphereAlive  = NULL;
+	m_sphereCount  = 0;
+	m_bricks       = NULL;
+	m_brickAlive   = NULL;
+	m_brickCount   = 0;
+	m_walls        = NULL;
+	m_wallCount    = 0;
+	m_exitX        = 0;
+	m_paddleMinZ   = 0;
+	m_paddleMaxZ   = 0;
+	m_gridOrigin   = Vec2(0, 0);
+	m_cellSize     = 1;
+	m_gridW        = 0;
+	m_gridH        = 0;
+	m_cellStart    = NULL;
+	m_cellItems    = NULL;
+	m_candidateCap = 0;
+	m_jobs         = NULL;
+	m_threadCount  = 1;
+	m_threads      = NULL;
+	m_redoHits     = NULL;
+	m_steps        = NULL;
+	m_ballEvents   = NULL;
+	m_ballEventStride = 0;
+	m_stepDelta    = 0;
+	m_events       = NULL;
+	m_eventCount   = 0;
+	m_eventCap     = 0;
+	m_balls        = NULL;
+	m_ballStart    = NULL;
+	m_ballActive   = NULL;
+	m_ballCount    = 0;
+	m_paddle.pos   = m_paddle.vel = Vec2(0, 0);
+	m_playing      = false;
+	m_liveTargets  = 0;
+}
+
+bool sim::World::init(size_t levelBytes)
+{
+	mem::Scope tag(mem::TAG_LEVEL);
+	return m_arena.init(levelBytes);
+}
+
+bool sim::World::loadLevel(const LevelDesc& level)
+{
+	// everything from the previous level goes at once
+	m_arena.reset();
+	m_field.clear();
+
+	m_sphereCount = level.sphereCount;
+	m_brickCount  = level.brickCount;
+	m_wallCount   = level.wallCount;
+	m_spheres     = m_arena.allocArray<Vec2>(m_sphereCount);
+	m_sphereAlive = m_arena.allocArray<unsigned char>(m_sphereCount);
+	m_bricks      = m_arena.allocArray<Aabb>(m_brickCount);
+	m_brickAlive  = m_arena.allocArray<unsigned char>(m_brickCount);
+	m_walls       = m_arena.allocArray<Aabb>(m_wallCount);
+
+	m_ballCount   = 1 + level.ballCount;
+	m_balls       = m_arena.allocArray<Ball>(m_ballCount);
+	m_ballStart   = m_arena.allocArray<Ball>(m_ballCount);
+	m_ballActive  = m_arena.allocArray<unsigned char>(m_ballCount);
+	m_steps       = m_arena.allocArray<BallStep>(m_ballCount);
+
+	// each ball reports its own bounces in its own slots so threads never share
+	m_ballEventStride = (level.arenaShapeCount > 0 ? 1 : m_wallCount) + 2;
+	m_ballEvents  = m_arena.allocArray<Event>(m_ballCount * m_ballEventStride);
+
+	// a frame can report every target plus what every ball did
+	m_eventCap    = m_sphereCount + m_brickCount + m_ballCount * m_ballEventStride;
+	m_events      = m_arena.allocArray<Event>(m_eventCap);
+
+	if (!m_spheres || !m_sphereAlive || !m_bricks || !m_brickAlive || !m_walls || !m_events ||
+		!m_balls || !m_ballStart || !m_ballActive || !m_steps || !m_ballEvents)
+		return false;
+
+	for (int i = 0; i < m_sphereCount; i++) m_spheres[i] = level.spheres[i];
+	for (int i = 0; i < m_brickCount; i++)  m_bricks[i]  = level.bricks[i];
+	for (int i = 0; i < m_wallCount; i++)   m_walls[i]   = level.walls[i];
+	for (int i = 1; i < m_ballCount; i++)   m_ballStart[i] = level.balls[i - 1];
+	m_ballStart[0].pos = m_ballStart[0].vel = Vec2(0, 0);
+
+	m_exitX      = level.exitX;
+	m_paddleMinZ = level.paddleMinZ;
+	m_paddleMaxZ = level.paddleMaxZ;
+	m_paddle.pos = level.paddleStart;
+	m_paddle.vel = Vec2(0, 0);
+
+	if (!buildGrid())
+		return false;
+	if (level.arenaShapeCount > 0 && !bakeField(level))
+		return false;
+
+	resetLevel();
+	return true;
+}
+
+bool sim::World::buildGrid(void)
+{
+	int items = m_sphereCount + m_brickCount;
+
+	// bounds of everything that can be hit
+	Vec2 lo(0, 0), hi(0, 0);
+	for (int i = 0; i < items; i++) {
+		Aabb b = i < m_sphereCount
+			? Aabb(m_spheres[i] - Vec2(BALL_RADIUS, BALL_RADIUS), m_spheres[i] + Vec2(BALL_RADIUS, BALL_RADIUS))
+			: m_bricks[i - m_sphereCount];
+		if (i == 0 || b.lo.x < lo.x) lo.x = b.lo.x;
+		if (i == 0 || b.lo.z < lo.z) lo.z = b.lo.z;
+		if (i == 0 || b.hi.x > hi.x) hi.x = b.hi.x;
+		if (i == 0 || b.hi.z > hi.z) hi.z = b.hi.z;
+	}
+
+	// roughly one target per cell at the game's density
+	m_cellSize = 4 * BALL_RADIUS;
+	Scalar extent = (hi.x - lo.x) > (hi.z - lo.z) ? (hi.x - lo.x) : (hi.z - lo.z);
+	if (extent / m_cellSize > MAX_GRID_CELLS)
+		m_cellSize = extent / MAX_GRID_CELLS;
+	m_gridOrigin = lo;
+	m_gridW = truncToInt((hi.x - lo.x) / m_cellSize) + 1;
+	m_gridH = truncToInt((hi.z - lo.z) / m_cellSize) + 1;
+
+	int cells = m_gridW * m_gridH;
+	m_cellStart = m_arena.allocArray<int>(cells + 1);
+	int* cursor = m_arena.allocArray<int>(cells + 1);
+	if (!m_cellStart || !cursor)
+		return false;
+	::memset(m_cellStart, 0, sizeof(int) * (cells + 1));
+
+	// two passes: count items per cell, then fill the prefix-summed slots
+	int total = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		for (int i = 0; i < items; i++) {
+			Aabb b = i < m_sphereCount
+				? Aabb(m_spheres[i] - Vec2(BALL_RADIUS, BALL_RADIUS), m_spheres[i] + Vec2(BALL_RADIUS, BALL_RADIUS))
+				: m_bricks[i - m_sphereCount];
+			int x0 = truncToInt((b.lo.x - lo.x) / m_cellSize), x1 = truncToInt((b.hi.x - lo.x) / m_cellSize);
+			int z0 = truncToInt((b.lo.z - lo.z) / m_cellSize), z1 = truncToInt((b.hi.z - lo.z) / m_cellSize);
+			for (int z = z0; z <= z1; z++) {
+				for (int x = x0; x <= x1; x++) {
+					int cell = z * m_gridW + x;
+					if (pass == 0) m_cellStart[cell + 1]++;
+					else           m_cellItems[cursor[cell]++] = i;
+				}
+			}
+		}
+		if (pass == 0) {
+			for (int c = 0; c < cells; c++)
+				m_cellStart[c + 1] += m_cellStart[c];
+			total = m_cellStart[cells];
+			::memcpy(cursor, m_cellStart, sizeof(int) * (cells + 1));
+			m_cellItems = m_arena.allocArray<int>(total);
+			if (!m_cellItems)
+				return false;
+		}
+	}
+
+	m_candidateCap = total;
+
+	// detect-phase scratch for every thread the job system can run on; hits
+	// past a thread's share fall back to the serial redo in resolveBall()
+	m_threadCount = m_jobs ? m_jobs->threadCount() : 1;
+	m_threads     = m_arena.allocArray<ThreadScratch>(m_threadCount);
+	m_redoHits    = m_arena.allocArray<Hit>(m_candidateCap);
+	if (!m_threads || (m_candidateCap && !m_redoHits))
+		return false;
+	for (int t = 0; t < m_threadCount; t++) {
+		ThreadScratch& s = m_threads[t];
+		s.hitCap     = 64 + items / m_threadCount;
+		s.hitCount   = 0;
+		s.candidates = m_arena.allocArray<int>(m_candidateCap);
+		s.hits       = m_arena.allocArray<Hit>(s.hitCap);
+		if ((m_candidateCap && !s.candidates) || !s.hits)
+			return false;
+	}
+	return true;
+}
+
+sim::TargetGrid sim::World::targetGrid(void) const
+{
+	TargetGrid g;
+	g.origin    = m_gridOrigin;
+	g.cellSize  = m_cellSize;
+	g.width     = m_gridW;
+	g.height    = m_gridH;
+	g.cellStart = m_cellStart;
+	g.cellItems = m_cellItems;
+	return g;
+}
+
+// Collects the targets whose grid cells touch the square of half size 'reach'
+// around p, sorted by item index and without duplicates, so they are handled
+// in the same order as the plain loops over all spheres and then all bricks.
+int sim::World::gatherCandidates(const Vec2& p, Scalar reach, int* out) const
+{
+	if (m_gridW == 0 || m_sphereCount + m_brickCount == 0)
+		return 0;
+
+	int x0 = floorToInt((p.x - reach - m_gridOrigin.x) / m_cellSize);
+	int x1 = floorToInt((p.x + reach - m_gridOrigin.x) / m_cellSize);
+	int z0 = floorToInt((p.z - reach - m_gridOrigin.z) / m_cellSize);
+	int z1 = floorToInt((p.z + reach - m_gridOrigin.z) / m_cellSize);
+	if (x1 < 0 || z1 < 0 || x0 >= m_gridW || z0 >= m_gridH)
+		return 0;
+	if (x0 < 0) x0 = 0;
+	if (z0 < 0) z0 = 0;
+	if (x1 >= m_gridW) x1 = m_gridW - 1;
+	if (z1 >= m_gridH) z1 = m_gridH - 1;
+
+	int n = 0;
+	for (int z = z0; z <= z1; z++) {
+		for (int x = x0; x <= x1; x++) {
+			int cell = z * m_gridW + x;
+			for (int k = m_cellStart[cell]; k < m_cellStart[cell + 1]; k++) {
+				// insertion sort; a query only sees a handful of items
+				int item = m_cellItems[k];
+				int j = n;
+				while (j > 0 && out[j - 1] > item) j--;
+				if (j > 0 && out[j - 1] == item) continue;
+				if (n >= m_candidateCap) return n;
+				for (int m = n; m > j; m--) out[m] = out[m - 1];
+				out[j] = item;
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+// The walls join the level's arena shapes in one field that covers everything
+// a ball can reach, with a margin so balls pushed slightly out still sample it.
+bool sim::World::bakeField(const LevelDesc& level)
+{
+	int count = level.arenaShapeCount + m_wallCount;
+	ArenaShape* shapes = m_arena.allocArray<ArenaShape>(count);
+	if (shapes == NULL)
+		return false;
+
+	Aabb area(level.paddleStart, level.paddleStart);
+	for (int i = 0; i < count; i++) {
+		ArenaShape& s = shapes[i];
+		if (i < level.arenaShapeCount) {
+			s = level.arenaShapes[i];
+		}
+		else {
+			s.kind   = ARENA_BOX;
+			s.a      = m_walls[i - level.arenaShapeCount].lo;
+			s.b      = m_walls[i - level.arenaShapeCount].hi;
+			s.radius = 0;
+			s.inside = false;
+		}
+
+		Vec2 lo = s.a, hi = s.kind == ARENA_CIRCLE ? s.a : s.b;
+		if (s.kind != ARENA_BOX) {
+			Vec2 r(s.radius, s.radius);
+			Vec2 l(lo.x < hi.x ? lo.x : hi.x, lo.z < hi.z ? lo.z : hi.z);
+			Vec2 h(lo.x > hi.x ? lo.x : hi.x, lo.z > hi.z ? lo.z : hi.z);
+			lo = l - r;
+			hi = h + r;
+		}
+		if (lo.x < area.lo.x) area.lo.x = lo.x;
+		if (lo.z < area.lo.z) area.lo.z = lo.z;
+		if (hi.x > area.hi.x) area.hi.x = hi.x;
+		if (hi.z > area.hi.z) area.hi.z = hi.z;
+	}
+	if (m_exitX > area.hi.x) area.hi.x = m_exitX;
+	Vec2 margin(4 * BALL_RADIUS, 4 * BALL_RADIUS);
+	area = Aabb(area.lo - margin, area.hi + margin);
+
+	Scalar cell = level.fieldCellSize > 0 ? level.fieldCellSize : DEFAULT_FIELD_CELL;
+	return m_field.bake(m_arena, area, cell, shapes, count);
+}
+
+void sim::World::resetLevel(void)
+{
+	::memset(m_sphereAlive, 1, m_sphereCount);
+	::memset(m_brickAlive, 1, m_brickCount);
+	::memset(m_ballActive, 1, m_ballCount);
+	m_liveTargets = m_sphereCount + m_brickCount;
+	m_playing     = false;
+	for (int i = 1; i < m_ballCount; i++)
+		m_balls[i] = m_ballStart[i];
+	m_balls[0].vel = Vec2(0, 0);
+	parkBall();
+}
+
+void sim::World::parkBall(void)
+{
+	m_balls[0].pos = Vec2(m_paddle.pos.x - 2 * BALL_RADIUS, m_paddle.pos.z);
+}
+
+void sim::World::launch(void)
+{
+	m_playing      = true;
+	m_balls[0].vel = Vec2(-LAUNCH_SPEED, 0);
+}
+
+void sim::World::movePaddle(Scalar z)
+{
+	m_paddle.pos.z = clampf(z, m_paddleMinZ, m_paddleMaxZ);
+}
+
+void sim::World::pushEvent(int kind, int index, const Vec2& pos)
+{
+	if (m_eventCount < m_eventCap) {
+		Event& e = m_events[m_eventCount++];
+		e.kind     = kind;
+		e.index    = index;
+		e.position = pos;
+	}
+}
+
+bool sim::World::isAlive(int item) const
+{
+	return item < m_sphereCount ? m_sphereAlive[item] != 0 : m_brickAlive[item - m_sphereCount] != 0;
+}
+
+// Runs b through the live targets near it, in item order, and records what it
+// hit. Only reads the alive flags: within one ball no target is met twice, so
+// committing the hits afterwards is the same as removing them on the way.
+// Returns the candidates tested; hitCount is -1 if 'hits' was too small.
+int sim::World::collideTargets(Ball& b, int* candidates, Hit* hits, int hitCap, int& hitCount) const
+{
+	// a brick push can move the ball by up to its radius, so look that much further
+	int n = gatherCandidates(b.pos, 3 * BALL_RADIUS, candidates);
+
+	hitCount = 0;
+	for (int k = 0; k < n; k++) {
+		int item = candidates[k];
+		if (!isAlive(item)) continue;
+
+		Manifold m;
+		if (item < m_sphereCount) {
+			if (!collide(Sphere(b.pos, BALL_RADIUS), Sphere(m_spheres[item], BALL_RADIUS), m)) continue;
+			deflect(b.vel, m);
+		}
+		else {
+			if (!collide(Sphere(b.pos, BALL_RADIUS), m_bricks[item - m_sphereCount], m)) continue;
+			bounce(b.pos, b.vel, m);
+		}
+
+		if (hitCount < 0 || hitCount >= hitCap) {
+			hitCount = -1;
+			continue;
+		}
+		hits[hitCount].item     = item;
+		hits[hitCount].position = b.pos;
+		hitCount++;
+	}
+	return n;
+}
+
+// detect phase: one ball against the targets alive at the start of the step
+void sim::World::detectBall(int ball, int thread)
+{
+	BallStep& s = m_steps[ball];
+	s.hitCount = 0;
+	s.tests    = 0;
+	if (!m_ballActive[ball])
+		return;
+
+	ThreadScratch& t = m_threads[thread];
+	s.after     = m_balls[ball];
+	s.hitThread = thread;
+	s.hitStart  = t.hitCount;
+	s.tests     = collideTargets(s.after, t.candidates, t.hits + t.hitCount, t.hitCap - t.hitCount, s.hitCount);
+	if (s.hitCount > 0)
+		t.hitCount += s.hitCount;
+}
+
+// resolve phase, serial in ball order: commit a ball's hits, or redo it if an
+// earlier ball got one of its targets first
+void sim::World::resolveBall(int ball)
+{
+	if (!m_ballActive[ball])
+		return;
+
+	BallStep& s = m_steps[ball];
+	const Hit* hits = m_threads[s.hitThread].hits + s.hitStart;
+	int count = s.hitCount;
+
+	bool stale = count < 0;
+	for (int k = 0; k < count && !stale; k++)
+		stale = !isAlive(hits[k].item);
+	if (stale) {
+		s.after = m_balls[ball];
+		collideTargets(s.after, m_threads[0].candidates, m_redoHits, m_candidateCap, count);
+		hits = m_redoHits;
+	}
+
+	for (int k = 0; k < count; k++) {
+		int item = hits[k].item;
+		if (item < m_sphereCount) {
+			m_sphereAlive[item] = 0;
+			pushEvent(EVENT_TARGET_HIT, item, hits[k].position);
+		}
+		else {
+			m_brickAlive[item - m_sphereCount] = 0;
+			pushEvent(EVENT_BRICK_HIT, item - m_sphereCount, hits[k].position);
+		}
+		m_liveTargets--;
+	}
+	m_balls[ball] = s.after;
+}
+
+void sim::World::integrate(Ball& b, Scalar timeDelta) const
+{
+	if (scalarAbs(b.vel.x) > STOP_SPEED || scalarAbs(b.vel.z) > STOP_SPEED) {
+		b.pos.x = b.pos.x + TIME_SCALE * timeDelta * b.vel.x;
+		b.pos.z = b.pos.z + TIME_SCALE * timeDelta * b.vel.z;
+	}
+	else {
+		b.vel = Vec2(0, 0);
+	}
+}
+
+// bounces b off the arena; with out != NULL each bounce is written there as
+// an event, and the count is returned
+int sim::World::collideArena(Ball& b, Event* out) const
+{
+	int bounces = 0;
+	Manifold m;
+	if (m_field.isBaked()) {
+		// one sample, whatever the arena looks like
+		if (collide(Sphere(b.pos, BALL_RADIUS), m_field, m)) {
+			bounce(b.pos, b.vel, m);
+			if (out) {
+				out[0].kind     = EVENT_WALL_BOUNCE;
+				out[0].index    = -1;
+				out[0].position = b.pos;
+			}
+			bounces++;
+		}
+		return bounces;
+	}
+
+	for (int i = 0; i < m_wallCount; i++) {
+		if (collide(Sphere(b.pos, BALL_RADIUS), m_walls[i], m)) {
+			bounce(b.pos, b.vel, m);
+			if (out) {
+				out[bounces].kind     = EVENT_WALL_BOUNCE;
+				out[bounces].index    = i;
+				out[bounces].position = b.pos;
+			}
+			bounces++;
+		}
+	}
+	return bounces;
+}
+
+// move phase: walls, the white ball and the exit; events go to the ball's own slots
+void sim::World::moveBall(int ball, Scalar timeDelta)
+{
+	BallStep& s = m_steps[ball];
+	s.eventCount = 0;
+	s.lost       = false;
+	if (!m_ballActive[ball])
+		return;
+
+	Ball& b = m_balls[ball];
+	Event* out = m_ballEvents + ball * m_ballEventStride;
+
+	integrate(b, timeDelta);
+	s.eventCount += collideArena(b, out);
+
+	Manifold m;
+	if (collide(Sphere(b.pos, BALL_RADIUS), Sphere(m_paddle.pos, BALL_RADIUS), m)) {
+		deflect(b.vel, m);
+		if (ball != 0 || m_playing) {
+			out[s.eventCount].kind     = EVENT_PADDLE_HIT;
+			out[s.eventCount].index    = ball;
+			out[s.eventCount].position = b.pos;
+			s.eventCount++;
+		}
+	}
+
+	if (ball == 0 && !m_playing)
+		parkBall();
+
+	if (m_exitX <= b.pos.x) { // ball is out of the plane
+		out[s.eventCount].kind     = EVENT_BALL_LOST;
+		out[s.eventCount].index    = ball;
+		out[s.eventCount].position = b.pos;
+		s.eventCount++;
+		s.lost = true;
+	}
+}
+
+void sim::World::detectRange(void* ctx, int begin, int end, int thread)
+{
+	World* w = (World*)ctx;
+	for (int i = begin; i < end; i++)
+		w->detectBall(i, thread);
+}
+
+void sim::World::moveRange(void* ctx, int begin, int end, int /*thread*/)
+{
+	World* w = (World*)ctx;
+	for (int i = begin; i < end; i++)
+		w->moveBall(i, w->m_stepDelta);
+}
+
+void sim::World::runPhase(void (*fn)(void*, int, int, int))
+{
+	// a pool that grew after loadLevel() has no scratch for its extra threads
+	if (m_jobs && m_jobs->threadCount() > 1 && m_jobs->threadCount() <= m_threadCount)
+		m_jobs->parallelFor(m_ballCount, BALL_GRAIN, fn, this);
+	else
+		fn(this, 0, m_ballCount, 0);
+}
+
+void sim::World::step(Scalar timeDelta)
+{
+	m_eventCount = 0;
+	m_stepDelta  = timeDelta;
+
+	// detect, then resolve in ball order
+	for (int t = 0; t < m_threadCount; t++)
+		m_threads[t].hitCount = 0;
+	runPhase(detectRange);
+
+	int tests = 0;
+	for (int i = 0; i < m_ballCount; i++) {
+		resolveBall(i);
+		tests += m_steps[i].tests;
+	}
+
+	// the white ball only meets the walls, so it goes first
+	integrate(m_paddle, timeDelta);
+	collideArena(m_paddle, NULL);
+	tests += arenaTests();
+
+	runPhase(moveRange);
+
+	// merge per-ball events in ball order
+	bool lostRed = false;
+	for (int i = 0; i < m_ballCount; i++) {
+		const BallStep& s = m_steps[i];
+		if (!m_ballActive[i])
+			continue;
+		const Event* e = m_ballEvents + i * m_ballEventStride;
+		for (int k = 0; k < s.eventCount; k++)
+			pushEvent(e[k].kind, e[k].index, e[k].position);
+		tests += arenaTests() + 1;
+		if (s.lost) {
+			if (i == 0) lostRed = true;
+			else        m_ballActive[i] = 0;
+		}
+	}
+	perf::add(perf::COLLISION_TESTS, tests);
+
+	if (lostRed)
+		resetLevel();
+
+	perf::add(perf::SIM_STEPS);
+	perf::set(perf::LIVE_TARGETS, m_liveTargets);
+}
+
+static void fnv(uint64_t& h, const void* data, size_t bytes)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < bytes; i++) {
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+}
+
+uint64_t sim::World::stateHash(void) const
+{
+	uint64_t h = 14695981039346656037ull;
+	fnv(h, m_balls, sizeof(Ball) * m_ballCount);
+	fnv(h, m_ballActive, m_ballCount);
+	fnv(h, &m_paddle, sizeof(m_paddle));
+	fnv(h, m_sphereAlive, m_sphereCount);
+	fnv(h, m_brickAlive, m_brickCount);
+	unsigned char playing = m_playing ? 1 : 0;
+	fnv(h, &playing, 1);
+	return h;
+}
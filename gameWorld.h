@@ -0,0 +1,233 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: gameWorld.h
+// 
+// Desc: Headless game state and the per-frame update that Display() used to do
+//       inline: target hits, ball movement, wall bounces, the white ball and
+//       the game-over reset. All per-level storage (targets, the broadphase
+//       grid, its index lists and the event buffer) is carved from one
+//       LinearArena that is reset when a level is loaded, so step() never
+//       touches the heap.
+//
+//       A level can hold many balls. step() runs them in phases: target hits
+//       are found for every ball against the targets alive at the start of
+//       the frame, committed in ball order (a ball whose target was taken by
+//       an earlier ball is redone), then the balls move and bounce. With a
+//       JobSystem the two per-ball phases are split across threads; the
+//       result is the same bit for bit whatever the thread count.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __gameWorldH__
+#define __gameWorldH__
+
+#include "arena.h"
+#include "distanceField.h"
+#include "shapes.h"
+#include "trajectory.h"
+#include <cstdint>
+
+class JobSystem;
+
+namespace sim
+{
+	const Scalar BALL_RADIUS  = Scalar(0.21f);
+	const Scalar TIME_SCALE   = Scalar(3.3f);   // ball displacement per unit of velocity and timeDelta
+	const Scalar LAUNCH_SPEED = 3;
+	const Scalar STOP_SPEED   = Scalar(0.01f);  // slower balls are stopped
+
+	struct Ball
+	{
+		Vec2 pos;
+		Vec2 vel;
+	};
+
+	struct LevelDesc
+	{
+		const Vec2* spheres;        // sphere target centers
+		int         sphereCount;
+		const Aabb* bricks;         // rectangular targets
+		int         brickCount;
+
+		const Aabb* walls;
+		int         wallCount;
+		Scalar      exitX;          // the red ball is lost when its center reaches this x
+		Vec2        paddleStart;
+		Scalar      paddleMinZ;     // white ball travel along z
+		Scalar      paddleMaxZ;
+
+		const Ball* balls;          // extra balls already in play; lost ones are gone until reset
+		int         ballCount;
+
+		// with any arena shapes the walls and shapes are baked into a distance
+		// field, and balls meet the arena through it instead of wall by wall
+		const ArenaShape* arenaShapes;
+		int               arenaShapeCount;
+		Scalar            fieldCellSize;  // 0 picks a default
+	};
+
+	enum EventKind
+	{
+		EVENT_TARGET_HIT = 0,
+		EVENT_BRICK_HIT,
+		EVENT_WALL_BOUNCE,
+		EVENT_PADDLE_HIT,
+		EVENT_BALL_LOST
+	};
+
+	struct Event
+	{
+		int  kind;                  // EventKind
+		int  index;                 // target, brick or wall index (-1 for the distance field); the ball for hits and losses
+		Vec2 position;              // ball center when it happened
+	};
+
+	class World
+	{
+	public:
+		World(void);
+
+		// reserves the level arena once; loadLevel() fails if a level needs more
+		bool init(size_t levelBytes);
+
+		// splits step() across the pool's threads; set it before loadLevel(),
+		// which sizes the per-thread buffers. NULL runs on the caller only.
+		void setJobSystem(JobSystem* jobs)  { m_jobs = jobs; }
+
+		bool loadLevel(const LevelDesc& level);
+		void resetLevel(void);              // all targets back, ball parked on the white ball
+
+		void step(Scalar timeDelta);        // one frame of game logic
+		void launch(void);                  // VK_SPACE
+		void movePaddle(Scalar z);          // clamped to the level's paddle range
+
+		bool        isPlaying(void) const   { return m_playing; }
+		const Ball& ball(void) const        { return m_balls[0]; }
+		const Ball& paddle(void) const      { return m_paddle; }
+
+		// ball 0 is the red ball; the rest come from LevelDesc::balls
+		int                  ballCount(void) const   { return m_ballCount; }
+		const Ball*          balls(void) const       { return m_balls; }
+		const unsigned char* ballActive(void) const  { return m_ballActive; }
+
+		int                  sphereCount(void) const { return m_sphereCount; }
+		const Vec2*          spheres(void) const     { return m_spheres; }
+		const unsigned char* sphereAlive(void) const { return m_sphereAlive; }
+		int                  brickCount(void) const  { return m_brickCount; }
+		const Aabb*          bricks(void) const      { return m_bricks; }
+		const unsigned char* brickAlive(void) const  { return m_brickAlive; }
+		int                  wallCount(void) const   { return m_wallCount; }
+		const Aabb*          walls(void) const       { return m_walls; }
+		Scalar               exitX(void) const       { return m_exitX; }
+		const DistanceField& field(void) const       { return m_field; }
+		int                  liveTargets(void) const { return m_liveTargets; }
+
+		// the broadphase grid, for TrajectoryScene::grid
+		TargetGrid           targetGrid(void) const;
+
+		// events raised by the last step()
+		int          eventCount(void) const  { return m_eventCount; }
+		const Event* events(void) const      { return m_events; }
+
+		const LinearArena& arena(void) const { return m_arena; }
+
+		// 64-bit FNV-1a over everything step() changes, for determinism checks
+		uint64_t stateHash(void) const;
+
+	private:
+		World(const World&);
+		World& operator=(const World&);
+
+		struct Hit
+		{
+			int  item;                      // grid item: sphere i or sphereCount + brick
+			Vec2 position;
+		};
+
+		// per-thread scratch for the detect phase
+		struct ThreadScratch
+		{
+			int* candidates;                // m_candidateCap
+			Hit* hits;
+			int  hitCount;
+			int  hitCap;
+		};
+
+		// what one ball did this step, written by whichever thread ran it
+		struct BallStep
+		{
+			Ball  after;                    // state after its target hits
+			int   hitThread;
+			int   hitStart;
+			int   hitCount;                 // -1 if the thread's hit buffer ran out
+			int   tests;
+			int   eventCount;               // into m_ballEvents + ball * m_ballEventStride
+			bool  lost;
+		};
+
+		bool buildGrid(void);
+		bool bakeField(const LevelDesc& level);
+		int  collideArena(Ball& b, Event* out) const;
+		int  arenaTests(void) const         { return m_field.isBaked() ? 1 : m_wallCount; }
+		int  gatherCandidates(const Vec2& p, Scalar reach, int* out) const;
+		int  collideTargets(Ball& b, int* candidates, Hit* hits, int hitCap, int& hitCount) const;
+		bool isAlive(int item) const;
+		void detectBall(int ball, int thread);
+		void resolveBall(int ball);
+		void moveBall(int ball, Scalar timeDelta);
+		void runPhase(void (*fn)(void*, int, int, int));
+		void integrate(Ball& b, Scalar timeDelta) const;
+		void parkBall(void);
+		void pushEvent(int kind, int index, const Vec2& pos);
+
+		static void detectRange(void* ctx, int begin, int end, int thread);
+		static void moveRange(void* ctx, int begin, int end, int thread);
+
+		LinearArena    m_arena;
+
+		// level data, carved from m_arena
+		Vec2*          m_spheres;
+		unsigned char* m_sphereAlive;
+		int            m_sphereCount;
+		Aabb*          m_bricks;
+		unsigned char* m_brickAlive;
+		int            m_brickCount;
+		Aabb*          m_walls;
+		int            m_wallCount;
+		Scalar         m_exitX;
+		Scalar         m_paddleMinZ, m_paddleMaxZ;
+		DistanceField  m_field;             // baked only for levels with arena shapes
+
+		// uniform grid over the targets; items are sphere i or brick (sphereCount + i)
+		Vec2           m_gridOrigin;
+		Scalar         m_cellSize;
+		int            m_gridW, m_gridH;
+		int*           m_cellStart;         // m_gridW * m_gridH + 1 offsets into m_cellItems
+		int*           m_cellItems;
+		int            m_candidateCap;      // enough for any query
+
+		JobSystem*     m_jobs;
+		int            m_threadCount;       // per-thread scratch carved at load
+		ThreadScratch* m_threads;
+		Hit*           m_redoHits;          // resolve phase redo, m_candidateCap entries
+		BallStep*      m_steps;
+		Event*         m_ballEvents;
+		int            m_ballEventStride;   // wall bounces, a paddle hit and a loss
+		Scalar         m_stepDelta;
+
+		Event*         m_events;
+		int            m_eventCount;
+		int            m_eventCap;
+
+		// game state
+		Ball*          m_balls;             // [0] is the red ball
+		Ball*          m_ballStart;         // extra balls as loaded
+		unsigned char* m_ballActive;
+		int            m_ballCount;
+		Ball           m_paddle;            // white ball
+		bool           m_playing;
+		int            m_liveTargets;
+	};
+}
+
+#endif // __gameWorldH__
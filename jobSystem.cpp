@@ -0,0 +1,117 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: jobSystem.cpp
+// 
+// Desc: JobSystem worker pool.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "jobSystem.h"
+
+JobSystem::JobSystem(void)
+	: m_next(0)
+{
+	m_fn         = NULL;
+	m_ctx        = NULL;
+	m_count      = 0;
+	m_grain      = 1;
+	m_busy       = 0;
+	m_generation = 0;
+	m_quit       = false;
+}
+
+JobSystem::~JobSystem(void)
+{
+	stop();
+}
+
+int JobSystem::hardwareThreads(void)
+{
+	int n = (int)std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+bool JobSystem::start(int threads)
+{
+	stop();
+	m_quit = false;
+	for (int i = 1; i < threads; i++)
+		m_workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+	return true;
+}
+
+void JobSystem::stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+	m_workers.clear();
+}
+
+void JobSystem::runChunks(int thread)
+{
+	for (;;) {
+		int begin = m_next.fetch_add(m_grain, std::memory_order_relaxed);
+		if (begin >= m_count)
+			break;
+		int end = begin + m_grain < m_count ? begin + m_grain : m_count;
+		m_fn(m_ctx, begin, end, thread);
+	}
+}
+
+void JobSystem::workerLoop(int thread)
+{
+	unsigned seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_quit && m_generation == seen)
+				m_wake.wait(lock);
+			if (m_quit)
+				return;
+			seen = m_generation;
+		}
+
+		runChunks(thread);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busy == 0)
+			m_done.notify_one();
+	}
+}
+
+void JobSystem::parallelFor(int count, int grain, RangeFn fn, void* ctx)
+{
+	if (count <= 0)
+		return;
+	if (grain < 1)
+		grain = 1;
+
+	// not worth waking anybody for a single chunk
+	if (m_workers.empty() || count <= grain) {
+		fn(ctx, 0, count, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fn    = fn;
+		m_ctx   = ctx;
+		m_count = count;
+		m_grain = grain;
+		m_next.store(0, std::memory_order_relaxed);
+		m_busy  = (int)m_workers.size();
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	runChunks(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_busy != 0)
+		m_done.wait(lock);
+}
@@ -0,0 +1,63 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: jobSystem.h
+// 
+// Desc: A small pool of worker threads that split index ranges between
+//       themselves. The calling thread takes part as thread 0, and a call only
+//       returns when every chunk is done, so each parallelFor() is one phase of
+//       a frame. Dispatching a range does not allocate.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __jobSystemH__
+#define __jobSystemH__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem
+{
+public:
+	// fn(ctx, begin, end, thread) handles items [begin, end); thread is in [0, threadCount())
+	typedef void (*RangeFn)(void* ctx, int begin, int end, int thread);
+
+	JobSystem(void);
+	~JobSystem(void);
+
+	// threads counts the caller too; 1 runs everything inline
+	bool start(int threads);
+	void stop(void);
+
+	int  threadCount(void) const { return (int)m_workers.size() + 1; }
+
+	// splits [0, count) into chunks of 'grain' items
+	void parallelFor(int count, int grain, RangeFn fn, void* ctx);
+
+	static int hardwareThreads(void);
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	void workerLoop(int thread);
+	void runChunks(int thread);
+
+	std::vector<std::thread> m_workers;
+	std::mutex               m_mutex;
+	std::condition_variable  m_wake;
+	std::condition_variable  m_done;
+
+	RangeFn                  m_fn;
+	void*                    m_ctx;
+	int                      m_count;
+	int                      m_grain;
+	std::atomic<int>         m_next;
+	int                      m_busy;
+	unsigned                 m_generation;
+	bool                     m_quit;
+};
+
+#endif // __jobSystemH__
@@ -0,0 +1,246 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: level.cpp
+// 
+// Desc: The built-in layout and the level text format.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "level.h"
+#include "memTrack.h"
+#include <cstdio>
+#include <cstring>
+
+static const float spherePos[54][2] = {
+	{-2.5,2},{0.5,0.5},{0.5,-0.5},{-0.5,0.5},{-0.5,-0.5},{0,0.5},{0,-0.5},{-0.5,0},{0.5,0},
+	{2.5,2},{2.5,-2},{2,2.5},{2,-2.5},{0,2.5},{0,-2.5},{-2,2.5},{-2,-2.5},{2.5,0},
+	{3,1},{3,-1},{-3,1},{-2.5,0},{-3,-1},{-1,0.5},{-1,-0.5},{1.5,1.5},{1.5,-1.5},
+	{-1.5,1.5},{-1.5,-1.5},{0,1.5},{0,-1.5},{-1.5,0},{1.5,0},{1,1.5},{1,-1.5},{-1,1.5},
+	{-1,-1.5},{1.5,1},{1.5,-1},{-1.5,1},{-1.5,-1},{0.5,1.5},{0.5,-1.5},{-0.5,1.5},{-0.5,-1.5},
+	{1.5,0.5},{1.5,-0.5},{-1.5,0.5},{-1.5,-0.5},{-2.5,2.5},{-2.5,-2.5},{2.5,2.5},{2.5,-2.5},{-2.5,-2}
+}; 
+
+// rectangular bricks: x, z, width (along x), depth (along z)
+static const float brickPos[6][4] = {
+	{-3.8f,-2.5f,0.3f,0.8f},{-3.8f,-1.5f,0.3f,0.8f},{-3.8f,-0.5f,0.3f,0.8f},
+	{-3.8f,0.5f,0.3f,0.8f},{-3.8f,1.5f,0.3f,0.8f},{-3.8f,2.5f,0.3f,0.8f}
+};
+
+// walls around the 9 x 6 plane: x, z, width, depth; the +x side is open
+static const float wallPos[3][4] = {
+	{0.0f,3.06f,9.0f,0.12f},{0.0f,-3.06f,9.0f,0.12f},{-4.56f,0.0f,0.12f,6.24f}
+};
+
+static const float PLANE_WIDTH = 9.0f;
+
+sim::Level::Level(void)
+{
+	clear();
+}
+
+void sim::Level::clear(void)
+{
+	spheres.clear();
+	bricks.clear();
+	walls.clear();
+	balls.clear();
+	arena.clear();
+	fieldCell   = 0;
+	exitX       = 0;
+	paddleStart = Vec2(0, 0);
+	paddleMinZ  = 0;
+	paddleMaxZ  = 0;
+}
+
+sim::LevelDesc sim::Level::desc(void) const
+{
+	LevelDesc d;
+	d.spheres     = spheres.empty() ? NULL : &spheres[0];
+	d.sphereCount = (int)spheres.size();
+	d.bricks      = bricks.empty() ? NULL : &bricks[0];
+	d.brickCount  = (int)bricks.size();
+	d.walls       = walls.empty() ? NULL : &walls[0];
+	d.wallCount   = (int)walls.size();
+	d.exitX       = exitX;
+	d.paddleStart = paddleStart;
+	d.paddleMinZ  = paddleMinZ;
+	d.paddleMaxZ  = paddleMaxZ;
+	d.balls       = balls.empty() ? NULL : &balls[0];
+	d.ballCount   = (int)balls.size();
+	d.arenaShapes     = arena.empty() ? NULL : &arena[0];
+	d.arenaShapeCount = (int)arena.size();
+	d.fieldCellSize   = fieldCell;
+	return d;
+}
+
+void sim::defaultLevel(Level& level)
+{
+	mem::Scope tag(mem::TAG_LEVEL);
+	int i;
+
+	level.clear();
+	for (i = 0; i < 54; i++)
+		level.spheres.push_back(toVec2(spherePos[i][0], spherePos[i][1]));
+	for (i = 0; i < 6; i++)
+		level.bricks.push_back(boxAt(Scalar(brickPos[i][0]), Scalar(brickPos[i][1]), Scalar(brickPos[i][2]), Scalar(brickPos[i][3])));
+	for (i = 0; i < 3; i++)
+		level.walls.push_back(boxAt(Scalar(wallPos[i][0]), Scalar(wallPos[i][1]), Scalar(wallPos[i][2]), Scalar(wallPos[i][3])));
+
+	// red ball is lost past the open side; the white ball rides along it between the walls
+	level.exitX       = Scalar(PLANE_WIDTH * 0.5f);
+	level.paddleStart = toVec2(PLANE_WIDTH * 0.5f, 0.0f);
+	level.paddleMinZ  = Scalar(wallPos[1][1] + wallPos[1][3] * 0.5f) + BALL_RADIUS;
+	level.paddleMaxZ  = Scalar(wallPos[0][1] - wallPos[0][3] * 0.5f) - BALL_RADIUS;
+}
+
+// one line of the text format; false if it isn't blank, a comment or an item
+static bool parseLevelLine(char* line, sim::Level& level, char* kind)
+{
+	using namespace sim;
+	char* hash = strchr(line, '#');
+	if (hash) *hash = '\0';
+
+	float v[5];
+	int n = sscanf(line, "%15s %f %f %f %f %f", kind, &v[0], &v[1], &v[2], &v[3], &v[4]);
+	if (n <= 0)
+		return true;   // blank or comment
+
+	// arena shapes end with an optional "inside"
+	ArenaShape shape;
+	shape.inside = strstr(line, "inside") != NULL;
+
+	if      (strcmp(kind, "sphere") == 0 && n == 3) level.spheres.push_back(toVec2(v[0], v[1]));
+	else if (strcmp(kind, "brick") == 0 && n == 5)  level.bricks.push_back(Aabb(toVec2(v[0], v[1]), toVec2(v[2], v[3])));
+	else if (strcmp(kind, "wall") == 0 && n == 5)   level.walls.push_back(Aabb(toVec2(v[0], v[1]), toVec2(v[2], v[3])));
+	else if (strcmp(kind, "exit") == 0 && n == 2)   level.exitX = Scalar(v[0]);
+	else if (strcmp(kind, "fieldcell") == 0 && n == 2) level.fieldCell = Scalar(v[0]);
+	else if ((strcmp(kind, "arenabox") == 0 || strcmp(kind, "arenasegment") == 0) && n == 6) {
+		shape.kind   = kind[5] == 'b' ? ARENA_BOX : ARENA_SEGMENT;
+		shape.a      = toVec2(v[0], v[1]);
+		shape.b      = toVec2(v[2], v[3]);
+		shape.radius = Scalar(v[4]);
+		level.arena.push_back(shape);
+	}
+	else if (strcmp(kind, "arenacircle") == 0 && n == 4) {
+		shape.kind   = ARENA_CIRCLE;
+		shape.a      = shape.b = toVec2(v[0], v[1]);
+		shape.radius = Scalar(v[2]);
+		level.arena.push_back(shape);
+	}
+	else if (strcmp(kind, "ball") == 0 && n == 5) {
+		Ball b;
+		b.pos = toVec2(v[0], v[1]);
+		b.vel = toVec2(v[2], v[3]);
+		level.balls.push_back(b);
+	}
+	else if (strcmp(kind, "paddle") == 0 && n == 5) {
+		level.paddleStart = toVec2(v[0], v[1]);
+		level.paddleMinZ  = Scalar(v[2]);
+		level.paddleMaxZ  = Scalar(v[3]);
+	}
+	else
+		return false;
+	return true;
+}
+
+bool sim::loadLevelFile(const char* path, Level& level)
+{
+	mem::Scope tag(mem::TAG_LEVEL);
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+		return false;
+
+	level.clear();
+	char line[256];
+	char kind[16];
+	int lineNo = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), fp)) {
+		lineNo++;
+		if (!parseLevelLine(line, level, kind)) {
+			fprintf(stderr, "%s(%d): can't parse '%s'\n", path, lineNo, kind);
+			ok = false;
+		}
+	}
+	fclose(fp);
+	return ok;
+}
+
+bool sim::loadLevelPack(const char* path, std::vector<Level>& levels)
+{
+	mem::Scope tag(mem::TAG_LEVEL);
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+		return false;
+
+	levels.clear();
+	char line[256];
+	char kind[16];
+	int lineNo = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), fp)) {
+		lineNo++;
+		bool word = sscanf(line, "%15s", kind) == 1;
+		if (word && strcmp(kind, "level") == 0) {
+			levels.push_back(Level());
+			continue;
+		}
+		if (levels.empty()) {
+			// only comments before the first level
+			if (word && kind[0] != '#') {
+				fprintf(stderr, "%s(%d): '%s' before the first level\n", path, lineNo, kind);
+				ok = false;
+			}
+			continue;
+		}
+		if (!parseLevelLine(line, levels.back(), kind)) {
+			fprintf(stderr, "%s(%d): can't parse '%s'\n", path, lineNo, kind);
+			ok = false;
+		}
+	}
+	fclose(fp);
+	return ok;
+}
+
+// %.9g round-trips every float, so a saved level replays bit for bit
+bool sim::writeLevel(FILE* fp, const Level& level)
+{
+	size_t i;
+	fprintf(fp, "exit %.9g\n", toFloat(level.exitX));
+	fprintf(fp, "paddle %.9g %.9g %.9g %.9g\n", toFloat(level.paddleStart.x), toFloat(level.paddleStart.z), toFloat(level.paddleMinZ), toFloat(level.paddleMaxZ));
+	for (i = 0; i < level.walls.size(); i++) {
+		const Aabb& b = level.walls[i];
+		fprintf(fp, "wall %.9g %.9g %.9g %.9g\n", toFloat(b.lo.x), toFloat(b.lo.z), toFloat(b.hi.x), toFloat(b.hi.z));
+	}
+	for (i = 0; i < level.spheres.size(); i++)
+		fprintf(fp, "sphere %.9g %.9g\n", toFloat(level.spheres[i].x), toFloat(level.spheres[i].z));
+	for (i = 0; i < level.bricks.size(); i++) {
+		const Aabb& b = level.bricks[i];
+		fprintf(fp, "brick %.9g %.9g %.9g %.9g\n", toFloat(b.lo.x), toFloat(b.lo.z), toFloat(b.hi.x), toFloat(b.hi.z));
+	}
+	if (level.fieldCell > 0)
+		fprintf(fp, "fieldcell %.9g\n", toFloat(level.fieldCell));
+	for (i = 0; i < level.arena.size(); i++) {
+		const ArenaShape& a = level.arena[i];
+		const char* inside = a.inside ? " inside" : "";
+		if (a.kind == ARENA_CIRCLE)
+			fprintf(fp, "arenacircle %.9g %.9g %.9g%s\n", toFloat(a.a.x), toFloat(a.a.z), toFloat(a.radius), inside);
+		else
+			fprintf(fp, "%s %.9g %.9g %.9g %.9g %.9g%s\n", a.kind == ARENA_BOX ? "arenabox" : "arenasegment",
+				toFloat(a.a.x), toFloat(a.a.z), toFloat(a.b.x), toFloat(a.b.z), toFloat(a.radius), inside);
+	}
+	for (i = 0; i < level.balls.size(); i++) {
+		const Ball& b = level.balls[i];
+		fprintf(fp, "ball %.9g %.9g %.9g %.9g\n", toFloat(b.pos.x), toFloat(b.pos.z), toFloat(b.vel.x), toFloat(b.vel.z));
+	}
+	return ferror(fp) == 0;
+}
+
+bool sim::saveLevelFile(const char* path, const Level& level)
+{
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL)
+		return false;
+	bool ok = writeLevel(fp, level);
+	return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,77 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: level.h
+// 
+// Desc: Level layouts independent of the renderer: the built-in layout the
+//       game starts with, and a plain text format for other ones. A Level
+//       owns its arrays; desc() points a LevelDesc at them for World.
+//
+//       Text format, one item per line, '#' starts a comment:
+//
+//           sphere x z
+//           brick  minX minZ maxX maxZ
+//           wall   minX minZ maxX maxZ
+//           ball   x z vx vz
+//           exit   x
+//           paddle x z minZ maxZ
+//
+//       Arena shapes for the distance field (see distanceField.h); "inside"
+//       as a last word makes the shape the play area instead of a solid:
+//
+//           arenabox     minX minZ maxX maxZ cornerRadius [inside]
+//           arenasegment ax az bx bz radius [inside]
+//           arenacircle  x z radius [inside]
+//           fieldcell    size
+//
+//       A level pack (see tools/packBuilder.cpp) holds any number of levels
+//       in the same format, each one starting at a line whose first word is
+//       "level"; the rest of that line is ignored.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __levelH__
+#define __levelH__
+
+#include "gameWorld.h"
+#include <cstdio>
+#include <vector>
+
+namespace sim
+{
+	struct Level
+	{
+		std::vector<Vec2> spheres;
+		std::vector<Aabb> bricks;
+		std::vector<Aabb> walls;
+		std::vector<Ball> balls;        // extra balls, see LevelDesc::balls
+		std::vector<ArenaShape> arena;  // baked with the walls into a distance field
+		Scalar            fieldCell;
+		Scalar            exitX;
+		Vec2              paddleStart;
+		Scalar            paddleMinZ;
+		Scalar            paddleMaxZ;
+
+		Level(void);
+		void      clear(void);
+		LevelDesc desc(void) const;     // valid until the level changes
+	};
+
+	// box of the given size centred on (x, z), as CWall::getShape() computes it
+	inline Aabb boxAt(Scalar x, Scalar z, Scalar width, Scalar depth)
+	{
+		return Aabb(Vec2(x - width * Scalar(0.5f), z - depth * Scalar(0.5f)), Vec2(x + width * Scalar(0.5f), z + depth * Scalar(0.5f)));
+	}
+
+	// the 54 spheres and 6 bricks on the 9 x 6 plane the game ships with
+	void defaultLevel(Level& level);
+
+	bool loadLevelFile(const char* path, Level& level);
+	bool saveLevelFile(const char* path, const Level& level);
+
+	// the items of one level, as saveLevelFile() writes them
+	bool writeLevel(FILE* fp, const Level& level);
+
+	bool loadLevelPack(const char* path, std::vector<Level>& levels);
+}
+
+#endif // __levelH__
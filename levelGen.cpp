@@ -0,0 +1,403 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: levelGen.cpp
+// 
+// Desc: Layout patterns, symmetry, and LayoutChecker's spatial index.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "levelGen.h"
+#include "distanceField.h"
+#include <cmath>
+
+const char* const sim::layoutPatternNames[sim::LAYOUT_PATTERN_COUNT] = {
+	"grid",
+	"rings",
+	"diamond",
+	"scatter",
+};
+
+const char* const sim::layoutSymmetryNames[sim::SYMMETRY_COUNT] = {
+	"none",
+	"mirror",
+	"point",
+};
+
+const char* const sim::layoutFaultNames[sim::LAYOUT_FAULT_COUNT] = {
+	"ok",
+	"empty",
+	"out of bounds",
+	"overlap",
+	"blocked",
+};
+
+// bricks like the built-in ones, laid along x or z
+static const sim::Scalar BRICK_THIN = sim::Scalar(0.3f);
+static const sim::Scalar BRICK_LONG = sim::Scalar(0.8f);
+
+// grid cells the checker may use; levels beyond get bigger cells
+static const int MAX_CHECK_CELLS = 1 << 16;
+
+static const int MAX_LAYOUT_TARGETS = 4096;
+
+namespace
+{
+	struct Rng
+	{
+		uint32_t s;
+
+		explicit Rng(uint32_t seed) : s(seed ? seed : 0x9e3779b9u) {}
+
+		uint32_t next(void)
+		{
+			s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+			return s;
+		}
+		float       unit(void)                         { return (next() & 0xffffff) / 16777216.0f; }
+		sim::Scalar range(sim::Scalar lo, sim::Scalar hi) { return lo + (hi - lo) * sim::Scalar(unit()); }
+	};
+}
+
+static uint32_t mix(uint32_t a, uint32_t b)
+{
+	uint32_t h = a * 0x9e3779b1u ^ (b + 0x7f4a7c15u);
+	h ^= h >> 16; h *= 0x85ebca6bu;
+	h ^= h >> 13; h *= 0xc2b2ae35u;
+	return h ^ (h >> 16);
+}
+
+static sim::Aabb grow(const sim::Aabb& b, sim::Scalar by)
+{
+	return sim::Aabb(sim::Vec2(b.lo.x - by, b.lo.z - by), sim::Vec2(b.hi.x + by, b.hi.z + by));
+}
+
+static bool inside(const sim::Aabb& outer, const sim::Aabb& b)
+{
+	return b.lo.x >= outer.lo.x && b.lo.z >= outer.lo.z && b.hi.x <= outer.hi.x && b.hi.z <= outer.hi.z;
+}
+
+// -----------------------------------------------------------------------------
+// Areas
+// -----------------------------------------------------------------------------
+
+sim::LayoutRules sim::defaultLayoutRules(void)
+{
+	LayoutRules r;
+	r.minGap          = Scalar(0.1f);   // the built-in layout's 0.5 spacing leaves 0.08
+	r.launchClearance = Scalar(0.5f);
+	return r;
+}
+
+sim::Aabb sim::targetArea(const Level& level)
+{
+	// everything the walls and arena shapes span
+	Aabb outer(toVec2(1e30f, 1e30f), toVec2(-1e30f, -1e30f));
+	size_t i;
+	for (i = 0; i < level.walls.size(); i++) {
+		const Aabb& w = level.walls[i];
+		outer.lo = Vec2(w.lo.x < outer.lo.x ? w.lo.x : outer.lo.x, w.lo.z < outer.lo.z ? w.lo.z : outer.lo.z);
+		outer.hi = Vec2(w.hi.x > outer.hi.x ? w.hi.x : outer.hi.x, w.hi.z > outer.hi.z ? w.hi.z : outer.hi.z);
+	}
+	for (i = 0; i < level.arena.size(); i++) {
+		const ArenaShape& a = level.arena[i];
+		Scalar lx = (a.a.x < a.b.x ? a.a.x : a.b.x) - a.radius, hx = (a.a.x > a.b.x ? a.a.x : a.b.x) + a.radius;
+		Scalar lz = (a.a.z < a.b.z ? a.a.z : a.b.z) - a.radius, hz = (a.a.z > a.b.z ? a.a.z : a.b.z) + a.radius;
+		outer.lo = Vec2(lx < outer.lo.x ? lx : outer.lo.x, lz < outer.lo.z ? lz : outer.lo.z);
+		outer.hi = Vec2(hx > outer.hi.x ? hx : outer.hi.x, hz > outer.hi.z ? hz : outer.hi.z);
+	}
+	if (outer.lo.x > outer.hi.x)
+		return Aabb(Vec2(0, 0), Vec2(0, 0));
+
+	// each wall closes the side of the middle it lies on; long ones along x
+	// close the top or bottom, the others the left or right
+	Vec2 mid((outer.lo.x + outer.hi.x) * Scalar(0.5f), (outer.lo.z + outer.hi.z) * Scalar(0.5f));
+	Aabb area = outer;
+	for (i = 0; i < level.walls.size(); i++) {
+		const Aabb& w = level.walls[i];
+		if (w.hi.x - w.lo.x >= w.hi.z - w.lo.z) {
+			if (w.lo.z + w.hi.z > 2 * mid.z) area.hi.z = w.lo.z < area.hi.z ? w.lo.z : area.hi.z;
+			else                                area.lo.z = w.hi.z > area.lo.z ? w.hi.z : area.lo.z;
+		}
+		else {
+			if (w.lo.x + w.hi.x > 2 * mid.x) area.hi.x = w.lo.x < area.hi.x ? w.lo.x : area.hi.x;
+			else                                area.lo.x = w.hi.x > area.lo.x ? w.hi.x : area.lo.x;
+		}
+	}
+	if (level.exitX < area.hi.x)
+		area.hi.x = level.exitX;
+	return area;
+}
+
+sim::Aabb sim::launchLane(const Level& level, Scalar clearance)
+{
+	Scalar parkX = level.paddleStart.x - 2 * BALL_RADIUS;
+	Scalar endX  = level.exitX > level.paddleStart.x + BALL_RADIUS ? level.exitX : level.paddleStart.x + BALL_RADIUS;
+	return Aabb(Vec2(parkX - BALL_RADIUS - clearance, level.paddleMinZ - BALL_RADIUS),
+		Vec2(endX, level.paddleMaxZ + BALL_RADIUS));
+}
+
+// -----------------------------------------------------------------------------
+// Generation
+// -----------------------------------------------------------------------------
+
+sim::LayoutParams sim::layoutParams(uint32_t runSeed, int index, float minDensity, float maxDensity)
+{
+	LayoutParams p;
+	uint32_t h = mix(runSeed, (uint32_t)index);
+	Rng rng(h);
+	p.pattern    = index % LAYOUT_PATTERN_COUNT;
+	p.symmetry   = (index / LAYOUT_PATTERN_COUNT) % SYMMETRY_COUNT;
+	p.density    = minDensity + (maxDensity - minDensity) * rng.unit();
+	p.brickShare = 0.25f * rng.unit();
+	p.seed       = rng.next();
+	return p;
+}
+
+static void addTarget(sim::Level& out, const sim::Vec2& p, int brick)
+{
+	if (brick == 0)
+		out.spheres.push_back(p);
+	else if (brick == 1)
+		out.bricks.push_back(sim::boxAt(p.x, p.z, BRICK_THIN, BRICK_LONG));
+	else
+		out.bricks.push_back(sim::boxAt(p.x, p.z, BRICK_LONG, BRICK_THIN));
+}
+
+// one target of the fundamental region, plus its symmetric copy
+static void place(sim::Level& out, const sim::LayoutParams& params, const sim::Vec2& mid, const sim::Vec2& p, Rng& rng)
+{
+	int brick = rng.unit() < params.brickShare ? 1 + (int)(rng.next() & 1) : 0;
+	addTarget(out, p, brick);
+
+	// a target on the axis is its own copy
+	if (params.symmetry == sim::SYMMETRY_NONE || sim::scalarAbs(p.z - mid.z) < sim::Scalar(1e-4f))
+		return;
+	if (params.symmetry == sim::SYMMETRY_MIRROR)
+		addTarget(out, sim::Vec2(p.x, 2 * mid.z - p.z), brick);
+	else
+		addTarget(out, sim::Vec2(2 * mid.x - p.x, 2 * mid.z - p.z), brick);
+}
+
+void sim::generateLayout(const LayoutParams& params, const Level& shell, Level& out)
+{
+	out.spheres.clear();
+	out.bricks.clear();
+	out.walls       = shell.walls;
+	out.balls       = shell.balls;
+	out.arena       = shell.arena;
+	out.fieldCell   = shell.fieldCell;
+	out.exitX       = shell.exitX;
+	out.paddleStart = shell.paddleStart;
+	out.paddleMinZ  = shell.paddleMinZ;
+	out.paddleMaxZ  = shell.paddleMaxZ;
+
+	// centers stay a ball radius inside the walls and short of the launch lane
+	Aabb area = targetArea(shell);
+	Aabb lane = launchLane(shell, defaultLayoutRules().launchClearance);
+	if (lane.lo.x < area.hi.x)
+		area.hi.x = lane.lo.x;
+	Aabb f = grow(area, -BALL_RADIUS);
+	if (f.lo.x >= f.hi.x || f.lo.z >= f.hi.z)
+		return;
+
+	// the symmetric kinds lay out the top half and copy it
+	Vec2 mid((f.lo.x + f.hi.x) * Scalar(0.5f), (f.lo.z + f.hi.z) * Scalar(0.5f));
+	if (params.symmetry != SYMMETRY_NONE)
+		f.lo.z = mid.z;
+
+	Rng    rng(params.seed);
+	Scalar w = f.hi.x - f.lo.x, d = f.hi.z - f.lo.z;
+	int    n = truncToInt(Scalar(params.density) * (w + 2 * BALL_RADIUS) * (d + BALL_RADIUS) / (Scalar(3.14159265f) * BALL_RADIUS * BALL_RADIUS));
+	if (n < 1) n = 1;
+	if (n > MAX_LAYOUT_TARGETS / 2) n = MAX_LAYOUT_TARGETS / 2;
+	Scalar s = scalarSqrt(w * d / n);   // spacing that fits n
+
+	switch (params.pattern) {
+	case LAYOUT_GRID: {
+		Vec2 o(f.lo.x + rng.range(0, s), f.lo.z + rng.range(0, s));
+		for (Scalar z = o.z; z <= f.hi.z; z += s) {
+			for (Scalar x = o.x; x <= f.hi.x; x += s) {
+				Vec2 p(x + rng.range(Scalar(-0.05f), Scalar(0.05f)) * s, z + rng.range(Scalar(-0.05f), Scalar(0.05f)) * s);
+				if (p.x >= f.lo.x && p.x <= f.hi.x && p.z >= f.lo.z && p.z <= f.hi.z)
+					place(out, params, mid, p, rng);
+			}
+		}
+		break;
+	}
+	case LAYOUT_RINGS: {
+		Vec2 c(rng.range(f.lo.x, f.hi.x), rng.range(f.lo.z, f.hi.z));
+		Scalar reach = scalarSqrt(w * w + d * d);
+		for (int k = 0; k * s <= reach; k++) {
+			int   count = k == 0 ? 1 : (int)(6.2831853f * k);
+			float turn  = 6.2831853f * rng.unit();
+			for (int i = 0; i < count; i++) {
+				float a = turn + 6.2831853f * i / count;
+				Vec2  p(c.x + Scalar(std::cos(a) * k) * s, c.z + Scalar(std::sin(a) * k) * s);
+				if (p.x >= f.lo.x && p.x <= f.hi.x && p.z >= f.lo.z && p.z <= f.hi.z)
+					place(out, params, mid, p, rng);
+			}
+		}
+		break;
+	}
+	case LAYOUT_DIAMOND: {
+		// neighbours s apart along both diagonals
+		Scalar h = s * Scalar(0.70710678f);
+		Vec2  c(rng.range(f.lo.x, f.hi.x), rng.range(f.lo.z, f.hi.z));
+		int   k = truncToInt((w + d) / h) + 1;
+		for (int i = -k; i <= k; i++) {
+			for (int j = -k; j <= k; j++) {
+				Vec2 p(c.x + (i - j) * h, c.z + (i + j) * h);
+				if (p.x >= f.lo.x && p.x <= f.hi.x && p.z >= f.lo.z && p.z <= f.hi.z)
+					place(out, params, mid, p, rng);
+			}
+		}
+		break;
+	}
+	default: {
+		// dart throwing; the gap rule is the checker's business
+		std::vector<Vec2> placed;
+		placed.reserve(n);
+		const Scalar minD2 = 4 * BALL_RADIUS * BALL_RADIUS;
+		for (int tries = 0; tries < n * 30 && (int)placed.size() < n; tries++) {
+			Vec2 p(rng.range(f.lo.x, f.hi.x), rng.range(f.lo.z, f.hi.z));
+			bool clear = true;
+			for (size_t i = 0; i < placed.size() && clear; i++)
+				clear = lengthSq(p - placed[i]) >= minD2;
+			if (clear) {
+				placed.push_back(p);
+				place(out, params, mid, p, rng);
+			}
+		}
+		break;
+	}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Checking
+// -----------------------------------------------------------------------------
+
+sim::LayoutChecker::LayoutChecker(void)
+{
+	m_rules      = defaultLayoutRules();
+	m_maxTargets = 0;
+}
+
+bool sim::LayoutChecker::init(int maxTargets, const LayoutRules& rules)
+{
+	m_rules      = rules;
+	m_maxTargets = maxTargets;
+	m_cellStart.assign(MAX_CHECK_CELLS + 1, 0);
+	m_cellItems.assign((size_t)maxTargets * 4, 0);   // a target covers at most 2 x 2 cells
+	return true;
+}
+
+// targets 0..spheres-1 are spheres, the rest bricks; both grown by half the gap
+bool sim::LayoutChecker::overlaps(const Level& level, int i, int j) const
+{
+	int   ns   = (int)level.spheres.size();
+	Scalar half = m_rules.minGap * Scalar(0.5f);
+	Manifold m;
+	if (i < ns && j < ns)
+		return collide(Sphere(level.spheres[i], BALL_RADIUS + half), Sphere(level.spheres[j], BALL_RADIUS + half), m);
+	if (i < ns)
+		return collide(Sphere(level.spheres[i], BALL_RADIUS + half), grow(level.bricks[j - ns], half), m);
+	if (j < ns)
+		return collide(Sphere(level.spheres[j], BALL_RADIUS + half), grow(level.bricks[i - ns], half), m);
+	return collide(grow(level.bricks[i - ns], half), grow(level.bricks[j - ns], half), m);
+}
+
+int sim::LayoutChecker::check(const Level& level, int* a, int* b)
+{
+	int ns = (int)level.spheres.size();
+	int n  = ns + (int)level.bricks.size();
+	if (a) *a = -1;
+	if (b) *b = -1;
+	if (n == 0)
+		return LAYOUT_EMPTY;
+	if (n > m_maxTargets)
+		init(n, m_rules);
+
+	Aabb  area = targetArea(level);
+	Aabb  lane = launchLane(level, m_rules.launchClearance);
+	Scalar half = m_rules.minGap * Scalar(0.5f);
+	Scalar extent = 2 * BALL_RADIUS;
+	int   i;
+
+	// walls and arena shapes, then the launch lane
+	for (i = 0; i < n; i++) {
+		Aabb  box   = i < ns ? grow(Aabb(level.spheres[i], level.spheres[i]), BALL_RADIUS) : level.bricks[i - ns];
+		Vec2  c((box.lo.x + box.hi.x) * Scalar(0.5f), (box.lo.z + box.hi.z) * Scalar(0.5f));
+		Scalar reach = i < ns ? BALL_RADIUS : Scalar(0.5f) * length(box.hi - box.lo);
+		bool  out   = !inside(area, box);
+		for (size_t k = 0; k < level.arena.size() && !out; k++) {
+			Vec2 g;
+			out = arenaDistance(level.arena[k], c, g) < reach;
+		}
+		if (out) {
+			if (a) *a = i;
+			return LAYOUT_OUT_OF_BOUNDS;
+		}
+		if (box.hi.x - box.lo.x > extent) extent = box.hi.x - box.lo.x;
+		if (box.hi.z - box.lo.z > extent) extent = box.hi.z - box.lo.z;
+	}
+	for (i = 0; i < n; i++) {
+		Manifold m;
+		bool hit = i < ns ? collide(Sphere(level.spheres[i], BALL_RADIUS), lane, m) : collide(level.bricks[i - ns], lane, m);
+		if (hit) {
+			if (a) *a = i;
+			return LAYOUT_BLOCKED;
+		}
+	}
+
+	// cells at least as big as any grown target, so each lands in 2 x 2 at most
+	Scalar cell = extent + m_rules.minGap;
+	Vec2   origin(area.lo.x - cell, area.lo.z - cell);
+	int    gw = truncToInt((area.hi.x - area.lo.x) / cell) + 3;
+	int    gh = truncToInt((area.hi.z - area.lo.z) / cell) + 3;
+	while (gw * gh > MAX_CHECK_CELLS) {
+		cell *= 2;
+		gw = truncToInt((area.hi.x - area.lo.x) / cell) + 3;
+		gh = truncToInt((area.hi.z - area.lo.z) / cell) + 3;
+	}
+	int cells = gw * gh;
+
+	// counting sort: how many per cell, where each cell starts, then fill
+	int* start = &m_cellStart[0];
+	int* items = &m_cellItems[0];
+	for (i = 0; i <= cells; i++)
+		start[i] = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		for (i = 0; i < n; i++) {
+			Aabb box = grow(i < ns ? grow(Aabb(level.spheres[i], level.spheres[i]), BALL_RADIUS) : level.bricks[i - ns], half);
+			int x0 = truncToInt((box.lo.x - origin.x) / cell), x1 = truncToInt((box.hi.x - origin.x) / cell);
+			int z0 = truncToInt((box.lo.z - origin.z) / cell), z1 = truncToInt((box.hi.z - origin.z) / cell);
+			for (int z = z0; z <= z1; z++)
+				for (int x = x0; x <= x1; x++) {
+					if (pass == 0) start[z * gw + x + 1]++;
+					else           items[start[z * gw + x]++] = i;
+				}
+		}
+		if (pass == 0) {
+			for (i = 0; i < cells; i++)
+				start[i + 1] += start[i];
+		}
+	}
+	// the fill moved every start to the next cell's; shift them back
+	for (i = cells; i > 0; i--)
+		start[i] = start[i - 1];
+	start[0] = 0;
+
+	for (int c = 0; c < cells; c++) {
+		for (int p = start[c]; p < start[c + 1]; p++) {
+			for (int q = p + 1; q < start[c + 1]; q++) {
+				if (overlaps(level, items[p], items[q])) {
+					if (a) *a = items[p] < items[q] ? items[p] : items[q];
+					if (b) *b = items[p] < items[q] ? items[q] : items[p];
+					return LAYOUT_OVERLAP;
+				}
+			}
+		}
+	}
+	return LAYOUT_OK;
+}
@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: levelGen.h
+// 
+// Desc: Procedural target layouts and the checks a layout has to pass before
+//       it goes into a level pack: targets keep a gap between each other
+//       (found through a uniform grid, not by testing every pair), stay
+//       inside the walls, and leave the lane in front of the white ball free
+//       so a launch has somewhere to go. Generation and checking of one
+//       layout only depend on its parameters, so any number of threads can
+//       work through a run and produce the same pack.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __levelGenH__
+#define __levelGenH__
+
+#include "level.h"
+#include <cstdint>
+
+namespace sim
+{
+	enum LayoutPattern
+	{
+		LAYOUT_GRID = 0,            // rows and columns, slightly jittered
+		LAYOUT_RINGS,               // concentric rings around a point
+		LAYOUT_DIAMOND,             // a grid turned 45 degrees
+		LAYOUT_SCATTER,             // random, no two centers closer than a ball
+
+		LAYOUT_PATTERN_COUNT
+	};
+
+	enum LayoutSymmetry
+	{
+		SYMMETRY_NONE = 0,
+		SYMMETRY_MIRROR,            // top half mirrored onto the bottom, like the built-in layout
+		SYMMETRY_POINT,             // half turned 180 degrees about the middle
+
+		SYMMETRY_COUNT
+	};
+
+	enum LayoutFault
+	{
+		LAYOUT_OK = 0,
+		LAYOUT_EMPTY,               // no targets
+		LAYOUT_OUT_OF_BOUNDS,       // through a wall or an arena shape
+		LAYOUT_OVERLAP,             // two targets closer than the gap
+		LAYOUT_BLOCKED,             // a target in the launch lane
+
+		LAYOUT_FAULT_COUNT
+	};
+
+	extern const char* const layoutPatternNames[LAYOUT_PATTERN_COUNT];
+	extern const char* const layoutSymmetryNames[SYMMETRY_COUNT];
+	extern const char* const layoutFaultNames[LAYOUT_FAULT_COUNT];
+
+	struct LayoutParams
+	{
+		int      pattern;           // LayoutPattern
+		int      symmetry;          // LayoutSymmetry
+		float    density;           // share of the free area covered by targets
+		float    brickShare;        // share of targets that become bricks
+		uint32_t seed;
+	};
+
+	// the parameters of layout 'index' of a run, spread over every pattern and
+	// symmetry with densities in [minDensity, maxDensity]
+	LayoutParams layoutParams(uint32_t runSeed, int index, float minDensity, float maxDensity);
+
+	// keeps the walls, exit and paddle of 'shell' and lays new targets out
+	// between them; 'out' may be reused to keep its capacity
+	void generateLayout(const LayoutParams& params, const Level& shell, Level& out);
+
+	struct LayoutRules
+	{
+		Scalar minGap;              // between target surfaces
+		Scalar launchClearance;     // free run in front of the parked ball
+	};
+
+	LayoutRules defaultLayoutRules(void);
+
+	// inside the walls; the open side ends at the exit
+	Aabb targetArea(const Level& level);
+
+	// the strip the red ball is parked and launched in, along the whole paddle travel
+	Aabb launchLane(const Level& level, Scalar clearance);
+
+	//
+	// Checks layouts against the rules. Owns its spatial index, so one per
+	// thread; check() doesn't allocate once init() has sized it.
+	//
+	class LayoutChecker
+	{
+	public:
+		LayoutChecker(void);
+
+		bool init(int maxTargets, const LayoutRules& rules);
+
+		// LayoutFault; for an overlap 'a' and 'b' are the two targets
+		// (spheres first, then bricks), otherwise 'a' is the offender
+		int check(const Level& level, int* a = NULL, int* b = NULL);
+
+	private:
+		bool overlaps(const Level& level, int i, int j) const;
+
+		LayoutRules       m_rules;
+		int               m_maxTargets;
+		std::vector<int>  m_cellStart;  // targets sorted into grid cells, per cell a range of m_cellItems
+		std::vector<int>  m_cellItems;
+	};
+}
+
+#endif // __levelGenH__
@@ -0,0 +1,172 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: mappedFile.cpp
+// 
+// Desc: Win32 / POSIX implementation of MappedFile.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "mappedFile.h"
+#include "memTrack.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(void)
+{
+	m_pData = NULL;
+	m_size  = 0;
+	m_tag   = mem::TAG_UNTAGGED;
+#ifdef _WIN32
+	m_hFile    = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#else
+	m_fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile(void)
+{
+	close();
+}
+
+bool MappedFile::create(const char* path, size_t bytes)
+{
+	return map(path, bytes, true, true);
+}
+
+bool MappedFile::open(const char* path, bool writable, size_t bytes)
+{
+	return map(path, bytes, writable, false);
+}
+
+#ifdef _WIN32
+
+bool MappedFile::map(const char* path, size_t bytes, bool writable, bool create)
+{
+	close();
+
+	// OPEN_ALWAYS, not CREATE_ALWAYS: that fails while a reader holds a view
+	DWORD access = writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+	DWORD share  = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+	HANDLE hFile = ::CreateFileA(path, access, share, 0,
+		create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER len;
+	if (!::GetFileSizeEx(hFile, &len)) {
+		::CloseHandle(hFile);
+		return false;
+	}
+	if (bytes == 0)
+		bytes = (size_t)len.QuadPart;
+	// a shorter file is grown by the mapping below when creating, refused otherwise
+	if (bytes == 0 || (!create && (unsigned __int64)len.QuadPart < bytes)) {
+		::CloseHandle(hFile);
+		return false;
+	}
+
+	HANDLE hMapping = ::CreateFileMappingA(hFile, 0, writable ? PAGE_READWRITE : PAGE_READONLY,
+		0, (DWORD)bytes, 0);
+	if (hMapping == NULL) {
+		::CloseHandle(hFile);
+		return false;
+	}
+
+	void* p = ::MapViewOfFile(hMapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, bytes);
+	if (p == NULL) {
+		::CloseHandle(hMapping);
+		::CloseHandle(hFile);
+		return false;
+	}
+
+	m_hFile    = hFile;
+	m_hMapping = hMapping;
+	m_pData    = p;
+	m_size     = bytes;
+	m_tag      = mem::currentTag();
+	mem::charge(m_tag, mem::POOL_MAPPED, m_size);
+	return true;
+}
+
+void MappedFile::close(void)
+{
+	if (m_pData != NULL) {
+		mem::release(m_tag, mem::POOL_MAPPED, m_size);
+		::UnmapViewOfFile(m_pData);
+		m_pData = NULL;
+	}
+	if (m_hMapping != NULL) {
+		::CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE) {
+		::CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+	m_size = 0;
+}
+
+#else
+
+bool MappedFile::map(const char* path, size_t bytes, bool writable, bool create)
+{
+	close();
+
+	// no O_TRUNC: a process that has the file mapped would fault on the lost pages
+	int flags = writable ? O_RDWR : O_RDONLY;
+	if (create) flags |= O_CREAT;
+	int fd = ::open(path, flags, 0644);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	if (bytes == 0)
+		bytes = (size_t)st.st_size;
+	bool shortFile = (size_t)st.st_size < bytes;
+	if (bytes == 0 || (shortFile && !create) ||
+		(shortFile && ::ftruncate(fd, (off_t)bytes) != 0)) {   // only ever grows it
+		::close(fd);
+		return false;
+	}
+
+	void* p = ::mmap(0, bytes, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		::close(fd);
+		return false;
+	}
+
+	m_fd    = fd;
+	m_pData = p;
+	m_size  = bytes;
+	m_tag   = mem::currentTag();
+	mem::charge(m_tag, mem::POOL_MAPPED, m_size);
+	return true;
+}
+
+void MappedFile::close(void)
+{
+	if (m_pData != NULL) {
+		mem::release(m_tag, mem::POOL_MAPPED, m_size);
+		::munmap(m_pData, m_size);
+		m_pData = NULL;
+	}
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_size = 0;
+}
+
+#endif
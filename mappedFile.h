@@ -0,0 +1,56 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: mappedFile.h
+// 
+// Desc: Maps a file on disk into memory so that other processes (or later runs)
+//       can see the same bytes. Works on Win32 and POSIX; nothing here depends
+//       on Direct3D so headless tools can use it too. Views are charged to the
+//       mem::Scope they are opened in.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __mappedFileH__
+#define __mappedFileH__
+
+#include <cstddef>
+
+class MappedFile
+{
+public:
+	MappedFile(void);
+	~MappedFile(void);
+
+	// map the first 'bytes' of a file read/write, creating it or growing it
+	// as needed. An existing file is never truncated or shrunk: another
+	// process may have it mapped, and its pages past a new end would fault.
+	// The old contents stay, so the caller rewrites them.
+	bool create(const char* path, size_t bytes);
+
+	// map an existing file; bytes == 0 maps the whole file. Fails if the
+	// file is shorter than 'bytes'.
+	bool open(const char* path, bool writable, size_t bytes = 0);
+
+	void close(void);
+
+	void*  data(void) const { return m_pData; }
+	size_t size(void) const { return m_size; }
+	bool   isOpen(void) const { return m_pData != NULL; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	bool map(const char* path, size_t bytes, bool writable, bool create);
+
+	void*  m_pData;
+	size_t m_size;
+	int    m_tag;       // mem::Tag the view is charged to
+#ifdef _WIN32
+	void*  m_hFile;
+	void*  m_hMapping;
+#else
+	int    m_fd;
+#endif
+};
+
+#endif // __mappedFileH__
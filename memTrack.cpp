@@ -0,0 +1,191 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: memTrack.cpp
+// 
+// Desc: Per-tag counters, the report and mesh size estimates.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "memTrack.h"
+#include <atomic>
+
+const char* const mem::tagNames[mem::TAG_COUNT] = {
+	"untagged",
+	"render",
+	"level",
+	"particles",
+	"audio",
+	"counters",
+	"env",
+};
+
+const char* const mem::poolNames[mem::POOL_COUNT] = {
+	"heap",
+	"arena",
+	"mapped",
+	"vertex",
+	"index",
+};
+
+// plain zero-initialized statics, so the heap hook can charge before main()
+static std::atomic<uint64_t> s_bytes[mem::TAG_COUNT][mem::POOL_COUNT];
+static std::atomic<uint64_t> s_peak[mem::TAG_COUNT][mem::POOL_COUNT];
+static std::atomic<uint64_t> s_blocks[mem::TAG_COUNT][mem::POOL_COUNT];
+static std::atomic<uint64_t> s_total;
+static std::atomic<uint64_t> s_totalPeak;
+
+static thread_local int t_tag = mem::TAG_UNTAGGED;
+
+static void raisePeak(std::atomic<uint64_t>& peak, uint64_t now)
+{
+	uint64_t seen = peak.load(std::memory_order_relaxed);
+	while (now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed))
+		;
+}
+
+void mem::charge(int tag, int pool, size_t bytes)
+{
+	uint64_t now = s_bytes[tag][pool].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	s_blocks[tag][pool].fetch_add(1, std::memory_order_relaxed);
+	raisePeak(s_peak[tag][pool], now);
+	raisePeak(s_totalPeak, s_total.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void mem::release(int tag, int pool, size_t bytes)
+{
+	s_bytes[tag][pool].fetch_sub(bytes, std::memory_order_relaxed);
+	s_blocks[tag][pool].fetch_sub(1, std::memory_order_relaxed);
+	s_total.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+mem::Scope::Scope(int tag)
+{
+	m_prev = t_tag;
+	t_tag  = tag;
+}
+
+mem::Scope::~Scope(void)
+{
+	t_tag = m_prev;
+}
+
+int mem::currentTag(void)
+{
+	return t_tag;
+}
+
+// -----------------------------------------------------------------------------
+// Report
+// -----------------------------------------------------------------------------
+
+uint64_t mem::Report::tagBytes(int tag) const
+{
+	uint64_t sum = 0;
+	for (int p = 0; p < POOL_COUNT; p++)
+		sum += usage[tag][p].bytes;
+	return sum;
+}
+
+uint64_t mem::Report::poolBytes(int pool) const
+{
+	uint64_t sum = 0;
+	for (int t = 0; t < TAG_COUNT; t++)
+		sum += usage[t][pool].bytes;
+	return sum;
+}
+
+void mem::snapshot(Report& out)
+{
+	// each counter is read on its own; a report taken while other threads
+	// allocate can be off by their last few blocks
+	for (int t = 0; t < TAG_COUNT; t++) {
+		for (int p = 0; p < POOL_COUNT; p++) {
+			out.usage[t][p].bytes  = s_bytes[t][p].load(std::memory_order_relaxed);
+			out.usage[t][p].peak   = s_peak[t][p].load(std::memory_order_relaxed);
+			out.usage[t][p].blocks = s_blocks[t][p].load(std::memory_order_relaxed);
+		}
+	}
+	out.bytes = s_total.load(std::memory_order_relaxed);
+	out.peak  = s_totalPeak.load(std::memory_order_relaxed);
+#if defined(_DEBUG) || defined(ARK_ALLOC_HOOK)
+	out.heapTracked = true;
+#else
+	out.heapTracked = false;
+#endif
+}
+
+void mem::resetPeaks(void)
+{
+	for (int t = 0; t < TAG_COUNT; t++)
+		for (int p = 0; p < POOL_COUNT; p++)
+			s_peak[t][p].store(s_bytes[t][p].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	s_totalPeak.store(s_total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+static double kb(uint64_t bytes)
+{
+	return bytes / 1024.0;
+}
+
+void mem::print(FILE* fp, const Report& r)
+{
+	fprintf(fp, "%-10s", "KB");
+	for (int p = 0; p < POOL_COUNT; p++)
+		fprintf(fp, " %10s", poolNames[p]);
+	fprintf(fp, " %10s %10s\n", "total", "peak");
+
+	for (int t = 0; t < TAG_COUNT; t++) {
+		uint64_t peak = 0;
+		for (int p = 0; p < POOL_COUNT; p++)
+			peak += r.usage[t][p].peak;
+		if (peak == 0)
+			continue;
+		fprintf(fp, "%-10s", tagNames[t]);
+		for (int p = 0; p < POOL_COUNT; p++)
+			fprintf(fp, " %10.1f", kb(r.usage[t][p].bytes));
+		// the sum of the pool peaks, which may not have been reached together
+		fprintf(fp, " %10.1f %10.1f\n", kb(r.tagBytes(t)), kb(peak));
+	}
+
+	fprintf(fp, "%-10s", "all");
+	for (int p = 0; p < POOL_COUNT; p++)
+		fprintf(fp, " %10.1f", kb(r.poolBytes(p)));
+	fprintf(fp, " %10.1f %10.1f\n", kb(r.bytes), kb(r.peak));
+	if (!r.heapTracked)
+		fprintf(fp, "heap not tracked: build with _DEBUG or ARK_ALLOC_HOOK\n");
+}
+
+bool mem::dumpFile(const char* path)
+{
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL)
+		return false;
+	Report r;
+	snapshot(r);
+	print(fp, r);
+	return fclose(fp) == 0;
+}
+
+// -----------------------------------------------------------------------------
+// Meshes
+// -----------------------------------------------------------------------------
+
+mem::MeshCost mem::meshCost(int vertices, int vertexStride, int faces, bool index32)
+{
+	MeshCost c;
+	c.vertexBytes = (size_t)vertices * vertexStride;
+	c.indexBytes  = (size_t)faces * 3 * (index32 ? 4 : 2);
+	return c;
+}
+
+void mem::chargeMesh(int tag, const MeshCost& cost)
+{
+	charge(tag, POOL_VERTEX, cost.vertexBytes);
+	charge(tag, POOL_INDEX, cost.indexBytes);
+}
+
+void mem::releaseMesh(int tag, const MeshCost& cost)
+{
+	release(tag, POOL_VERTEX, cost.vertexBytes);
+	release(tag, POOL_INDEX, cost.indexBytes);
+}
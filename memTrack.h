@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: memTrack.h
+// 
+// Desc: Memory accounting by subsystem. Every byte the game holds is charged to
+//       a tag (render, level, particles, ...) and a pool (heap, arena, mapped
+//       file, vertex and index buffers). Arenas and mapped files charge
+//       themselves to the tag of the Scope they are created in; heap blocks
+//       are only counted when the allocation hook is compiled in (see arena.h).
+//       Meshes are charged by the render backend that creates them (see
+//       renderCache.h), from the device's mesh when there is one and from the
+//       vertex and index data when there isn't.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __memTrackH__
+#define __memTrackH__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace mem
+{
+	//
+	// Tags. Add new ones at the end of the list and to tagNames.
+	//
+	enum Tag
+	{
+		TAG_UNTAGGED = 0,   // anything made outside a Scope
+		TAG_RENDER,         // meshes and the debris vertex array
+		TAG_LEVEL,          // level layouts and the world arena they are loaded into
+		TAG_PARTICLES,      // debris pool
+		TAG_AUDIO,          // sound bank and mixer
+		TAG_COUNTERS,       // perf counter segment
+		TAG_ENV,            // training environments (arkEnv.h)
+
+		TAG_COUNT
+	};
+
+	enum Pool
+	{
+		POOL_HEAP = 0,      // operator new, when the allocation hook is compiled in
+		POOL_ARENA,         // LinearArena blocks, all of the reservation
+		POOL_MAPPED,        // MappedFile views
+		POOL_VERTEX,        // vertex buffers
+		POOL_INDEX,         // index buffers
+
+		POOL_COUNT
+	};
+
+	extern const char* const tagNames[TAG_COUNT];
+	extern const char* const poolNames[POOL_COUNT];
+
+	// any thread; bytes released must have been charged to the same tag and pool
+	void charge(int tag, int pool, size_t bytes);
+	void release(int tag, int pool, size_t bytes);
+
+	//
+	// Charges what the current thread creates to 'tag' while it is alive.
+	// Scopes nest; the innermost one wins.
+	//
+	class Scope
+	{
+	public:
+		explicit Scope(int tag);
+		~Scope(void);
+
+	private:
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+
+		int m_prev;
+	};
+
+	int currentTag(void);
+
+	//
+	// Report
+	//
+	struct Usage
+	{
+		uint64_t bytes;     // held now
+		uint64_t peak;      // most held at once
+		uint64_t blocks;    // live allocations
+	};
+
+	struct Report
+	{
+		Usage    usage[TAG_COUNT][POOL_COUNT];
+		uint64_t bytes;      // everything held now
+		uint64_t peak;       // most held at once, all tags and pools together
+		bool     heapTracked;
+
+		uint64_t tagBytes(int tag) const;
+		uint64_t poolBytes(int pool) const;
+	};
+
+	void snapshot(Report& out);
+
+	// starts the peaks over from what is held now
+	void resetPeaks(void);
+
+	// one row per tag, one column per pool, in KB
+	void print(FILE* fp, const Report& r);
+	bool dumpFile(const char* path);
+
+	//
+	// Buffer sizes of a mesh, for charging it
+	//
+	struct MeshCost
+	{
+		size_t vertexBytes;
+		size_t indexBytes;
+	};
+
+	MeshCost meshCost(int vertices, int vertexStride, int faces, bool index32);
+
+	void chargeMesh(int tag, const MeshCost& cost);
+	void releaseMesh(int tag, const MeshCost& cost);
+}
+
+#endif // __memTrackH__
@@ -0,0 +1,129 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: meshGen.cpp
+// 
+// Desc: Sphere and box tessellation, and the game's mesh list.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "meshGen.h"
+#include <cmath>
+
+static gfx::MeshVertex vertex(float x, float y, float z, float nx, float ny, float nz)
+{
+	gfx::MeshVertex v = { x, y, z, nx, ny, nz };
+	return v;
+}
+
+static void triangle(gfx::MeshData& out, int a, int b, int c)
+{
+	out.indices.push_back((uint16_t)a);
+	out.indices.push_back((uint16_t)b);
+	out.indices.push_back((uint16_t)c);
+}
+
+bool gfx::buildSphere(float radius, int slices, int stacks, MeshData& out)
+{
+	out.vertices.clear();
+	out.indices.clear();
+	if (slices < 3 || stacks < 2 || 2 + (stacks - 1) * slices > 0xffff)
+		return false;
+
+	out.vertices.reserve(2 + (stacks - 1) * slices);
+	out.indices.reserve(6 * slices * (stacks - 1));
+
+	// pole, stacks - 1 rings of 'slices' vertices, pole
+	out.vertices.push_back(vertex(0.0f, radius, 0.0f, 0.0f, 1.0f, 0.0f));
+	for (int i = 1; i < stacks; i++) {
+		double phi = 3.14159265358979 * i / stacks;
+		float  y = (float)std::cos(phi), ring = (float)std::sin(phi);
+		for (int j = 0; j < slices; j++) {
+			double theta = 2.0 * 3.14159265358979 * j / slices;
+			float  x = ring * (float)std::cos(theta), z = ring * (float)std::sin(theta);
+			out.vertices.push_back(vertex(x * radius, y * radius, z * radius, x, y, z));
+		}
+	}
+	int bottom = (int)out.vertices.size();
+	out.vertices.push_back(vertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f));
+
+	for (int j = 0; j < slices; j++) {
+		int k = (j + 1) % slices;
+		triangle(out, 0, 1 + k, 1 + j);
+	}
+	for (int i = 0; i < stacks - 2; i++) {
+		int a = 1 + i * slices, b = a + slices;
+		for (int j = 0; j < slices; j++) {
+			int k = (j + 1) % slices;
+			triangle(out, a + j, a + k, b + k);
+			triangle(out, a + j, b + k, b + j);
+		}
+	}
+	int last = 1 + (stacks - 2) * slices;
+	for (int j = 0; j < slices; j++) {
+		int k = (j + 1) % slices;
+		triangle(out, bottom, last + j, last + k);
+	}
+	return true;
+}
+
+void gfx::buildBox(float width, float height, float depth, MeshData& out)
+{
+	// per side: the normal, then the two directions its corners spread along
+	static const float sides[6][9] = {
+		{ 1, 0, 0,   0, 0, 1,   0, 1, 0 },
+		{-1, 0, 0,   0, 1, 0,   0, 0, 1 },
+		{ 0, 1, 0,   1, 0, 0,   0, 0, 1 },
+		{ 0,-1, 0,   0, 0, 1,   1, 0, 0 },
+		{ 0, 0, 1,   0, 1, 0,   1, 0, 0 },
+		{ 0, 0,-1,   1, 0, 0,   0, 1, 0 },
+	};
+	float half[3] = { width * 0.5f, height * 0.5f, depth * 0.5f };
+
+	out.vertices.clear();
+	out.indices.clear();
+	out.vertices.reserve(24);
+	out.indices.reserve(36);
+	for (int s = 0; s < 6; s++) {
+		const float* n = sides[s];
+		const float* u = sides[s] + 3;
+		const float* v = sides[s] + 6;
+		int base = (int)out.vertices.size();
+		for (int c = 0; c < 4; c++) {
+			float su = c == 1 || c == 2 ? 1.0f : -1.0f;
+			float sv = c >= 2 ? 1.0f : -1.0f;
+			float p[3];
+			for (int k = 0; k < 3; k++)
+				p[k] = (n[k] + u[k] * su + v[k] * sv) * half[k];
+			out.vertices.push_back(vertex(p[0], p[1], p[2], n[0], n[1], n[2]));
+		}
+		triangle(out, base, base + 2, base + 1);
+		triangle(out, base, base + 3, base + 2);
+	}
+}
+
+// what virtualLego.cpp draws: balls of radius 0.21 (M_RADIUS) at 50 slices and
+// stacks, then the coarser targets the quality governor can pick
+const gfx::MeshSpec gfx::gameMeshes[GAME_MESH_COUNT] = {
+	{ "targets",            MESH_SPHERE, { 0.21f, 0.0f, 0.0f },  50, 50 },
+	{ "target lod 1",       MESH_SPHERE, { 0.21f, 0.0f, 0.0f },  30, 30 },
+	{ "target lod 2",       MESH_SPHERE, { 0.21f, 0.0f, 0.0f },  18, 18 },
+	{ "target lod 3",       MESH_SPHERE, { 0.21f, 0.0f, 0.0f },  10, 10 },
+	{ "red ball",           MESH_SPHERE, { 0.21f, 0.0f, 0.0f },  50, 50 },
+	{ "white ball",         MESH_SPHERE, { 0.21f, 0.0f, 0.0f },  50, 50 },
+	{ "plane",              MESH_BOX,    { 9.0f, 0.03f, 6.0f },   0,  0 },
+	{ "wall 0",             MESH_BOX,    { 0.0f, 0.3f, 0.0f },    0,  0 },
+	{ "wall 1",             MESH_BOX,    { 0.0f, 0.3f, 0.0f },    0,  0 },
+	{ "wall 2",             MESH_BOX,    { 0.0f, 0.3f, 0.0f },    0,  0 },
+	{ "brick",              MESH_BOX,    { 1.0f, 0.3f, 1.0f },    0,  0 },
+	{ "light",              MESH_SPHERE, { 0.1f, 0.0f, 0.0f },   10, 10 },
+	{ "sphere placeholder", MESH_SPHERE, { 0.21f, 0.0f, 0.0f },   8,  6 },
+	{ "box placeholder",    MESH_BOX,    { 1.0f, 1.0f, 1.0f },    0,  0 },
+};
+
+bool gfx::buildMesh(const MeshSpec& spec, MeshData& out)
+{
+	if (spec.shape == MESH_SPHERE)
+		return buildSphere(spec.size[0], spec.slices, spec.stacks, out);
+	buildBox(spec.size[0], spec.size[1], spec.size[2], out);
+	return true;
+}
@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: meshGen.h
+// 
+// Desc: Vertex and index data for the game's spheres and boxes, built on
+//       the CPU without a device so startup can make it on a worker thread
+//       while the window comes up. Spheres and boxes are laid out the way
+//       D3DXCreateSphere and D3DXCreateBox lay out theirs: position and normal
+//       per vertex, a 16-bit triangle list, clockwise front faces.
+//
+//       gameMeshes lists every mesh the game puts on the device. The game
+//       builds and uploads from it, and tools that size the GPU footprint
+//       without a device walk the same list.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __meshGenH__
+#define __meshGenH__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gfx
+{
+	// D3DFVF_XYZ | D3DFVF_NORMAL
+	struct MeshVertex
+	{
+		float x, y, z;
+		float nx, ny, nz;
+	};
+
+	struct MeshData
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<uint16_t>   indices;    // three per face
+
+		int faceCount(void) const           { return (int)indices.size() / 3; }
+		size_t bytes(void) const            { return vertices.size() * sizeof(MeshVertex) + indices.size() * sizeof(uint16_t); }
+	};
+
+	// 'slices' around the y axis, 'stacks' from pole to pole; false if it
+	// needs more vertices than 16-bit indices reach
+	bool buildSphere(float radius, int slices, int stacks, MeshData& out);
+
+	// four vertices per side so each side has its own normal
+	void buildBox(float width, float height, float depth, MeshData& out);
+
+	enum MeshShape
+	{
+		MESH_SPHERE = 0,
+		MESH_BOX
+	};
+
+	struct MeshSpec
+	{
+		const char* name;
+		int         shape;
+		float       size[3];            // sphere: radius; box: width, height, depth, 0 where the level decides
+		int         slices, stacks;     // spheres
+	};
+
+	// one entry per device mesh; the red and white balls share the target's data
+	enum GameMesh
+	{
+		MESH_TARGET = 0,                // the full ball, then ever coarser ones
+		MESH_TARGET_LOD1,
+		MESH_TARGET_LOD2,
+		MESH_TARGET_LOD3,
+		MESH_RED_BALL,
+		MESH_WHITE_BALL,
+		MESH_PLANE,
+		MESH_WALL0,
+		MESH_WALL1,
+		MESH_WALL2,
+		MESH_BRICK,                     // a unit box stretched over each brick
+		MESH_LIGHT,
+		MESH_SPHERE_PLACEHOLDER,        // drawn until the real meshes are in
+		MESH_BOX_PLACEHOLDER,
+
+		GAME_MESH_COUNT
+	};
+
+	const int TARGET_LODS = MESH_TARGET_LOD3 - MESH_TARGET + 1;
+
+	extern const MeshSpec gameMeshes[GAME_MESH_COUNT];
+
+	// the spec as it stands; a box the level sizes comes out flat, with the
+	// same vertex and index count as any other
+	bool buildMesh(const MeshSpec& spec, MeshData& out);
+}
+
+#endif // __meshGenH__
@@ -0,0 +1,202 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: particles.cpp
+// 
+// Desc: ParticleSystem pool, integration and expiry.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "particles.h"
+#include "memTrack.h"
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define PARTICLES_SSE
+#include <xmmintrin.h>
+#endif
+
+static const unsigned int TARGET_DEBRIS = 0xffffff00;   // yellow, like the target mesh
+static const unsigned int BRICK_DEBRIS  = 0xffff00ff;   // magenta
+
+sim::ParticleSystem::ParticleSystem(void)
+{
+	m_px = m_py = m_pz = NULL;
+	m_vx = m_vy = m_vz = NULL;
+	m_life     = NULL;
+	m_color    = NULL;
+	m_count    = 0;
+	m_capacity = 0;
+	m_budget   = 0;
+	m_floorY   = 0.0f;
+	m_rng      = 2463534242u;
+}
+
+bool sim::ParticleSystem::init(int capacity, float floorY)
+{
+	mem::Scope tag(mem::TAG_PARTICLES);
+	capacity = (capacity + 3) & ~3;
+
+	// seven float streams and the colors, each 16-byte aligned, plus slack for the alignment
+	if (!m_arena.init((sizeof(float) * 7 + sizeof(unsigned int)) * capacity + 8 * 16))
+		return false;
+	m_px    = m_arena.allocArray<float>(capacity);
+	m_py    = m_arena.allocArray<float>(capacity);
+	m_pz    = m_arena.allocArray<float>(capacity);
+	m_vx    = m_arena.allocArray<float>(capacity);
+	m_vy    = m_arena.allocArray<float>(capacity);
+	m_vz    = m_arena.allocArray<float>(capacity);
+	m_life  = m_arena.allocArray<float>(capacity);
+	m_color = m_arena.allocArray<unsigned int>(capacity);
+	if (!m_color)
+		return false;
+
+	m_capacity = capacity;
+	m_budget   = capacity;
+	m_count    = 0;
+	m_floorY   = floorY;
+	return true;
+}
+
+void sim::ParticleSystem::release(void)
+{
+	m_arena.release();
+	m_count = m_capacity = m_budget = 0;
+}
+
+float sim::ParticleSystem::frand(float lo, float hi)
+{
+	m_rng ^= m_rng << 13; m_rng ^= m_rng >> 17; m_rng ^= m_rng << 5;
+	return lo + (hi - lo) * ((m_rng & 0xffffff) / 16777216.0f);
+}
+
+int sim::ParticleSystem::emitBurst(float x, float y, float z, int count, float speed, float life, unsigned int color)
+{
+	if (count > m_budget - m_count)
+		count = m_budget - m_count;     // a full pool drops the rest of the burst
+	if (count < 0)
+		count = 0;                      // over a budget that was just lowered
+
+	for (int k = 0; k < count; k++) {
+		int i = m_count++;
+		// mostly sideways and up, so the burst fans out over the plane
+		float a = frand(0.0f, 6.2831853f);
+		float s = speed * frand(0.3f, 1.0f);
+		m_px[i]    = x;
+		m_py[i]    = y;
+		m_pz[i]    = z;
+		m_vx[i]    = s * std::cos(a);
+		m_vy[i]    = speed * frand(0.5f, 1.5f);
+		m_vz[i]    = s * std::sin(a);
+		m_life[i]  = life * frand(0.5f, 1.0f);
+		m_color[i] = color;
+	}
+	return count;
+}
+
+// swap-remove; order changes but stays the same from run to run
+void sim::ParticleSystem::expire(void)
+{
+	int i = 0;
+	while (i < m_count) {
+		if (m_life[i] > 0.0f) {
+			i++;
+			continue;
+		}
+		int last = --m_count;
+		m_px[i]    = m_px[last];
+		m_py[i]    = m_py[last];
+		m_pz[i]    = m_pz[last];
+		m_vx[i]    = m_vx[last];
+		m_vy[i]    = m_vy[last];
+		m_vz[i]    = m_vz[last];
+		m_life[i]  = m_life[last];
+		m_color[i] = m_color[last];
+	}
+}
+
+void sim::ParticleSystem::integrate(int from, float dt)
+{
+	const float gdt   = DEBRIS_GRAVITY * dt;
+	const float floor = m_floorY;
+
+	for (int i = from; i < m_count; i++) {
+		float vy = m_vy[i] - gdt;
+		float px = m_px[i] + m_vx[i] * dt;
+		float py = m_py[i] + vy * dt;
+		float pz = m_pz[i] + m_vz[i] * dt;
+		if (py < floor) {
+			py      = floor;
+			vy      = -vy * DEBRIS_RESTITUTION;
+			m_vx[i] = m_vx[i] * DEBRIS_FRICTION;
+			m_vz[i] = m_vz[i] * DEBRIS_FRICTION;
+		}
+		m_px[i]   = px;
+		m_py[i]   = py;
+		m_pz[i]   = pz;
+		m_vy[i]   = vy;
+		m_life[i] = m_life[i] - dt;
+	}
+}
+
+void sim::ParticleSystem::updateScalar(float dt)
+{
+	integrate(0, dt);
+	expire();
+}
+
+void sim::ParticleSystem::update(float dt)
+{
+#ifdef PARTICLES_SSE
+	const __m128 vdt   = _mm_set1_ps(dt);
+	const __m128 vgdt  = _mm_set1_ps(DEBRIS_GRAVITY * dt);
+	const __m128 floor = _mm_set1_ps(m_floorY);
+	const __m128 rest  = _mm_set1_ps(-DEBRIS_RESTITUTION);
+	const __m128 fric  = _mm_set1_ps(DEBRIS_FRICTION);
+
+	// whole groups of four live particles; the last one to three are done
+	// one at a time, so no lane ever reads a slot that was never written
+	int i = 0;
+	for (; i + 4 <= m_count; i += 4) {
+		__m128 vx = _mm_load_ps(m_vx + i);
+		__m128 vy = _mm_sub_ps(_mm_load_ps(m_vy + i), vgdt);
+		__m128 vz = _mm_load_ps(m_vz + i);
+		__m128 px = _mm_add_ps(_mm_load_ps(m_px + i), _mm_mul_ps(vx, vdt));
+		__m128 py = _mm_add_ps(_mm_load_ps(m_py + i), _mm_mul_ps(vy, vdt));
+		__m128 pz = _mm_add_ps(_mm_load_ps(m_pz + i), _mm_mul_ps(vz, vdt));
+
+		// lanes below the floor take the bounced values
+		__m128 below = _mm_cmplt_ps(py, floor);
+		py = _mm_or_ps(_mm_and_ps(below, floor), _mm_andnot_ps(below, py));
+		vy = _mm_or_ps(_mm_and_ps(below, _mm_mul_ps(vy, rest)), _mm_andnot_ps(below, vy));
+		vx = _mm_or_ps(_mm_and_ps(below, _mm_mul_ps(vx, fric)), _mm_andnot_ps(below, vx));
+		vz = _mm_or_ps(_mm_and_ps(below, _mm_mul_ps(vz, fric)), _mm_andnot_ps(below, vz));
+
+		_mm_store_ps(m_px + i, px);
+		_mm_store_ps(m_py + i, py);
+		_mm_store_ps(m_pz + i, pz);
+		_mm_store_ps(m_vx + i, vx);
+		_mm_store_ps(m_vy + i, vy);
+		_mm_store_ps(m_vz + i, vz);
+		_mm_store_ps(m_life + i, _mm_sub_ps(_mm_load_ps(m_life + i), vdt));
+	}
+	integrate(i, dt);
+	expire();
+#else
+	updateScalar(dt);
+#endif
+}
+
+void sim::emitDebris(ParticleSystem& ps, const World& world, int perTarget, float y)
+{
+	for (int e = 0; e < world.eventCount(); e++) {
+		const Event& ev = world.events()[e];
+		if (ev.kind == EVENT_TARGET_HIT) {
+			const Vec2& c = world.spheres()[ev.index];
+			ps.emitBurst(toFloat(c.x), y, toFloat(c.z), perTarget, 1.5f, 1.2f, TARGET_DEBRIS);
+		}
+		else if (ev.kind == EVENT_BRICK_HIT) {
+			const Aabb& b = world.bricks()[ev.index];
+			ps.emitBurst(toFloat((b.lo.x + b.hi.x) * Scalar(0.5f)), y, toFloat((b.lo.z + b.hi.z) * Scalar(0.5f)), perTarget, 1.5f, 1.2f, BRICK_DEBRIS);
+		}
+	}
+}
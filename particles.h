@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: particles.h
+// 
+// Desc: Debris thrown out by destroyed targets. Particles live in a fixed pool
+//       stored as separate x / y / z / velocity / life arrays, so update()
+//       moves four of them per SSE instruction; dead ones are removed by
+//       swapping the last live particle into their slot. Nothing is allocated
+//       after init().
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __particlesH__
+#define __particlesH__
+
+#include "arena.h"
+#include "gameWorld.h"
+
+namespace sim
+{
+	const float DEBRIS_GRAVITY     = 6.0f;    // units / s^2 along -y
+	const float DEBRIS_RESTITUTION = 0.45f;   // vertical speed kept on a floor bounce
+	const float DEBRIS_FRICTION    = 0.7f;    // horizontal speed kept on a floor bounce
+
+	class ParticleSystem
+	{
+	public:
+		ParticleSystem(void);
+
+		// capacity is rounded up to a multiple of 4; floorY is the top of the plane
+		bool init(int capacity, float floorY);
+		void release(void);
+		void clear(void)                    { m_count = 0; }
+
+		// live particles allowed, at most the capacity; emitBurst() stops there,
+		// and particles already flying live out their life
+		void setBudget(int budget)          { m_budget = budget < m_capacity ? budget : m_capacity; }
+
+		// throws 'count' particles out of (x, y, z); returns how many fit in the pool
+		int  emitBurst(float x, float y, float z, int count, float speed, float life, unsigned int color);
+
+		void update(float dt);              // SSE where available
+		void updateScalar(float dt);        // same arithmetic one particle at a time
+
+		int                 count(void) const    { return m_count; }
+		int                 capacity(void) const { return m_capacity; }
+		int                 budget(void) const   { return m_budget; }
+		const float*        posX(void) const     { return m_px; }
+		const float*        posY(void) const     { return m_py; }
+		const float*        posZ(void) const     { return m_pz; }
+		const float*        life(void) const     { return m_life; }
+		const unsigned int* color(void) const    { return m_color; }
+
+	private:
+		ParticleSystem(const ParticleSystem&);
+		ParticleSystem& operator=(const ParticleSystem&);
+
+		void  integrate(int from, float dt);    // particles from..m_count, no expiry
+		void  expire(void);
+		float frand(float lo, float hi);
+
+		LinearArena   m_arena;
+		float*        m_px;
+		float*        m_py;
+		float*        m_pz;
+		float*        m_vx;
+		float*        m_vy;
+		float*        m_vz;
+		float*        m_life;               // seconds left
+		unsigned int* m_color;              // D3DCOLOR
+		int           m_count;
+		int           m_capacity;
+		int           m_budget;
+		float         m_floorY;
+		unsigned int  m_rng;
+	};
+
+	// a burst at every target and brick the last World::step() destroyed
+	void emitDebris(ParticleSystem& ps, const World& world, int perTarget, float y);
+}
+
+#endif // __particlesH__
@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: perfCounters.cpp
+// 
+// Desc: Seqlock writer/reader for the live counter segment.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "perfCounters.h"
+#include "mappedFile.h"
+#include "memTrack.h"
+#include <chrono>
+#include <cstring>
+
+const char* const perf::counterNames[perf::COUNTER_COUNT] = {
+	"frame_us",
+	"sim_steps",
+	"collision_tests",
+	"live_targets",
+	"draw_calls",
+	"input_depth",
+	"quality",
+	"frame_avg_us",
+	"device_calls",
+	"calls_saved",
+	"multiplies",
+	"multiplies_saved",
+};
+
+thread_local uint64_t perf::g_frame[perf::COUNTER_COUNT];
+
+static MappedFile     s_file;
+static perf::Segment* s_pSegment   = NULL;
+static uint64_t       s_frameNo    = 0;
+static uint64_t       s_frameStart = 0;
+
+bool perf::open(const char* path)
+{
+	mem::Scope tag(mem::TAG_COUNTERS);
+	close();
+	if (!s_file.create(path, sizeof(Segment)))
+		return false;
+
+	// the file may be the last run's, with a reader still attached: take the
+	// magic away first, then rewrite the rest under the seqlock
+	s_pSegment = static_cast<Segment*>(s_file.data());
+	s_pSegment->magic.store(0, std::memory_order_relaxed);
+	uint32_t seq = s_pSegment->seq.load(std::memory_order_relaxed);
+	seq += seq & 1;     // a run that died inside endFrame() left it odd
+	s_pSegment->seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	s_pSegment->version      = SEGMENT_VERSION;
+	s_pSegment->counterCount = COUNTER_COUNT;
+	s_pSegment->reserved     = 0;
+	s_pSegment->pad          = 0;
+	s_pSegment->frame.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < COUNTER_COUNT; i++)
+		s_pSegment->values[i].store(0, std::memory_order_relaxed);
+
+	s_pSegment->seq.store(seq + 2, std::memory_order_release);
+	s_pSegment->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+	return true;
+}
+
+void perf::close(void)
+{
+	s_pSegment = NULL;
+	s_file.close();
+}
+
+uint64_t perf::nowMicroseconds(void)
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void perf::beginFrame(void)
+{
+	s_frameStart = nowMicroseconds();
+}
+
+void perf::endFrame(void)
+{
+	g_frame[FRAME_TIME_US] = nowMicroseconds() - s_frameStart;
+	++s_frameNo;
+
+	if (s_pSegment != NULL) {
+		// seqlock: make seq odd, store the payload, make it even again
+		uint32_t seq = s_pSegment->seq.load(std::memory_order_relaxed);
+		s_pSegment->seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		s_pSegment->frame.store(s_frameNo, std::memory_order_relaxed);
+		for (int i = 0; i < COUNTER_COUNT; i++)
+			s_pSegment->values[i].store(g_frame[i], std::memory_order_relaxed);
+
+		s_pSegment->seq.store(seq + 2, std::memory_order_release);
+	}
+
+	::memset(g_frame, 0, sizeof(g_frame));
+}
+
+bool perf::isValid(const Segment* seg)
+{
+	return seg != NULL && seg->magic.load(std::memory_order_acquire) == SEGMENT_MAGIC &&
+		seg->version == SEGMENT_VERSION && seg->counterCount == COUNTER_COUNT;
+}
+
+bool perf::read(const Segment* seg, Snapshot& out)
+{
+	if (!isValid(seg))
+		return false;
+
+	// give up after a bounded number of torn reads; the writer only holds
+	// the lock for a handful of stores so this practically never happens
+	for (int attempt = 0; attempt < 1000; attempt++) {
+		uint32_t before = seg->seq.load(std::memory_order_acquire);
+		if (before & 1)
+			continue;
+
+		out.frame = seg->frame.load(std::memory_order_relaxed);
+		for (int i = 0; i < COUNTER_COUNT; i++)
+			out.values[i] = seg->values[i].load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seg->seq.load(std::memory_order_relaxed) == before)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: perfCounters.h
+// 
+// Desc: Live performance counters. The game accumulates plain integers during a
+//       frame and publishes them once per frame into a memory-mapped file using
+//       a seqlock, so an outside reader (tools/counterReader.cpp) can tail a
+//       running instance without stopping it.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __perfCountersH__
+#define __perfCountersH__
+
+#include <atomic>
+#include <cstdint>
+
+namespace perf
+{
+	//
+	// Counters. Add new ones at the end and bump SEGMENT_VERSION.
+	//
+	enum Counter
+	{
+		FRAME_TIME_US = 0,   // wall time of the last frame
+		SIM_STEPS,           // physics steps run this frame
+		COLLISION_TESTS,     // pair tests run this frame
+		LIVE_TARGETS,        // targets still standing
+		DRAW_CALLS,          // DrawSubset / DrawPrimitive calls this frame
+		INPUT_QUEUE_DEPTH,   // window messages drained before this frame
+		QUALITY_LEVEL,       // the quality governor's level (qualityGovernor.h)
+		FRAME_AVERAGE_US,    // the frame time it steers by
+		DEVICE_CALLS,        // state and draw calls the render cache passed to the device this frame
+		DEVICE_CALLS_SAVED,  // and the redundant ones it dropped (renderCache.h)
+		MATRIX_MULTIPLIES,   // world matrices remade this frame
+		MULTIPLIES_SAVED,    // world matrices that were still current
+
+		COUNTER_COUNT
+	};
+
+	extern const char* const counterNames[COUNTER_COUNT];
+
+	const uint32_t SEGMENT_MAGIC   = 0x434b5241; // 'ARKC'
+	const uint32_t SEGMENT_VERSION = 3;
+
+	//
+	// Layout of the mapped file. Readers must check magic, version and count.
+	//
+	struct Segment
+	{
+		std::atomic<uint32_t> magic;      // stored last, with release; 0 while the segment is rewritten
+		uint32_t              version;
+		uint32_t              counterCount;
+		uint32_t              reserved;
+		std::atomic<uint32_t> seq;        // odd while the writer is inside publish()
+		uint32_t              pad;
+		std::atomic<uint64_t> frame;
+		std::atomic<uint64_t> values[COUNTER_COUNT];
+	};
+
+	struct Snapshot
+	{
+		uint64_t frame;
+		uint64_t values[COUNTER_COUNT];
+	};
+
+	//
+	// Writer side. Every thread counts into its own copy; only the game
+	// thread's are published.
+	//
+	extern thread_local uint64_t g_frame[COUNTER_COUNT];
+
+	inline void add(Counter c, uint64_t n = 1) { g_frame[c] += n; }
+	inline void set(Counter c, uint64_t v)     { g_frame[c] = v; }
+
+	bool open(const char* path);   // false leaves counting on but unpublished
+	void close(void);
+
+	void beginFrame(void);         // starts the frame timer
+	void endFrame(void);           // stores FRAME_TIME_US, publishes, clears g_frame
+
+	uint64_t nowMicroseconds(void);
+
+	//
+	// Reader side
+	//
+	bool isValid(const Segment* seg);
+	bool read(const Segment* seg, Snapshot& out);
+}
+
+#endif // __perfCountersH__
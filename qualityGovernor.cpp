@@ -0,0 +1,174 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: qualityGovernor.cpp
+// 
+// Desc: The quality ladder and the controller that climbs it.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "qualityGovernor.h"
+
+// cheapest first. Going down, the resolution and the debris go before the
+// ball meshes, which are what the player watches; the top two spend spare
+// time on substeps, which make fast balls meet thin walls and targets sooner.
+static const QualitySettings s_ladder[QualityGovernor::LEVEL_COUNT] = {
+	//  lod  particles  substeps  scale
+	{   3,     5000,      1,      0.5f   },
+	{   3,    10000,      1,      0.625f },
+	{   2,    10000,      1,      0.75f  },
+	{   2,    25000,      1,      0.875f },
+	{   1,    25000,      1,      1.0f   },
+	{   1,    50000,      1,      1.0f   },
+	{   0,    50000,      1,      1.0f   },
+	{   0,   100000,      1,      1.0f   },    // DEFAULT_LEVEL
+	{   0,   100000,      2,      1.0f   },
+	{   0,   100000,      4,      1.0f   },
+};
+
+static const char* const decisionNames[] = { "hold", "lower", "raise" };
+
+QualityGovernor::QualityGovernor(void)
+{
+	init(defaultConfig(16.6f));
+}
+
+QualityGovernor::Config QualityGovernor::defaultConfig(float budgetMs)
+{
+	Config c;
+	c.budgetMs      = budgetMs;
+	c.smoothing     = 0.15f;    // about seven frames
+	c.spikeLimit    = 3.0f;
+	c.margin        = 0.08f;
+	c.gainDown      = 0.2f;     // 50% over drops a level in 10 frames
+	c.gainUp        = 0.02f;    // half the budget spare raises one in about 150
+	c.headroom      = 0.15f;
+	c.leak          = 0.05f;
+	c.holdFrames    = 15;
+	c.backoffFrames = 1200;     // 20 seconds at 60 Hz
+	c.backoffLimit  = 19200;
+	return c;
+}
+
+void QualityGovernor::init(const Config& config, int level)
+{
+	if (level < 0) level = 0;
+	if (level >= LEVEL_COUNT) level = LEVEL_COUNT - 1;
+
+	m_config     = config;
+	m_level      = level;
+	m_demand     = (float)level;
+	m_smoothedMs = 0.0f;
+	m_hold       = 0;
+	m_raiseWait  = 0;
+	m_backoff    = config.backoffFrames;
+	m_raisedFrom = -1;
+	m_lastRaise  = 0;
+	m_frames     = 0;
+	m_overBudget = 0;
+	m_changes    = 0;
+}
+
+const QualitySettings& QualityGovernor::ladder(int level)
+{
+	if (level < 0) level = 0;
+	if (level >= LEVEL_COUNT) level = LEVEL_COUNT - 1;
+	return s_ladder[level];
+}
+
+bool QualityGovernor::update(float frameMs)
+{
+	const Config& c = m_config;
+	m_frames++;
+	if (c.budgetMs <= 0.0f)
+		return false;
+	if (frameMs > c.budgetMs)
+		m_overBudget++;
+
+	// a single long frame (a file, the OS) moves the average only so far
+	float sample = frameMs < c.budgetMs * c.spikeLimit ? frameMs : c.budgetMs * c.spikeLimit;
+	m_smoothedMs = m_frames == 1 ? sample : m_smoothedMs + c.smoothing * (sample - m_smoothedMs);
+
+	if (m_raiseWait > 0)
+		m_raiseWait--;
+	if (m_raisedFrom >= 0 && m_frames - m_lastRaise > (uint64_t)c.backoffLimit) {
+		m_raisedFrom = -1;      // the raise was kept; the next one that fails waits the least
+		m_backoff = c.backoffFrames;
+	}
+	if (m_hold > 0) {
+		m_hold--;
+		return false;   // the average still holds frames from before the change
+	}
+
+	// positive is time to spare
+	float error = (c.budgetMs * (1.0f - c.margin) - m_smoothedMs) / c.budgetMs;
+	if (error < 0.0f)
+		m_demand += c.gainDown * error;
+	else if (error > c.headroom && m_raiseWait == 0)
+		m_demand += c.gainUp * (error - c.headroom);
+	else
+		m_demand += c.leak * ((float)m_level - m_demand);
+
+	if (m_demand <= (float)m_level - 1.0f && m_level > 0) {
+		// straight back to where the last raise came from: the budget sits between the two
+		if (m_raisedFrom == m_level - 1) {
+			m_raiseWait = m_backoff;
+			m_backoff = m_backoff * 2 < c.backoffLimit ? m_backoff * 2 : c.backoffLimit;
+		}
+		m_raisedFrom = -1;
+		change(m_level - 1, LOWER, frameMs);
+		return true;
+	}
+	if (m_demand >= (float)m_level + 1.0f && m_level < LEVEL_COUNT - 1) {
+		m_raisedFrom = m_level;
+		m_lastRaise  = m_frames;
+		change(m_level + 1, RAISE, frameMs);
+		return true;
+	}
+
+	// nothing past the ends of the ladder builds up
+	if (m_demand < -0.5f) m_demand = -0.5f;
+	if (m_demand > LEVEL_COUNT - 0.5f) m_demand = LEVEL_COUNT - 0.5f;
+	return false;
+}
+
+void QualityGovernor::change(int to, int decision, float frameMs)
+{
+	Record& r    = m_records[m_changes % RECORD_COUNT];
+	r.frame      = m_frames;
+	r.frameMs    = frameMs;
+	r.smoothedMs = m_smoothedMs;
+	r.decision   = decision;
+	r.from       = m_level;
+	r.to         = to;
+	m_changes++;
+
+	m_level  = to;
+	m_demand = (float)to;
+	m_hold   = m_config.holdFrames;
+}
+
+int QualityGovernor::recordCount(void) const
+{
+	return m_changes < RECORD_COUNT ? m_changes : RECORD_COUNT;
+}
+
+const QualityGovernor::Record& QualityGovernor::record(int i) const
+{
+	int first = m_changes < RECORD_COUNT ? 0 : m_changes - RECORD_COUNT;
+	return m_records[(first + i) % RECORD_COUNT];
+}
+
+void QualityGovernor::print(FILE* fp) const
+{
+	const QualitySettings& s = settings();
+	fprintf(fp, "budget %.1f ms   level %d of %d   lod bias %d, %d particles, %d substeps, scale %.3f\n",
+		m_config.budgetMs, m_level, LEVEL_COUNT - 1, s.sphereLodBias, s.particleBudget, s.substeps, s.resolutionScale);
+	fprintf(fp, "%llu frames, %llu over budget (%.1f%%), average %.2f ms, %d changes\n",
+		(unsigned long long)m_frames, (unsigned long long)m_overBudget,
+		m_frames ? 100.0 * m_overBudget / m_frames : 0.0, m_smoothedMs, m_changes);
+	for (int i = 0; i < recordCount(); i++) {
+		const Record& r = record(i);
+		fprintf(fp, "  frame %8llu  %-5s %d -> %d   frame %7.2f ms  average %7.2f ms\n",
+			(unsigned long long)r.frame, decisionNames[r.decision], r.from, r.to, r.frameMs, r.smoothedMs);
+	}
+}
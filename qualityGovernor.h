@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: qualityGovernor.h
+// 
+// Desc: Holds the game to a frame-time budget by trading detail for speed.
+//       Display() hands it the measured length of every frame. It keeps a
+//       smoothed frame time, and a damped controller walks a quality level
+//       up or down a ladder of settings: how coarse the target meshes are,
+//       how much debris may be alive, how many physics substeps a frame runs
+//       and how much of the back buffer the scene is drawn into.
+//
+//       Over budget it lowers the level quickly. With clear headroom it
+//       raises it slowly. After every change it holds still while the average
+//       catches up. Each time a raise is taken back the next one waits twice
+//       as long, so a budget that falls between two levels does not flip back
+//       and forth.
+//
+//       Nothing here reads a clock or touches the device, so the tools can
+//       drive it with simulated frame times (tools/qualityBench.cpp).
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __qualityGovernorH__
+#define __qualityGovernorH__
+
+#include <cstdint>
+#include <cstdio>
+
+// one rung of the ladder
+struct QualitySettings
+{
+	int   sphereLodBias;        // added to every target's mesh LOD; 0 is the full ball
+	int   particleBudget;       // live debris allowed
+	int   substeps;             // World::step() calls a frame
+	float resolutionScale;      // side of the back buffer the scene is drawn into
+};
+
+class QualityGovernor
+{
+public:
+	enum
+	{
+		LEVEL_COUNT   = 10,
+		DEFAULT_LEVEL = 7,          // the settings the game had before it was governed
+		RECORD_COUNT  = 64          // decisions kept for the report
+	};
+
+	enum Decision
+	{
+		HOLD = 0,
+		LOWER,
+		RAISE
+	};
+
+	struct Config
+	{
+		float budgetMs;             // e.g. 16.6; 0 leaves the level where it starts
+		float smoothing;            // weight of a new frame in the average
+		float spikeLimit;           // a frame counts as at most this many budgets
+		float margin;               // aim this far under the budget, so noise seldom crosses it
+		float gainDown;             // levels a frame per unit of relative overrun
+		float gainUp;               // levels a frame per unit of relative headroom
+		float headroom;             // raise only when this far under the aim
+		float leak;                 // pull back toward the current level inside the band
+		int   holdFrames;           // after a change, before the next
+		int   backoffFrames;        // first wait after a raise is taken back; doubles
+		int   backoffLimit;         // also how long a raise has to last to count as kept
+	};
+
+	// what was decided, when and on what
+	struct Record
+	{
+		uint64_t frame;
+		float    frameMs;
+		float    smoothedMs;
+		int      decision;
+		int      from;
+		int      to;
+	};
+
+	QualityGovernor(void);
+
+	static Config defaultConfig(float budgetMs);
+
+	void init(const Config& config, int level = DEFAULT_LEVEL);
+
+	// one frame's length; true when settings() changed
+	bool update(float frameMs);
+
+	int                    level(void) const       { return m_level; }
+	const QualitySettings& settings(void) const    { return ladder(m_level); }
+	static const QualitySettings& ladder(int level);
+
+	const Config& config(void) const        { return m_config; }
+	float         smoothedMs(void) const    { return m_smoothedMs; }
+	float         demand(void) const        { return m_demand; }    // where the controller wants the level
+	uint64_t      frames(void) const        { return m_frames; }
+	uint64_t      overBudget(void) const    { return m_overBudget; }
+	int           changes(void) const       { return m_changes; }
+
+	// the last RECORD_COUNT level changes, oldest first
+	int           recordCount(void) const;
+	const Record& record(int i) const;
+
+	// the settings, the counts and the recorded decisions
+	void print(FILE* fp) const;
+
+private:
+	void change(int to, int decision, float frameMs);
+
+	Config   m_config;
+	int      m_level;
+	float    m_demand;
+	float    m_smoothedMs;
+	int      m_hold;                // frames before any change
+	int      m_raiseWait;           // frames before a raise
+	int      m_backoff;             // next m_raiseWait after a raise is taken back
+	int      m_raisedFrom;          // level before the last raise, -1 once it has stuck or been left
+	uint64_t m_lastRaise;           // frame of the last raise
+
+	uint64_t m_frames;
+	uint64_t m_overBudget;
+	int      m_changes;
+	Record   m_records[RECORD_COUNT];
+};
+
+#endif // __qualityGovernorH__
@@ -0,0 +1,335 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: renderCache.cpp
+// 
+// Desc: Matrix helpers, the render state cache and the counting backend.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "renderCache.h"
+#include "memTrack.h"
+#include <cstring>
+
+const char* const gfx::callNames[gfx::CALL_KIND_COUNT] = {
+	"SetTransform",
+	"MultiplyTransform",
+	"SetMaterial",
+	"SetLight",
+	"LightEnable",
+	"SetRenderState",
+	"SetFVF",
+	"Draw",
+};
+
+static const gfx::Matrix s_identity = { {
+	{ 1.0f, 0.0f, 0.0f, 0.0f },
+	{ 0.0f, 1.0f, 0.0f, 0.0f },
+	{ 0.0f, 0.0f, 1.0f, 0.0f },
+	{ 0.0f, 0.0f, 0.0f, 1.0f } } };
+
+const gfx::Matrix& gfx::identity(void)
+{
+	return s_identity;
+}
+
+bool gfx::isIdentity(const Matrix& m)
+{
+	return memcmp(&m, &s_identity, sizeof(Matrix)) == 0;
+}
+
+void gfx::translation(Matrix& out, float x, float y, float z)
+{
+	out = s_identity;
+	out.m[3][0] = x;
+	out.m[3][1] = y;
+	out.m[3][2] = z;
+}
+
+void gfx::scaling(Matrix& out, float x, float y, float z)
+{
+	out = s_identity;
+	out.m[0][0] = x;
+	out.m[1][1] = y;
+	out.m[2][2] = z;
+}
+
+void gfx::multiply(Matrix& out, const Matrix& a, const Matrix& b)
+{
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			out.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+}
+
+void gfx::transformPoint(float out[3], const float p[3], const Matrix& m)
+{
+	float v[4];
+	for (int c = 0; c < 4; c++)
+		v[c] = p[0] * m.m[0][c] + p[1] * m.m[1][c] + p[2] * m.m[2][c] + m.m[3][c];
+	float w = v[3] != 0.0f ? 1.0f / v[3] : 1.0f;
+	out[0] = v[0] * w;
+	out[1] = v[1] * w;
+	out[2] = v[2] * w;
+}
+
+void gfx::setParent(ParentMatrix& p, const Matrix& m)
+{
+	p.m        = m;
+	p.identity = isIdentity(m);
+	p.version++;
+	if (p.version == 0)
+		p.version = 1;              // 0 means stale
+}
+
+void gfx::WorldMatrix::init(void)
+{
+	local   = s_identity;
+	world   = s_identity;
+	version = 0;
+}
+
+void gfx::WorldMatrix::setLocal(const Matrix& m)
+{
+	if (memcmp(&m, &local, sizeof(Matrix)) != 0) {
+		local   = m;
+		version = 0;
+	}
+}
+
+//
+// Counting backend
+//
+
+void gfx::CallCounts::clear(void)
+{
+	memset(calls, 0, sizeof(calls));
+}
+
+uint64_t gfx::CallCounts::total(void) const
+{
+	uint64_t n = 0;
+	for (int i = 0; i < CALL_KIND_COUNT; i++)
+		n += calls[i];
+	return n;
+}
+
+static void countSetTransform(void* ctx, int, const gfx::Matrix&)          { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_SET_TRANSFORM]++; }
+static void countMultiplyTransform(void* ctx, int, const gfx::Matrix&)     { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_MULTIPLY_TRANSFORM]++; }
+static void countSetMaterial(void* ctx, const gfx::Material&)              { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_SET_MATERIAL]++; }
+static void countSetLight(void* ctx, int, const gfx::Light&)               { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_SET_LIGHT]++; }
+static void countLightEnable(void* ctx, int, bool)                         { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_LIGHT_ENABLE]++; }
+static void countSetRenderState(void* ctx, int, uint32_t)                  { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_SET_RENDER_STATE]++; }
+static void countSetFVF(void* ctx, uint32_t)                               { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_SET_FVF]++; }
+static void countDrawMesh(void* ctx, void*)                                { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_DRAW]++; }
+static void countDrawPoints(void* ctx, const void*, int, int)              { ((gfx::CallCounts*)ctx)->calls[gfx::CALL_DRAW]++; }
+
+// the handle is what was charged, so the release takes back the same
+static void* countCreateMesh(void*, const gfx::MeshData& data)
+{
+	mem::MeshCost* cost = new mem::MeshCost(mem::meshCost((int)data.vertices.size(), sizeof(gfx::MeshVertex),
+		data.faceCount(), false));
+	mem::chargeMesh(mem::TAG_RENDER, *cost);
+	return cost;
+}
+
+static void countReleaseMesh(void*, void* mesh)
+{
+	mem::MeshCost* cost = (mem::MeshCost*)mesh;
+	mem::releaseMesh(mem::TAG_RENDER, *cost);
+	delete cost;
+}
+
+gfx::RenderBackend gfx::countingBackend(CallCounts* counts)
+{
+	RenderBackend b;
+	b.ctx               = counts;
+	b.setTransform      = countSetTransform;
+	b.multiplyTransform = countMultiplyTransform;
+	b.setMaterial       = countSetMaterial;
+	b.setLight          = countSetLight;
+	b.lightEnable       = countLightEnable;
+	b.setRenderState    = countSetRenderState;
+	b.setFVF            = countSetFVF;
+	b.drawMesh          = countDrawMesh;
+	b.drawPoints        = countDrawPoints;
+	b.createMesh        = countCreateMesh;
+	b.releaseMesh       = countReleaseMesh;
+	counts->clear();
+	return b;
+}
+
+//
+// RenderStateCache
+//
+
+gfx::RenderStateCache::RenderStateCache(void)
+{
+	memset(&m_backend, 0, sizeof(m_backend));   // init() before the first call
+	resetStats();
+	invalidate();
+}
+
+void gfx::RenderStateCache::init(const RenderBackend& backend)
+{
+	m_backend = backend;
+	resetStats();
+	invalidate();
+}
+
+void gfx::RenderStateCache::invalidate(void)
+{
+	memset(m_transformKnown, 0, sizeof(m_transformKnown));
+	memset(m_lightKnown, 0, sizeof(m_lightKnown));
+	memset(m_lightOnKnown, 0, sizeof(m_lightOnKnown));
+	memset(m_renderStateKnown, 0, sizeof(m_renderStateKnown));
+	m_materialKnown = false;
+	m_fvfKnown      = false;
+}
+
+void gfx::RenderStateCache::resetStats(void)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+int gfx::RenderStateCache::transformSlot(int state) const
+{
+	switch (state) {
+	case TRANSFORM_VIEW:       return 0;
+	case TRANSFORM_PROJECTION: return 1;
+	case TRANSFORM_WORLD:      return 2;
+	}
+	return -1;
+}
+
+void gfx::RenderStateCache::setTransform(int state, const Matrix& m)
+{
+	int slot = transformSlot(state);
+	if (slot >= 0) {
+		if (m_transformKnown[slot] && memcmp(&m_transform[slot], &m, sizeof(Matrix)) == 0) {
+			m_stats.callsSaved++;
+			return;
+		}
+		m_transform[slot]      = m;
+		m_transformKnown[slot] = true;
+	}
+	m_backend.setTransform(m_backend.ctx, state, m);
+	m_stats.calls++;
+}
+
+void gfx::RenderStateCache::setMaterial(const Material& m)
+{
+	if (m_materialKnown && memcmp(&m_material, &m, sizeof(Material)) == 0) {
+		m_stats.callsSaved++;
+		return;
+	}
+	m_material      = m;
+	m_materialKnown = true;
+	m_backend.setMaterial(m_backend.ctx, m);
+	m_stats.calls++;
+}
+
+void gfx::RenderStateCache::setLight(int index, const Light& l)
+{
+	if (index >= 0 && index < MAX_LIGHTS) {
+		if (m_lightKnown[index] && memcmp(&m_light[index], &l, sizeof(Light)) == 0) {
+			m_stats.callsSaved++;
+			return;
+		}
+		m_light[index]      = l;
+		m_lightKnown[index] = true;
+	}
+	m_backend.setLight(m_backend.ctx, index, l);
+	m_stats.calls++;
+}
+
+void gfx::RenderStateCache::lightEnable(int index, bool on)
+{
+	if (index >= 0 && index < MAX_LIGHTS) {
+		if (m_lightOnKnown[index] && m_lightOn[index] == on) {
+			m_stats.callsSaved++;
+			return;
+		}
+		m_lightOn[index]      = on;
+		m_lightOnKnown[index] = true;
+	}
+	m_backend.lightEnable(m_backend.ctx, index, on);
+	m_stats.calls++;
+}
+
+void gfx::RenderStateCache::setRenderState(int state, uint32_t value)
+{
+	if (state >= 0 && state < MAX_RENDER_STATES) {
+		if (m_renderStateKnown[state] && m_renderState[state] == value) {
+			m_stats.callsSaved++;
+			return;
+		}
+		m_renderState[state]      = value;
+		m_renderStateKnown[state] = true;
+	}
+	m_backend.setRenderState(m_backend.ctx, state, value);
+	m_stats.calls++;
+}
+
+void gfx::RenderStateCache::setFVF(uint32_t fvf)
+{
+	if (m_fvfKnown && m_fvf == fvf) {
+		m_stats.callsSaved++;
+		return;
+	}
+	m_fvf      = fvf;
+	m_fvfKnown = true;
+	m_backend.setFVF(m_backend.ctx, fvf);
+	m_stats.calls++;
+}
+
+void gfx::RenderStateCache::drawMesh(void* mesh)
+{
+	m_backend.drawMesh(m_backend.ctx, mesh);
+	m_stats.calls++;
+	m_fvfKnown = false;
+}
+
+void gfx::RenderStateCache::drawPoints(const void* vertices, int count, int stride)
+{
+	m_backend.drawPoints(m_backend.ctx, vertices, count, stride);
+	m_stats.calls++;
+}
+
+void* gfx::RenderStateCache::createMesh(const MeshData& data)
+{
+	return m_backend.createMesh(m_backend.ctx, data);
+}
+
+void gfx::RenderStateCache::releaseMesh(void* mesh)
+{
+	m_backend.releaseMesh(m_backend.ctx, mesh);
+}
+
+const gfx::Matrix& gfx::RenderStateCache::updateWorld(WorldMatrix& w, const ParentMatrix& parent)
+{
+	if (w.version != 0 && w.version == parent.version) {
+		m_stats.multipliesSaved++;
+		return w.world;
+	}
+	if (parent.identity) {
+		w.world = w.local;
+		m_stats.multipliesSaved++;
+	}
+	else {
+		gfx::multiply(w.world, w.local, parent.m);
+		m_stats.multiplies++;
+	}
+	w.version = parent.version;
+	return w.world;
+}
+
+void gfx::RenderStateCache::updateWorlds(WorldMatrix* w, int count, const ParentMatrix& parent)
+{
+	for (int i = 0; i < count; i++)
+		updateWorld(w[i], parent);
+}
+
+void gfx::RenderStateCache::multiply(Matrix& out, const Matrix& a, const Matrix& b)
+{
+	gfx::multiply(out, a, b);
+	m_stats.multiplies++;
+}
@@ -0,0 +1,205 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: renderCache.h
+// 
+// Desc: Keeps what the device was last told and drops calls that would not
+//       change it. Objects carry their world matrix ready made, local * parent,
+//       and remake it only when the object or its parent moves, so drawing one
+//       is a single SetTransform instead of a SetTransform and a
+//       MultiplyTransform that the runtime works out again every frame.
+//
+//       The cache reaches the device through a RenderBackend, a table of plain
+//       functions. The game's goes to D3D; countingBackend() only counts, so a
+//       tool can see what a frame costs in device calls without a window
+//       (tools/renderBench.cpp). Meshes are created through the backend too,
+//       and each backend charges what it makes to the memory report, the
+//       counting one from the sizes of the data it was given. Matrices, materials and lights are laid out
+//       like their D3D counterparts and are passed to the device as they are.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __renderCacheH__
+#define __renderCacheH__
+
+#include "meshGen.h"
+#include <cstdint>
+
+namespace gfx
+{
+	// row-major like D3DMATRIX; points are row vectors, so a * b applies a first
+	struct Matrix
+	{
+		float m[4][4];
+	};
+
+	const Matrix& identity(void);
+	bool isIdentity(const Matrix& m);
+	void translation(Matrix& out, float x, float y, float z);
+	void scaling(Matrix& out, float x, float y, float z);
+	void multiply(Matrix& out, const Matrix& a, const Matrix& b);      // out must not be a or b
+	void transformPoint(float out[3], const float p[3], const Matrix& m);  // D3DXVec3TransformCoord
+
+	// D3DMATERIAL9
+	struct Material
+	{
+		float diffuse[4], ambient[4], specular[4], emissive[4];
+		float power;
+	};
+
+	// D3DLIGHT9
+	struct Light
+	{
+		int   type;
+		float diffuse[4], specular[4], ambient[4];
+		float position[3], direction[3];
+		float range, falloff, attenuation0, attenuation1, attenuation2, theta, phi;
+	};
+
+	// D3DTS_VIEW, D3DTS_PROJECTION and D3DTS_WORLD
+	enum TransformState
+	{
+		TRANSFORM_VIEW       = 2,
+		TRANSFORM_PROJECTION = 3,
+		TRANSFORM_WORLD      = 256
+	};
+
+	// what objects hang off; setParent() bumps the version, which makes every
+	// world matrix under it stale
+	struct ParentMatrix
+	{
+		Matrix   m;
+		uint32_t version;
+		bool     identity;
+	};
+	void setParent(ParentMatrix& p, const Matrix& m);
+
+	// an object's own matrix and the world matrix made from it
+	struct WorldMatrix
+	{
+		Matrix   local;
+		Matrix   world;                 // local * parent
+		uint32_t version;               // of the parent 'world' was made from; 0 when stale
+
+		void init(void);                // identity, stale
+		void setLocal(const Matrix& m); // stale only if it really changed
+	};
+
+	// the device calls, each with the device (or whatever stands in) as ctx
+	struct RenderBackend
+	{
+		void* ctx;
+		void (*setTransform)(void* ctx, int state, const Matrix& m);
+		void (*multiplyTransform)(void* ctx, int state, const Matrix& m);  // the cache never needs it
+		void (*setMaterial)(void* ctx, const Material& m);
+		void (*setLight)(void* ctx, int index, const Light& l);
+		void (*lightEnable)(void* ctx, int index, bool on);
+		void (*setRenderState)(void* ctx, int state, uint32_t value);
+		void (*setFVF)(void* ctx, uint32_t fvf);
+		void (*drawMesh)(void* ctx, void* mesh);    // an ID3DXMesh's subset 0
+		void (*drawPoints)(void* ctx, const void* vertices, int count, int stride);
+
+		// a mesh with the data's vertices and indices, charged to mem::TAG_RENDER; NULL if it failed
+		void* (*createMesh)(void* ctx, const MeshData& data);
+		void  (*releaseMesh)(void* ctx, void* mesh);
+	};
+
+	enum CallKind
+	{
+		CALL_SET_TRANSFORM = 0,
+		CALL_MULTIPLY_TRANSFORM,
+		CALL_SET_MATERIAL,
+		CALL_SET_LIGHT,
+		CALL_LIGHT_ENABLE,
+		CALL_SET_RENDER_STATE,
+		CALL_SET_FVF,
+		CALL_DRAW,
+
+		CALL_KIND_COUNT
+	};
+
+	extern const char* const callNames[CALL_KIND_COUNT];
+
+	struct CallCounts
+	{
+		uint64_t calls[CALL_KIND_COUNT];
+
+		void     clear(void);
+		uint64_t total(void) const;
+	};
+
+	// counts every call into 'counts' and draws nothing; its meshes hold no
+	// vertices but are charged as if they did
+	RenderBackend countingBackend(CallCounts* counts);
+
+	struct RenderStats
+	{
+		uint64_t calls;                 // passed on to the backend
+		uint64_t callsSaved;            // dropped: the device already had that state
+		uint64_t multiplies;            // world matrices made
+		uint64_t multipliesSaved;       // world matrices still current, or copied from under an identity parent
+	};
+
+	class RenderStateCache
+	{
+	public:
+		enum
+		{
+			MAX_LIGHTS        = 8,
+			MAX_RENDER_STATES = 256
+		};
+
+		RenderStateCache(void);
+
+		void init(const RenderBackend& backend);
+
+		// forget what the device has, after a reset or anything that set state around the cache
+		void invalidate(void);
+
+		void setTransform(int state, const Matrix& m);
+		void setMaterial(const Material& m);
+		void setLight(int index, const Light& l);
+		void lightEnable(int index, bool on);
+		void setRenderState(int state, uint32_t value);
+		void setFVF(uint32_t fvf);
+
+		// a D3DX mesh sets its own FVF, so the cache forgets it
+		void drawMesh(void* mesh);
+		void drawPoints(const void* vertices, int count, int stride);
+
+		// straight to the backend; nothing about meshes is cached
+		void* createMesh(const MeshData& data);
+		void  releaseMesh(void* mesh);
+
+		// remakes w.world if the object or the parent moved since it was made
+		const Matrix& updateWorld(WorldMatrix& w, const ParentMatrix& parent);
+		void updateWorlds(WorldMatrix* w, int count, const ParentMatrix& parent);
+		void multiply(Matrix& out, const Matrix& a, const Matrix& b);     // counted
+
+		const RenderStats& stats(void) const { return m_stats; }
+		void resetStats(void);
+
+	private:
+		RenderStateCache(const RenderStateCache&);
+		RenderStateCache& operator=(const RenderStateCache&);
+
+		int transformSlot(int state) const;
+
+		RenderBackend m_backend;
+		RenderStats   m_stats;
+
+		Matrix        m_transform[3];   // view, projection, world
+		bool          m_transformKnown[3];
+		Material      m_material;
+		bool          m_materialKnown;
+		Light         m_light[MAX_LIGHTS];
+		bool          m_lightKnown[MAX_LIGHTS];
+		bool          m_lightOn[MAX_LIGHTS];
+		bool          m_lightOnKnown[MAX_LIGHTS];
+		uint32_t      m_renderState[MAX_RENDER_STATES];
+		bool          m_renderStateKnown[MAX_RENDER_STATES];
+		uint32_t      m_fvf;
+		bool          m_fvfKnown;
+	};
+}
+
+#endif // __renderCacheH__
@@ -0,0 +1,287 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: shapes.h
+// 
+// Desc: Collision shapes on the x/z plane and their pairwise overlap tests.
+//       The routine for a pair of shapes is picked at compile time through the
+//       Collide<A, B> specializations below, so loops over typed arrays of
+//       shapes compile down to straight inline code with no virtual calls.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __shapesH__
+#define __shapesH__
+
+#include "simMath.h"
+
+namespace sim
+{
+	struct Sphere
+	{
+		Vec2   center;
+		Scalar radius;
+
+		Sphere() {}
+		Sphere(const Vec2& c, Scalar r) : center(c), radius(r) {}
+	};
+
+	// Aabb lives in simMath.h
+
+	struct Capsule
+	{
+		Vec2   a, b;       // segment end points
+		Scalar radius;
+
+		Capsule() {}
+		Capsule(const Vec2& ia, const Vec2& ib, Scalar r) : a(ia), b(ib), radius(r) {}
+	};
+
+	// Result of collide(a, b): 'normal' is the unit direction that pushes a out
+	// of b, 'depth' how far a has to move along it, 'point' the contact on b.
+	struct Manifold
+	{
+		Vec2   normal;
+		Scalar depth;
+		Vec2   point;
+	};
+
+	inline Vec2 closestPointOnSegment(const Vec2& p, const Vec2& a, const Vec2& b)
+	{
+		Vec2  ab = b - a;
+		Scalar l2 = lengthSq(ab);
+		if (l2 <= 0) return a;
+		return a + ab * clampf(dot(p - a, ab) / l2, 0, 1);
+	}
+
+	// closest points between segments p1-q1 and p2-q2, c1 on the first and c2
+	// on the second; clamped parameters, so parallel and point segments work
+	inline void closestPointsOnSegments(const Vec2& p1, const Vec2& q1, const Vec2& p2, const Vec2& q2, Vec2& c1, Vec2& c2)
+	{
+		Vec2   d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+		Scalar a = lengthSq(d1), e = lengthSq(d2), f = dot(d2, r);
+		Scalar s = 0, t = 0;
+		if (a <= 0) {
+			if (e > 0) t = clampf(f / e, 0, 1);
+		}
+		else {
+			Scalar c = dot(d1, r);
+			if (e <= 0) {
+				s = clampf(-c / a, 0, 1);
+			}
+			else {
+				Scalar b     = dot(d1, d2);
+				Scalar denom = a * e - b * b;
+				s = denom > 0 ? clampf((b * f - c * e) / denom, 0, 1) : 0;
+				t = (b * s + f) / e;
+				if (t < 0)      { t = 0; s = clampf(-c / a, 0, 1); }
+				else if (t > 1) { t = 1; s = clampf((b - c) / a, 0, 1); }
+			}
+		}
+		c1 = p1 + d1 * s;
+		c2 = p2 + d2 * t;
+	}
+
+	// narrows [t0, t1] to where p + d*t lies within [lo, hi] on one axis
+	inline bool clipSlab(Scalar p, Scalar d, Scalar lo, Scalar hi, Scalar& t0, Scalar& t1)
+	{
+		if (d == 0)
+			return lo <= p && p <= hi;
+		Scalar ta = (lo - p) / d, tb = (hi - p) / d;
+		if (ta > tb) { Scalar x = ta; ta = tb; tb = x; }
+		if (ta > t0) t0 = ta;
+		if (tb < t1) t1 = tb;
+		return t0 <= t1;
+	}
+
+	inline Scalar distanceSqToBox(const Vec2& p, const Aabb& box)
+	{
+		return lengthSq(p - Vec2(clampf(p.x, box.lo.x, box.hi.x), clampf(p.z, box.lo.z, box.hi.z)));
+	}
+
+	// the point of segment a-b nearest the box. A segment through the box gives
+	// the middle of the part inside, so a capsule is pushed out like a sphere
+	// centered there; otherwise the gap is narrowest at an end of the segment
+	// or opposite a corner of the box.
+	inline Vec2 closestPointOnSegmentToBox(const Vec2& a, const Vec2& b, const Aabb& box)
+	{
+		Vec2   d  = b - a;
+		Scalar t0 = 0, t1 = 1;
+		if (clipSlab(a.x, d.x, box.lo.x, box.hi.x, t0, t1) && clipSlab(a.z, d.z, box.lo.z, box.hi.z, t0, t1))
+			return a + d * ((t0 + t1) * Scalar(0.5f));
+
+		const Vec2 corners[4] = { box.lo, Vec2(box.hi.x, box.lo.z), box.hi, Vec2(box.lo.x, box.hi.z) };
+		Vec2   best  = a;
+		Scalar bestD = distanceSqToBox(a, box);
+		Scalar dist  = distanceSqToBox(b, box);
+		if (dist < bestD) { best = b; bestD = dist; }
+		for (int i = 0; i < 4; i++) {
+			Vec2 q = closestPointOnSegment(corners[i], a, b);
+			dist = distanceSqToBox(q, box);
+			if (dist < bestD) { best = q; bestD = dist; }
+		}
+		return best;
+	}
+
+	//
+	// Pair routines. Only one order of each pair is written out; the primary
+	// template answers the reversed order by flipping the manifold. A pair with
+	// neither order implemented fails to compile.
+	//
+	template<class A, class B> struct Collide
+	{
+		enum { IMPLEMENTED = 0 };
+
+		static bool test(const A& a, const B& b, Manifold& m)
+		{
+			static_assert(Collide<B, A>::IMPLEMENTED, "no collision routine for this pair of shapes");
+			if (!Collide<B, A>::test(b, a, m))
+				return false;
+			m.point  = m.point - m.normal * m.depth;
+			m.normal = -m.normal;
+			return true;
+		}
+	};
+
+	template<> struct Collide<Sphere, Sphere>
+	{
+		enum { IMPLEMENTED = 1 };
+
+		static bool test(const Sphere& a, const Sphere& b, Manifold& m)
+		{
+			Vec2   d     = a.center - b.center;
+			Scalar reach = a.radius + b.radius;
+			Scalar d2    = lengthSq(d);
+			if (d2 > reach * reach)
+				return false;
+			Scalar dist = scalarSqrt(d2);
+			m.normal = dist > 0 ? d * (1 / dist) : Vec2(1, 0);
+			m.depth  = reach - dist;
+			m.point  = b.center + m.normal * b.radius;
+			return true;
+		}
+	};
+
+	template<> struct Collide<Sphere, Aabb>
+	{
+		enum { IMPLEMENTED = 1 };
+
+		// closest point on the box, so faces and corners are handled alike
+		static bool test(const Sphere& a, const Aabb& b, Manifold& m)
+		{
+			Vec2   q(clampf(a.center.x, b.lo.x, b.hi.x), clampf(a.center.z, b.lo.z, b.hi.z));
+			Vec2   d  = a.center - q;
+			Scalar d2 = lengthSq(d);
+			if (d2 > a.radius * a.radius)
+				return false;
+
+			if (d2 > 0) {
+				Scalar dist = scalarSqrt(d2);
+				m.normal = d * (1 / dist);
+				m.depth  = a.radius - dist;
+				m.point  = q;
+				return true;
+			}
+
+			// center inside the box: leave through the nearest face
+			Scalar left  = a.center.x - b.lo.x, right = b.hi.x - a.center.x;
+			Scalar front = a.center.z - b.lo.z, back  = b.hi.z - a.center.z;
+			Scalar best  = left;
+			m.normal = Vec2(-1, 0);
+			if (right < best) { best = right; m.normal = Vec2(1, 0); }
+			if (front < best) { best = front; m.normal = Vec2(0, -1); }
+			if (back  < best) { best = back;  m.normal = Vec2(0, 1); }
+			m.depth = a.radius + best;
+			m.point = a.center + m.normal * best;
+			return true;
+		}
+	};
+
+	template<> struct Collide<Sphere, Capsule>
+	{
+		enum { IMPLEMENTED = 1 };
+
+		static bool test(const Sphere& a, const Capsule& b, Manifold& m)
+		{
+			Sphere s(closestPointOnSegment(a.center, b.a, b.b), b.radius);
+			return Collide<Sphere, Sphere>::test(a, s, m);
+		}
+	};
+
+	template<> struct Collide<Capsule, Aabb>
+	{
+		enum { IMPLEMENTED = 1 };
+
+		static bool test(const Capsule& a, const Aabb& b, Manifold& m)
+		{
+			Sphere s(closestPointOnSegmentToBox(a.a, a.b, b), a.radius);
+			return Collide<Sphere, Aabb>::test(s, b, m);
+		}
+	};
+
+	template<> struct Collide<Capsule, Capsule>
+	{
+		enum { IMPLEMENTED = 1 };
+
+		static bool test(const Capsule& a, const Capsule& b, Manifold& m)
+		{
+			Vec2 ca, cb;
+			closestPointsOnSegments(a.a, a.b, b.a, b.b, ca, cb);
+			return Collide<Sphere, Sphere>::test(Sphere(ca, a.radius), Sphere(cb, b.radius), m);
+		}
+	};
+
+	template<> struct Collide<Aabb, Aabb>
+	{
+		enum { IMPLEMENTED = 1 };
+
+		static bool test(const Aabb& a, const Aabb& b, Manifold& m)
+		{
+			Scalar ox = (a.hi.x < b.hi.x ? a.hi.x : b.hi.x) - (a.lo.x > b.lo.x ? a.lo.x : b.lo.x);
+			Scalar oz = (a.hi.z < b.hi.z ? a.hi.z : b.hi.z) - (a.lo.z > b.lo.z ? a.lo.z : b.lo.z);
+			if (ox < 0 || oz < 0)
+				return false;
+			bool ax = a.lo.x + a.hi.x < b.lo.x + b.hi.x;
+			bool az = a.lo.z + a.hi.z < b.lo.z + b.hi.z;
+			if (ox < oz) {
+				m.normal = Vec2(ax ? -1 : 1, 0);
+				m.depth  = ox;
+				m.point  = Vec2(ax ? b.lo.x : b.hi.x, clampf((a.lo.z + a.hi.z) * Scalar(0.5f), b.lo.z, b.hi.z));
+			}
+			else {
+				m.normal = Vec2(0, az ? -1 : 1);
+				m.depth  = oz;
+				m.point  = Vec2(clampf((a.lo.x + a.hi.x) * Scalar(0.5f), b.lo.x, b.hi.x), az ? b.lo.z : b.hi.z);
+			}
+			return true;
+		}
+	};
+
+	template<class A, class B>
+	inline bool collide(const A& a, const B& b, Manifold& m)
+	{
+		return Collide<A, B>::test(a, b, m);
+	}
+
+	//
+	// Responses
+	//
+
+	// pushes the ball out along the normal and mirrors its velocity if it was
+	// moving into the surface
+	inline void bounce(Vec2& pos, Vec2& vel, const Manifold& m)
+	{
+		pos = pos + m.normal * m.depth;
+		Scalar vn = dot(vel, m.normal);
+		if (vn < 0)
+			vel = vel - m.normal * (2 * vn);
+	}
+
+	// the game's ball-on-ball rule: keep the speed, leave straight away from
+	// the center that was hit
+	inline void deflect(Vec2& vel, const Manifold& m)
+	{
+		vel = m.normal * length(vel);
+	}
+}
+
+#endif // __shapesH__
@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: simMath.h
+// 
+// Desc: Small vector types for the simulation side of the game. The play field
+//       is the x/z plane, so the physics only needs 2D math. Nothing here
+//       depends on Direct3D so simulation code can run headless.
+//
+//       Coordinates are sim::Scalar: float, or with ARK_FIXED_POINT the
+//       Fixed of fixedPoint.h. Simulation code sticks to Scalar and the
+//       helpers below instead of float and <cmath>, so it builds either way;
+//       toFloat() hands values to the renderer. Whole numbers mix freely
+//       with Scalars; other constants are written Scalar(0.5f), since Fixed
+//       takes floats only explicitly.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __simMathH__
+#define __simMathH__
+
+#include <cfloat>
+#include <cmath>
+
+#ifdef ARK_FIXED_POINT
+#include "fixedPoint.h"
+#endif
+
+namespace sim
+{
+#ifdef ARK_FIXED_POINT
+	typedef Fixed Scalar;
+	const Scalar SCALAR_MAX = Fixed::fromRaw(FIXED_MAX);
+	const char* const SCALAR_NAME = FIXED_NAME;
+#else
+	typedef float Scalar;
+	const Scalar SCALAR_MAX = FLT_MAX;
+	const char* const SCALAR_NAME = "float";
+
+	inline float scalarSqrt(float v)   { return std::sqrt(v); }
+	inline float scalarAbs(float v)    { return std::fabs(v); }
+	inline int   floorToInt(float v)   { return (int)std::floor(v); }
+	inline int   ceilToInt(float v)    { return (int)std::ceil(v); }
+	inline int   truncToInt(float v)   { return (int)v; }
+	inline float toFloat(float v)      { return v; }
+#endif
+
+	struct Vec2
+	{
+		Scalar x, z;
+
+		Vec2() {}
+		Vec2(Scalar ix, Scalar iz) : x(ix), z(iz) {}
+
+		Vec2 operator+(const Vec2& v) const { return Vec2(x + v.x, z + v.z); }
+		Vec2 operator-(const Vec2& v) const { return Vec2(x - v.x, z - v.z); }
+		Vec2 operator*(Scalar s) const      { return Vec2(x * s, z * s); }
+		Vec2 operator-() const              { return Vec2(-x, -z); }
+	};
+
+	inline Scalar dot(const Vec2& a, const Vec2& b) { return a.x * b.x + a.z * b.z; }
+	inline Scalar lengthSq(const Vec2& v)           { return dot(v, v); }
+	inline Scalar length(const Vec2& v)             { return scalarSqrt(dot(v, v)); }
+
+	inline Scalar clampf(Scalar v, Scalar lo, Scalar hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+	// floats from tables, level files and the tools come in through Scalar(f)
+	// or this, and out through toFloat()
+	inline Vec2 toVec2(float x, float z) { return Vec2(Scalar(x), Scalar(z)); }
+
+	// axis aligned rectangle on the x/z plane
+	struct Aabb
+	{
+		Vec2 lo;
+		Vec2 hi;
+
+		Aabb() {}
+		Aabb(const Vec2& ilo, const Vec2& ihi) : lo(ilo), hi(ihi) {}
+	};
+}
+
+#endif // __simMathH__
@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: soundBank.cpp
+// 
+// Desc: Sound bank reading, writing and the built-in sounds.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "soundBank.h"
+#include "memTrack.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+audio::SoundBank::SoundBank(void)
+{
+	m_count = 0;
+}
+
+bool audio::SoundBank::open(const char* path)
+{
+	mem::Scope tag(mem::TAG_AUDIO);
+	close();
+	if (!m_file.open(path, false))
+		return false;
+
+	const unsigned char* base = static_cast<const unsigned char*>(m_file.data());
+	size_t size = m_file.size();
+	const BankHeader* h = reinterpret_cast<const BankHeader*>(base);
+	if (size < sizeof(BankHeader) || h->magic != BANK_MAGIC || h->version != BANK_VERSION ||
+		h->soundCount > MAX_SOUNDS || size < sizeof(BankHeader) + h->soundCount * sizeof(BankEntry)) {
+		close();
+		return false;
+	}
+
+	const BankEntry* e = reinterpret_cast<const BankEntry*>(h + 1);
+	for (uint32_t i = 0; i < h->soundCount; i++) {
+		if (e[i].offset + (size_t)e[i].frames * sizeof(int16_t) > size || e[i].frames < 2) {
+			close();
+			return false;
+		}
+		m_sounds[i].samples    = reinterpret_cast<const int16_t*>(base + e[i].offset);
+		m_sounds[i].frames     = (int)e[i].frames;
+		m_sounds[i].sampleRate = (int)e[i].sampleRate;
+	}
+	m_count = (int)h->soundCount;
+	return true;
+}
+
+void audio::SoundBank::close(void)
+{
+	m_file.close();
+	m_count = 0;
+}
+
+bool audio::writeSoundBank(const char* path, const Sound* sounds, int count)
+{
+	size_t offset = sizeof(BankHeader) + count * sizeof(BankEntry);
+	std::vector<BankEntry> entries(count);
+	for (int i = 0; i < count; i++) {
+		offset = (offset + 15) & ~(size_t)15;
+		entries[i].offset     = (uint32_t)offset;
+		entries[i].frames     = (uint32_t)sounds[i].frames;
+		entries[i].sampleRate = (uint32_t)sounds[i].sampleRate;
+		entries[i].reserved   = 0;
+		offset += sounds[i].frames * sizeof(int16_t);
+	}
+
+	MappedFile file;
+	if (!file.create(path, offset))
+		return false;
+
+	unsigned char* base = static_cast<unsigned char*>(file.data());
+	::memset(base, 0, offset);
+	BankHeader* h = reinterpret_cast<BankHeader*>(base);
+	h->magic      = BANK_MAGIC;
+	h->version    = BANK_VERSION;
+	h->soundCount = (uint32_t)count;
+	h->reserved   = 0;
+	if (count > 0)
+		::memcpy(h + 1, &entries[0], count * sizeof(BankEntry));
+	for (int i = 0; i < count; i++)
+		::memcpy(base + entries[i].offset, sounds[i].samples, sounds[i].frames * sizeof(int16_t));
+	file.close();
+	return true;
+}
+
+// a decaying tone sliding from f0 to f1 Hz, with a little noise for the attack
+static void synthBlip(std::vector<int16_t>& out, int rate, float seconds, float f0, float f1, float decay, float noise)
+{
+	int frames = (int)(rate * seconds);
+	out.resize(frames);
+	unsigned int rng = 22222;
+	float phase = 0.0f;
+	for (int i = 0; i < frames; i++) {
+		float t = (float)i / rate;
+		float f = f0 + (f1 - f0) * t / seconds;
+		phase += 6.2831853f * f / rate;
+		rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+		float n = ((rng & 0xffff) / 32768.0f - 1.0f) * noise * std::exp(-t * 60.0f);
+		float v = (std::sin(phase) + n) * std::exp(-t * decay);
+		out[i] = (int16_t)(v * 24000.0f);
+	}
+}
+
+bool audio::writeDefaultSoundBank(const char* path, int sampleRate)
+{
+	std::vector<int16_t> pcm[SOUND_COUNT];
+	synthBlip(pcm[SOUND_HIT],       sampleRate, 0.15f, 1200.0f, 700.0f, 30.0f, 0.6f);
+	synthBlip(pcm[SOUND_BOUNCE],    sampleRate, 0.08f, 300.0f, 260.0f, 45.0f, 0.3f);
+	synthBlip(pcm[SOUND_GAME_OVER], sampleRate, 1.2f, 440.0f, 110.0f, 2.5f, 0.0f);
+
+	Sound sounds[SOUND_COUNT];
+	for (int i = 0; i < SOUND_COUNT; i++) {
+		sounds[i].samples    = &pcm[i][0];
+		sounds[i].frames     = (int)pcm[i].size();
+		sounds[i].sampleRate = sampleRate;
+	}
+	return writeSoundBank(path, sounds, SOUND_COUNT);
+}
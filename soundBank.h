@@ -0,0 +1,80 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: soundBank.h
+// 
+// Desc: Mono 16-bit PCM sounds packed into one file that is memory-mapped
+//       read-only, so samples are never copied or decoded at play time. The
+//       game's own sounds are synthesized into a bank the first time it runs.
+//
+//       Layout: BankHeader, soundCount BankEntry records, then the samples.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __soundBankH__
+#define __soundBankH__
+
+#include "mappedFile.h"
+#include <cstdint>
+
+namespace audio
+{
+	const uint32_t BANK_MAGIC   = 0x4b4e4253;   // "SBNK"
+	const uint32_t BANK_VERSION = 1;
+
+	enum SoundId
+	{
+		SOUND_HIT = 0,      // a target or brick destroyed
+		SOUND_BOUNCE,       // wall or white ball
+		SOUND_GAME_OVER,    // red ball lost
+		SOUND_COUNT
+	};
+
+	struct BankHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t soundCount;
+		uint32_t reserved;
+	};
+
+	struct BankEntry
+	{
+		uint32_t offset;        // bytes from the start of the file, 16-byte aligned
+		uint32_t frames;
+		uint32_t sampleRate;
+		uint32_t reserved;
+	};
+
+	struct Sound
+	{
+		const int16_t* samples;
+		int            frames;
+		int            sampleRate;
+	};
+
+	class SoundBank
+	{
+	public:
+		SoundBank(void);
+
+		bool open(const char* path);
+		void close(void);
+
+		int          soundCount(void) const { return m_count; }
+		const Sound& sound(int i) const     { return m_sounds[i]; }
+
+	private:
+		enum { MAX_SOUNDS = 64 };
+
+		MappedFile m_file;
+		Sound      m_sounds[MAX_SOUNDS];
+		int        m_count;
+	};
+
+	bool writeSoundBank(const char* path, const Sound* sounds, int count);
+
+	// synthesizes SOUND_HIT, SOUND_BOUNCE and SOUND_GAME_OVER at 'sampleRate'
+	bool writeDefaultSoundBank(const char* path, int sampleRate);
+}
+
+#endif // __soundBankH__
@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: spscQueue.h
+// 
+// Desc: Fixed-size ring buffer for one producer thread and one consumer
+//       thread. push() and pop() never block or retry: each is a couple of
+//       loads and one store, and push() simply fails when the ring is full.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __spscQueueH__
+#define __spscQueueH__
+
+#include <atomic>
+
+template<class T, int N>
+class SpscQueue
+{
+	static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+	SpscQueue(void) : m_head(0), m_tail(0) {}
+
+	// producer thread only; false when full
+	bool push(const T& item)
+	{
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == (unsigned int)N)
+			return false;
+		m_items[tail & (N - 1)] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer thread only; false when empty
+	bool pop(T& item)
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return false;
+		item = m_items[head & (N - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// a snapshot; only exact when called from one of the two threads with the other idle
+	int size(void) const
+	{
+		return (int)(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+	}
+
+private:
+	// head and tail on separate cache lines so the two threads don't share one
+	alignas(64) std::atomic<unsigned int> m_head;
+	alignas(64) std::atomic<unsigned int> m_tail;
+	alignas(64) T                         m_items[N];
+};
+
+#endif // __spscQueueH__
@@ -0,0 +1,269 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: taskGraph.cpp
+// 
+// Desc: TaskGraph scheduling. One mutex guards the task states and both
+//       ready queues; tasks run outside it.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "taskGraph.h"
+#include "perfCounters.h"
+
+static const char* const whereNames[] = { "worker", "main", "signal" };
+static const char* const stateNames[] = { "waiting", "ready", "running", "done", "FAILED", "skipped" };
+
+TaskGraph::TaskGraph(void)
+{
+	m_unfinished  = 0;
+	m_workerCount = 0;
+	m_started     = false;
+	m_quit        = false;
+}
+
+TaskGraph::~TaskGraph(void)
+{
+	stop();
+}
+
+int TaskGraph::add(const char* name, TaskFn fn, void* ctx, int where)
+{
+	Task t;
+	t.name    = name;
+	t.fn      = fn;
+	t.ctx     = ctx;
+	t.where   = where;
+	t.state   = TASK_WAITING;
+	t.pending = 0;
+	t.thread  = -1;
+	t.readyUs = t.startUs = t.endUs = 0;
+	m_tasks.push_back(t);
+	m_unfinished++;
+	return (int)m_tasks.size() - 1;
+}
+
+void TaskGraph::depend(int task, int on)
+{
+	m_tasks[on].dependents.push_back(task);
+	m_tasks[task].pending++;
+}
+
+bool TaskGraph::start(int workers)
+{
+	if (m_started)
+		return false;
+	m_started = true;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_workerCount = workers > 0 ? workers : 0;
+		for (size_t i = 0; i < m_tasks.size(); i++)
+			if (m_tasks[i].pending == 0)
+				makeReady((int)i);
+	}
+	for (int i = 1; i <= workers; i++)
+		m_workers.push_back(std::thread(&TaskGraph::workerLoop, this, i));
+	return true;
+}
+
+void TaskGraph::makeReady(int task)
+{
+	Task& t = m_tasks[task];
+	t.state   = TASK_READY;
+	t.readyUs = perf::nowMicroseconds();
+	if (t.where == ON_WORKER) {
+		m_workerReady.push_back(task);
+		m_wake.notify_one();
+		if (m_workerCount == 0)
+			m_change.notify_all();
+	}
+	else if (t.where == ON_MAIN) {
+		m_mainReady.push_back(task);
+		m_change.notify_all();
+	}
+	// events stay ready until signal()
+}
+
+void TaskGraph::complete(int task, bool ok)
+{
+	Task& t = m_tasks[task];
+	t.state = ok ? TASK_DONE : TASK_FAILED;
+	t.endUs = perf::nowMicroseconds();
+	m_unfinished--;
+
+	for (size_t i = 0; i < t.dependents.size(); i++) {
+		int d = t.dependents[i];
+		if (!ok)
+			skip(d);
+		else if (m_tasks[d].state == TASK_WAITING && --m_tasks[d].pending == 0)
+			makeReady(d);
+	}
+	m_change.notify_all();
+}
+
+void TaskGraph::skip(int task)
+{
+	Task& t = m_tasks[task];
+	if (t.state != TASK_WAITING && t.state != TASK_READY)
+		return;
+	t.state = TASK_SKIPPED;
+	m_unfinished--;
+	for (size_t i = 0; i < t.dependents.size(); i++)
+		skip(t.dependents[i]);
+}
+
+int TaskGraph::take(std::deque<int>& queue, int thread)
+{
+	while (!queue.empty()) {
+		int task = queue.front();
+		queue.pop_front();
+		Task& t = m_tasks[task];
+		if (t.state != TASK_READY)
+			continue;   // skipped by stop() while it sat in the queue
+		t.state   = TASK_RUNNING;
+		t.thread  = thread;
+		t.startUs = perf::nowMicroseconds();
+		return task;
+	}
+	return -1;
+}
+
+void TaskGraph::workerLoop(int thread)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		while (!m_quit && m_workerReady.empty())
+			m_wake.wait(lock);
+		if (m_quit)
+			return;
+
+		int task = take(m_workerReady, thread);
+		if (task < 0)
+			continue;
+		lock.unlock();
+		bool ok = m_tasks[task].fn(m_tasks[task].ctx);
+		lock.lock();
+		complete(task, ok);
+	}
+}
+
+int TaskGraph::runMain(uint64_t budgetUs)
+{
+	uint64_t t0 = perf::nowMicroseconds();
+	int ran = 0;
+	for (;;) {
+		int task;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			task = take(m_mainReady, 0);
+			if (task < 0 && m_workerCount == 0)
+				task = take(m_workerReady, 0);
+			if (task < 0)
+				break;
+		}
+
+		bool ok = m_tasks[task].fn(m_tasks[task].ctx);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			complete(task, ok);
+		}
+		ran++;
+		if (perf::nowMicroseconds() - t0 >= budgetUs)
+			break;
+	}
+	return ran;
+}
+
+void TaskGraph::signal(int event, bool ok)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Task& t = m_tasks[event];
+	if (t.state != TASK_READY && t.state != TASK_WAITING)
+		return;
+	t.thread  = 0;
+	t.startUs = t.readyUs;      // an event's run is the wait for it
+	complete(event, ok);
+}
+
+void TaskGraph::wait(void)
+{
+	for (;;) {
+		runMain(~(uint64_t)0);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_unfinished == 0)
+			return;
+		if (!m_mainReady.empty() || (m_workerCount == 0 && !m_workerReady.empty()))
+			continue;
+		m_change.wait(lock);
+	}
+}
+
+void TaskGraph::stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+		for (size_t i = 0; i < m_tasks.size(); i++)
+			skip((int)i);
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+	m_workers.clear();
+}
+
+bool TaskGraph::isDone(int task) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_tasks[task].state >= TASK_DONE;
+}
+
+bool TaskGraph::succeeded(int task) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_tasks[task].state == TASK_DONE;
+}
+
+bool TaskGraph::finished(void) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_unfinished == 0;
+}
+
+int TaskGraph::firstFailure(void) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_tasks.size(); i++)
+		if (m_tasks[i].state == TASK_FAILED)
+			return (int)i;
+	return -1;
+}
+
+TaskGraph::Timing TaskGraph::timing(int task) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const Task& t = m_tasks[task];
+	Timing out;
+	out.name    = t.name;
+	out.where   = t.where;
+	out.state   = t.state;
+	out.thread  = t.thread;
+	out.readyUs = t.readyUs;
+	out.startUs = t.startUs;
+	out.endUs   = t.endUs;
+	return out;
+}
+
+void TaskGraph::print(FILE* fp, uint64_t originUs) const
+{
+	for (int i = 0; i < taskCount(); i++) {
+		Timing t = timing(i);
+		double ready = t.readyUs ? (t.readyUs - originUs) / 1000.0 : 0.0;
+		double begin = t.startUs ? (t.startUs - originUs) / 1000.0 : 0.0;
+		double end   = t.endUs ? (t.endUs - originUs) / 1000.0 : 0.0;
+		fprintf(fp, "  %-20s %-6s %-7s thread %2d   ready %8.2f  start %8.2f  end %8.2f ms  (%.2f ms)\n",
+			t.name, whereNames[t.where], stateNames[t.state], t.thread, ready, begin, end,
+			t.endUs > t.startUs ? (t.endUs - t.startUs) / 1000.0 : 0.0);
+	}
+}
@@ -0,0 +1,136 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: taskGraph.h
+// 
+// Desc: Startup work as a graph of tasks. A task runs once, after all the
+//       tasks it depends on have succeeded. Worker tasks are picked up by the
+//       graph's own threads as soon as they are ready. Main tasks (anything
+//       that calls the D3D device, which is not created multithreaded) wait
+//       for the main thread to call runMain() between frames, and events are
+//       completed from outside with signal(), e.g. once the device exists.
+//
+//       Unlike JobSystem nothing here blocks the caller, so the window keeps
+//       presenting frames while the graph fills in. Tasks and edges are added
+//       before start(); a graph runs once.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __taskGraphH__
+#define __taskGraphH__
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGraph
+{
+public:
+	// false fails the task, and every task that depends on it is skipped
+	typedef bool (*TaskFn)(void* ctx);
+
+	enum Where
+	{
+		ON_WORKER = 0,
+		ON_MAIN,                        // run by runMain()
+		ON_SIGNAL                       // no work; completed by signal()
+	};
+
+	enum State
+	{
+		TASK_WAITING = 0,
+		TASK_READY,
+		TASK_RUNNING,
+		TASK_DONE,
+		TASK_FAILED,
+		TASK_SKIPPED                    // a dependency failed, or the graph was stopped
+	};
+
+	// times are perf::nowMicroseconds(); 0 if it never got there
+	struct Timing
+	{
+		const char* name;
+		int         where;
+		int         state;
+		int         thread;             // 0 is the main thread, -1 if it never ran
+		uint64_t    readyUs;
+		uint64_t    startUs;
+		uint64_t    endUs;
+	};
+
+	TaskGraph(void);
+	~TaskGraph(void);
+
+	int  add(const char* name, TaskFn fn, void* ctx, int where = ON_WORKER);
+	int  addEvent(const char* name)     { return add(name, NULL, NULL, ON_SIGNAL); }
+	void depend(int task, int on);
+
+	// workers 0 leaves worker tasks to runMain() as well
+	bool start(int workers);
+
+	// runs ready main tasks until budgetUs has passed; at least one if any
+	// is ready. Returns how many ran.
+	int  runMain(uint64_t budgetUs);
+	void signal(int event, bool ok);
+
+	// runs main tasks and waits for workers until every task has finished;
+	// events have to be signalled first
+	void wait(void);
+
+	// skips whatever has not started and joins the workers
+	void stop(void);
+
+	bool isDone(int task) const;        // done, failed or skipped
+	bool succeeded(int task) const;
+	bool finished(void) const;          // every task is done, failed or skipped
+	int  firstFailure(void) const;      // -1 if nothing failed
+
+	int    taskCount(void) const        { return (int)m_tasks.size(); }
+	Timing timing(int task) const;
+
+	// one line per task, times relative to originUs
+	void print(FILE* fp, uint64_t originUs) const;
+
+private:
+	TaskGraph(const TaskGraph&);
+	TaskGraph& operator=(const TaskGraph&);
+
+	struct Task
+	{
+		const char*      name;
+		TaskFn           fn;
+		void*            ctx;
+		int              where;
+		int              state;
+		int              pending;       // dependencies not yet done
+		std::vector<int> dependents;
+		int              thread;
+		uint64_t         readyUs;
+		uint64_t         startUs;
+		uint64_t         endUs;
+	};
+
+	void makeReady(int task);           // with m_mutex held
+	void complete(int task, bool ok);   // with m_mutex held
+	void skip(int task);                // with m_mutex held
+	int  take(std::deque<int>& queue, int thread);  // with m_mutex held; -1 if none is ready
+	void workerLoop(int thread);
+
+	std::vector<Task>        m_tasks;
+	std::deque<int>          m_workerReady;
+	std::deque<int>          m_mainReady;
+	int                      m_unfinished;
+	int                      m_workerCount; // set before the threads exist; read under m_mutex
+	bool                     m_started;
+	bool                     m_quit;
+
+	std::vector<std::thread> m_workers;
+	mutable std::mutex       m_mutex;
+	std::condition_variable  m_wake;    // workers: something is ready, or quit
+	std::condition_variable  m_change;  // wait(): a task finished or main work is ready
+};
+
+#endif // __taskGraphH__
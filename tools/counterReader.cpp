@@ -0,0 +1,73 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: counterReader.cpp
+// 
+// Desc: Standalone console tool that tails the live counter file written by the
+//       game (see perfCounters.h). Build it next to the game sources, e.g.
+//
+//           cl /EHsc /I.. counterReader.cpp ..\perfCounters.cpp ..\mappedFile.cpp ..\memTrack.cpp
+//           g++ -O2 -I.. counterReader.cpp ../perfCounters.cpp ../mappedFile.cpp ../memTrack.cpp
+//
+//       usage: counterReader [counter file] [poll interval in microseconds]
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "perfCounters.h"
+#include "mappedFile.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static void printHeader(void)
+{
+	printf("%10s", "frame");
+	for (int i = 0; i < perf::COUNTER_COUNT; i++)
+		printf(" %15s", perf::counterNames[i]);
+	printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+	const char* path = argc > 1 ? argv[1] : "arkanoid.counters";
+	int intervalUs   = argc > 2 ? atoi(argv[2]) : 500;
+	if (intervalUs < 0) intervalUs = 0;
+
+	MappedFile file;
+	uint64_t lastFrame = 0;
+	int lines = 0;
+
+	for (;;) {
+		if (!file.isOpen()) {
+			if (!file.open(path, false, sizeof(perf::Segment))) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(250));
+				continue;
+			}
+			lastFrame = 0;
+		}
+
+		const perf::Segment* seg = static_cast<const perf::Segment*>(file.data());
+		if (!perf::isValid(seg)) {
+			// writer not started yet, or built with a different layout
+			file.close();
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+			continue;
+		}
+
+		perf::Snapshot snap;
+		if (perf::read(seg, snap) && snap.frame != lastFrame) {
+			if (lines++ % 40 == 0)
+				printHeader();
+			printf("%10llu", (unsigned long long)snap.frame);
+			for (int i = 0; i < perf::COUNTER_COUNT; i++)
+				printf(" %15llu", (unsigned long long)snap.values[i]);
+			printf("\n");
+			fflush(stdout);
+			lastFrame = snap.frame;
+		}
+
+		if (intervalUs > 0)
+			std::this_thread::sleep_for(std::chrono::microseconds(intervalUs));
+	}
+	return 0;
+}
@@ -0,0 +1,211 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: envBench.cpp
+// 
+// Desc: Drives the training environment (arkEnv.h) with a paddle that follows
+//       the red ball, reports world steps per second for batches of 1 to 1024
+//       worlds, and checks that a seed replays the same episodes on any number
+//       of threads and through a mapped observation file, and that NaN or
+//       infinite actions are ignored. Build it next to the game sources, e.g.
+//
+//           cl /O2 /EHsc /I.. envBench.cpp ..\arkEnv.cpp ..\level.cpp ..\gameWorld.cpp ..\distanceField.cpp ..\jobSystem.cpp ..\arena.cpp ..\memTrack.cpp ..\perfCounters.cpp ..\mappedFile.cpp
+//           g++ -O2 -I.. envBench.cpp ../arkEnv.cpp ../level.cpp ../gameWorld.cpp ../distanceField.cpp ../jobSystem.cpp ../arena.cpp ../memTrack.cpp ../perfCounters.cpp ../mappedFile.cpp -pthread
+//
+//       usage: envBench [-threads n] [-grid w h] [-level file]
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "arkEnv.h"
+#include "mappedFile.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static double nowSeconds(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void fnv(uint64_t& h, const void* data, size_t bytes)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < bytes; i++) {
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+}
+
+// everything a step writes, for comparing runs
+static uint64_t hashStep(const ArkEnvBuffers* b, uint64_t h)
+{
+	const ArkEnvHeader* hd = b->header;
+	size_t n = hd->envCount;
+	fnv(h, b->balls, sizeof(float) * 4 * hd->maxBalls * n);
+	fnv(h, b->ballActive, hd->maxBalls * n);
+	fnv(h, b->paddle, sizeof(float) * 4 * n);
+	fnv(h, b->alive, sizeof(uint32_t) * hd->aliveWords * n);
+	if (b->grid)
+		fnv(h, b->grid, (size_t)hd->gridW * hd->gridH * n);
+	fnv(h, b->reward, sizeof(float) * n);
+	fnv(h, b->done, n);
+	fnv(h, b->frame, sizeof(int32_t) * n);
+	return h;
+}
+
+// keep the white ball under the red one, with a little lag per world so the
+// batch doesn't play the same game everywhere
+static void follow(const ArkEnvBuffers* b, std::vector<ArkAction>& actions)
+{
+	const ArkEnvHeader* hd = b->header;
+	for (size_t i = 0; i < actions.size(); i++) {
+		const float* red = b->balls + i * hd->maxBalls * 4;
+		actions[i].paddleZ = red[1] - red[3] * 0.02f * (float)(i % 7);
+		actions[i].launch  = 1;
+	}
+}
+
+struct RunStats
+{
+	uint64_t hash;
+	double   seconds;      // in ark_env_step() only
+	long     episodes;
+	double   reward;
+};
+
+static bool run(const ArkEnvConfig& config, int steps, uint64_t seed, const char* mapPath, RunStats& out)
+{
+	ArkEnv* env = ark_env_create(&config);
+	if (env == NULL) {
+		fprintf(stderr, "can't create the environment\n");
+		return false;
+	}
+	if (mapPath && !ark_env_map(env, mapPath)) {
+		fprintf(stderr, "can't map '%s'\n", mapPath);
+		ark_env_destroy(env);
+		return false;
+	}
+
+	std::vector<ArkAction> actions(config.envCount);
+	const ArkEnvBuffers* b = ark_env_reset(env, seed);
+	out.hash     = hashStep(b, 14695981039346656037ull);
+	out.episodes = 0;
+	out.reward   = 0.0;
+	out.seconds  = 0.0;
+	for (int s = 0; s < steps; s++) {
+		follow(b, actions);
+		double t0 = nowSeconds();
+		b = ark_env_step(env, &actions[0]);
+		out.seconds += nowSeconds() - t0;
+		for (int i = 0; i < config.envCount; i++) {
+			out.reward += b->reward[i];
+			out.episodes += b->done[i] != ARK_DONE_NONE;
+		}
+		out.hash = hashStep(b, out.hash);
+	}
+
+	// another process sees the same block through the file
+	if (mapPath) {
+		MappedFile view;
+		const ArkEnvHeader* h = NULL;
+		if (view.open(mapPath, false))
+			h = static_cast<const ArkEnvHeader*>(view.data());
+		if (h == NULL || h->magic != ARK_ENV_MAGIC || h->steps != (uint64_t)steps ||
+			memcmp(static_cast<const char*>(view.data()) + h->rewardOffset, b->reward, sizeof(float) * config.envCount) != 0) {
+			printf("FAILED: the mapped file doesn't show the last step\n");
+			ark_env_destroy(env);
+			return false;
+		}
+	}
+	ark_env_destroy(env);
+	return true;
+}
+
+// every other step asks for NaN or an infinity; none of it may reach the
+// balls or the paddle
+static bool checkBadActions(ArkEnvConfig config)
+{
+	config.envCount = 4;
+	config.threads  = 1;
+	ArkEnv* env = ark_env_create(&config);
+	if (env == NULL)
+		return false;
+
+	const float bad[] = { NAN, INFINITY, -INFINITY };
+	std::vector<ArkAction> actions(config.envCount);
+	const ArkEnvBuffers* b = ark_env_reset(env, 5);
+	bool finite = true;
+	for (int s = 0; s < 2000 && finite; s++) {
+		follow(b, actions);
+		if (s & 1)
+			for (size_t i = 0; i < actions.size(); i++)
+				actions[i].paddleZ = bad[(s / 2 + i) % 3];
+		b = ark_env_step(env, &actions[0]);
+
+		const ArkEnvHeader* hd = b->header;
+		for (size_t i = 0; i < 4 * hd->maxBalls * hd->envCount; i++)
+			finite = finite && std::isfinite(b->balls[i]);
+		for (size_t i = 0; i < 4 * hd->envCount; i++)
+			finite = finite && std::isfinite(b->paddle[i]);
+	}
+	ark_env_destroy(env);
+	printf("NaN and inf actions %s\n", finite ? "ignored" : "LEAKED into the observations");
+	return finite;
+}
+
+int main(int argc, char* argv[])
+{
+	ArkEnvConfig config;
+	ark_env_default_config(&config);
+	config.maxFrames = 5000;
+	int threads = 1;
+	for (int a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "-threads") == 0 && a + 1 < argc)   threads = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-grid") == 0 && a + 2 < argc) { config.gridW = atoi(argv[++a]); config.gridH = atoi(argv[++a]); }
+		else if (strcmp(argv[a], "-level") == 0 && a + 1 < argc) config.levelPath = argv[++a];
+		else {
+			printf("usage: envBench [-threads n] [-grid w h] [-level file]\n");
+			return 2;
+		}
+	}
+
+	const int   batches[] = { 1, 64, 1024 };
+	const float FRAMES    = 2000000.0f;   // world steps per batch size
+	bool ok = true;
+	for (int k = 0; k < 3; k++) {
+		config.envCount = batches[k];
+		int steps = (int)(FRAMES / batches[k]);
+
+		RunStats single, pooled;
+		config.threads = 1;
+		if (!run(config, steps, 7, NULL, single))
+			return 1;
+		config.threads = threads;
+		if (!run(config, steps, 7, NULL, pooled))
+			return 1;
+
+		double frames = (double)steps * batches[k] * config.frameSkip;
+		printf("env  %4d worlds  %2d threads  %10.0f steps/s  (1 thread %10.0f)  %6ld episodes  reward %+.3f/episode  %s\n",
+			batches[k], threads, frames / pooled.seconds, frames / single.seconds, pooled.episodes,
+			pooled.episodes ? pooled.reward / pooled.episodes : 0.0, single.hash == pooled.hash ? "identical" : "DIFFERENT");
+		ok = ok && single.hash == pooled.hash;
+	}
+
+	// a seed replays, a different one doesn't, and the mapped block is the same
+	RunStats a, b, c;
+	config.envCount = 16;
+	config.threads  = threads;
+	if (!run(config, 3000, 99, NULL, a) || !run(config, 3000, 99, "envBench.obs", b) || !run(config, 3000, 100, NULL, c))
+		return 1;
+	remove("envBench.obs");
+	printf("seed 99 twice %s (mapped file), seed 100 %s\n",
+		a.hash == b.hash ? "identical" : "DIFFERENT", a.hash != c.hash ? "differs" : "IDENTICAL");
+	ok = ok && a.hash == b.hash && a.hash != c.hash;
+	ok = checkBadActions(config) && ok;
+
+	if (!ok)
+		printf("FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: mixBench.cpp
+// 
+// Desc: Headless checks and timings for the audio mixer: mix time per buffer
+//       as the number of playing voices grows, SSE against scalar output, and
+//       the command queue: sequenced commands through the ring in order,
+//       and the mixer's run/dropped accounting under a producer that never
+//       waits.
+//       Build it next to the game sources, e.g.
+//
+//           cl /O2 /EHsc /I.. mixBench.cpp ..\audioMixer.cpp ..\soundBank.cpp ..\arena.cpp ..\memTrack.cpp ..\mappedFile.cpp
+//           g++ -O2 -I.. mixBench.cpp ../audioMixer.cpp ../soundBank.cpp ../arena.cpp ../memTrack.cpp ../mappedFile.cpp -pthread
+//
+//       usage: mixBench [bank file] [-wav out.wav]
+//       The bank is (re)written with the game's sounds and then memory-mapped.
+//       The exit code is non-zero when a check fails.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "audioMixer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static const int RATE   = 44100;
+static const int FRAMES = 512;      // one buffer, about 11.6 ms
+
+static double nowSeconds(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static unsigned int s_rng = 12345;
+static float frand(float lo, float hi)
+{
+	s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+	return lo + (hi - lo) * ((s_rng & 0xffffff) / 16777216.0f);
+}
+
+// keeps every voice busy and asks for one more, so each buffer also steals one
+static void topUp(audio::AudioMixer& m, int voices)
+{
+	for (int i = m.activeVoices(); i <= voices; i++)
+		m.play(i % 4 == 0 ? audio::SOUND_HIT : audio::SOUND_GAME_OVER, frand(0.1f, 1.0f), frand(0.8f, 1.25f), frand(-1.0f, 1.0f));
+}
+
+static bool benchVoices(const audio::SoundBank& bank)
+{
+	const int COUNTS[] = { 1, 4, 16, 64, 128, 256 };
+	const int BUFFERS = 1000;
+	std::vector<int16_t> out(FRAMES * 2), ref(FRAMES * 2);
+	bool ok = true;
+
+	for (int c = 0; c < (int)(sizeof(COUNTS) / sizeof(COUNTS[0])); c++) {
+		int voices = COUNTS[c];
+		double t[2] = { 0.0, 0.0 };
+		bool same = true;
+
+		// same commands into both mixers, then compare every buffer
+		audio::AudioMixer simd, scalar;
+		if (!simd.init(&bank, RATE, voices, FRAMES, 0.25f) || !scalar.init(&bank, RATE, voices, FRAMES, 0.25f))
+			return false;
+		for (int b = 0; b < BUFFERS; b++) {
+			unsigned int seed = s_rng;
+			topUp(simd, voices);
+			s_rng = seed;
+			topUp(scalar, voices);
+
+			double t0 = nowSeconds();
+			simd.render(&out[0], FRAMES);
+			double t1 = nowSeconds();
+			scalar.renderScalar(&ref[0], FRAMES);
+			double t2 = nowSeconds();
+			t[0] += t1 - t0;
+			t[1] += t2 - t1;
+			if (memcmp(&out[0], &ref[0], out.size() * sizeof(int16_t)) != 0)
+				same = false;
+		}
+
+		double budget = (double)FRAMES / RATE;
+		printf("mix  %3d voices  sse %7.2f us/buffer (%5.2f%% of real time, %5.2f ns/voice-frame)   scalar %7.2f us/buffer   stolen %lu  %s\n",
+			voices, t[0] * 1e6 / BUFFERS, 100.0 * t[0] / BUFFERS / budget, t[0] * 1e9 / BUFFERS / FRAMES / voices,
+			t[1] * 1e6 / BUFFERS, simd.stolenVoices(), same ? "identical" : "DIFFERENT");
+		ok = ok && same;
+	}
+	return ok;
+}
+
+// command i carries i in every field, so a reordered, repeated, lost or torn
+// command shows up on the audio side
+static audio::Command sequenced(unsigned long i)
+{
+	audio::Command c;
+	c.type  = audio::COMMAND_PLAY;
+	c.sound = (int)i;
+	c.gain  = (float)(i & 0xffff);
+	c.pitch = (float)(i >> 16);
+	c.pan   = -c.gain;
+	return c;
+}
+
+static bool intact(const audio::Command& c, unsigned long i)
+{
+	audio::Command e = sequenced(i);
+	return c.type == e.type && c.sound == e.sound && c.gain == e.gain && c.pitch == e.pitch && c.pan == e.pan;
+}
+
+// the mixer's command ring between two threads. The producer waits for room
+// instead of dropping, so every command must arrive once, in order, whole.
+static bool checkQueueOrder(void)
+{
+	const unsigned long POSTS = 1000000;
+	audio::CommandQueue queue;
+
+	unsigned long full = 0;
+	std::thread producer([&]() {
+		for (unsigned long i = 0; i < POSTS; i++)
+			while (!queue.push(sequenced(i))) {
+				full++;
+				std::this_thread::yield();
+			}
+	});
+
+	unsigned long received = 0, bad = 0;
+	audio::Command c;
+	while (received < POSTS) {
+		if (!queue.pop(c)) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (!intact(c, received))
+			bad++;
+		received++;
+	}
+	producer.join();
+
+	bool ok = bad == 0 && queue.size() == 0;
+	printf("queue  %lu sequenced commands through the ring (%lu waits for room)  %lu out of order or torn  %s\n",
+		POSTS, full, bad, ok ? "ok" : "CORRUPT");
+	return ok;
+}
+
+// a game thread posting hits while the audio thread renders; every command
+// must either be run or be counted as dropped. Like the game, the producer
+// never retries a dropped command, but after a drop it holds off until the
+// next buffer has drained the queue, so most commands still get through.
+static bool checkQueue(const audio::SoundBank& bank)
+{
+	const unsigned long POSTS = 200000;
+	audio::AudioMixer m;
+	if (!m.init(&bank, RATE, 64, FRAMES, 0.25f))
+		return false;
+
+	std::atomic<bool> done(false);
+	std::atomic<int>  buffers(0);
+	double postTime = 0.0;
+	std::thread producer([&]() {
+		double t0 = nowSeconds();
+		for (unsigned long i = 0; i < POSTS; i++) {
+			if (m.play(audio::SOUND_HIT, 0.5f, 1.0f, 0.0f))
+				continue;
+			int seen = buffers.load();
+			while (buffers.load() == seen)
+				std::this_thread::yield();
+		}
+		postTime = nowSeconds() - t0;
+		done = true;
+	});
+
+	std::vector<int16_t> out(FRAMES * 2);
+	while (!done) {
+		m.render(&out[0], FRAMES);
+		buffers++;
+	}
+	producer.join();
+	m.render(&out[0], FRAMES);
+
+	unsigned long run = m.commandsRun(), dropped = m.droppedCommands();
+	bool ok = run + dropped == POSTS && run > POSTS / 2;
+	printf("queue  %lu posted (%.1f ns each)  %lu run  %lu dropped (queue full)  over %d buffers  %s\n",
+		POSTS, postTime * 1e9 / POSTS, run, dropped, buffers.load() + 1, ok ? "ok" : (run + dropped == POSTS ? "MOSTLY DROPPED" : "LOST COMMANDS"));
+	return ok;
+}
+
+// three seconds of a scripted rally, for listening
+static bool writeWav(const audio::SoundBank& bank, const char* path)
+{
+	audio::AudioMixer m;
+	if (!m.init(&bank, RATE, 32, FRAMES, 0.5f))
+		return false;
+
+	int total = RATE * 3 / FRAMES;
+	std::vector<int16_t> pcm(total * FRAMES * 2);
+	for (int b = 0; b < total; b++) {
+		if (b % 9 == 0) m.play(audio::SOUND_BOUNCE, 0.8f, 1.0f, frand(-1.0f, 1.0f));
+		if (b % 5 == 2) m.play(audio::SOUND_HIT, 0.6f, frand(0.9f, 1.3f), frand(-1.0f, 1.0f));
+		if (b == total - 110) m.play(audio::SOUND_GAME_OVER, 1.0f, 1.0f, 0.0f);
+		m.render(&pcm[b * FRAMES * 2], FRAMES);
+	}
+
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return false;
+	uint32_t bytes = (uint32_t)(pcm.size() * sizeof(int16_t));
+	uint32_t header[11] = { 0x46464952, 36 + bytes, 0x45564157, 0x20746d66, 16, 0x00020001,
+		(uint32_t)RATE, (uint32_t)RATE * 4, 0x00100004, 0x61746164, bytes };   // RIFF/WAVE, PCM 16-bit stereo
+	fwrite(header, sizeof(header), 1, fp);
+	fwrite(&pcm[0], bytes, 1, fp);
+	fclose(fp);
+	printf("wrote %s\n", path);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* bankPath = "mixBench.bank";
+	const char* wavPath  = NULL;
+	for (int a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "-wav") == 0 && a + 1 < argc) wavPath  = argv[++a];
+		else                                                bankPath = argv[a];
+	}
+
+	audio::SoundBank bank;
+	if (!audio::writeDefaultSoundBank(bankPath, 22050) || !bank.open(bankPath)) {
+		printf("can't write or map the sound bank '%s'\n", bankPath);
+		return 1;
+	}
+	for (int i = 0; i < bank.soundCount(); i++)
+		printf("bank  sound %d  %6d frames at %d Hz (mapped)\n", i, bank.sound(i).frames, bank.sound(i).sampleRate);
+
+	bool ok = benchVoices(bank);
+	ok = checkQueueOrder() && ok;
+	ok = checkQueue(bank) && ok;
+	if (wavPath)
+		ok = writeWav(bank, wavPath) && ok;
+	return ok ? 0 : 1;
+}
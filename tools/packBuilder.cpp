@@ -0,0 +1,255 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: packBuilder.cpp
+// 
+// Desc: Generates target layouts in the shell of the built-in level (its
+//       walls, exit and paddle), checks them on every thread of a JobSystem
+//       and writes the ones that pass into a level pack (see level.h).
+//       Layout i of a run only depends on the seed and i, and passing ones
+//       are written in index order, so the pack is the same for any number
+//       of threads; the builder checks that against a single-threaded run.
+//       Build it next to the game sources, e.g.
+//
+//           cl /O2 /EHsc /I.. packBuilder.cpp ..\levelGen.cpp ..\level.cpp ..\gameWorld.cpp ..\distanceField.cpp ..\jobSystem.cpp ..\arena.cpp ..\memTrack.cpp ..\perfCounters.cpp ..\mappedFile.cpp
+//           g++ -O2 -I.. packBuilder.cpp ../levelGen.cpp ../level.cpp ../gameWorld.cpp ../distanceField.cpp ../jobSystem.cpp ../arena.cpp ../memTrack.cpp ../perfCounters.cpp ../mappedFile.cpp -pthread
+//
+//       usage: packBuilder <out.pack> [-count n] [-threads n] [-seed s] [-density lo hi]
+//              packBuilder check [pack | level]
+//       check runs the rules over every level of a pack (*.pack), a level
+//       file, or the built-in layout, and exits with 1 if any of them fails.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "levelGen.h"
+#include "jobSystem.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// candidates generated and checked per parallelFor()
+static const int BATCH = 1024;
+
+static double nowSeconds(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct BuildOptions
+{
+	int      count;
+	int      threads;
+	uint32_t seed;
+	float    minDensity, maxDensity;
+};
+
+struct BuildStats
+{
+	int    generated;
+	int    faults[sim::LAYOUT_FAULT_COUNT];    // of the candidates up to the last one written
+	double seconds;     // generating and checking only
+};
+
+// one batch of candidate slots; levels and checkers are kept between batches
+struct Batch
+{
+	const BuildOptions*            options;
+	const sim::Level*              shell;
+	int                            first;       // index of slot 0 in the run
+	sim::LayoutParams              params[BATCH];
+	int                            fault[BATCH];
+	std::vector<sim::Level>        levels;
+	std::vector<sim::LayoutChecker> checkers;   // one per thread
+};
+
+static void checkRange(void* ctx, int begin, int end, int thread)
+{
+	Batch* b = static_cast<Batch*>(ctx);
+	sim::LayoutChecker& checker = b->checkers[thread];
+	for (int i = begin; i < end; i++) {
+		b->params[i] = sim::layoutParams(b->options->seed, b->first + i, b->options->minDensity, b->options->maxDensity);
+		sim::generateLayout(b->params[i], *b->shell, b->levels[i]);
+		b->fault[i] = checker.check(b->levels[i]);
+	}
+}
+
+static bool build(const char* path, const BuildOptions& options, BuildStats& stats)
+{
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "can't write '%s'\n", path);
+		return false;
+	}
+	JobSystem jobs;
+	if (!jobs.start(options.threads)) {
+		fclose(fp);
+		return false;
+	}
+
+	sim::Level shell;
+	sim::defaultLevel(shell);
+
+	Batch* b = new Batch;
+	b->options = &options;
+	b->shell   = &shell;
+	b->levels.resize(BATCH);
+	b->checkers.resize(jobs.threadCount());
+	for (size_t t = 0; t < b->checkers.size(); t++)
+		b->checkers[t].init(256, sim::defaultLayoutRules());
+
+	memset(&stats, 0, sizeof(stats));
+	fprintf(fp, "# packBuilder seed %u density %.3g %.3g\n", options.seed, options.minDensity, options.maxDensity);
+
+	// give up on ranges where hardly anything passes
+	int written = 0;
+	bool ok = true;
+	while (ok && written < options.count && stats.generated < options.count * 100) {
+		b->first = stats.generated;
+		double t0 = nowSeconds();
+		jobs.parallelFor(BATCH, 16, checkRange, b);
+		stats.seconds += nowSeconds() - t0;
+		stats.generated += BATCH;
+
+		for (int i = 0; i < BATCH && written < options.count; i++) {
+			stats.faults[b->fault[i]]++;
+			if (b->fault[i] != sim::LAYOUT_OK)
+				continue;
+			const sim::LayoutParams& p = b->params[i];
+			fprintf(fp, "level %d  # %s %s density %.3f candidate %d\n", written, sim::layoutPatternNames[p.pattern],
+				sim::layoutSymmetryNames[p.symmetry], p.density, b->first + i);
+			ok = sim::writeLevel(fp, b->levels[i]);
+			written++;
+		}
+	}
+	delete b;
+	jobs.stop();
+	if (fclose(fp) != 0 || !ok) {
+		fprintf(stderr, "can't write '%s'\n", path);
+		return false;
+	}
+	if (written < options.count)
+		fprintf(stderr, "only %d of %d layouts passed\n", written, options.count);
+	return true;
+}
+
+static bool sameFile(const char* a, const char* b)
+{
+	FILE* fa = fopen(a, "rb");
+	FILE* fb = fopen(b, "rb");
+	bool same = fa && fb;
+	while (same) {
+		int ca = fgetc(fa), cb = fgetc(fb);
+		same = ca == cb;
+		if (ca == EOF)
+			break;
+	}
+	if (fa) fclose(fa);
+	if (fb) fclose(fb);
+	return same;
+}
+
+static int check(const char* path)
+{
+	std::vector<sim::Level> levels;
+	if (path == NULL) {
+		levels.resize(1);
+		sim::defaultLevel(levels[0]);
+	}
+	else {
+		size_t n = strlen(path);
+		bool loaded;
+		if (n > 5 && strcmp(path + n - 5, ".pack") == 0)
+			loaded = sim::loadLevelPack(path, levels);
+		else {
+			levels.resize(1);
+			loaded = sim::loadLevelFile(path, levels[0]);
+		}
+		if (!loaded) {
+			fprintf(stderr, "can't load '%s'\n", path);
+			return 1;
+		}
+	}
+
+	sim::LayoutChecker checker;
+	checker.init(256, sim::defaultLayoutRules());
+	int failed = 0;
+	for (size_t i = 0; i < levels.size(); i++) {
+		int a, b;
+		int fault = checker.check(levels[i], &a, &b);
+		if (fault == sim::LAYOUT_OK)
+			continue;
+		failed++;
+		printf("level %d: %s", (int)i, sim::layoutFaultNames[fault]);
+		if (a >= 0) printf(", target %d", a);
+		if (b >= 0) printf(" and %d", b);
+		printf("\n");
+	}
+	printf("%d of %d levels pass\n", (int)levels.size() - failed, (int)levels.size());
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc >= 2 && strcmp(argv[1], "check") == 0)
+		return check(argc >= 3 ? argv[2] : NULL);
+
+	BuildOptions options;
+	options.count      = 1000;
+	options.threads    = JobSystem::hardwareThreads();
+	options.seed       = 1;
+	options.minDensity = 0.15f;
+	options.maxDensity = 0.45f;
+	const char* out = argc >= 2 ? argv[1] : NULL;
+	for (int a = 2; a < argc; a++) {
+		if (strcmp(argv[a], "-count") == 0 && a + 1 < argc)          options.count   = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-threads") == 0 && a + 1 < argc)   options.threads = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-seed") == 0 && a + 1 < argc)      options.seed    = (uint32_t)strtoul(argv[++a], NULL, 10);
+		else if (strcmp(argv[a], "-density") == 0 && a + 2 < argc) { options.minDensity = (float)atof(argv[++a]); options.maxDensity = (float)atof(argv[++a]); }
+		else
+			out = NULL;
+	}
+	if (out == NULL || out[0] == '-') {
+		printf("usage: packBuilder <out.pack> [-count n] [-threads n] [-seed s] [-density lo hi]\n");
+		printf("       packBuilder check [pack | level]\n");
+		return 2;
+	}
+
+	BuildStats stats;
+	if (!build(out, options, stats))
+		return 1;
+	printf("%d layouts generated and checked on %d threads  %.0f layouts/s\n", stats.generated, options.threads, stats.generated / stats.seconds);
+	for (int f = 0; f < sim::LAYOUT_FAULT_COUNT; f++)
+		printf("  %-14s %6d\n", sim::layoutFaultNames[f], stats.faults[f]);
+
+	// the same run on one thread has to write the same pack
+	bool ok = true;
+	if (options.threads > 1) {
+		std::string single = std::string(out) + ".1";
+		BuildOptions one = options;
+		one.threads = 1;
+		BuildStats oneStats;
+		if (!build(single.c_str(), one, oneStats))
+			return 1;
+		ok = sameFile(out, single.c_str());
+		remove(single.c_str());
+		printf("1 thread %.0f layouts/s, pack %s\n", oneStats.generated / oneStats.seconds, ok ? "identical" : "DIFFERENT");
+	}
+
+	// how the built-in layout fares against the same rules
+	sim::Level builtIn;
+	sim::defaultLevel(builtIn);
+	sim::LayoutChecker checker;
+	checker.init(256, sim::defaultLayoutRules());
+	int a, b;
+	int fault = checker.check(builtIn, &a, &b);
+	printf("built-in layout: %s", sim::layoutFaultNames[fault]);
+	if (a >= 0) printf(", target %d", a);
+	if (b >= 0) printf(" and %d", b);
+	printf("\n");
+
+	if (!ok)
+		printf("FAILED\n");
+	return ok ? 0 : 1;
+}
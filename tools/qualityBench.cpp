@@ -0,0 +1,219 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: qualityBench.cpp
+// 
+// Desc: Runs the quality governor (see qualityGovernor.h) against a simulated
+//       clock instead of a window. Each frame's length comes from a cost model
+//       of the game: a fixed part, the physics substeps, the live debris, a
+//       draw call and the vertices for every target, and the fill at the
+//       current resolution. It is all scaled by how fast the machine is, and a
+//       little noise and the odd hitch are added on top. The clock is advanced
+//       by that much, and the governor gets the frame measured on the clock the
+//       way Display() measures it.
+//
+//       Every scenario checks that the governor settles under the budget and
+//       then stays still. A load that jumps has to be brought back within a
+//       few seconds. Build it next to the game sources, e.g.
+//
+//           cl /O2 /EHsc /I.. qualityBench.cpp ..\qualityGovernor.cpp
+//           g++ -O2 -I.. qualityBench.cpp ../qualityGovernor.cpp
+//
+//       usage: qualityBench [-budget ms] [-v] [scenario ...]   (no names runs all)
+//       -v prints a timeline and the governor's decisions. The exit code is
+//       non-zero when a check fails.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "qualityGovernor.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// faces of the target mesh at each LOD: 50, 30, 18 and 10 slices and stacks
+static const float s_lodFaces[4] = { 4900.0f, 1740.0f, 612.0f, 180.0f };
+
+struct Load
+{
+	int   targets;                  // drawn every frame
+	int   debris;                   // what the level throws up, before the budget
+	float machine;                  // 1 is a mid-range PC; a kiosk is slower
+};
+
+struct Scenario
+{
+	const char* name;
+	const char* desc;
+	int         frames;
+	Load        load;
+	int         stepFrame;          // 0, or the frame 'step' takes over
+	Load        step;
+	int         hitchEvery;         // frames; 0 for none
+	float       hitchMs;
+	int         expect;             // EXPECT_*
+};
+
+enum
+{
+	EXPECT_ANY = 0,
+	EXPECT_LOWER,                   // ends below the game's old fixed settings
+	EXPECT_TOP                      // ends at the top of the ladder
+};
+
+static const Scenario s_scenarios[] = {
+	{ "kiosk",   "slow machine, dense level",                      3000, { 400,  60000, 1.6f },     0, { 0, 0, 0.0f },       0,   0.0f, EXPECT_LOWER },
+	{ "strong",  "fast machine, light level",                      3000, { 100,  20000, 0.5f },     0, { 0, 0, 0.0f },       0,   0.0f, EXPECT_TOP },
+	{ "wave",    "light level, then a dense wave at frame 1500",   4000, { 100,  10000, 1.0f },  1500, { 800, 80000, 1.0f }, 0,   0.0f, EXPECT_ANY },
+	{ "hitches", "steady load with a 250 ms hitch every 300",      3000, { 200,  30000, 1.0f },     0, { 0, 0, 0.0f },     300, 250.0f, EXPECT_ANY },
+	{ "between", "budget falls between two levels",                12000, { 1600, 50000, 0.41f },   0, { 0, 0, 0.0f },       0,   0.0f, EXPECT_ANY },
+};
+
+// the game's frame, in ms, at these settings
+static float frameCost(const Load& l, const QualitySettings& q)
+{
+	int   lod = q.sphereLodBias < 3 ? q.sphereLodBias : 3;
+	int   live = l.debris < q.particleBudget ? l.debris : q.particleBudget;
+	float ms = 1.5f                                             // input, audio commands, Present
+		+ q.substeps * (0.2f + l.targets * 0.0008f)             // a step: the grid, the hits, the moves
+		+ live * 0.00004f                                       // update, copy and draw a particle
+		+ l.targets * (0.01f + s_lodFaces[lod] * 0.0000015f)    // a draw call and its vertices
+		+ 5.0f * q.resolutionScale * q.resolutionScale;         // clear and fill at 1024x768
+	return ms * l.machine;
+}
+
+// the simulated clock; the game reads a real one between Display() calls
+struct SimClock
+{
+	uint64_t nowUs;
+	void advance(float ms) { nowUs += (uint64_t)(ms * 1000.0f); }
+};
+
+static unsigned int s_rng;
+static float noise(float amount)
+{
+	s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+	return 1.0f + amount * ((s_rng & 0xffff) / 32768.0f - 1.0f);
+}
+
+struct Result
+{
+	float overPct;                  // frames over budget once settled
+	float fixedOverPct;             // the same frames at the old fixed settings
+	float averageMs;                // once settled
+	int   changes;                  // in all
+	int   lateChanges;              // in the last third
+	int   recoverFrames;            // after the wave, until the average is back under; -1 if never
+	int   level;
+};
+
+static bool runScenario(const Scenario& s, float budgetMs, bool verbose)
+{
+	QualityGovernor gov;
+	gov.init(QualityGovernor::defaultConfig(budgetMs));
+
+	SimClock clock = { 0 };
+	uint64_t last = 0;
+	s_rng = 2463534242u;
+
+	// the first half of each load is the governor finding its level
+	int settle = s.stepFrame ? s.stepFrame + (s.frames - s.stepFrame) / 2 : s.frames / 2;
+	int late = s.frames - s.frames / 3;
+	int settled = 0, over = 0, fixedOver = 0, lateChanges = 0;
+	double settledMs = 0.0;
+	Result r;
+	r.recoverFrames = s.stepFrame ? -1 : 0;
+
+	if (verbose)
+		printf("  %8s %8s %8s %6s\n", "frame", "ms", "average", "level");
+	for (int f = 0; f < s.frames; f++) {
+		const Load& load = s.stepFrame && f >= s.stepFrame ? s.step : s.load;
+		float n = noise(0.04f);
+		float ms = frameCost(load, gov.settings()) * n;
+		if (s.hitchEvery && f % s.hitchEvery == s.hitchEvery - 1)
+			ms += s.hitchMs;
+		clock.advance(ms);
+
+		// measured from one frame to the next
+		float measured = (clock.nowUs - last) / 1000.0f;
+		last = clock.nowUs;
+		int before = gov.changes();
+		gov.update(measured);
+		if (f >= late && gov.changes() != before)
+			lateChanges++;
+
+		if (r.recoverFrames < 0 && f > s.stepFrame + 10 && gov.smoothedMs() < budgetMs)
+			r.recoverFrames = f - s.stepFrame;
+		if (f >= settle) {
+			settled++;
+			settledMs += measured;
+			if (measured > budgetMs) over++;
+			if (frameCost(load, QualityGovernor::ladder(QualityGovernor::DEFAULT_LEVEL)) * n > budgetMs) fixedOver++;
+		}
+		if (verbose && f % 100 == 0)
+			printf("  %8d %8.2f %8.2f %6d\n", f, measured, gov.smoothedMs(), gov.level());
+	}
+
+	r.overPct      = 100.0f * over / settled;
+	r.fixedOverPct = 100.0f * fixedOver / settled;
+	r.averageMs    = (float)(settledMs / settled);
+	r.changes      = gov.changes();
+	r.lateChanges  = lateChanges;
+	r.level        = gov.level();
+	if (verbose)
+		gov.print(stdout);
+
+	// the hitches are over budget whatever the level
+	float allowed = 5.0f + (s.hitchEvery ? 100.0f / s.hitchEvery : 0.0f);
+	bool ok = r.overPct <= allowed && r.lateChanges <= 1;
+	if (s.stepFrame)
+		ok = ok && r.recoverFrames >= 0 && r.recoverFrames <= 300;
+	if (s.expect == EXPECT_LOWER)
+		ok = ok && r.level < QualityGovernor::DEFAULT_LEVEL;
+	if (s.expect == EXPECT_TOP)
+		ok = ok && r.level == QualityGovernor::LEVEL_COUNT - 1;
+
+	printf("%-8s level %d  average %6.2f ms  over budget %5.1f%% (fixed settings %5.1f%%)  %2d changes, %d late",
+		s.name, r.level, r.averageMs, r.overPct, r.fixedOverPct, r.changes, r.lateChanges);
+	if (s.stepFrame)
+		printf("  back under in %d frames", r.recoverFrames);
+	printf("  %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static int usage(void)
+{
+	printf("usage: qualityBench [-budget ms] [-v] [scenario ...]\n");
+	return 2;
+}
+
+int main(int argc, char* argv[])
+{
+	float budgetMs = 16.6f;
+	bool  verbose = false;
+	const char* names[16];
+	int   nameCount = 0;
+	for (int a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "-budget") == 0 && a + 1 < argc) budgetMs = (float)atof(argv[++a]);
+		else if (strcmp(argv[a], "-v") == 0)                 verbose = true;
+		else if (argv[a][0] == '-' || nameCount == 16)       return usage();
+		else                                                 names[nameCount++] = argv[a];
+	}
+	if (budgetMs <= 0.0f)
+		return usage();
+
+	printf("budget %.1f ms\n", budgetMs);
+	const int count = sizeof(s_scenarios) / sizeof(s_scenarios[0]);
+	int failed = 0;
+	for (int i = 0; i < count; i++) {
+		bool selected = nameCount == 0;
+		for (int n = 0; n < nameCount; n++)
+			if (strcmp(names[n], s_scenarios[i].name) == 0) selected = true;
+		if (!selected)
+			continue;
+		if (verbose)
+			printf("%s: %s\n", s_scenarios[i].name, s_scenarios[i].desc);
+		if (!runScenario(s_scenarios[i], budgetMs, verbose))
+			failed++;
+	}
+	return failed ? 1 : 0;
+}
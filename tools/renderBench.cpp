@@ -0,0 +1,404 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: renderBench.cpp
+// 
+// Desc: Counts the device calls of a frame of the game without a window, the
+//       way Display() drew before the render cache (see renderCache.h) and
+//       the way it draws now. The old frame is replayed call for call: a
+//       SetTransform, a MultiplyTransform and a SetMaterial for every object,
+//       with the brick matrices made again each frame. The new one goes
+//       through a RenderStateCache with the world matrices made when the
+//       level loads. Both go into a backend that only counts, and a second
+//       run records every world matrix that reaches the device, so the two
+//       frames can be checked to put everything in the same place.
+//
+//       Each level is drawn with the parent still, as the game has it, and
+//       with the parent turning every frame, which remakes every world matrix.
+//       Build it next to the game sources, e.g.
+//
+//           cl /O2 /EHsc /I.. renderBench.cpp ..\renderCache.cpp ..\level.cpp ..\memTrack.cpp
+//           g++ -O2 -I.. renderBench.cpp ../renderCache.cpp ../level.cpp ../memTrack.cpp
+//
+//       usage: renderBench [-frames n] [-targets n ...]
+//       -targets replaces the built-in level and the two rooms of 1000 and
+//       10000 targets with rooms of the sizes given. The exit code is
+//       non-zero when a check fails.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "renderCache.h"
+#include "level.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// what virtualLego.cpp uses
+static const float BALL_RADIUS  = 0.21f;
+static const float BRICK_HEIGHT = 0.12f;
+static const int   RS_LIGHTING  = 137;      // D3DRS_LIGHTING
+static const int   RS_POINTSIZE = 154;      // D3DRS_POINTSIZE
+static const int   DEBRIS_FVF   = 0x042;    // D3DFVF_XYZ | D3DFVF_DIFFUSE
+
+static double nowSeconds(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static unsigned int s_rng;
+static float frand(float lo, float hi)
+{
+	s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+	return lo + (hi - lo) * ((s_rng & 0xffffff) / 16777216.0f);
+}
+
+// a square room with 'targets' spheres on a jittered grid and a brick for every tenth
+static void roomLevel(sim::Level& level, int targets)
+{
+	int   side = (int)std::ceil(std::sqrt((float)targets));
+	float h = side * 0.25f + 1.0f;
+
+	level.clear();
+	s_rng = 4242u + (unsigned)targets;
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h, h), sim::toVec2(h, h + 0.12f)));
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h, -h - 0.12f), sim::toVec2(h, -h)));
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h - 0.12f, -h - 0.12f), sim::toVec2(-h, h + 0.12f)));
+	for (int i = 0; i < targets; i++)
+		level.spheres.push_back(sim::toVec2(-h + 0.5f + (i % side) * 0.5f + frand(-0.03f, 0.03f),
+			-h + 1.0f + (i / side) * 0.5f + frand(-0.03f, 0.03f)));
+	for (int i = 0; i < targets / 10; i++) {
+		float x = frand(-h + 0.5f, h - 0.5f), z = frand(-h + 0.5f, h - 0.5f);
+		level.bricks.push_back(sim::boxAt(sim::Scalar(x), sim::Scalar(z), sim::Scalar(0.4f), sim::Scalar(0.2f)));
+	}
+}
+
+static void boxTransform(gfx::Matrix& out, const sim::Aabb& box, float y)
+{
+	gfx::scaling(out, sim::toFloat(box.hi.x - box.lo.x), 1.0f, sim::toFloat(box.hi.z - box.lo.z));
+	out.m[3][0] = sim::toFloat((box.lo.x + box.hi.x) * sim::Scalar(0.5f));
+	out.m[3][1] = y;
+	out.m[3][2] = sim::toFloat((box.lo.z + box.hi.z) * sim::Scalar(0.5f));
+}
+
+// a turn about y, as a mouse drag would give the world
+static void turn(gfx::Matrix& out, float angle)
+{
+	out = gfx::identity();
+	out.m[0][0] = std::cos(angle);  out.m[0][2] = -std::sin(angle);
+	out.m[2][0] = std::sin(angle);  out.m[2][2] = std::cos(angle);
+}
+
+// what the game draws, with every local matrix made the way Display() makes it
+struct Scene
+{
+	std::vector<gfx::Matrix>      locals;       // plane, walls, balls, targets, bricks
+	std::vector<int>              material;     // index into 'materials'
+	std::vector<gfx::WorldMatrix> worlds;       // the same objects, for the cache
+	gfx::Material                 materials[5]; // plane, wall, target, brick, ball
+	gfx::Light                    light;
+	float                         debris[3 * 64];
+	int                           targets;
+	int                           bricks;
+};
+
+enum { MTRL_PLANE = 0, MTRL_WALL, MTRL_TARGET, MTRL_BRICK, MTRL_BALL };
+
+static void addObject(Scene& s, const gfx::Matrix& local, int material)
+{
+	gfx::WorldMatrix w;
+	w.init();
+	w.setLocal(local);
+	s.locals.push_back(local);
+	s.material.push_back(material);
+	s.worlds.push_back(w);
+}
+
+static void makeScene(Scene& s, const sim::Level& level)
+{
+	gfx::Matrix m;
+	size_t i;
+	memset(s.materials, 0, sizeof(s.materials));
+	for (i = 0; i < 5; i++) {
+		s.materials[i].diffuse[0] = s.materials[i].ambient[0] = 0.2f * (i + 1);
+		s.materials[i].power = 5.0f;
+	}
+	memset(&s.light, 0, sizeof(s.light));
+	s.light.type = 1;
+	s.light.position[1] = 3.0f;
+	memset(s.debris, 0, sizeof(s.debris));
+
+	gfx::translation(m, 0.0f, -0.0006f / 5, 0.0f);
+	addObject(s, m, MTRL_PLANE);
+	for (i = 0; i < level.walls.size() && i < 3; i++) {
+		const sim::Aabb& w = level.walls[i];
+		gfx::translation(m, sim::toFloat((w.lo.x + w.hi.x) * sim::Scalar(0.5f)), 0.12f, sim::toFloat((w.lo.z + w.hi.z) * sim::Scalar(0.5f)));
+		addObject(s, m, MTRL_WALL);
+	}
+	for (i = 0; i < 2; i++) {
+		gfx::translation(m, 4.0f, 0.5f, -1.0f + 2.0f * i);
+		addObject(s, m, MTRL_BALL);
+	}
+	for (i = 0; i < level.spheres.size(); i++) {
+		gfx::translation(m, sim::toFloat(level.spheres[i].x), BALL_RADIUS, sim::toFloat(level.spheres[i].z));
+		addObject(s, m, MTRL_TARGET);
+	}
+	for (i = 0; i < level.bricks.size(); i++) {
+		boxTransform(m, level.bricks[i], BRICK_HEIGHT);
+		addObject(s, m, MTRL_BRICK);
+	}
+	s.targets = (int)level.spheres.size();
+	s.bricks  = (int)level.bricks.size();
+}
+
+// the frame as Display() drew it before: the runtime multiplies every object's
+// local matrix onto the world matrix it was just given
+static void drawOld(const gfx::RenderBackend& b, const Scene& s, const gfx::Matrix& parent, int& multiplies)
+{
+	float size = 3.0f;
+	uint32_t pointSize;
+	memcpy(&pointSize, &size, sizeof(pointSize));
+	int first = 4 + 2, brick = first + s.targets;
+	for (size_t i = 0; i < s.locals.size(); i++) {
+		gfx::Matrix l = s.locals[i];
+		if ((int)i >= brick) {
+			gfx::Matrix sc, t;
+			gfx::scaling(sc, l.m[0][0], 1.0f, l.m[2][2]);
+			gfx::translation(t, l.m[3][0], l.m[3][1], l.m[3][2]);
+			gfx::multiply(l, sc, t);            // CWall::setBox() for every live brick
+			multiplies++;
+		}
+		b.setTransform(b.ctx, gfx::TRANSFORM_WORLD, parent);
+		b.multiplyTransform(b.ctx, gfx::TRANSFORM_WORLD, l);
+		multiplies++;
+		b.setMaterial(b.ctx, s.materials[s.material[i]]);
+		b.drawMesh(b.ctx, NULL);
+	}
+
+	b.setTransform(b.ctx, gfx::TRANSFORM_WORLD, parent);
+	b.setRenderState(b.ctx, RS_LIGHTING, 0);
+	b.setRenderState(b.ctx, RS_POINTSIZE, pointSize);
+	b.setFVF(b.ctx, DEBRIS_FVF);
+	b.drawPoints(b.ctx, s.debris, 64, 3 * sizeof(float));
+	b.setRenderState(b.ctx, RS_LIGHTING, 1);
+
+	gfx::Matrix marker;
+	gfx::translation(marker, s.light.position[0], s.light.position[1], s.light.position[2]);
+	b.setTransform(b.ctx, gfx::TRANSFORM_WORLD, marker);
+	b.setMaterial(b.ctx, s.materials[MTRL_BALL]);
+	b.drawMesh(b.ctx, NULL);
+}
+
+// the frame as Display() draws it now
+static void drawNew(gfx::RenderStateCache& rs, Scene& s, const gfx::ParentMatrix& parent)
+{
+	float size = 3.0f;
+	uint32_t pointSize;
+	memcpy(&pointSize, &size, sizeof(pointSize));
+	rs.updateWorlds(&s.worlds[0], (int)s.worlds.size(), parent);
+	rs.setLight(0, s.light);
+	rs.lightEnable(0, true);
+	for (size_t i = 0; i < s.worlds.size(); i++) {
+		rs.setTransform(gfx::TRANSFORM_WORLD, s.worlds[i].world);
+		rs.setMaterial(s.materials[s.material[i]]);
+		rs.drawMesh(NULL);
+	}
+
+	rs.setTransform(gfx::TRANSFORM_WORLD, parent.m);
+	rs.setRenderState(RS_LIGHTING, 0);
+	rs.setRenderState(RS_POINTSIZE, pointSize);
+	rs.setFVF(DEBRIS_FVF);
+	rs.drawPoints(s.debris, 64, 3 * sizeof(float));
+	rs.setRenderState(RS_LIGHTING, 1);
+
+	gfx::Matrix marker;
+	gfx::translation(marker, s.light.position[0], s.light.position[1], s.light.position[2]);
+	rs.setTransform(gfx::TRANSFORM_WORLD, marker);
+	rs.setMaterial(s.materials[MTRL_BALL]);
+	rs.drawMesh(NULL);
+}
+
+//
+// A backend that keeps the world matrix each draw would use, for the check
+//
+
+struct Recorder
+{
+	gfx::Matrix              current;
+	std::vector<gfx::Matrix> draws;
+};
+
+static void recSetTransform(void* ctx, int state, const gfx::Matrix& m)
+{
+	if (state == gfx::TRANSFORM_WORLD) ((Recorder*)ctx)->current = m;
+}
+static void recMultiplyTransform(void* ctx, int state, const gfx::Matrix& m)
+{
+	Recorder* r = (Recorder*)ctx;
+	gfx::Matrix out;
+	if (state != gfx::TRANSFORM_WORLD) return;
+	gfx::multiply(out, m, r->current);      // what the runtime does: m * current
+	r->current = out;
+}
+static void recSetMaterial(void*, const gfx::Material&)    {}
+static void recSetLight(void*, int, const gfx::Light&)     {}
+static void recLightEnable(void*, int, bool)               {}
+static void recSetRenderState(void*, int, uint32_t)        {}
+static void recSetFVF(void*, uint32_t)                     {}
+static void recDrawMesh(void* ctx, void*)                  { ((Recorder*)ctx)->draws.push_back(((Recorder*)ctx)->current); }
+static void recDrawPoints(void* ctx, const void*, int, int) { ((Recorder*)ctx)->draws.push_back(((Recorder*)ctx)->current); }
+
+static gfx::RenderBackend recordingBackend(Recorder* r)
+{
+	gfx::RenderBackend b;
+	b.ctx               = r;
+	b.setTransform      = recSetTransform;
+	b.multiplyTransform = recMultiplyTransform;
+	b.setMaterial       = recSetMaterial;
+	b.setLight          = recSetLight;
+	b.lightEnable       = recLightEnable;
+	b.setRenderState    = recSetRenderState;
+	b.setFVF            = recSetFVF;
+	b.drawMesh          = recDrawMesh;
+	b.drawPoints        = recDrawPoints;
+	r->current = gfx::identity();
+	return b;
+}
+
+// both frames put every draw in the same place, up to float rounding
+static float placementError(Scene& s, const gfx::ParentMatrix& parent)
+{
+	Recorder oldFrame, newFrame;
+	int multiplies = 0;
+	drawOld(recordingBackend(&oldFrame), s, parent.m, multiplies);
+
+	gfx::RenderStateCache rs;
+	rs.init(recordingBackend(&newFrame));
+	drawNew(rs, s, parent);
+
+	if (oldFrame.draws.size() != newFrame.draws.size())
+		return 1e30f;
+	float worst = 0.0f;
+	for (size_t i = 0; i < oldFrame.draws.size(); i++)
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++) {
+				float d = std::fabs(oldFrame.draws[i].m[r][c] - newFrame.draws[i].m[r][c]);
+				if (d > worst) worst = d;
+			}
+	return worst;
+}
+
+static void printCalls(const char* name, const gfx::CallCounts& c, int frames)
+{
+	printf("    %-4s", name);
+	for (int k = 0; k < gfx::CALL_KIND_COUNT; k++)
+		printf(" %9.1f", (double)c.calls[k] / frames);
+	printf(" %9.1f\n", (double)c.total() / frames);
+}
+
+static bool runLevel(const char* name, const sim::Level& level, int frames, bool moving)
+{
+	Scene s;
+	makeScene(s, level);
+
+	gfx::ParentMatrix parent;
+	parent.version = 0;
+	gfx::setParent(parent, gfx::identity());
+
+	// the old frame
+	gfx::CallCounts oldCalls;
+	gfx::RenderBackend oldBackend = gfx::countingBackend(&oldCalls);
+	int oldMultiplies = 0;
+	gfx::Matrix m;
+	for (int f = 0; f < frames; f++) {
+		if (moving) turn(m, 0.001f * f); else m = gfx::identity();
+		drawOld(oldBackend, s, m, oldMultiplies);
+	}
+
+	// the new one; the first frame makes every world matrix, so it is left out.
+	// The time is the cache's own: the counting backend costs next to nothing,
+	// where the device calls it stands in for are what the cache saves.
+	gfx::CallCounts newCalls;
+	gfx::RenderStateCache rs;
+	rs.init(gfx::countingBackend(&newCalls));
+	drawNew(rs, s, parent);
+	newCalls.clear();
+	rs.resetStats();
+	double t0 = nowSeconds();
+	for (int f = 0; f < frames; f++) {
+		if (moving) {
+			turn(m, 0.001f * f);
+			gfx::setParent(parent, m);
+		}
+		drawNew(rs, s, parent);
+	}
+	double newUs = (nowSeconds() - t0) * 1e6 / frames;
+	const gfx::RenderStats& st = rs.stats();
+
+	if (moving) {
+		turn(m, 0.5f);
+		gfx::setParent(parent, m);
+	}
+	float error = placementError(s, parent);
+
+	int objects = (int)s.locals.size() + 2;   // and the debris and the light's marker
+	bool ok = error < 1e-4f &&
+		newCalls.calls[gfx::CALL_DRAW] == oldCalls.calls[gfx::CALL_DRAW] &&
+		newCalls.calls[gfx::CALL_MULTIPLY_TRANSFORM] == 0 &&
+		newCalls.total() < oldCalls.total() &&
+		(moving || st.multiplies == 0);
+
+	printf("%s, parent %s: %d targets, %d bricks, %d draws a frame\n",
+		name, moving ? "turning" : "still", s.targets, s.bricks, objects);
+	printf("    %-4s", "");
+	for (int k = 0; k < gfx::CALL_KIND_COUNT; k++)
+		printf(" %9.9s", gfx::callNames[k]);
+	printf(" %9s\n", "total");
+	printCalls("old", oldCalls, frames);
+	printCalls("new", newCalls, frames);
+	printf("    device calls %.1f%% fewer, %.1f dropped by the cache; multiplies %.1f -> %.1f (%.1f still current)\n",
+		100.0 * (1.0 - (double)newCalls.total() / oldCalls.total()), (double)st.callsSaved / frames,
+		(double)oldMultiplies / frames, (double)st.multiplies / frames, (double)st.multipliesSaved / frames);
+	printf("    cache %.1f us a frame (%.1f ns a draw), placement error %.2g  %s\n",
+		newUs, newUs * 1000.0 / objects, error, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static int usage(void)
+{
+	printf("usage: renderBench [-frames n] [-targets n ...]\n");
+	return 2;
+}
+
+int main(int argc, char* argv[])
+{
+	int frames = 300;
+	int targets[8];
+	int targetCount = 0;
+	for (int a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "-frames") == 0 && a + 1 < argc)                         frames = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-targets") == 0 && a + 1 < argc && targetCount < 8) targets[targetCount++] = atoi(argv[++a]);
+		else                                                                          return usage();
+	}
+	if (frames <= 0)
+		return usage();
+
+	sim::Level level;
+	int failed = 0;
+	if (targetCount == 0) {
+		sim::defaultLevel(level);
+		for (int moving = 0; moving < 2; moving++)
+			if (!runLevel("built-in", level, frames, moving != 0)) failed++;
+		targets[targetCount++] = 1000;
+		targets[targetCount++] = 10000;
+	}
+	for (int i = 0; i < targetCount; i++) {
+		char name[32];
+		sprintf(name, "room of %d", targets[i]);
+		roomLevel(level, targets[i]);
+		for (int moving = 0; moving < 2; moving++)
+			if (!runLevel(name, level, frames, moving != 0)) failed++;
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,527 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: scenarioRunner.cpp
+// 
+// Desc: Runs the game logic of Display() headless at a fixed step, driven by a
+//       scripted input timeline, and hashes the world state after every frame
+//       (World::stateHash()). Recorded hashes are kept as golden files, so a
+//       change to the physics shows up as the first frame that differs.
+//       Build it next to the game sources, e.g.
+//
+//           cl /O2 /EHsc /I.. scenarioRunner.cpp ..\level.cpp ..\gameWorld.cpp ..\distanceField.cpp ..\particles.cpp ..\jobSystem.cpp ..\arena.cpp ..\memTrack.cpp ..\perfCounters.cpp ..\mappedFile.cpp ..\meshGen.cpp ..\renderCache.cpp
+//           g++ -O2 -I.. scenarioRunner.cpp ../level.cpp ../gameWorld.cpp ../distanceField.cpp ../particles.cpp ../jobSystem.cpp ../arena.cpp ../memTrack.cpp ../perfCounters.cpp ../mappedFile.cpp ../meshGen.cpp ../renderCache.cpp -pthread
+//
+//       Adding /DARK_FIXED_POINT=16 or -DARK_FIXED_POINT=16 builds it with
+//       the fixed-point simulation (see fixedPoint.h); goldens remember the
+//       scalar they were recorded with, and bench in both builds compares
+//       the two.
+//
+//       usage: scenarioRunner run    <scenario> [level]
+//              scenarioRunner record <scenario> <golden> [level]
+//              scenarioRunner check  <scenario> <golden> [level]
+//              scenarioRunner bench  [target count ...]
+//              scenarioRunner memory [level | target count]
+//       Add "-threads n" to step on a JobSystem. The level defaults to the
+//       built-in layout (see level.h for the file format); "pack@n" picks
+//       level n of a level pack. check exits with 1 at the first divergent
+//       frame. memory loads a level the way the game does and prints the
+//       footprint report, with the GPU buffers of every mesh in the game's
+//       list (gfx::gameMeshes) created through the counting render backend;
+//       heap blocks, the debris point list among them, show up when the
+//       runner is built with ARK_ALLOC_HOOK.
+//
+//       Scenario format, one command per line, '#' starts a comment:
+//
+//           frames 3600          number of frames to run
+//           dt 0.0112            step passed to World::step()
+//           <frame> paddle <z>   mouse drag to z
+//           <frame> launch       VK_SPACE
+//
+//       Commands for a frame are applied in file order before that frame's step,
+//       the way EnterMsgLoop() dispatches messages before calling Display().
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "level.h"
+#include "particles.h"
+#include "jobSystem.h"
+#include "memTrack.h"
+#include "renderCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static double nowSeconds(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------
+// Input timeline
+// -----------------------------------------------------------------------------
+
+enum InputKind { INPUT_PADDLE, INPUT_LAUNCH };
+
+struct Input
+{
+	int   frame;
+	int   kind;     // InputKind
+	float value;    // paddle z
+};
+
+struct Scenario
+{
+	int                frames;
+	float              dt;
+	std::vector<Input> inputs;   // sorted by frame, file order within a frame
+};
+
+static bool inputBefore(const Input& a, const Input& b)
+{
+	return a.frame < b.frame;
+}
+
+static bool loadScenario(const char* path, Scenario& sc)
+{
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "can't open scenario '%s'\n", path);
+		return false;
+	}
+
+	sc.frames = 0;
+	sc.dt     = 0.016f * 0.7f;   // EnterMsgLoop's scale at 60 Hz
+	sc.inputs.clear();
+
+	char line[256];
+	int lineNo = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), fp)) {
+		lineNo++;
+		char* hash = strchr(line, '#');
+		if (hash) *hash = '\0';
+
+		char  word[16], cmd[16];
+		int   frame;
+		float value;
+		Input in;
+		if (sscanf(line, "%15s", word) != 1)
+			continue;
+		if (strcmp(word, "frames") == 0 && sscanf(line, "%*s %d", &sc.frames) == 1)
+			continue;
+		if (strcmp(word, "dt") == 0 && sscanf(line, "%*s %f", &sc.dt) == 1)
+			continue;
+
+		int n = sscanf(line, "%d %15s %f", &frame, cmd, &value);
+		if (n == 2 && strcmp(cmd, "launch") == 0) {
+			in.frame = frame; in.kind = INPUT_LAUNCH; in.value = 0.0f;
+			sc.inputs.push_back(in);
+		}
+		else if (n == 3 && strcmp(cmd, "paddle") == 0) {
+			in.frame = frame; in.kind = INPUT_PADDLE; in.value = value;
+			sc.inputs.push_back(in);
+		}
+		else {
+			fprintf(stderr, "%s(%d): can't parse '%s'\n", path, lineNo, word);
+			ok = false;
+		}
+	}
+	fclose(fp);
+
+	std::stable_sort(sc.inputs.begin(), sc.inputs.end(), inputBefore);
+	return ok && sc.frames > 0;
+}
+
+// -----------------------------------------------------------------------------
+// Running
+// -----------------------------------------------------------------------------
+
+struct RunResult
+{
+	std::vector<uint64_t> hashes;    // after every frame
+	double                seconds;   // in step() and input only
+	int                   liveTargets;
+	int                   hits;      // targets and bricks
+	int                   lost;      // balls
+};
+
+static bool runScenario(const Scenario& sc, const sim::Level& level, JobSystem* jobs, RunResult& out)
+{
+	sim::World world;
+	world.setJobSystem(jobs);
+	size_t bytes = (size_t)64 << 20;
+	if (!world.init(bytes) || !world.loadLevel(level.desc())) {
+		fprintf(stderr, "level doesn't fit in %u bytes\n", (unsigned)bytes);
+		return false;
+	}
+
+	out.hashes.resize(sc.frames);
+	out.hits = out.lost = 0;
+	size_t next = 0;
+	double t0 = nowSeconds();
+	for (int f = 0; f < sc.frames; f++) {
+		for (; next < sc.inputs.size() && sc.inputs[next].frame <= f; next++) {
+			const Input& in = sc.inputs[next];
+			if (in.kind == INPUT_LAUNCH) world.launch();
+			else                         world.movePaddle(sim::Scalar(in.value));
+		}
+		world.step(sim::Scalar(sc.dt));
+		out.hashes[f] = world.stateHash();
+
+		for (int e = 0; e < world.eventCount(); e++) {
+			int kind = world.events()[e].kind;
+			if (kind == sim::EVENT_TARGET_HIT || kind == sim::EVENT_BRICK_HIT) out.hits++;
+			else if (kind == sim::EVENT_BALL_LOST)                             out.lost++;
+		}
+	}
+	out.seconds     = nowSeconds() - t0;
+	out.liveTargets = world.liveTargets();
+	return true;
+}
+
+static bool loadLevelArg(const char* arg, sim::Level& level)
+{
+	if (arg == NULL || strcmp(arg, "default") == 0) {
+		sim::defaultLevel(level);
+		return true;
+	}
+	// "file@n" is level n of a pack
+	const char* at = strrchr(arg, '@');
+	if (at) {
+		std::string path(arg, at - arg);
+		std::vector<sim::Level> pack;
+		int n = atoi(at + 1);
+		if (!sim::loadLevelPack(path.c_str(), pack) || n < 0 || n >= (int)pack.size()) {
+			fprintf(stderr, "can't load level %d of pack '%s'\n", n, path.c_str());
+			return false;
+		}
+		level = pack[n];
+		return true;
+	}
+	if (!sim::loadLevelFile(arg, level)) {
+		fprintf(stderr, "can't load level '%s'\n", arg);
+		return false;
+	}
+	return true;
+}
+
+static void printSummary(const Scenario& sc, const RunResult& r)
+{
+	printf("%d frames  %.3f ms total  %.2f us/frame  %d hits  %d balls lost  %d live targets  final hash %016llx\n",
+		sc.frames, r.seconds * 1e3, r.seconds * 1e6 / sc.frames, r.hits, r.lost, r.liveTargets,
+		(unsigned long long)r.hashes[sc.frames - 1]);
+}
+
+// -----------------------------------------------------------------------------
+// Golden files: "frame hash" per line
+// -----------------------------------------------------------------------------
+
+static bool writeGolden(const char* path, const char* scenario, const char* level, const RunResult& r)
+{
+	FILE* fp = fopen(path, "w");
+	if (fp == NULL)
+		return false;
+	fprintf(fp, "# scenario %s  level %s  frames %d  scalar %s\n", scenario, level ? level : "default", (int)r.hashes.size(), sim::SCALAR_NAME);
+	for (size_t f = 0; f < r.hashes.size(); f++)
+		fprintf(fp, "%d %016llx\n", (int)f, (unsigned long long)r.hashes[f]);
+	return fclose(fp) == 0;
+}
+
+// 'scalar' is what the hashes were recorded with; files from before the
+// fixed-point build don't say and are float
+static bool readGolden(const char* path, std::vector<uint64_t>& hashes, std::string& scalar)
+{
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+		return false;
+	hashes.clear();
+	scalar = "float";
+	char line[128];
+	while (fgets(line, sizeof(line), fp)) {
+		int frame;
+		unsigned long long h;
+		if (line[0] == '#') {
+			const char* s = strstr(line, "scalar ");
+			char name[16];
+			if (s && sscanf(s + 7, "%15s", name) == 1)
+				scalar = name;
+			continue;
+		}
+		if (sscanf(line, "%d %llx", &frame, &h) != 2)
+			continue;
+		if (frame != (int)hashes.size()) {
+			fclose(fp);
+			return false;
+		}
+		hashes.push_back(h);
+	}
+	fclose(fp);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// Large generated levels
+// -----------------------------------------------------------------------------
+
+static unsigned int s_rng = 12345;
+static float frand(float lo, float hi)
+{
+	s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+	return lo + (hi - lo) * ((s_rng & 0xffffff) / 16777216.0f);
+}
+
+// a square room with about 'targets' spheres on a jittered grid, a brick for
+// every sixteenth cell and one extra ball per hundred targets
+static void generateLevel(sim::Level& level, int targets)
+{
+	const float SPACING = 0.5f;
+	int side = (int)std::ceil(std::sqrt((float)targets));
+	float h = side * SPACING * 0.5f + 1.0f;
+
+	level.clear();
+	s_rng = 4242u + (unsigned)targets;
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h, h), sim::toVec2(h, h + 0.12f)));
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h, -h - 0.12f), sim::toVec2(h, -h)));
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h - 0.12f, -h - 0.12f), sim::toVec2(-h, h + 0.12f)));
+
+	for (int i = 0; i < targets; i++) {
+		float x = -h + 0.5f + (i % side) * SPACING;
+		float z = -h + 1.0f + (i / side) * SPACING;
+		if (i % 16 == 15)
+			level.bricks.push_back(sim::boxAt(sim::Scalar(x), sim::Scalar(z), sim::Scalar(0.3f), sim::Scalar(0.4f)));
+		else
+			level.spheres.push_back(sim::toVec2(x + frand(-0.03f, 0.03f), z + frand(-0.03f, 0.03f)));
+	}
+	for (int i = 0; i < targets / 100; i++) {
+		sim::Ball b;
+		float a = frand(0.0f, 6.2831853f);
+		b.pos = sim::toVec2(frand(-h + 0.5f, h - 0.5f), frand(-h + 0.5f, h - 0.5f));
+		b.vel = sim::toVec2(std::cos(a), std::sin(a)) * sim::LAUNCH_SPEED;
+		level.balls.push_back(b);
+	}
+
+	// the exit sits a little past the targets so the room stays busy
+	level.exitX       = sim::Scalar(h + 1.0f);
+	level.paddleStart = sim::toVec2(h + 0.5f, 0.0f);
+	level.paddleMinZ  = sim::Scalar(-h) + sim::BALL_RADIUS;
+	level.paddleMaxZ  = sim::Scalar(h) - sim::BALL_RADIUS;
+}
+
+// the player sweeping the paddle and relaunching now and then
+static void generateScenario(Scenario& sc, int frames, float range)
+{
+	sc.frames = frames;
+	sc.dt     = 0.016f * 0.7f;
+	sc.inputs.clear();
+	for (int f = 0; f < frames; f++) {
+		Input in;
+		in.frame = f;
+		if (f % 400 == 0) {
+			in.kind = INPUT_LAUNCH; in.value = 0.0f;
+			sc.inputs.push_back(in);
+		}
+		in.kind  = INPUT_PADDLE;
+		in.value = range * std::sin(f * 0.011f);
+		sc.inputs.push_back(in);
+	}
+}
+
+static bool runBench(const std::vector<int>& sizes, JobSystem* jobs)
+{
+	printf("bench  %s scalars\n", sim::SCALAR_NAME);
+	for (size_t i = 0; i < sizes.size(); i++) {
+		sim::Level level;
+		generateLevel(level, sizes[i]);
+		Scenario sc;
+		generateScenario(sc, 600, sim::toFloat(level.paddleMaxZ));
+
+		RunResult r;
+		if (!runScenario(sc, level, jobs, r))
+			return false;
+
+		printf("bench  %7d targets %5d balls  %9.2f us/frame  %8.0f frames/s  %7d live  final hash %016llx\n",
+			sizes[i], (int)level.balls.size() + 1, r.seconds * 1e6 / sc.frames, sc.frames / r.seconds,
+			r.liveTargets, (unsigned long long)r.hashes[sc.frames - 1]);
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// Memory footprint
+// -----------------------------------------------------------------------------
+
+// what the game's startup in virtualLego.cpp reserves next to the level
+static const size_t GAME_LEVEL_BYTES = 1 << 20;
+static const int    GAME_DEBRIS      = 100000;
+
+// every mesh the game creates, through a backend that charges them without a device
+static bool createGameMeshes(gfx::RenderStateCache& rs, void* meshes[gfx::GAME_MESH_COUNT])
+{
+	gfx::MeshData data;
+	for (int i = 0; i < gfx::GAME_MESH_COUNT; i++) {
+		meshes[i] = NULL;
+		if (!gfx::buildMesh(gfx::gameMeshes[i], data) || (meshes[i] = rs.createMesh(data)) == NULL)
+			return false;
+	}
+	return true;
+}
+
+static bool runMemory(const char* arg)
+{
+	sim::Level level;
+	if (arg != NULL && arg[0] >= '0' && arg[0] <= '9') {
+		mem::Scope tag(mem::TAG_LEVEL);
+		generateLevel(level, atoi(arg));
+	}
+	else if (!loadLevelArg(arg, level))
+		return false;
+
+	// a trial load finds what the level needs; then the arena is reserved the
+	// way the game does, or as big as the level if the game's isn't enough
+	size_t need;
+	{
+		sim::World trial;
+		size_t bytes = (size_t)64 << 20;
+		if (!trial.init(bytes) || !trial.loadLevel(level.desc())) {
+			fprintf(stderr, "level doesn't fit in %u bytes\n", (unsigned)bytes);
+			return false;
+		}
+		need = trial.arena().highWater();
+	}
+	mem::resetPeaks();
+
+	sim::World world;
+	if (!world.init(need > GAME_LEVEL_BYTES ? need : GAME_LEVEL_BYTES) || !world.loadLevel(level.desc()))
+		return false;
+	sim::ParticleSystem debris;
+	if (!debris.init(GAME_DEBRIS, 0.0f))
+		return false;
+
+	gfx::CallCounts calls;
+	gfx::RenderStateCache rs;
+	rs.init(gfx::countingBackend(&calls));
+	void* meshes[gfx::GAME_MESH_COUNT];
+	if (!createGameMeshes(rs, meshes))
+		return false;
+
+	// CDebris's point list, position and color per particle, is a heap block
+	// like the game's: counted when the allocation hook is in, not made up otherwise
+	std::vector<char> debrisPoints;
+	{
+		mem::Scope tag(mem::TAG_RENDER);
+		debrisPoints.resize((size_t)GAME_DEBRIS * 16);
+	}
+
+	mem::Report r;
+	mem::snapshot(r);
+	mem::print(stdout, r);
+
+	printf("level data %.1f KB of the world arena (%u spheres, %u bricks); the game reserves %u KB%s\n",
+		need / 1024.0, (unsigned)level.spheres.size(), (unsigned)level.bricks.size(),
+		(unsigned)(GAME_LEVEL_BYTES >> 10), need > GAME_LEVEL_BYTES ? ", not enough" : "");
+
+	for (int i = 0; i < gfx::GAME_MESH_COUNT; i++)
+		rs.releaseMesh(meshes[i]);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+static int usage(void)
+{
+	printf("usage: scenarioRunner run    <scenario> [level]\n"
+	       "       scenarioRunner record <scenario> <golden> [level]\n"
+	       "       scenarioRunner check  <scenario> <golden> [level]\n"
+	       "       scenarioRunner bench  [target count ...]\n"
+	       "       scenarioRunner memory [level | target count]\n"
+	       "       options: -threads n\n");
+	return 2;
+}
+
+int main(int argc, char* argv[])
+{
+	// pull out options, leave the positional arguments
+	std::vector<const char*> args;
+	int threads = 1;
+	for (int a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "-threads") == 0 && a + 1 < argc) threads = atoi(argv[++a]);
+		else                                                   args.push_back(argv[a]);
+	}
+	if (args.empty())
+		return usage();
+
+	JobSystem jobs;
+	if (threads > 1)
+		jobs.start(threads);
+	JobSystem* pool = threads > 1 ? &jobs : NULL;
+
+	const char* mode = args[0];
+	if (strcmp(mode, "bench") == 0) {
+		std::vector<int> sizes;
+		for (size_t a = 1; a < args.size(); a++)
+			sizes.push_back(atoi(args[a]));
+		if (sizes.empty()) {
+			sizes.push_back(1000);
+			sizes.push_back(10000);
+			sizes.push_back(100000);
+		}
+		return runBench(sizes, pool) ? 0 : 1;
+	}
+	if (strcmp(mode, "memory") == 0)
+		return runMemory(args.size() > 1 ? args[1] : NULL) ? 0 : 1;
+
+	bool golden = strcmp(mode, "record") == 0 || strcmp(mode, "check") == 0;
+	if ((strcmp(mode, "run") != 0 && !golden) || args.size() < (golden ? 3u : 2u))
+		return usage();
+
+	const char* scenarioPath = args[1];
+	const char* goldenPath   = golden ? args[2] : NULL;
+	size_t      levelArg     = golden ? 3 : 2;
+	const char* levelPath    = args.size() > levelArg ? args[levelArg] : NULL;
+
+	Scenario sc;
+	sim::Level level;
+	RunResult r;
+	if (!loadScenario(scenarioPath, sc) || !loadLevelArg(levelPath, level) || !runScenario(sc, level, pool, r))
+		return 1;
+	printSummary(sc, r);
+
+	if (strcmp(mode, "record") == 0) {
+		if (!writeGolden(goldenPath, scenarioPath, levelPath, r)) {
+			fprintf(stderr, "can't write '%s'\n", goldenPath);
+			return 1;
+		}
+		printf("recorded %d hashes to %s\n", sc.frames, goldenPath);
+	}
+	else if (strcmp(mode, "check") == 0) {
+		std::vector<uint64_t> expected;
+		std::string scalar;
+		if (!readGolden(goldenPath, expected, scalar)) {
+			fprintf(stderr, "can't read golden file '%s'\n", goldenPath);
+			return 1;
+		}
+		if (scalar != sim::SCALAR_NAME) {
+			printf("FAILED: %s was recorded with %s scalars, this runner is built with %s\n", goldenPath, scalar.c_str(), sim::SCALAR_NAME);
+			return 1;
+		}
+		size_t frames = expected.size() < r.hashes.size() ? expected.size() : r.hashes.size();
+		for (size_t f = 0; f < frames; f++) {
+			if (expected[f] != r.hashes[f]) {
+				printf("FAILED: frame %d diverges (expected %016llx, got %016llx)\n",
+					(int)f, (unsigned long long)expected[f], (unsigned long long)r.hashes[f]);
+				return 1;
+			}
+		}
+		if (expected.size() != r.hashes.size()) {
+			printf("FAILED: golden file has %d frames, scenario ran %d\n", (int)expected.size(), (int)r.hashes.size());
+			return 1;
+		}
+		printf("ok: %d frames match %s\n", (int)frames, goldenPath);
+	}
+	return 0;
+}
@@ -0,0 +1,1045 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: simBench.cpp
+// 
+// Desc: Console benchmarks and cross-checks for the headless simulation code.
+//       Build it next to the game sources, e.g.
+//
+//           cl /O2 /EHsc /I.. /DARK_ALLOC_HOOK simBench.cpp ..\trajectory.cpp ..\gameWorld.cpp ..\distanceField.cpp ..\particles.cpp ..\jobSystem.cpp ..\arena.cpp ..\memTrack.cpp ..\perfCounters.cpp ..\mappedFile.cpp
+//           g++ -O2 -I.. -DARK_ALLOC_HOOK simBench.cpp ../trajectory.cpp ../gameWorld.cpp ../distanceField.cpp ../particles.cpp ../jobSystem.cpp ../arena.cpp ../memTrack.cpp ../perfCounters.cpp ../mappedFile.cpp -pthread
+//
+//       usage: simBench [bench name ...]   (no names runs everything)
+//       The exit code is non-zero when a check fails.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "trajectory.h"
+#include "gameWorld.h"
+#include "jobSystem.h"
+#include "particles.h"
+#include "fixedPoint.h"
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static double nowSeconds(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// deterministic xorshift so runs are comparable
+static unsigned int s_rng = 12345;
+static float frand(float lo, float hi)
+{
+	s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+	return lo + (hi - lo) * ((s_rng & 0xffffff) / 16777216.0f);
+}
+
+// -----------------------------------------------------------------------------
+// Play field matching Setup() in virtualLego.cpp
+// -----------------------------------------------------------------------------
+
+static const sim::Scalar BALL_RADIUS = sim::Scalar(0.21f);
+static const sim::Scalar FIELD_RIGHT = sim::Scalar(4.5f);
+
+struct Field
+{
+	sim::Aabb                  walls[3];
+	std::vector<sim::Vec2>     targets;
+	std::vector<unsigned char> alive;
+	std::vector<sim::Aabb>     bricks;
+	std::vector<unsigned char> brickAlive;
+	sim::Vec2                  paddle;
+};
+
+static sim::Aabb boxAt(float x, float z, float width, float depth)
+{
+	return sim::Aabb(sim::toVec2(x - width * 0.5f, z - depth * 0.5f), sim::toVec2(x + width * 0.5f, z + depth * 0.5f));
+}
+
+// targets, then bricks, on random cells of a grid inside the walls; spacing keeps them apart
+static void makeField(Field& f, int targetCount, int brickCount = 0)
+{
+	f.walls[0] = boxAt(0.0f, 3.06f, 9.0f, 0.12f);
+	f.walls[1] = boxAt(0.0f, -3.06f, 9.0f, 0.12f);
+	f.walls[2] = boxAt(-4.56f, 0.0f, 0.12f, 6.24f);
+	f.paddle   = sim::Vec2(FIELD_RIGHT, 0);
+
+	const float SPACING = 0.46f;
+	std::vector<sim::Vec2> cells;
+	for (float x = -4.1f; x <= 3.0f; x += SPACING)
+		for (float z = -2.6f; z <= 2.6f; z += SPACING)
+			cells.push_back(sim::toVec2(x, z));
+	for (size_t i = cells.size() - 1; i > 0; i--) {
+		size_t j = (size_t)frand(0.0f, (float)i + 0.999f);
+		sim::Vec2 tmp = cells[i]; cells[i] = cells[j]; cells[j] = tmp;
+	}
+	if (targetCount > (int)cells.size())
+		targetCount = (int)cells.size();
+	f.targets.assign(cells.begin(), cells.begin() + targetCount);
+	f.alive.assign(f.targets.size(), 1);
+	if (brickCount > (int)cells.size() - targetCount)
+		brickCount = (int)cells.size() - targetCount;
+	f.bricks.clear();
+	for (int i = 0; i < brickCount; i++) {
+		const sim::Vec2& c = cells[targetCount + i];
+		f.bricks.push_back(boxAt(sim::toFloat(c.x), sim::toFloat(c.z), 0.3f, 0.2f));
+	}
+	f.brickAlive.assign(f.bricks.size(), 1);
+}
+
+static sim::TrajectoryScene sceneOf(const Field& f, const sim::TargetGrid* grid = NULL)
+{
+	sim::TrajectoryScene s;
+	s.walls        = f.walls;
+	s.wallCount    = 3;
+	s.targets      = f.targets.empty() ? NULL : &f.targets[0];
+	s.targetAlive  = f.alive.empty() ? NULL : &f.alive[0];
+	s.targetCount  = (int)f.targets.size();
+	s.targetRadius = BALL_RADIUS;
+	s.bricks       = f.bricks.empty() ? NULL : &f.bricks[0];
+	s.brickAlive   = f.brickAlive.empty() ? NULL : &f.brickAlive[0];
+	s.brickCount   = (int)f.bricks.size();
+	s.hasPaddle    = true;
+	s.paddle       = f.paddle;
+	s.paddleRadius = BALL_RADIUS;
+	s.ballRadius   = BALL_RADIUS;
+	s.exitX        = FIELD_RIGHT;
+	s.grid         = grid;
+	return s;
+}
+
+static sim::LevelDesc levelOf(const Field& f)
+{
+	sim::LevelDesc level;
+	level.spheres     = &f.targets[0];
+	level.sphereCount = (int)f.targets.size();
+	level.bricks      = f.bricks.empty() ? NULL : &f.bricks[0];
+	level.brickCount  = (int)f.bricks.size();
+	level.walls       = f.walls;
+	level.wallCount   = 3;
+	level.exitX       = FIELD_RIGHT;
+	level.paddleStart = f.paddle;
+	level.paddleMinZ  = f.walls[1].hi.z + BALL_RADIUS;
+	level.paddleMaxZ  = f.walls[0].lo.z - BALL_RADIUS;
+	level.balls       = NULL;
+	level.ballCount   = 0;
+	level.arenaShapes     = NULL;
+	level.arenaShapeCount = 0;
+	level.fieldCellSize   = 0;
+	return level;
+}
+
+// the field loaded into a World, for its broadphase grid
+static bool gridOf(const Field& f, sim::World& world, sim::TargetGrid& grid)
+{
+	if (!world.init(1 << 20) || !world.loadLevel(levelOf(f)))
+		return false;
+	grid = world.targetGrid();
+	return true;
+}
+
+static bool sameContacts(const sim::Contact* a, int na, const sim::Contact* b, int nb)
+{
+	if (na != nb)
+		return false;
+	for (int i = 0; i < na; i++)
+		if (a[i].kind != b[i].kind || a[i].index != b[i].index || a[i].time != b[i].time ||
+			a[i].velocity.x != b[i].velocity.x || a[i].velocity.z != b[i].velocity.z)
+			return false;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// Step-by-step reference: the rules of Display() at a small fixed step
+// -----------------------------------------------------------------------------
+
+struct StepEvent
+{
+	float     time;
+	int       kind;
+	int       index;
+	sim::Vec2 velocity;     // after the bounce
+	sim::Vec2 normal;       // of the surface, towards the ball
+};
+
+static int stepSimulate(Field f, sim::Vec2 p, sim::Vec2 v, float dt, float maxTime,
+	StepEvent* out, int maxEvents)
+{
+	int count = 0;
+	const sim::Scalar reach = 2 * BALL_RADIUS;
+	// the ball moves from where it last turned, counted in whole steps, so
+	// neither time nor position adds up a rounding error every step (a Q16.16
+	// dt of 0.0001 alone is 7% off)
+	sim::Vec2 from = p;
+	int turned = 0;
+	for (int step = 0; step * dt < maxTime && count < maxEvents; step++) {
+		float t = step * dt;
+		for (size_t i = 0; i < f.targets.size(); i++) {
+			if (!f.alive[i]) continue;
+			sim::Vec2 diff = f.targets[i] - p;
+			sim::Scalar dist = sim::length(diff);
+			if (dist <= reach) {
+				StepEvent e = { t, sim::CONTACT_TARGET, (int)i, v, diff * (-1 / dist) };
+				v = diff * (-sim::length(v) / dist);
+				e.velocity = v;
+				f.alive[i] = 0;
+				out[count++] = e;
+				from = p; turned = step;
+			}
+		}
+		for (size_t i = 0; i < f.bricks.size() && count < maxEvents; i++) {
+			if (!f.brickAlive[i]) continue;
+			sim::Manifold m;
+			if (sim::collide(sim::Sphere(p, BALL_RADIUS), f.bricks[i], m)) {
+				sim::bounce(p, v, m);
+				f.brickAlive[i] = 0;
+				StepEvent e = { t, sim::CONTACT_BRICK, (int)i, v, m.normal };
+				out[count++] = e;
+				from = p; turned = step;
+			}
+		}
+		if (count >= maxEvents) break;
+
+		p = from + v * sim::Scalar((step + 1 - turned) * dt);
+
+		for (int i = 0; i < 3; i++) {
+			sim::Manifold m;
+			if (sim::collide(sim::Sphere(p, BALL_RADIUS), f.walls[i], m)) {
+				sim::bounce(p, v, m);
+				StepEvent e = { t, sim::CONTACT_WALL, i, v, m.normal };
+				if (count < maxEvents) out[count++] = e;
+				from = p; turned = step + 1;
+			}
+		}
+
+		sim::Vec2 diff = f.paddle - p;
+		sim::Scalar dist = sim::length(diff);
+		if (dist <= reach) {
+			StepEvent e = { t, sim::CONTACT_PADDLE, 0, v, diff * (-1 / dist) };
+			v = diff * (-sim::length(v) / dist);
+			e.velocity = v;
+			if (count < maxEvents) out[count++] = e;
+			from = p; turned = step + 1;
+		}
+
+		if (p.x >= FIELD_RIGHT) {
+			StepEvent e = { t, sim::CONTACT_EXIT, 0, v, sim::Vec2(-1, 0) };
+			if (count < maxEvents) out[count++] = e;
+			break;
+		}
+	}
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmarks
+// -----------------------------------------------------------------------------
+
+static bool benchTrajectory(void)
+{
+	const int   K       = 8;
+	const float SPEED   = 3.0f * 3.3f;   // launch speed times TIME_SCALE
+	const float MAXTIME = 20.0f;
+
+	int sizes[] = { 54, 180 };
+	bool ok = true;
+	for (int s = 0; s < 2; s++) {
+		Field field;
+		makeField(field, sizes[s]);
+		sim::World world;
+		sim::TargetGrid grid;
+		if (!gridOf(field, world, grid))
+			return false;
+		sim::TrajectoryScene scene = sceneOf(field), gridScene = sceneOf(field, &grid);
+
+		const int QUERIES = sizes[s] > 100 ? 50000 : 200000;
+		std::vector<sim::Vec2> starts(QUERIES), vels(QUERIES);
+		for (int i = 0; i < QUERIES; i++) {
+			float a = frand(2.4f, 3.9f);
+			starts[i] = sim::Vec2(FIELD_RIGHT - 2 * BALL_RADIUS - sim::Scalar(0.01f), sim::Scalar(frand(-2.5f, 2.5f)));
+			vels[i]   = sim::toVec2(std::cos(a) * SPEED, std::sin(a) * SPEED);
+		}
+
+		sim::Contact contacts[K], gridContacts[K];
+		long long bounces = 0;
+		double t0 = nowSeconds();
+		for (int i = 0; i < QUERIES; i++)
+			bounces += sim::predictTrajectory(scene, starts[i], vels[i], contacts, K, sim::Scalar(MAXTIME));
+		double analytic = nowSeconds() - t0;
+
+		long long gridBounces = 0;
+		t0 = nowSeconds();
+		for (int i = 0; i < QUERIES; i++)
+			gridBounces += sim::predictTrajectory(gridScene, starts[i], vels[i], gridContacts, K, sim::Scalar(MAXTIME));
+		double walked = nowSeconds() - t0;
+
+		// the grid walk has to find exactly what sweeping every target does
+		int differ = 0;
+		for (int i = 0; i < QUERIES; i++) {
+			int n  = sim::predictTrajectory(scene, starts[i], vels[i], contacts, K, sim::Scalar(MAXTIME));
+			int ng = sim::predictTrajectory(gridScene, starts[i], vels[i], gridContacts, K, sim::Scalar(MAXTIME));
+			if (!sameContacts(contacts, n, gridContacts, ng))
+				differ++;
+		}
+
+		// step-by-step cost for the same queries at a 1 ms step
+		const int STEPPED = QUERIES / 1000;
+		StepEvent events[K];
+		long long stepBounces = 0;
+		t0 = nowSeconds();
+		for (int i = 0; i < STEPPED; i++)
+			stepBounces += stepSimulate(field, starts[i], vels[i], 0.001f, MAXTIME, events, K);
+		double stepped = nowSeconds() - t0;
+
+		printf("trajectory  targets=%4d  all targets %7.1f ns/bounce   grid walk %7.1f ns/bounce  (%lld bounces, %d queries differ)   stepped(1ms) %10.1f ns/bounce\n",
+			sizes[s], analytic * 1e9 / (double)bounces, walked * 1e9 / (double)gridBounces, bounces, differ,
+			stepped * 1e9 / (double)(stepBounces ? stepBounces : 1));
+		ok = ok && differ == 0 && gridBounces == bounces;
+	}
+	return ok;
+}
+
+// angle in degrees between two velocities
+static float angleBetween(sim::Vec2 a, sim::Vec2 b)
+{
+	float c = sim::toFloat(sim::dot(a, b)) / (sim::toFloat(sim::length(a)) * sim::toFloat(sim::length(b)));
+	c = c > 1.0f ? 1.0f : (c < -1.0f ? -1.0f : c);
+	return std::acos(c) * 57.2957795f;
+}
+
+// Compares the predicted contacts with a fine step-by-step run of the same
+// rules. Every one of the leading contacts has to be the same shape, at the
+// same time and leaving in the same direction, within the tolerances below.
+// The stepped run resolves a hit up to a step late, and the game's rule for
+// balls (leave straight away from the center) roughly doubles that error at
+// every hit, so a chain of bounces would soon drift apart for reasons that
+// have nothing to do with the predictor. Each contact is therefore checked
+// from the one before it: the stepped run restarts where the prediction says
+// the ball left the last contact, with the shapes hit so far removed.
+// A contact met at a grazing angle, in either run, is where the two may
+// rightly disagree: the stepped ball can skip or catch a sliver of overlap the
+// exact sweep does not. The comparison of a launch stops there; those
+// launches are counted and may be only a few. The angle allowed is what one
+// step of travel can turn a corner's normal by, doubled by the mirror bounce,
+// and doubled again for margin. The prediction walks the World's target grid,
+// and has to match a sweep over every target and brick exactly.
+static bool checkTrajectory(void)
+{
+	const int   K         = 4;
+	const int   LEADING   = 3;
+	const float SPEED     = 3.0f * 3.3f;
+	const float DT        = 0.0001f;
+	const float MAXTIME   = 5.0f;
+	const float NUDGE     = 0.0001f;    // off the contact the ball is leaving
+	const float TIME_TOL  = 0.0005f;    // five steps
+	const float ANGLE_TOL = 4.0f * SPEED * DT / sim::toFloat(BALL_RADIUS) * 57.2957795f;    // degrees, about 1.1
+	const float GRAZING   = 0.05f;      // cosine between the approach and the normal, about 3 degrees off tangent
+	const int   TRIALS    = 200;
+
+	// launches from the white ball into targets; into targets and bricks; and
+	// from the field back at the white ball
+	struct Case { const char* name; int targets, bricks; bool atPaddle; };
+	static const Case cases[] = {
+		{ "targets",  54,  0, false },
+		{ "bricks",   30, 30, false },
+		{ "paddle",    8,  8, true  },
+	};
+
+	bool ok = true;
+	for (int c = 0; c < 3; c++) {
+		int matched = 0, compared = 0, grazing = 0, failed = 0, gridDiffers = 0, seen[5] = { 0 };
+		float worstDt = 0.0f, worstAngle = 0.0f;
+		for (int trial = 0; trial < TRIALS; trial++) {
+			Field field;
+			makeField(field, cases[c].targets, cases[c].bricks);
+			sim::World world;
+			sim::TargetGrid grid;
+			if (!gridOf(field, world, grid))
+				return false;
+			sim::TrajectoryScene scene = sceneOf(field, &grid);
+
+			sim::Vec2 p, v;
+			if (cases[c].atPaddle) {
+				// from a clear spot in the middle of the field, aimed at the white ball's reach
+				for (bool clear = false; !clear; ) {
+					p = sim::toVec2(frand(0.5f, 3.0f), frand(-2.0f, 2.0f));
+					sim::Manifold m;
+					clear = true;
+					for (size_t k = 0; k < field.targets.size(); k++)
+						clear = clear && sim::length(field.targets[k] - p) > 2 * BALL_RADIUS;
+					for (size_t k = 0; k < field.bricks.size(); k++)
+						clear = clear && !sim::collide(sim::Sphere(p, BALL_RADIUS), field.bricks[k], m);
+				}
+				sim::Vec2 aim = field.paddle + sim::toVec2(0.0f, frand(-0.35f, 0.35f)) - p;
+				v = aim * sim::Scalar(SPEED / sim::toFloat(sim::length(aim)));
+			}
+			else {
+				float a = frand(2.4f, 3.9f);
+				p = sim::Vec2(FIELD_RIGHT - 2 * BALL_RADIUS - sim::Scalar(0.01f), sim::Scalar(frand(-2.5f, 2.5f)));
+				v = sim::toVec2(std::cos(a) * SPEED, std::sin(a) * SPEED);
+			}
+
+			sim::Contact predicted[K], swept[K];
+			int np = sim::predictTrajectory(scene, p, v, predicted, K, sim::Scalar(MAXTIME));
+			int n = np < LEADING ? np : LEADING;
+			if (!sameContacts(predicted, np, swept, sim::predictTrajectory(sceneOf(field), p, v, swept, K, sim::Scalar(MAXTIME))))
+				gridDiffers++;
+
+			Field rest = field;
+			float start = 0.0f;
+			bool good = true;
+			for (int i = 0; i < n && good; i++) {
+				const sim::Contact& pc = predicted[i];
+				StepEvent stepped;
+				float left = sim::toFloat(pc.time) - start + 10.0f * TIME_TOL;
+				int ns = stepSimulate(rest, p, v, DT, left, &stepped, 1);
+				float graze = GRAZING * sim::toFloat(sim::length(v));
+				if ((pc.kind != sim::CONTACT_EXIT && std::fabs(sim::toFloat(sim::dot(v, pc.normal))) < graze) ||
+					(ns == 1 && stepped.kind != sim::CONTACT_EXIT && std::fabs(sim::toFloat(sim::dot(v, stepped.normal))) < graze)) {
+					grazing++;
+					break;
+				}
+
+				compared++;
+				if (ns != 1 || pc.kind != stepped.kind || pc.index != stepped.index) {
+					good = false;
+					break;
+				}
+				float d = std::fabs(sim::toFloat(pc.time) - (start + stepped.time));
+				float angle = angleBetween(pc.velocity, stepped.velocity);
+				if (d > worstDt) worstDt = d;
+				if (angle > worstAngle) worstAngle = angle;
+				if (d > TIME_TOL || angle > ANGLE_TOL) {
+					good = false;
+					break;
+				}
+				seen[pc.kind]++;
+				matched++;
+
+				// on from where the prediction leaves this contact
+				if (pc.kind == sim::CONTACT_TARGET) rest.alive[pc.index] = 0;
+				if (pc.kind == sim::CONTACT_BRICK)  rest.brickAlive[pc.index] = 0;
+				v     = pc.velocity;
+				p     = pc.position + v * sim::Scalar(NUDGE);
+				start = sim::toFloat(pc.time) + NUDGE;
+			}
+			if (!good)
+				failed++;
+		}
+		bool caseOk = failed == 0 && gridDiffers == 0 && grazing * 20 <= TRIALS;
+		printf("trajectory  check %-7s: %d/%d leading contacts match over %d launches (%d wall, %d target, %d brick, %d paddle, %d exit), "
+			"%d stop at a grazing hit, worst time error %.5f, worst angle %.3f deg, %d differ from the full sweep  %s\n",
+			cases[c].name, matched, compared, TRIALS, seen[sim::CONTACT_WALL], seen[sim::CONTACT_TARGET], seen[sim::CONTACT_BRICK],
+			seen[sim::CONTACT_PADDLE], seen[sim::CONTACT_EXIT], grazing, worstDt, worstAngle, gridDiffers, caseOk ? "ok" : "FAILED");
+		ok = ok && caseOk;
+	}
+	printf("            tolerances: time %.4f, direction %.1f deg; grazing is under %.0f deg from the surface\n",
+		TIME_TOL, ANGLE_TOL, std::asin(GRAZING) * 57.2957795f);
+	return ok;
+}
+
+// the per-class tests as they were written before shapes.h: plain member
+// functions that Display() called over its arrays of spheres and walls
+struct LegacyBall
+{
+	float x, z, r, vx, vz;
+	float getX() const { return x; }
+	float getZ() const { return z; }
+	float getRadius() const { return r; }
+};
+
+struct LegacySphere
+{
+	float x, z, r;
+	bool hitBy(LegacyBall& ball)
+	{
+		float dx = x - ball.getX(), dz = z - ball.getZ();
+		float dist = std::sqrt(dx * dx + dz * dz);
+		if (r + ball.getRadius() < dist) return false;
+		float speed = std::sqrt(ball.vx * ball.vx + ball.vz * ball.vz);
+		double vx2 = speed / dist * dx;
+		double vz2 = speed / dist * dz;
+		ball.vx = (float)-vx2; ball.vz = (float)-vz2;
+		return true;
+	}
+};
+
+struct LegacyWall
+{
+	float x, z, width, depth;
+	bool hitBy(LegacyBall& ball)
+	{
+		float top = x - width * 0.5f - ball.getRadius(), down = x + width * 0.5f + ball.getRadius();
+		float left = z - depth * 0.5f - ball.getRadius(), right = z + depth * 0.5f + ball.getRadius();
+		if (!((top <= ball.getX() && ball.getX() <= down) && (left <= ball.getZ() && ball.getZ() <= right)))
+			return false;
+		top += ball.getRadius(); down -= ball.getRadius(); left += ball.getRadius(); right -= ball.getRadius();
+		bool inX = top <= ball.getX() && ball.getX() <= down;
+		bool inZ = left <= ball.getZ() && ball.getZ() <= right;
+		if (inX && !inZ) ball.vz = -ball.vz;
+		if (inZ && !inX) ball.vx = -ball.vx;
+		return true;
+	}
+};
+
+// one pair with a known answer: 'a' has to leave along (nx, nz) by 'depth'
+// (0 for a miss), and the reversed order reports the flipped normal, the
+// same depth and its contact on a, the deepest point of a inside b
+template<class A, class B>
+static bool checkPair(const char* name, const A& a, const B& b, float nx, float nz, float depth)
+{
+	const float tol = 2e-3f;
+	sim::Manifold m, r;
+	m.normal = m.point = r.normal = r.point = sim::Vec2(0, 0);
+	m.depth  = r.depth = 0;
+	bool hit = sim::collide(a, b, m), hitR = sim::collide(b, a, r);
+	bool ok = hit == (depth > 0) && hitR == hit;
+	if (ok && hit) {
+		sim::Vec2 onA = m.point - m.normal * m.depth;
+		ok = std::fabs(sim::toFloat(m.normal.x) - nx) < tol && std::fabs(sim::toFloat(m.normal.z) - nz) < tol &&
+			std::fabs(sim::toFloat(m.depth) - depth) < tol &&
+			std::fabs(sim::toFloat(r.normal.x) + nx) < tol && std::fabs(sim::toFloat(r.normal.z) + nz) < tol &&
+			std::fabs(sim::toFloat(r.depth) - depth) < tol &&
+			std::fabs(sim::toFloat(r.point.x - onA.x)) < tol && std::fabs(sim::toFloat(r.point.z - onA.z)) < tol;
+	}
+	if (!ok)
+		printf("dispatch    %s: hit %d/%d normal (%.3f %.3f) depth %.3f, reversed (%.3f %.3f) %.3f; want (%.3f %.3f) %.3f\n",
+			name, hit, hitR, sim::toFloat(m.normal.x), sim::toFloat(m.normal.z), sim::toFloat(m.depth),
+			sim::toFloat(r.normal.x), sim::toFloat(r.normal.z), sim::toFloat(r.depth), nx, nz, depth);
+	return ok;
+}
+
+// the capsule pairs against hand-worked cases, and a capsule with both ends
+// at one point against the sphere routines it must match
+static bool checkCapsules(void)
+{
+	using sim::toVec2;
+	using sim::Scalar;
+	sim::Aabb box;
+	box.lo = toVec2(-1.0f, -1.0f);
+	box.hi = toVec2(1.0f, 1.0f);
+	const float diag = 0.70710678f, gap = 1.76776695f;  // corner (1, 1) to the line x + z = 4.5
+
+	bool ok = true;
+	ok = checkPair("capsule/box face",   sim::Capsule(toVec2(-2.0f, 1.5f), toVec2(2.0f, 1.5f), Scalar(0.75f)), box, 0.0f, 1.0f, 0.25f) && ok;
+	ok = checkPair("capsule/box through", sim::Capsule(toVec2(-3.0f, 0.5f), toVec2(3.0f, 0.5f), Scalar(0.1f)), box, 0.0f, 1.0f, 0.6f) && ok;
+	ok = checkPair("capsule/box corner", sim::Capsule(toVec2(1.5f, 3.0f), toVec2(3.0f, 1.5f), Scalar(2)), box, diag, diag, 2.0f - gap) && ok;
+	ok = checkPair("capsule/box miss",   sim::Capsule(toVec2(1.5f, 3.0f), toVec2(3.0f, 1.5f), Scalar(1)), box, 0.0f, 0.0f, 0.0f) && ok;
+	ok = checkPair("capsule/capsule parallel", sim::Capsule(toVec2(0.0f, 0.0f), toVec2(2.0f, 0.0f), Scalar(0.5f)),
+		sim::Capsule(toVec2(1.0f, 0.8f), toVec2(3.0f, 0.8f), Scalar(0.5f)), 0.0f, -1.0f, 0.2f) && ok;
+	ok = checkPair("capsule/capsule end", sim::Capsule(toVec2(0.0f, 1.0f), toVec2(0.0f, 3.0f), Scalar(0.5f)),
+		sim::Capsule(toVec2(-1.0f, 0.0f), toVec2(1.0f, 0.0f), Scalar(0.75f)), 0.0f, 1.0f, 0.25f) && ok;
+	ok = checkPair("capsule/capsule skew", sim::Capsule(toVec2(2.0f, 0.5f), toVec2(3.0f, 2.0f), Scalar(0.5f)),
+		sim::Capsule(toVec2(-1.0f, 0.0f), toVec2(1.5f, 0.0f), Scalar(0.25f)), diag, diag, 0.75f - 1.0f / (2.0f * diag)) && ok;
+	ok = checkPair("capsule/sphere",     sim::Capsule(toVec2(-1.0f, 1.0f), toVec2(1.0f, 1.0f), Scalar(0.5f)),
+		sim::Sphere(toVec2(0.5f, 0.0f), Scalar(0.75f)), 0.0f, 1.0f, 0.25f) && ok;
+
+	const sim::Capsule wall(toVec2(-1.0f, -2.0f), toVec2(1.5f, 2.0f), Scalar(0.3f));
+	int mismatches = 0;
+	for (int i = 0; i < 2000; i++) {
+		sim::Vec2 p = toVec2(frand(-2.5f, 2.5f), frand(-3.0f, 3.0f));
+		sim::Manifold ms, mc;
+		bool hs = sim::collide(sim::Sphere(p, BALL_RADIUS), box, ms);
+		bool hc = sim::collide(sim::Capsule(p, p, BALL_RADIUS), box, mc);
+		if (hs != hc || (hs && (ms.normal.x != mc.normal.x || ms.normal.z != mc.normal.z || ms.depth != mc.depth)))
+			mismatches++;
+		hs = sim::collide(sim::Sphere(p, BALL_RADIUS), wall, ms);
+		hc = sim::collide(sim::Capsule(p, p, BALL_RADIUS), wall, mc);
+		if (hs != hc || (hs && (ms.normal.x != mc.normal.x || ms.normal.z != mc.normal.z || ms.depth != mc.depth)))
+			mismatches++;
+	}
+	if (mismatches)
+		printf("dispatch    point capsule differs from the sphere %d times\n", mismatches);
+	return ok && mismatches == 0;
+}
+
+static bool benchDispatch(void)
+{
+	Field field;
+	makeField(field, 54);
+
+	std::vector<sim::Sphere> spheres;
+	std::vector<sim::Aabb>   boxes(field.walls, field.walls + 3);
+	std::vector<LegacySphere> legacySpheres(field.targets.size());
+	std::vector<LegacyWall>   legacyWalls(3);
+	for (size_t i = 0; i < field.targets.size(); i++) {
+		spheres.push_back(sim::Sphere(field.targets[i], BALL_RADIUS));
+		legacySpheres[i].x = sim::toFloat(field.targets[i].x); legacySpheres[i].z = sim::toFloat(field.targets[i].z); legacySpheres[i].r = sim::toFloat(BALL_RADIUS);
+	}
+	for (int i = 0; i < 3; i++) {
+		const sim::Aabb& w = field.walls[i];
+		legacyWalls[i].x = sim::toFloat((w.lo.x + w.hi.x) * sim::Scalar(0.5f)); legacyWalls[i].width = sim::toFloat(w.hi.x - w.lo.x);
+		legacyWalls[i].z = sim::toFloat((w.lo.z + w.hi.z) * sim::Scalar(0.5f)); legacyWalls[i].depth = sim::toFloat(w.hi.z - w.lo.z);
+	}
+
+	const int BALLS = 4096;
+	std::vector<sim::Sphere> balls(BALLS);
+	for (int i = 0; i < BALLS; i++)
+		balls[i] = sim::Sphere(sim::toVec2(frand(-4.5f, 4.5f), frand(-3.1f, 3.1f)), BALL_RADIUS);
+
+	const int ROUNDS = 200;
+	long long pairs = (long long)ROUNDS * BALLS * (long long)(spheres.size() + boxes.size());
+
+	int hits = 0;
+	double t0 = nowSeconds();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int b = 0; b < BALLS; b++) {
+			sim::Vec2 pos = balls[b].center, vel = sim::toVec2(1.0f, 0.5f);
+			sim::Manifold m;
+			for (size_t i = 0; i < spheres.size(); i++)
+				if (sim::collide(sim::Sphere(pos, BALL_RADIUS), spheres[i], m)) { sim::deflect(vel, m); hits++; }
+			for (size_t i = 0; i < boxes.size(); i++)
+				if (sim::collide(sim::Sphere(pos, BALL_RADIUS), boxes[i], m)) { sim::bounce(pos, vel, m); hits++; }
+		}
+	}
+	double typed = nowSeconds() - t0;
+
+	int legacyHits = 0;
+	t0 = nowSeconds();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int b = 0; b < BALLS; b++) {
+			LegacyBall ball = { sim::toFloat(balls[b].center.x), sim::toFloat(balls[b].center.z), sim::toFloat(BALL_RADIUS), 1.0f, 0.5f };
+			for (size_t i = 0; i < legacySpheres.size(); i++)
+				if (legacySpheres[i].hitBy(ball)) legacyHits++;
+			for (size_t i = 0; i < legacyWalls.size(); i++)
+				if (legacyWalls[i].hitBy(ball)) legacyHits++;
+		}
+	}
+	double direct = nowSeconds() - t0;
+
+	printf("dispatch    templated %6.2f ns/pair   per-class direct %6.2f ns/pair   (hits %d / %d)\n",
+		typed * 1e9 / (double)pairs, direct * 1e9 / (double)pairs, hits, legacyHits);
+	return checkCapsules();
+}
+
+// cost of one World::step(), and the guarantee that it never allocates
+static bool benchWorld(void)
+{
+	Field field;
+	makeField(field, 54);
+
+	sim::World world;
+	if (!world.init(1 << 20) || !world.loadLevel(levelOf(field)))
+		return false;
+
+	const int FRAMES = 200000;
+	const float DT = 0.016f * 0.7f;   // EnterMsgLoop's scale at 60 Hz
+	unsigned long allocations = 0;
+	int lost = 0, hits = 0;
+	double t0 = nowSeconds();
+	for (int f = 0; f < FRAMES; f++) {
+		if (!world.isPlaying())
+			world.launch();
+		world.movePaddle(sim::Scalar(std::sin(f * 0.01f) * 2.5f));
+
+		NoAllocScope noAlloc;
+		world.step(sim::Scalar(DT));
+		allocations += noAlloc.count();
+
+		for (int e = 0; e < world.eventCount(); e++) {
+			if (world.events()[e].kind == sim::EVENT_BALL_LOST) lost++;
+			if (world.events()[e].kind == sim::EVENT_TARGET_HIT) hits++;
+		}
+	}
+	double elapsed = nowSeconds() - t0;
+
+	printf("world       %7.1f ns/step  (%d target hits, %d balls lost, arena %u/%u bytes)  heap allocations in step: %lu%s\n",
+		elapsed * 1e9 / FRAMES, hits, lost, (unsigned)world.arena().highWater(), (unsigned)world.arena().capacity(),
+		allocations, NoAllocScope::hookEnabled() ? "" : " (hook not compiled in)");
+	return allocations == 0;
+}
+
+// -----------------------------------------------------------------------------
+// Very large level split across threads
+// -----------------------------------------------------------------------------
+
+// a square room of side 'size' packed with targets, open on the right, with
+// 'ballCount' balls already flying through it
+struct BigLevel
+{
+	std::vector<sim::Vec2> targets;
+	std::vector<sim::Ball> balls;
+	sim::Aabb              walls[3];
+	sim::LevelDesc         desc;
+};
+
+static void makeBigLevel(BigLevel& b, float size, int ballCount)
+{
+	float h = size * 0.5f;
+	b.walls[0] = sim::Aabb(sim::toVec2(-h, h), sim::toVec2(h, h + 0.2f));
+	b.walls[1] = sim::Aabb(sim::toVec2(-h, -h - 0.2f), sim::toVec2(h, -h));
+	b.walls[2] = sim::Aabb(sim::toVec2(-h - 0.2f, -h - 0.2f), sim::toVec2(-h, h + 0.2f));
+
+	s_rng = 777;
+	b.targets.clear();
+	for (float z = -h + 0.5f; z < h - 0.5f; z += 0.5f)
+		for (float x = -h + 0.5f; x < h - 2.0f; x += 0.5f)
+			if (frand(0.0f, 1.0f) < 0.8f)
+				b.targets.push_back(sim::toVec2(x + frand(-0.02f, 0.02f), z + frand(-0.02f, 0.02f)));
+
+	b.balls.resize(ballCount);
+	for (int i = 0; i < ballCount; i++) {
+		float a = frand(0.0f, 6.2831853f);
+		b.balls[i].pos = sim::toVec2(frand(-h + 1.0f, h - 1.0f), frand(-h + 1.0f, h - 1.0f));
+		b.balls[i].vel = sim::toVec2(std::cos(a) * 3.0f, std::sin(a) * 3.0f);
+	}
+
+	sim::LevelDesc& d = b.desc;
+	d.spheres     = &b.targets[0];
+	d.sphereCount = (int)b.targets.size();
+	d.bricks      = NULL;
+	d.brickCount  = 0;
+	d.walls       = b.walls;
+	d.wallCount   = 3;
+	d.exitX       = sim::Scalar(h);
+	d.paddleStart = sim::toVec2(h - 0.5f, 0.0f);
+	d.paddleMinZ  = sim::Scalar(-h) + BALL_RADIUS;
+	d.paddleMaxZ  = sim::Scalar(h) - BALL_RADIUS;
+	d.balls       = &b.balls[0];
+	d.ballCount   = ballCount;
+	d.arenaShapes     = NULL;
+	d.arenaShapeCount = 0;
+	d.fieldCellSize   = 0;
+}
+
+// World::step() on 1..N threads: time per step, and the state hash after every
+// step must match the single-threaded run exactly
+static bool benchParallel(void)
+{
+	BigLevel level;
+	makeBigLevel(level, 110.0f, 4096);
+
+	const int STEPS = 400;
+	const float DT = 0.016f * 0.7f;
+	int maxThreads = JobSystem::hardwareThreads();
+	if (maxThreads < 4)
+		maxThreads = 4;   // still checks determinism on small machines
+
+	std::vector<unsigned long long> reference(STEPS);
+	double serial = 0.0;
+	bool same = true;
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		JobSystem jobs;
+		jobs.start(threads);
+		sim::World world;
+		world.setJobSystem(&jobs);
+		if (!world.init(64 << 20) || !world.loadLevel(level.desc))
+			return false;
+		world.launch();
+
+		int mismatch = -1;
+		double elapsed = 0.0;
+		for (int s = 0; s < STEPS; s++) {
+			double t0 = nowSeconds();
+			world.step(sim::Scalar(DT));
+			elapsed += nowSeconds() - t0;
+
+			unsigned long long h = world.stateHash();
+			if (threads == 1)
+				reference[s] = h;
+			else if (h != reference[s] && mismatch < 0)
+				mismatch = s;
+		}
+		if (threads == 1)
+			serial = elapsed;
+
+		printf("parallel    %2d thread%s %8.1f us/step  speedup %4.2fx  (%d targets, %d balls, %d live)  %s\n",
+			threads, threads == 1 ? " " : "s", elapsed * 1e6 / STEPS, serial / elapsed,
+			world.sphereCount(), world.ballCount(), world.liveTargets(),
+			threads == 1 ? "reference" : mismatch < 0 ? "bit-identical" : "DIVERGED");
+		if (mismatch >= 0) {
+			printf("            first divergent step %d\n", mismatch);
+			same = false;
+		}
+	}
+	printf("            (%d hardware threads)\n", JobSystem::hardwareThreads());
+	return same;
+}
+
+// -----------------------------------------------------------------------------
+// Debris particles
+// -----------------------------------------------------------------------------
+
+static void fillDebris(sim::ParticleSystem& ps, int count)
+{
+	ps.clear();
+	for (int i = 0; ps.count() < count; i++)
+		ps.emitBurst(frand(-4.0f, 4.0f), 0.21f, frand(-3.0f, 3.0f), 100, 1.5f, 1.2f, 0xffffff00);
+}
+
+// update cost at 10k and 100k live particles, SSE against one-at-a-time, and
+// the two must leave exactly the same particles behind
+static bool benchParticles(void)
+{
+	const int SIZES[] = { 10000, 100000 };
+	const float DT = 0.016f * 0.7f;
+	bool same = true;
+
+	for (int s = 0; s < 2; s++) {
+		int n = SIZES[s];
+		sim::ParticleSystem simd, scalar;
+		if (!simd.init(n, 0.015f) || !scalar.init(n, 0.015f))
+			return false;
+
+		// steady state: a frame tops the pool back up with fresh bursts, then updates
+		double t[2] = { 0.0, 0.0 };
+		int frames = 2000000 / n + 20;
+		unsigned long allocations = 0;
+		for (int pass = 0; pass < 2; pass++) {
+			sim::ParticleSystem& ps = pass == 0 ? simd : scalar;
+			s_rng = 99;
+			fillDebris(ps, n);
+			for (int f = 0; f < frames; f++) {
+				ps.emitBurst(frand(-4.0f, 4.0f), 0.21f, frand(-3.0f, 3.0f), n / 50, 1.5f, 1.2f, 0xffffff00);
+				NoAllocScope noAlloc;
+				double t0 = nowSeconds();
+				if (pass == 0) ps.update(DT);
+				else           ps.updateScalar(DT);
+				t[pass] += nowSeconds() - t0;
+				allocations += noAlloc.count();
+			}
+		}
+
+		bool match = simd.count() == scalar.count();
+		for (int i = 0; match && i < simd.count(); i++)
+			match = simd.posX()[i] == scalar.posX()[i] && simd.posY()[i] == scalar.posY()[i] &&
+				simd.posZ()[i] == scalar.posZ()[i] && simd.life()[i] == scalar.life()[i];
+
+		printf("particles %6d  sse %8.1f us/update (%5.2f ns/particle)   scalar %8.1f us/update   %d live after %d frames, %s, allocations %lu\n",
+			n, t[0] * 1e6 / frames, t[0] * 1e9 / frames / n, t[1] * 1e6 / frames,
+			simd.count(), frames, match ? "identical" : "DIFFERENT", allocations);
+		same = same && match && allocations == 0;
+	}
+	return same;
+}
+
+// -----------------------------------------------------------------------------
+// Distance field arena
+// -----------------------------------------------------------------------------
+
+static volatile float s_fieldSink;
+
+static sim::ArenaShape arenaShape(int kind, const sim::Vec2& a, const sim::Vec2& b, sim::Scalar radius)
+{
+	sim::ArenaShape s;
+	s.kind   = kind;
+	s.a      = a;
+	s.b      = b;
+	s.radius = radius;
+	s.inside = false;
+	return s;
+}
+
+// Ball-vs-arena from one field sample against testing every wall: the game's
+// three boxes, then an arena with angled walls and obstacles. Accuracy is
+// measured where it matters, within a ball radius of the surface.
+static bool benchField(void)
+{
+	Field field;
+	makeField(field, 0);
+
+	std::vector<sim::ArenaShape> shapes;
+	for (int i = 0; i < 3; i++)
+		shapes.push_back(arenaShape(sim::ARENA_BOX, field.walls[i].lo, field.walls[i].hi, 0));
+
+	const int QUERIES = 1000000;
+	std::vector<sim::Vec2> points(QUERIES);
+	s_rng = 31;
+	for (int i = 0; i < QUERIES; i++)
+		points[i] = sim::toVec2(frand(-4.8f, 4.8f), frand(-3.3f, 3.3f));
+
+	bool ok = true;
+	for (int round = 0; round < 2; round++) {
+		if (round == 1) {
+			// angled walls, a pillar, rounded blocks and thin slanted bars
+			shapes.push_back(arenaShape(sim::ARENA_SEGMENT, sim::toVec2(-4.0f, 3.0f), sim::toVec2(-4.5f, 0.0f), sim::Scalar(0.06f)));
+			shapes.push_back(arenaShape(sim::ARENA_SEGMENT, sim::toVec2(-4.5f, 0.0f), sim::toVec2(-4.0f, -3.0f), sim::Scalar(0.06f)));
+			shapes.push_back(arenaShape(sim::ARENA_CIRCLE, sim::Vec2(0, 0), sim::Vec2(0, 0), sim::Scalar(0.35f)));
+			for (int k = 0; k < 6; k++) {
+				float x = -3.0f + k * 1.2f;
+				shapes.push_back(arenaShape(sim::ARENA_BOX, sim::toVec2(x, 1.6f), sim::toVec2(x + 0.5f, 2.2f), sim::Scalar(0.12f)));
+				shapes.push_back(arenaShape(sim::ARENA_SEGMENT, sim::toVec2(x, -2.2f), sim::toVec2(x + 0.6f, -1.4f), sim::Scalar(0.05f)));
+			}
+		}
+		int n = (int)shapes.size();
+
+		LinearArena arena;
+		sim::DistanceField sdf;
+		double t0 = nowSeconds();
+		if (!arena.init(8 << 20) ||
+			!sdf.bake(arena, sim::Aabb(sim::toVec2(-5.5f, -4.0f), sim::toVec2(5.5f, 4.0f)), sim::Scalar(0.05f), &shapes[0], n))
+			return false;
+		double bake = nowSeconds() - t0;
+
+		// per-wall: the exact distance to every shape, the nearest one wins
+		float sink = 0.0f;
+		int contactsExact = 0;
+		t0 = nowSeconds();
+		for (int i = 0; i < QUERIES; i++) {
+			sim::Vec2 g(0, 0), best(0, 0);
+			sim::Scalar d = sim::SCALAR_MAX;
+			for (int k = 0; k < n; k++) {
+				sim::Scalar dk = sim::arenaDistance(shapes[k], points[i], g);
+				if (dk < d) { d = dk; best = g; }
+			}
+			if (d < BALL_RADIUS) { contactsExact++; sink += sim::toFloat(best.x); }
+		}
+		double exact = nowSeconds() - t0;
+
+		int contactsField = 0;
+		t0 = nowSeconds();
+		for (int i = 0; i < QUERIES; i++) {
+			sim::Manifold m;
+			if (sim::collide(sim::Sphere(points[i], BALL_RADIUS), sdf, m)) { contactsField++; sink += sim::toFloat(m.normal.x); }
+		}
+		double sampled = nowSeconds() - t0;
+
+		// the game's wall loop, for the three-box arena
+		double boxes = 0.0;
+		if (round == 0) {
+			t0 = nowSeconds();
+			for (int i = 0; i < QUERIES; i++) {
+				for (int k = 0; k < 3; k++) {
+					sim::Manifold m;
+					if (sim::collide(sim::Sphere(points[i], BALL_RADIUS), field.walls[k], m)) sink += sim::toFloat(m.normal.x);
+				}
+			}
+			boxes = nowSeconds() - t0;
+		}
+
+		// error near the surface, where contacts are decided
+		float worstD = 0.0f;
+		double sumAngle = 0.0;
+		int near = 0;
+		for (int i = 0; i < QUERIES; i += 7) {
+			sim::Vec2 g(0, 0), best(0, 0), n2(0, 0);
+			sim::Scalar d = sim::SCALAR_MAX;
+			for (int k = 0; k < n; k++) {
+				sim::Scalar dk = sim::arenaDistance(shapes[k], points[i], g);
+				if (dk < d) { d = dk; best = g; }
+			}
+			if (d < 0 || d > BALL_RADIUS)
+				continue;
+			sim::Scalar ds = sdf.sample(points[i], n2);
+			float err = sim::toFloat(sim::scalarAbs(ds - d));
+			float angle = std::acos(sim::toFloat(sim::clampf(sim::dot(best, n2), -1, 1)));
+			if (err > worstD) worstD = err;
+			sumAngle += angle;
+			near++;
+		}
+
+		printf("field  %2d shapes  per-wall %6.2f ns/ball  field %5.2f ns/ball  (%dx%d nodes, %u KB, baked in %.2f ms)\n",
+			n, exact * 1e9 / QUERIES, sampled * 1e9 / QUERIES, sdf.width(), sdf.height(),
+			(unsigned)(sdf.bytes() / 1024), bake * 1e3);
+		if (round == 0)
+			printf("       3 boxes   game wall loop %5.2f ns/ball\n", boxes * 1e9 / QUERIES);
+		printf("       contacts exact %d field %d   worst distance error %.4f  mean normal error %.2f deg\n",
+			contactsExact, contactsField, worstD, near > 0 ? sumAngle / near * 57.29578 : 0.0);
+		s_fieldSink = sink;   // keeps the timed loops from being optimized away
+
+		// the worst errors sit on the creases where two walls meet and stay
+		// under a cell; a ball radius is 0.21
+		ok = ok && worstD < sim::toFloat(sdf.cellSize());
+	}
+	return ok;
+}
+
+// -----------------------------------------------------------------------------
+// Fixed-point arithmetic
+// -----------------------------------------------------------------------------
+
+static volatile float s_fixedSink;
+
+// pos += vel * dt over arrays of float, of Fixed one at a time and of Fixed
+// through fixedMulAdd(). The two Fixed loops must give the same bits, and
+// stay within the rounding of one step per step of the float loop.
+static bool benchFixed(void)
+{
+	const int N = 4096, STEPS = 2000;
+	const float DT = 0.016f * 0.7f;
+	std::vector<float> pf(N), vf(N);
+	std::vector<sim::Fixed> p1(N), p2(N), v(N);
+	s_rng = 5;
+	for (int i = 0; i < N; i++) {
+		pf[i] = frand(-4.0f, 4.0f);
+		vf[i] = frand(-3.0f, 3.0f);
+		p1[i] = p2[i] = sim::Fixed(pf[i]);
+		v[i]  = sim::Fixed(vf[i]);
+	}
+	const sim::Fixed dt(DT);
+
+	double t[3] = { 0.0, 0.0, 0.0 };
+	for (int s = 0; s < STEPS; s++) {
+		double t0 = nowSeconds();
+		for (int i = 0; i < N; i++)
+			pf[i] += vf[i] * DT;
+		double t1 = nowSeconds();
+		for (int i = 0; i < N; i++)
+			p1[i] += v[i] * dt;
+		double t2 = nowSeconds();
+		sim::fixedMulAdd(&p2[0], &v[0], dt, N);
+		double t3 = nowSeconds();
+		t[0] += t1 - t0;
+		t[1] += t2 - t1;
+		t[2] += t3 - t2;
+	}
+
+	bool same = true;
+	float worst = 0.0f, sink = 0.0f;
+	for (int i = 0; i < N; i++) {
+		same = same && p1[i] == p2[i];
+		float err = std::fabs(sim::toFloat(p2[i]) - pf[i]);
+		if (err > worst) worst = err;
+		sink += pf[i] + sim::toFloat(p1[i]);
+	}
+	s_fixedSink = sink;
+
+	// per step: a Fixed product rounds down by under one unit, from a dt and
+	// velocities rounded by half a unit each, and a float sum rounds by half
+	// an ulp of the largest position
+	float unit = 1.0f / (float)sim::FIXED_ONE;
+	float reach = 4.0f + 3.0f * DT * STEPS;
+	float allowed = STEPS * (unit + 0.5f * unit * 3.0f + 0.5f * unit * DT + 0.5f * FLT_EPSILON * reach);
+	double per = 1e9 / ((double)N * STEPS);
+	printf("fixed   %s  float %5.3f ns/value   one at a time %5.3f ns/value   fixedMulAdd %5.3f ns/value   %s, worst drift from float %.5f (allowed %.5f)\n",
+		sim::FIXED_NAME, t[0] * per, t[1] * per, t[2] * per, same ? "identical" : "DIFFERENT", worst, allowed);
+	return same && worst <= allowed;
+}
+
+struct Bench
+{
+	const char* name;
+	bool (*run)(void);
+};
+
+static const Bench s_benches[] = {
+	{ "trajectory",       benchTrajectory },
+	{ "trajectory-check", checkTrajectory },
+	{ "dispatch",         benchDispatch },
+	{ "world",            benchWorld },
+	{ "parallel",         benchParallel },
+	{ "particles",        benchParticles },
+	{ "field",            benchField },
+	{ "fixed",            benchFixed },
+};
+
+int main(int argc, char* argv[])
+{
+	const int count = sizeof(s_benches) / sizeof(s_benches[0]);
+	int failed = 0;
+	for (int i = 0; i < count; i++) {
+		bool selected = argc < 2;
+		for (int a = 1; a < argc; a++)
+			if (strcmp(argv[a], s_benches[i].name) == 0) selected = true;
+		if (selected && !s_benches[i].run()) {
+			printf("%s: FAILED\n", s_benches[i].name);
+			failed++;
+		}
+	}
+	return failed ? 1 : 0;
+}
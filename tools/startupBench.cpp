@@ -0,0 +1,352 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: startupBench.cpp
+// 
+// Desc: Times the game's startup without a window: the old serial Setup()
+//       against the load graph WinMain now runs (see taskGraph.h), and
+//       reports time to first frame and time until everything is loaded.
+//       The device is stood in for by a wait on the main thread and each
+//       upload by a copy of the mesh into a staging buffer, which is what
+//       filling a managed D3DX mesh costs on the CPU. The serial Setup()
+//       generates every mesh's vertices where it creates it, as
+//       D3DXCreateSphere and D3DXCreateBox do, and draws its first frame
+//       like the graph does. Build it next to the game sources, e.g.
+//
+//           cl /O2 /EHsc /I.. startupBench.cpp ..\taskGraph.cpp ..\meshGen.cpp ..\level.cpp ..\gameWorld.cpp ..\distanceField.cpp ..\particles.cpp ..\jobSystem.cpp ..\arena.cpp ..\memTrack.cpp ..\perfCounters.cpp ..\mappedFile.cpp
+//           g++ -O2 -I.. startupBench.cpp ../taskGraph.cpp ../meshGen.cpp ../level.cpp ../gameWorld.cpp ../distanceField.cpp ../particles.cpp ../jobSystem.cpp ../arena.cpp ../memTrack.cpp ../perfCounters.cpp ../mappedFile.cpp -pthread
+//
+//       usage: startupBench [-targets n] [-tess n] [-device ms] [-create us] [-threads n] [-runs n]
+//       -targets builds a room of n targets instead of the built-in level,
+//       -tess sets the ball meshes' slices and stacks (50 in the game),
+//       -device how long window and device creation are taken to be and
+//       -create what the device adds to each mesh it creates (0; the game's
+//       startup.txt times every upload on the real device).
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "taskGraph.h"
+#include "meshGen.h"
+#include "level.h"
+#include "particles.h"
+#include "jobSystem.h"
+#include "perfCounters.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// what virtualLego.cpp uses
+static const float  BALL_RADIUS      = 0.21f;
+static const size_t LEVEL_BYTES      = 1 << 20;
+static const int    MAX_DEBRIS       = 100000;
+static const int    UPLOAD_BUDGET_US = 2000;
+static const int    FRAME_US         = 1000;    // drawing a frame while loading, about
+static const int    SPHERE_LODS      = 4;
+static const int    LOD_TESS[SPHERE_LODS] = { 0, 30, 18, 10 };  // 0 is -tess
+
+struct Options
+{
+	int targets;                        // 0 is the built-in level
+	int tess;
+	int deviceMs;
+	int createUs;
+	int threads;
+	int runs;
+};
+
+// everything startup makes; one per run
+struct Load
+{
+	const Options*      opt;
+	sim::Level          level;
+	sim::World          world;
+	sim::ParticleSystem debris;
+	gfx::MeshData       ball[SPHERE_LODS];
+	gfx::MeshData       light;
+	gfx::MeshData       boxes[5];       // plane, three walls, brick
+	std::vector<char>   staging;        // stands in for the locked vertex and index buffers
+	int                 uploads;
+};
+
+struct Upload
+{
+	Load*                load;
+	const gfx::MeshData* mesh;
+};
+
+static unsigned int s_rng = 12345;
+static float frand(float lo, float hi)
+{
+	s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+	return lo + (hi - lo) * ((s_rng & 0xffffff) / 16777216.0f);
+}
+
+// a square room with 'targets' spheres on a jittered grid
+static void roomLevel(sim::Level& level, int targets)
+{
+	int   side = (int)std::ceil(std::sqrt((float)targets));
+	float h = side * 0.25f + 1.0f;
+
+	level.clear();
+	s_rng = 4242u + (unsigned)targets;
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h, h), sim::toVec2(h, h + 0.12f)));
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h, -h - 0.12f), sim::toVec2(h, -h)));
+	level.walls.push_back(sim::Aabb(sim::toVec2(-h - 0.12f, -h - 0.12f), sim::toVec2(-h, h + 0.12f)));
+	for (int i = 0; i < targets; i++)
+		level.spheres.push_back(sim::toVec2(-h + 0.5f + (i % side) * 0.5f + frand(-0.03f, 0.03f),
+			-h + 1.0f + (i / side) * 0.5f + frand(-0.03f, 0.03f)));
+	level.exitX       = sim::Scalar(h + 1.0f);
+	level.paddleStart = sim::toVec2(h + 0.5f, 0.0f);
+	level.paddleMinZ  = sim::Scalar(-h + BALL_RADIUS);
+	level.paddleMaxZ  = sim::Scalar(h - BALL_RADIUS);
+}
+
+//
+// The tasks, as in virtualLego.cpp
+//
+
+static bool loadLevelTask(void* ctx)
+{
+	Load* l = (Load*)ctx;
+	if (l->opt->targets > 0)
+		roomLevel(l->level, l->opt->targets);
+	else
+		sim::defaultLevel(l->level);
+	return l->level.walls.size() >= 3;
+}
+
+static bool loadWorldTask(void* ctx)
+{
+	Load* l = (Load*)ctx;
+	size_t bytes = LEVEL_BYTES + l->level.spheres.size() * 128;   // about 85 a target
+	return l->world.init(bytes) && l->world.loadLevel(l->level.desc());
+}
+
+static bool createDebrisTask(void* ctx)
+{
+	return ((Load*)ctx)->debris.init(MAX_DEBRIS, 0.0f);
+}
+
+static bool buildBallMeshTask(void* ctx)
+{
+	Load* l = (Load*)ctx;
+	for (int i = 0; i < SPHERE_LODS; i++) {
+		int tess = i == 0 ? l->opt->tess : LOD_TESS[i];
+		if (!gfx::buildSphere(BALL_RADIUS, tess, tess, l->ball[i]))
+			return false;
+	}
+	return true;
+}
+
+static bool buildBoxMeshesTask(void* ctx)
+{
+	Load* l = (Load*)ctx;
+	gfx::buildBox(9.0f, 0.03f, 6.0f, l->boxes[0]);
+	for (int i = 0; i < 3; i++) {
+		const sim::Aabb& w = l->level.walls[i];
+		gfx::buildBox(sim::toFloat(w.hi.x - w.lo.x), 0.3f, sim::toFloat(w.hi.z - w.lo.z), l->boxes[1 + i]);
+	}
+	gfx::buildBox(1.0f, 0.3f, 1.0f, l->boxes[4]);
+	return true;
+}
+
+static bool buildLightMeshTask(void* ctx)
+{
+	return gfx::buildSphere(0.1f, 10, 10, ((Load*)ctx)->light);
+}
+
+static void waitMicroseconds(uint64_t us)
+{
+	std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+static bool uploadTask(void* ctx)
+{
+	Upload* u = (Upload*)ctx;
+	if (u->load->opt->createUs > 0)
+		waitMicroseconds((uint64_t)u->load->opt->createUs);
+	size_t vb = u->mesh->vertices.size() * sizeof(gfx::MeshVertex);
+	size_t ib = u->mesh->indices.size() * sizeof(uint16_t);
+	std::vector<char>& staging = u->load->staging;
+	staging.resize(vb + ib);
+	memcpy(&staging[0], &u->mesh->vertices[0], vb);
+	memcpy(&staging[vb], &u->mesh->indices[0], ib);
+	u->load->uploads++;
+	return true;
+}
+
+// in the game's order: three balls, five boxes, the light, the coarser targets
+static const int UPLOADS = 12;
+static const gfx::MeshData* uploadMesh(Load& l, int i)
+{
+	return i < 3 ? &l.ball[0] : i < 8 ? &l.boxes[i - 3] : i == 8 ? &l.light : &l.ball[i - 8];
+}
+
+// D3DXCreateSphere and D3DXCreateBox generate the vertices of every mesh they
+// make, so Setup() built the ball three times over before filling each
+static bool createSerial(Load& l, int i)
+{
+	gfx::MeshData mesh;
+	if (i < 3 || i > 8) {
+		int tess = i < 3 ? l.opt->tess : LOD_TESS[i - 8];
+		if (!gfx::buildSphere(BALL_RADIUS, tess, tess, mesh))
+			return false;
+	}
+	else if (i == 8) {
+		if (!gfx::buildSphere(0.1f, 10, 10, mesh))
+			return false;
+	}
+	else if (i == 3) {
+		gfx::buildBox(9.0f, 0.03f, 6.0f, mesh);
+	}
+	else if (i < 7) {
+		const sim::Aabb& w = l.level.walls[i - 4];
+		gfx::buildBox(sim::toFloat(w.hi.x - w.lo.x), 0.3f, sim::toFloat(w.hi.z - w.lo.z), mesh);
+	}
+	else {
+		gfx::buildBox(1.0f, 0.3f, 1.0f, mesh);
+	}
+	Upload u = { &l, &mesh };
+	return uploadTask(&u);
+}
+
+// Setup() as it was: device, then every step in turn, then the first frame
+static double runSerial(const Options& opt, Load& l)
+{
+	uint64_t t0 = perf::nowMicroseconds();
+	waitMicroseconds((uint64_t)opt.deviceMs * 1000);
+
+	bool ok = loadLevelTask(&l) && loadWorldTask(&l) && createDebrisTask(&l);
+	for (int i = 0; i < UPLOADS; i++)
+		ok = ok && createSerial(l, i);
+	if (!ok)
+		return -1.0;
+	waitMicroseconds(FRAME_US);
+	return (perf::nowMicroseconds() - t0) / 1000.0;
+}
+
+struct GraphResult
+{
+	double firstFrameMs;
+	double loadedMs;
+	int    frames;                      // presented before everything was in
+};
+
+// the load graph WinMain builds
+static bool runGraph(const Options& opt, Load& l, GraphResult& out, bool print)
+{
+	uint64_t t0 = perf::nowMicroseconds();
+
+	TaskGraph g;
+	int level  = g.add("level", loadLevelTask, &l);
+	int world  = g.add("world", loadWorldTask, &l);
+	g.add("debris", createDebrisTask, &l);
+	int balls  = g.add("ball mesh", buildBallMeshTask, &l);
+	int boxes  = g.add("box meshes", buildBoxMeshesTask, &l);
+	int light  = g.add("light mesh", buildLightMeshTask, &l);
+	int device = g.addEvent("window and device");
+	g.depend(world, level);
+	g.depend(boxes, level);
+
+	static const char* const names[UPLOADS] = { "upload targets", "upload red ball", "upload white ball",
+		"upload plane", "upload wall 0", "upload wall 1", "upload wall 2", "upload brick", "upload light",
+		"upload target lod 1", "upload target lod 2", "upload target lod 3" };
+	Upload u[UPLOADS];
+	for (int i = 0; i < UPLOADS; i++) {
+		u[i].load = &l;
+		u[i].mesh = uploadMesh(l, i);
+		int task = g.add(names[i], uploadTask, &u[i], TaskGraph::ON_MAIN);
+		g.depend(task, i < 3 || i > 8 ? balls : i < 8 ? boxes : light);
+		g.depend(task, device);
+	}
+	g.start(opt.threads);
+
+	waitMicroseconds((uint64_t)opt.deviceMs * 1000);
+	g.signal(device, true);
+
+	// frames go out from here on, placeholders first
+	out.frames = 0;
+	out.firstFrameMs = 0.0;
+	for (;;) {
+		g.runMain(UPLOAD_BUDGET_US);
+		waitMicroseconds(FRAME_US);
+		if (out.frames++ == 0)
+			out.firstFrameMs = (perf::nowMicroseconds() - t0) / 1000.0;
+		if (g.finished())
+			break;
+	}
+	out.loadedMs = (perf::nowMicroseconds() - t0) / 1000.0;
+
+	if (print)
+		g.print(stdout, t0);
+	return g.firstFailure() < 0;
+}
+
+static int usage(void)
+{
+	printf("usage: startupBench [-targets n] [-tess n] [-device ms] [-create us] [-threads n] [-runs n]\n");
+	return 2;
+}
+
+int main(int argc, char* argv[])
+{
+	Options opt;
+	opt.targets  = 0;
+	opt.tess     = 50;
+	opt.deviceMs = 100;
+	opt.createUs = 0;
+	opt.threads  = JobSystem::hardwareThreads() - 1;
+	opt.runs     = 3;
+	for (int a = 1; a < argc; a++) {
+		if (a + 1 >= argc)                        return usage();
+		if (strcmp(argv[a], "-targets") == 0)      opt.targets  = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-tess") == 0)    opt.tess     = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-device") == 0)  opt.deviceMs = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-create") == 0)  opt.createUs = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-threads") == 0) opt.threads  = atoi(argv[++a]);
+		else if (strcmp(argv[a], "-runs") == 0)    opt.runs     = atoi(argv[++a]);
+		else                                      return usage();
+	}
+	if (opt.threads < 1) opt.threads = 1;
+	if (opt.runs < 1) opt.runs = 1;
+
+	// best of each, alternating so both see the same machine
+	double serial = 0.0;
+	GraphResult best = { 0.0, 0.0, 0 };
+	int targets = 0;
+	for (int r = 0; r < opt.runs; r++) {
+		Load a;
+		a.opt = &opt; a.uploads = 0;
+		double s = runSerial(opt, a);
+		if (s < 0.0) {
+			fprintf(stderr, "serial load failed\n");
+			return 1;
+		}
+		if (r == 0 || s < serial)
+			serial = s;
+		targets = (int)(a.level.spheres.size() + a.level.bricks.size());
+
+		Load b;
+		b.opt = &opt; b.uploads = 0;
+		GraphResult g;
+		if (!runGraph(opt, b, g, r == opt.runs - 1)) {
+			fprintf(stderr, "graph load failed\n");
+			return 1;
+		}
+		if (r == 0 || g.loadedMs < best.loadedMs)
+			best = g;
+	}
+
+	printf("startup  %s level, %d targets, %dx%d ball mesh, device %d ms, %d us a mesh, %d load threads\n",
+		opt.targets > 0 ? "room" : "built-in", targets, opt.tess, opt.tess,
+		opt.deviceMs, opt.createUs, opt.threads);
+	printf("serial   first frame %8.2f ms   fully loaded %8.2f ms\n", serial, serial);
+	printf("graph    first frame %8.2f ms   fully loaded %8.2f ms   (%d frames while loading)\n",
+		best.firstFrameMs, best.loadedMs, best.frames);
+	printf("gain     first frame %8.2f ms   fully loaded %8.2f ms\n",
+		serial - best.firstFrameMs, serial - best.loadedMs);
+	return 0;
+}
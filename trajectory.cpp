@@ -0,0 +1,309 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: trajectory.cpp
+// 
+// Desc: Circle sweeps, the multi-bounce predictor and its walk over the
+//       target grid.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "trajectory.h"
+#include "shapes.h"
+
+// contacts closer than this to the previous one are the surface the ball is
+// just leaving, not a new hit
+static const sim::Scalar SWEEP_EPSILON = sim::Scalar(1e-6f);
+
+bool sim::sweepCircleCircle(Vec2 p, Vec2 d, Vec2 c, Scalar r, Scalar maxT, Scalar& t)
+{
+	Vec2  m  = p - c;
+	Scalar b  = dot(m, d);
+	if (b >= 0)                       // not moving towards the center
+		return false;
+	Scalar cc = dot(m, m) - r * r;
+	Scalar a  = dot(d, d);
+	Scalar disc = b * b - a * cc;
+	if (disc < 0)
+		return false;
+
+	Scalar hit = (-b - scalarSqrt(disc)) / a;
+	if (hit < 0) {
+		// already overlapping: the game resolves that on the very next step
+		if (cc > 0) return false;
+		hit = 0;
+	}
+	if (hit > maxT)
+		return false;
+	t = hit;
+	return true;
+}
+
+bool sim::sweepCircleAabb(Vec2 p, Vec2 d, const Aabb& box, Scalar r, Scalar maxT, Scalar& t, Vec2& n)
+{
+	// slab test against the box grown by r
+	Scalar tEnter = -SCALAR_MAX, tExit = SCALAR_MAX;
+	Vec2  enterN(0, 0);
+
+	const Scalar* pp = &p.x;
+	const Scalar* dd = &d.x;
+	const Scalar* lo = &box.lo.x;
+	const Scalar* hi = &box.hi.x;
+	for (int axis = 0; axis < 2; axis++) {
+		Scalar l = lo[axis] - r, h = hi[axis] + r;
+		if (dd[axis] == 0) {
+			if (pp[axis] < l || pp[axis] > h) return false;
+			continue;
+		}
+		// divided rather than scaled by 1 / dd, which a fixed-point
+		// reciprocal of a slow axis would overflow
+		Scalar t0 = (l - pp[axis]) / dd[axis];
+		Scalar t1 = (h - pp[axis]) / dd[axis];
+		Scalar sign = -1;
+		if (t0 > t1) { Scalar tmp = t0; t0 = t1; t1 = tmp; sign = 1; }
+		if (t0 > tEnter) {
+			tEnter = t0;
+			enterN = axis == 0 ? Vec2(sign, 0) : Vec2(0, sign);
+		}
+		if (t1 < tExit) tExit = t1;
+		if (tEnter > tExit) return false;
+	}
+	if (tExit < 0 || tEnter > maxT)
+		return false;
+
+	// a hit on the grown box outside both slabs of the original box is really a
+	// hit on the rounded corner. A ball that starts inside the grown box (just
+	// off a neighbouring brick, say) may still be in a corner the rounding cuts
+	// off, and then meets that corner on the way
+	Vec2 q = tEnter > 0 ? p + d * tEnter : p;
+	bool outX = q.x < box.lo.x || q.x > box.hi.x;
+	bool outZ = q.z < box.lo.z || q.z > box.hi.z;
+	if (outX && outZ) {
+		Vec2 corner(q.x < box.lo.x ? box.lo.x : box.hi.x, q.z < box.lo.z ? box.lo.z : box.hi.z);
+		Scalar tc;
+		if (!sweepCircleCircle(p, d, corner, r, maxT, tc))
+			return false;
+		Vec2 at = p + d * tc;
+		n = (at - corner) * (1 / r);
+		t = tc;
+		return true;
+	}
+	if (tEnter < 0)
+		return false;
+
+	n = enterN;
+	t = tEnter;
+	return true;
+}
+
+static bool wasRemoved(const int* removed, int count, int id)
+{
+	for (int i = 0; i < count; i++)
+		if (removed[i] == id)
+			return true;
+	return false;
+}
+
+// the earliest contact of one bounce found so far
+struct Nearest
+{
+	sim::Scalar best;
+	int         kind;
+	int         index;
+	int         item;           // grid item of a target or brick, -1 for the rest
+	sim::Vec2   normal;
+};
+
+// Sweeps grid item 'item'. On a tie the higher item wins, as it would in a
+// loop over the targets and then the bricks, so the grid walk picks the
+// same contact whatever order it meets the items in.
+static void sweepItem(const sim::TrajectoryScene& scene, int item, sim::Vec2 pos, sim::Vec2 vel,
+	const int* removed, int removedCount, Nearest& n)
+{
+	sim::Scalar t;
+	sim::Vec2   normal(0, 0);
+	int         kind, index;
+	if (item < scene.targetCount) {
+		index = item;
+		kind  = sim::CONTACT_TARGET;
+		if (scene.targetAlive != NULL && !scene.targetAlive[index])
+			return;
+		if (!sim::sweepCircleCircle(pos, vel, scene.targets[index], scene.targetRadius + scene.ballRadius, n.best, t))
+			return;
+	}
+	else {
+		index = item - scene.targetCount;
+		kind  = sim::CONTACT_BRICK;
+		if (scene.brickAlive != NULL && !scene.brickAlive[index])
+			return;
+		if (!sim::sweepCircleAabb(pos, vel, scene.bricks[index], scene.ballRadius, n.best, t, normal))
+			return;
+	}
+	if (t <= SWEEP_EPSILON || (t == n.best && item < n.item))
+		return;
+	if (wasRemoved(removed, removedCount, kind == sim::CONTACT_TARGET ? index : ~index))
+		return;
+	n.best = t; n.kind = kind; n.index = index; n.item = item; n.normal = normal;
+}
+
+static void sweepCell(const sim::TrajectoryScene& scene, int x, int z, sim::Vec2 pos, sim::Vec2 vel,
+	const int* removed, int removedCount, Nearest& n)
+{
+	const sim::TargetGrid& g = *scene.grid;
+	if (x < 0 || z < 0 || x >= g.width || z >= g.height)
+		return;
+	int cell = z * g.width + x;
+	for (int k = g.cellStart[cell]; k < g.cellStart[cell + 1]; k++)
+		sweepItem(scene, g.cellItems[k], pos, vel, removed, removedCount, n);
+}
+
+// Walks the cells the ball's center passes through until it enters one after
+// n.best, sweeping the items of each cell and its eight neighbours. The ball
+// touches an item from within its own radius of it, so while that is no more
+// than a cell the neighbours hold everything it can hit. The walk only moves
+// forward on each axis, so each step adds the one new row or column of three
+// and every cell is swept once.
+static void walkGrid(const sim::TrajectoryScene& scene, sim::Vec2 pos, sim::Vec2 vel,
+	const int* removed, int removedCount, Nearest& n)
+{
+	const sim::TargetGrid& g = *scene.grid;
+	const sim::Scalar size = g.cellSize;
+	if (g.width == 0 || g.height == 0)
+		return;
+
+	// start where the center enters the grid grown by a cell, where
+	// neighbours of the cells it crosses can still hold items
+	sim::Aabb area(g.origin - sim::Vec2(size, size), g.origin + sim::Vec2(size * (g.width + 1), size * (g.height + 1)));
+	sim::Scalar t0 = 0, t1 = n.best;
+	if (!sim::clipSlab(pos.x, vel.x, area.lo.x, area.hi.x, t0, t1) || !sim::clipSlab(pos.z, vel.z, area.lo.z, area.hi.z, t0, t1))
+		return;
+	sim::Vec2 start = pos + vel * t0;
+	int cx = sim::floorToInt((start.x - g.origin.x) / size);
+	int cz = sim::floorToInt((start.z - g.origin.z) / size);
+	cx = cx < -1 ? -1 : (cx > g.width ? g.width : cx);
+	cz = cz < -1 ? -1 : (cz > g.height ? g.height : cz);
+
+	int sx = vel.x > 0 ? 1 : (vel.x < 0 ? -1 : 0);
+	int sz = vel.z > 0 ? 1 : (vel.z < 0 ? -1 : 0);
+
+	for (int z = cz - 1; z <= cz + 1; z++)
+		for (int x = cx - 1; x <= cx + 1; x++)
+			sweepCell(scene, x, z, pos, vel, removed, removedCount, n);
+
+	for (;;) {
+		// times the center crosses into the next column and row; from the
+		// cell edges each time rather than summed, so nothing drifts
+		sim::Scalar nextX = sx == 0 ? sim::SCALAR_MAX : (g.origin.x + size * (sx > 0 ? cx + 1 : cx) - pos.x) / vel.x;
+		sim::Scalar nextZ = sz == 0 ? sim::SCALAR_MAX : (g.origin.z + size * (sz > 0 ? cz + 1 : cz) - pos.z) / vel.z;
+		if (nextX < nextZ) {
+			if (nextX > n.best)
+				break;
+			cx += sx;
+			if (cx < -1 || cx > g.width)
+				break;
+			for (int z = cz - 1; z <= cz + 1; z++)
+				sweepCell(scene, cx + sx, z, pos, vel, removed, removedCount, n);
+		}
+		else {
+			if (nextZ > n.best || nextZ == sim::SCALAR_MAX)
+				break;
+			cz += sz;
+			if (cz < -1 || cz > g.height)
+				break;
+			for (int x = cx - 1; x <= cx + 1; x++)
+				sweepCell(scene, x, cz + sz, pos, vel, removed, removedCount, n);
+		}
+	}
+}
+
+int sim::predictTrajectory(const TrajectoryScene& scene, Vec2 pos, Vec2 vel,
+	Contact* out, int maxContacts, Scalar maxTime)
+{
+	// targets (i) and bricks (~i) removed by earlier bounces of this query
+	int removed[MAX_PREDICTED_CONTACTS];
+	int removedCount = 0;
+	if (maxContacts > MAX_PREDICTED_CONTACTS)
+		maxContacts = MAX_PREDICTED_CONTACTS;
+
+	Scalar elapsed = 0;
+	int count = 0;
+
+	const Scalar paddleReach = scene.paddleRadius + scene.ballRadius;
+	const bool   useGrid     = scene.grid != NULL && scene.ballRadius <= scene.grid->cellSize;
+	const int    items       = scene.targetCount + scene.brickCount;
+
+	while (count < maxContacts && lengthSq(vel) > 0) {
+		Nearest near;
+		near.best   = maxTime - elapsed;
+		near.kind   = -1;
+		near.index  = 0;
+		near.item   = -1;
+		near.normal = Vec2(0, 0);
+		Scalar t;
+		Vec2  n;
+
+		for (int i = 0; i < scene.wallCount; i++) {
+			if (sweepCircleAabb(pos, vel, scene.walls[i], scene.ballRadius, near.best, t, n) && t > SWEEP_EPSILON) {
+				near.best = t; near.kind = CONTACT_WALL; near.index = i; near.normal = n;
+			}
+		}
+
+		if (useGrid)
+			walkGrid(scene, pos, vel, removed, removedCount, near);
+		else
+			for (int i = 0; i < items; i++)
+				sweepItem(scene, i, pos, vel, removed, removedCount, near);
+
+		Scalar best   = near.best;
+		int    kind   = near.kind;
+		int    index  = near.index;
+		Vec2   normal = near.normal;
+
+		if (scene.hasPaddle && sweepCircleCircle(pos, vel, scene.paddle, paddleReach, best, t) && t > SWEEP_EPSILON) {
+			best = t; kind = CONTACT_PADDLE; index = 0;
+		}
+
+		if (vel.x > 0 && scene.exitX != SCALAR_MAX) {
+			t = (scene.exitX - pos.x) / vel.x;
+			if (t >= 0 && t <= best) {
+				best = t; kind = CONTACT_EXIT; index = 0;
+			}
+		}
+
+		if (kind < 0)
+			break;
+
+		pos = pos + vel * best;
+		elapsed += best;
+
+		Contact& c = out[count++];
+		c.time     = elapsed;
+		c.position = pos;
+		c.kind     = kind;
+		c.index    = index;
+
+		if (kind == CONTACT_EXIT) {
+			c.normal   = Vec2(-1, 0);
+			c.velocity = vel;
+			break;
+		}
+
+		if (kind == CONTACT_WALL || kind == CONTACT_BRICK) {
+			// mirror the velocity about the surface normal
+			vel = vel - normal * (2 * dot(vel, normal));
+			if (kind == CONTACT_BRICK)
+				removed[removedCount++] = ~index;
+		}
+		else {
+			// the game sends the ball straight away from the center it hit, keeping its speed
+			Vec2 center = kind == CONTACT_TARGET ? scene.targets[index] : scene.paddle;
+			Vec2 away   = pos - center;
+			normal = away * (1 / length(away));
+			vel    = normal * length(vel);
+			if (kind == CONTACT_TARGET)
+				removed[removedCount++] = index;
+		}
+		c.normal   = normal;
+		c.velocity = vel;
+	}
+	return count;
+}
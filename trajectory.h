@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// 
+// File: trajectory.h
+// 
+// Desc: Analytic ball trajectory prediction. Instead of re-running the frame
+//       loop, the ball is swept as a circle along its velocity and intersected
+//       directly with the walls, the live targets and the paddle. Bounces follow
+//       the same rules as the game: walls and bricks reflect, sphere targets and
+//       the paddle send the ball away from their center, and targets and bricks
+//       disappear when hit. With a grid over the targets only those in the
+//       cells along the ball's path are swept.
+//          
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __trajectoryH__
+#define __trajectoryH__
+
+#include "simMath.h"
+
+namespace sim
+{
+	const int MAX_PREDICTED_CONTACTS = 64;
+
+	enum ContactKind
+	{
+		CONTACT_WALL = 0,
+		CONTACT_TARGET,
+		CONTACT_PADDLE,
+		CONTACT_BRICK,
+		CONTACT_EXIT       // ball center crossed exitX (the open side of the field)
+	};
+
+	struct Contact
+	{
+		Scalar time;       // time from the query start (same unit as the velocity)
+		Vec2   position;   // ball center at the contact
+		Vec2   normal;     // surface normal pointing towards the ball
+		Vec2   velocity;   // ball velocity after the bounce
+		int    kind;       // ContactKind
+		int    index;      // wall, target or brick index, 0 for paddle/exit
+	};
+
+	// A uniform grid over the targets and bricks, such as World's broadphase
+	// grid. Item i is target i below targetCount and brick i - targetCount
+	// from there on; each item is listed in every cell its shape overlaps.
+	struct TargetGrid
+	{
+		Vec2       origin;
+		Scalar     cellSize;
+		int        width, height;
+		const int* cellStart;      // width * height + 1 offsets into cellItems
+		const int* cellItems;
+	};
+
+	struct TrajectoryScene
+	{
+		const Aabb*          walls;
+		int                  wallCount;
+
+		const Vec2*          targets;
+		const unsigned char* targetAlive;   // NULL means all alive
+		int                  targetCount;
+		Scalar               targetRadius;
+
+		const Aabb*          bricks;        // rectangular targets, may be NULL
+		const unsigned char* brickAlive;    // NULL means all alive
+		int                  brickCount;
+
+		bool                 hasPaddle;
+		Vec2                 paddle;
+		Scalar               paddleRadius;
+
+		Scalar               ballRadius;
+		Scalar               exitX;         // SCALAR_MAX disables the exit test
+
+		const TargetGrid*    grid;          // NULL, or a ballRadius larger than a cell, sweeps every target and brick
+	};
+
+	// Sweeps a ball of scene.ballRadius from 'pos' with velocity 'vel' and writes
+	// up to maxContacts (capped at MAX_PREDICTED_CONTACTS) bounces into 'out'.
+	// Stops early at the exit, when nothing is hit before maxTime, or when the
+	// ball is not moving. Returns the number of contacts written.
+	int predictTrajectory(const TrajectoryScene& scene, Vec2 pos, Vec2 vel,
+		Contact* out, int maxContacts, Scalar maxTime);
+
+	// Single-shape sweeps used by the predictor. Both return the first time in
+	// [0, maxT] at which a circle of radius r moving from p with velocity d
+	// starts touching the shape, and only report contacts the ball is moving into.
+	bool sweepCircleCircle(Vec2 p, Vec2 d, Vec2 c, Scalar r, Scalar maxT, Scalar& t);
+	bool sweepCircleAabb(Vec2 p, Vec2 d, const Aabb& box, Scalar r, Scalar maxT, Scalar& t, Vec2& n);
+}
+
+#endif // __trajectoryH__
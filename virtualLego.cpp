@@ -11,11 +11,24 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "d3dUtility.h"
+#include "perfCounters.h"
+#include "gameWorld.h"
+#include "level.h"
+#include "particles.h"
+#include "audioMixer.h"
+#include "audioOut.h"
+#include "memTrack.h"
+#include "meshGen.h"
+#include "taskGraph.h"
+#include "jobSystem.h"
+#include "qualityGovernor.h"
+#include "renderCache.h"
 #include <vector>
 #include <ctime>
 #include <cstdlib>
 #include <cstdio>
 #include <cassert>
+#include <cstring>
 
 IDirect3DDevice9* Device = NULL;
 
@@ -23,21 +36,10 @@ IDirect3DDevice9* Device = NULL;
 const int Width  = 1024;
 const int Height = 768;
 
-const float spherePos[54][2] = {
-	{-2.5,2},{0.5,0.5},{0.5,-0.5},{-0.5,0.5},{-0.5,-0.5},{0,0.5},{0,-0.5},{-0.5,0},{0.5,0},
-	{2.5,2},{2.5,-2},{2,2.5},{2,-2.5},{0,2.5},{0,-2.5},{-2,2.5},{-2,-2.5},{2.5,0},
-	{3,1},{3,-1},{-3,1},{-2.5,0},{-3,-1},{-1,0.5},{-1,-0.5},{1.5,1.5},{1.5,-1.5},
-	{-1.5,1.5},{-1.5,-1.5},{0,1.5},{0,-1.5},{-1.5,0},{1.5,0},{1,1.5},{1,-1.5},{-1,1.5},
-	{-1,-1.5},{1.5,1},{1.5,-1},{-1.5,1},{-1.5,-1},{0.5,1.5},{0.5,-1.5},{-0.5,1.5},{-0.5,-1.5},
-	{1.5,0.5},{1.5,-0.5},{-1.5,0.5},{-1.5,-0.5},{-2.5,2.5},{-2.5,-2.5},{2.5,2.5},{2.5,-2.5},{-2.5,-2}
-}; 
-
-bool noGame = true;
-
 // -----------------------------------------------------------------------------
 // Transform matrices
 // -----------------------------------------------------------------------------
-D3DXMATRIX g_mWorld;
+gfx::ParentMatrix g_mWorld; //what every object hangs off; world matrices are remade only when it moves
 D3DXMATRIX g_mView;
 D3DXMATRIX g_mProj;
 
@@ -45,6 +47,64 @@ D3DXMATRIX g_mProj;
 #define PI 3.14159265
 #define M_HEIGHT 0.01
 #define DECREASE_RATE 0.9982
+#define BALL_HEIGHT 0.5     // height at which the red and white balls are drawn
+#define MAX_DEBRIS 100000   // live debris particles
+#define DEBRIS_PER_TARGET 96
+#define AUDIO_RATE 44100
+#define AUDIO_FRAMES 1024   // per waveOut buffer, about 23 ms
+#define LOD_FAR 14.0f           // targets further from the eye use the next LOD
+#define FRAME_BUDGET_MS 16.6f   // what the quality governor holds the frame to; -budget on the command line
+#define UPLOAD_BUDGET_US 2000   // time per frame for startup uploads, at least one each frame
+
+// the render cache's matrices, materials and lights are D3D's, and go to the device as they are
+static_assert(sizeof(gfx::Matrix) == sizeof(D3DMATRIX), "gfx::Matrix is a D3DMATRIX");
+static_assert(sizeof(gfx::Material) == sizeof(D3DMATERIAL9), "gfx::Material is a D3DMATERIAL9");
+static_assert(sizeof(gfx::Light) == sizeof(D3DLIGHT9), "gfx::Light is a D3DLIGHT9");
+
+static const gfx::Matrix&   asMatrix(const D3DMATRIX& m)        { return *(const gfx::Matrix*)&m; }
+static const gfx::Material& asMaterial(const D3DMATERIAL9& m)   { return *(const gfx::Material*)&m; }
+static const gfx::Light&    asLight(const D3DLIGHT9& l)         { return *(const gfx::Light*)&l; }
+
+// vertex and index buffer bytes of a D3DX mesh, for the memory report
+static mem::MeshCost meshCostOf(ID3DXMesh* pMesh)
+{
+	return mem::meshCost(pMesh->GetNumVertices(), pMesh->GetNumBytesPerVertex(), pMesh->GetNumFaces(),
+		(pMesh->GetOptions() & D3DXMESH_32BIT) != 0);
+}
+
+// copies geometry built on a worker into a managed D3DX mesh with one subset;
+// the render backend's createMesh
+static ID3DXMesh* uploadMesh(IDirect3DDevice9* pDevice, const gfx::MeshData& data)
+{
+	ID3DXMesh* pMesh = NULL;
+	if (FAILED(D3DXCreateMeshFVF(data.faceCount(), (DWORD)data.vertices.size(), D3DXMESH_MANAGED,
+			D3DFVF_XYZ | D3DFVF_NORMAL, pDevice, &pMesh)))
+		return NULL;
+
+	void*  pVertices = NULL;
+	void*  pIndices = NULL;
+	DWORD* pAttributes = NULL;
+	bool   ok = false;
+	if (SUCCEEDED(pMesh->LockVertexBuffer(0, &pVertices))) {
+		memcpy(pVertices, &data.vertices[0], data.vertices.size() * sizeof(gfx::MeshVertex));
+		pMesh->UnlockVertexBuffer();
+		if (SUCCEEDED(pMesh->LockIndexBuffer(0, &pIndices))) {
+			memcpy(pIndices, &data.indices[0], data.indices.size() * sizeof(uint16_t));
+			pMesh->UnlockIndexBuffer();
+			if (SUCCEEDED(pMesh->LockAttributeBuffer(0, &pAttributes))) {
+				memset(pAttributes, 0, data.faceCount() * sizeof(DWORD));
+				pMesh->UnlockAttributeBuffer();
+				ok = true;
+			}
+		}
+	}
+	if (!ok) {
+		pMesh->Release();
+		return NULL;
+	}
+	mem::chargeMesh(mem::TAG_RENDER, meshCostOf(pMesh));
+	return pMesh;
+}
 
 // -----------------------------------------------------------------------------
 // CSphere class definition
@@ -54,130 +114,95 @@ class CSphere {
 private :
 	float center_x, center_y, center_z; //position of sphere: x,y,z
     float m_radius; //radius of sphere
-	float m_velocity_x; //velocity of sphere to the direction of x
-	float m_velocity_z; //velocity of sphere to the direction of x
-	bool bottomBall = false; //indicate the ball is moving ball (as it moves at the bottom of the plane, it is named as bottomball)
 public:
     CSphere(void)
 	{
-        D3DXMatrixIdentity(&m_mLocal);
+        m_world.init();
         ZeroMemory(&m_mtrl, sizeof(m_mtrl));
         m_radius = 0;
-		m_velocity_x = 0;
-		m_velocity_z = 0;
-        m_pSphereMesh = NULL;
+        for (int i = 0; i < gfx::TARGET_LODS; i++)
+            m_pSphereMesh[i] = NULL;
     }
     ~CSphere(void) {}
 
 public:
-    bool create(IDirect3DDevice9* pDevice, D3DXCOLOR color = d3d::WHITE)
+    // the placeholder is drawn until create() has uploaded the real mesh
+    void setColor(D3DXCOLOR color)
     {
-        if (NULL == pDevice)
-            return false;
-		
         m_mtrl.Ambient  = color;
         m_mtrl.Diffuse  = color;
         m_mtrl.Specular = color;
         m_mtrl.Emissive = d3d::BLACK;
         m_mtrl.Power    = 5.0f;
-		
-        if (FAILED(D3DXCreateSphere(pDevice, getRadius(), 50, 50, &m_pSphereMesh, NULL)))
-            return false;
-        return true;
+    }
+
+    // lod 0 is the full ball; a sphere can have any of its LODs
+    bool create(gfx::RenderStateCache& rs, const gfx::MeshData& data, int lod = 0)
+    {
+        m_pSphereMesh[lod] = (ID3DXMesh*)rs.createMesh(data);
+        return m_pSphereMesh[lod] != NULL;
     }
 	
-    void destroy(void){
-        if (m_pSphereMesh != NULL) {
-            m_pSphereMesh->Release();
-            m_pSphereMesh = NULL;
+    void destroy(gfx::RenderStateCache& rs){
+        for (int i = 0; i < gfx::TARGET_LODS; i++) {
+            if (m_pSphereMesh[i] != NULL) {
+                rs.releaseMesh(m_pSphereMesh[i]);
+                m_pSphereMesh[i] = NULL;
+            }
         }
     }
 
-    void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld){
-        if (NULL == pDevice) return;
-        pDevice->SetTransform(D3DTS_WORLD, &mWorld);
-        pDevice->MultiplyTransform(D3DTS_WORLD, &m_mLocal);
-        pDevice->SetMaterial(&m_mtrl);
-		m_pSphereMesh->DrawSubset(0);
+    // the LOD asked for, else the nearest finer one, else the nearest coarser one
+    ID3DXMesh* meshFor(int lod) const {
+        if (lod >= gfx::TARGET_LODS) lod = gfx::TARGET_LODS - 1;
+        for (int i = lod; i >= 0; i--)
+            if (m_pSphereMesh[i] != NULL) return m_pSphereMesh[i];
+        for (int i = lod + 1; i < gfx::TARGET_LODS; i++)
+            if (m_pSphereMesh[i] != NULL) return m_pSphereMesh[i];
+        return s_pPlaceholder;
     }
-	
-    bool hasIntersected(CSphere& ball) {
-		D3DXVECTOR3 diff = this->getCenter() - ball.getCenter();
-		float dist = sqrt(diff.x * diff.x + diff.z * diff.z);
-		if (this->getRadius()+ball.getRadius() < dist) return false;
-		else return true;
-	}
-	
-	void hitBy(CSphere& ball){ //if ball is g_dirS, it destroys the targets balls. if ball is g_movS, ball changes the direction 
-		if (hasIntersected(ball)) { //distance = velocity * time
-			D3DXVECTOR3 diff = this->getCenter() - ball.getCenter();
-			float diff_x = diff.x;
-			float diff_z = diff.z;
-			float dist_xz = sqrt(diff_x * diff_x + diff_z * diff_z);
-
-			float velocity_x = ball.getVelocity_X();
-			float velocity_z = ball.getVelocity_Z();
-			float velocity_xz = sqrt(velocity_x*velocity_x + velocity_z * velocity_z);
-
-			double velocity_x2 = velocity_xz / dist_xz * diff_x;
-			double velocity_z2 = velocity_xz / dist_xz * diff_z;
-
-			ball.setPower(-velocity_x2, -velocity_z2); //to make the change on the direction, put 'minus'
-			//except for the moving ball, there are target spheres. It is make them disapear on the screen
-			if (!this->isBottomBall()) { this->setCenter(-7,-7,-7); } 
-		}
-	}
-
-	void ballUpdate(float timeDiff) {
-		const float TIME_SCALE = 3.3;
-		D3DXVECTOR3 cord = this->getCenter();
-		double vx = abs(this->getVelocity_X());
-		double vz = abs(this->getVelocity_Z());
-
-		if(vx > 0.01 || vz > 0.01){
-			float tX = cord.x + TIME_SCALE*timeDiff*m_velocity_x;
-			float tZ = cord.z + TIME_SCALE*timeDiff*m_velocity_z;
-			
-			this->setCenter(tX, cord.y, tZ);
-		}
-		else { this->setPower(0,0);}
-	}
 
-	double getVelocity_X() { return this->m_velocity_x;	}
-	double getVelocity_Z() { return this->m_velocity_z; }
-
-	void setPower(double vx, double vz)
-	{
-		this->m_velocity_x = vx;
-		this->m_velocity_z = vz;
-	}
+    // at its own world matrix, which updateWorldMatrices() has brought up to date
+    void draw(gfx::RenderStateCache& rs, int lod = 0){
+        drawAt(rs, m_world.world, lod);
+    }
 
+    // at a world matrix kept elsewhere; the one target mesh is drawn at every target's
+    void drawAt(gfx::RenderStateCache& rs, const gfx::Matrix& world, int lod = 0){
+        ID3DXMesh* pMesh = meshFor(lod);
+        if (NULL == pMesh) return;
+        rs.setTransform(gfx::TRANSFORM_WORLD, world);
+        rs.setMaterial(asMaterial(m_mtrl));
+		rs.drawMesh(pMesh);
+		perf::add(perf::DRAW_CALLS);
+    }
+	
 	void setCenter(float x, float y, float z){
-		D3DXMATRIX m;
+		gfx::Matrix m;
 		center_x=x;	center_y=y;	center_z=z;
-		D3DXMatrixTranslation(&m, x, y, z);
-		setLocalTransform(m);
+		gfx::translation(m, x, y, z);
+		m_world.setLocal(m);
 	}
 	
 	float getRadius(void)  const { return (float)(M_RADIUS);  }
-    const D3DXMATRIX& getLocalTransform(void) const { return m_mLocal; }
-    void setLocalTransform(const D3DXMATRIX& mLocal) { m_mLocal = mLocal; }
+    gfx::WorldMatrix& transform(void) { return m_world; }
 
     D3DXVECTOR3 getCenter(void) const{
         D3DXVECTOR3 org(center_x, center_y, center_z);
         return org;
     }
-	
-	void setBottomBall() { bottomBall = true; }
-	bool isBottomBall() { return bottomBall; } 
-	
+
+    static ID3DXMesh*       s_pPlaceholder; // a few dozen faces, made before the first frame
+
 private:
-    D3DXMATRIX              m_mLocal;
+    gfx::WorldMatrix        m_world;
     D3DMATERIAL9            m_mtrl;
-    ID3DXMesh*              m_pSphereMesh;
+    ID3DXMesh*              m_pSphereMesh[gfx::TARGET_LODS];
 	
 };
 
+ID3DXMesh* CSphere::s_pPlaceholder = NULL;
+
 // -----------------------------------------------------------------------------
 // CWall class definition
 // -----------------------------------------------------------------------------
@@ -191,17 +216,18 @@ private:
 	float m_height;
 public:
     CWall(void){
-        D3DXMatrixIdentity(&m_mLocal);
+        m_world.init();
         ZeroMemory(&m_mtrl, sizeof(m_mtrl));
+        m_x = m_z = 0;
         m_width = 0;
         m_depth = 0;
+        m_meshSize = D3DXVECTOR3(0, 0, 0);
         m_pBoundMesh = NULL;
     }
     ~CWall(void) {}
 public:
-    bool create(IDirect3DDevice9* pDevice, float ix, float iz, float iwidth, float iheight, float idepth, D3DXCOLOR color = d3d::WHITE){
-        if (NULL == pDevice) return false;
-		
+    // size and color; until create() uploads the box, the unit placeholder is stretched to this size
+    void init(float iwidth, float iheight, float idepth, D3DXCOLOR color = d3d::WHITE){
         m_mtrl.Ambient  = color;
         m_mtrl.Diffuse  = color;
         m_mtrl.Specular = color;
@@ -210,78 +236,57 @@ public:
 		
         m_width = iwidth;
         m_depth = idepth;
-		
-        if (FAILED(D3DXCreateBox(pDevice, iwidth, iheight, idepth, &m_pBoundMesh, NULL))) return false;
-        return true;
+        m_meshSize = D3DXVECTOR3(iwidth, iheight, idepth);
+    }
+
+    // CPU side of the box mesh; safe on a worker thread
+    void buildMesh(gfx::MeshData& out) const {
+        gfx::buildBox(m_meshSize.x, m_meshSize.y, m_meshSize.z, out);
     }
 
-    void destroy(void){
+    bool create(gfx::RenderStateCache& rs, const gfx::MeshData& data){
+        m_pBoundMesh = (ID3DXMesh*)rs.createMesh(data);
+        return m_pBoundMesh != NULL;
+    }
+
+    void destroy(gfx::RenderStateCache& rs){
         if (m_pBoundMesh != NULL) {
-            m_pBoundMesh->Release();
+            rs.releaseMesh(m_pBoundMesh);
             m_pBoundMesh = NULL;
         }
     }
 
-    void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld)
+    // at its own world matrix, which updateWorldMatrices() has brought up to date
+    void draw(gfx::RenderStateCache& rs)
     {
-        if (NULL == pDevice) return;
-        pDevice->SetTransform(D3DTS_WORLD, &mWorld);
-        pDevice->MultiplyTransform(D3DTS_WORLD, &m_mLocal);
-        pDevice->SetMaterial(&m_mtrl);
-		m_pBoundMesh->DrawSubset(0);
+        drawAt(rs, m_world.world);
     }
-	
-	bool hasIntersected(CSphere& ball) {
-		float ballx = ball.getCenter().x;
-		float ballz = ball.getCenter().z;;
-		float ballr = ball.getRadius();
-
-		float top = this->getPosition().x - this->getWidth() * 0.5 - ballr;
-		float down = this->getPosition().x + this->getWidth() * 0.5 + ballr;
-		float left = this->getPosition().z - this->getDepth() * 0.5 - ballr;
-		float right = this->getPosition().z + this->getDepth() * 0.5 + ballr;
-
-		if ((top <= ballx && ballx <= down) && (left <= ballz && ballz <= right)) return true;
-		else return false;
-	}
 
-	void hitBy(CSphere& ball) 
-	{
-		if (hasIntersected(ball)) {
-			float ballx = ball.getCenter().x;
-			float ballz = ball.getCenter().z;
-			float ballr = ball.getRadius();
-
-			float top = this->getPosition().x - this->getWidth() * 0.5;
-			float down = this->getPosition().x + this->getWidth() * 0.5;
-			float left = this->getPosition().z - this->getDepth() * 0.5;
-			float right = this->getPosition().z + this->getDepth() * 0.5;
-
-			if ((top <= ballx && ballx <= down) && !(left <= ballz && ballz <= right)) {
-				ball.setPower(ball.getVelocity_X(), -ball.getVelocity_Z()); 
-				if (top - ballr <= ballz && ballz <= this->getPosition().z) {
-					ballz = left - ballr;
-				}
-				else ballz = right + ballr;
-			}
-			if (!(top <= ballx && ballx <= down) && (left <= ballz && ballz <= right)) {
-				ball.setPower(-ball.getVelocity_X(), ball.getVelocity_Z());
-				if (left - ballr <= ballx && ballx <= this->getPosition().x) {
-					ballx = top - ballr;
-				}
-				else ballx = down + ballr;
-			}
-			ball.setCenter(ballx, ball.getCenter().y, ballz);
-		}
-	}    
+    // at a world matrix kept elsewhere; the one brick box is drawn at every brick's
+    void drawAt(gfx::RenderStateCache& rs, const gfx::Matrix& world)
+    {
+        ID3DXMesh* pMesh = m_pBoundMesh != NULL ? m_pBoundMesh : s_pPlaceholder;
+        if (NULL == pMesh) return;
+        if (pMesh == s_pPlaceholder) { //only while loading
+            gfx::Matrix s, m;
+            gfx::scaling(s, m_meshSize.x, m_meshSize.y, m_meshSize.z);
+            rs.multiply(m, s, world);
+            rs.setTransform(gfx::TRANSFORM_WORLD, m);
+        }
+        else
+            rs.setTransform(gfx::TRANSFORM_WORLD, world);
+        rs.setMaterial(asMaterial(m_mtrl));
+		rs.drawMesh(pMesh);
+		perf::add(perf::DRAW_CALLS);
+    }
 	
 	void setPosition(float x, float y, float z){
-		D3DXMATRIX m;
+		gfx::Matrix m;
 		this->m_x = x;
 		this->m_z = z;
 
-		D3DXMatrixTranslation(&m, x, y, z);
-		setLocalTransform(m);
+		gfx::translation(m, x, y, z);
+		m_world.setLocal(m);
 	}
 
 	D3DXVECTOR3 getPosition(void)const {
@@ -297,16 +302,32 @@ public:
 		D3DXVECTOR3 org(m_x, 0, m_z);
 		return org;
 	}
-	
+
+	sim::Aabb getShape(void) const {
+		return sim::Aabb(sim::toVec2(m_x - m_width * 0.5f, m_z - m_depth * 0.5f), sim::toVec2(m_x + m_width * 0.5f, m_z + m_depth * 0.5f));
+	}
+
+	// stretches a box created with unit width and depth over 'box' (bricks of any size share one mesh)
+	static void boxTransform(gfx::Matrix& out, const sim::Aabb& box, float y){
+		gfx::scaling(out, sim::toFloat(box.hi.x - box.lo.x), 1.0f, sim::toFloat(box.hi.z - box.lo.z));
+		out.m[3][0] = sim::toFloat((box.lo.x + box.hi.x) * sim::Scalar(0.5f));
+		out.m[3][1] = y;
+		out.m[3][2] = sim::toFloat((box.lo.z + box.hi.z) * sim::Scalar(0.5f));
+	}
+
+    gfx::WorldMatrix& transform(void) { return m_world; }
+
+    static ID3DXMesh*       s_pPlaceholder; // unit box, made before the first frame
 	
 private :
-    void setLocalTransform(const D3DXMATRIX& mLocal) { m_mLocal = mLocal; }
-	
-	D3DXMATRIX              m_mLocal;
+	gfx::WorldMatrix        m_world;
     D3DMATERIAL9            m_mtrl;
+    D3DXVECTOR3             m_meshSize;
     ID3DXMesh*              m_pBoundMesh;
 };
 
+ID3DXMesh* CWall::s_pPlaceholder = NULL;
+
 // -----------------------------------------------------------------------------
 // CLight class definition
 // -----------------------------------------------------------------------------
@@ -316,7 +337,8 @@ public:
     CLight(void){
         static DWORD i = 0;
         m_index = i++;
-        D3DXMatrixIdentity(&m_mLocal);
+        m_world.init();
+        m_marker = gfx::identity();
         ::ZeroMemory(&m_lit, sizeof(m_lit));
         m_pMesh = NULL;
         m_bound._center = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
@@ -324,12 +346,8 @@ public:
     }
     ~CLight(void) {}
 public:
-    bool create(IDirect3DDevice9* pDevice, const D3DLIGHT9& lit, float radius = 0.1f){
-        if (NULL == pDevice)
-            return false;
-        if (FAILED(D3DXCreateSphere(pDevice, radius, 10, 10, &m_pMesh, NULL)))
-            return false;
-		
+    // the light itself; its marker mesh comes later from createMesh()
+    void create(const D3DLIGHT9& lit, float radius = 0.1f){
         m_bound._center = lit.Position;
         m_bound._radius = radius;
 		
@@ -346,62 +364,156 @@ public:
         m_lit.Attenuation2  = lit.Attenuation2;
         m_lit.Theta         = lit.Theta;
         m_lit.Phi           = lit.Phi;
-        return true;
     }
-    void destroy(void)
+
+    bool createMesh(gfx::RenderStateCache& rs, const gfx::MeshData& data){
+        m_pMesh = (ID3DXMesh*)rs.createMesh(data);
+        return m_pMesh != NULL;
+    }
+    void destroy(gfx::RenderStateCache& rs)
     {
         if (m_pMesh != NULL) {
-            m_pMesh->Release();
+            rs.releaseMesh(m_pMesh);
             m_pMesh = NULL;
         }
     }
-    bool setLight(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld){
-        if (NULL == pDevice)
-            return false;
-		
-        D3DXVECTOR3 pos(m_bound._center);
-        D3DXVec3TransformCoord(&pos, &pos, &m_mLocal);
-        D3DXVec3TransformCoord(&pos, &pos, &mWorld);
-        m_lit.Position = pos;
+    // every frame; the cache drops it while neither the light nor the parent has moved
+    void setLight(gfx::RenderStateCache& rs, const gfx::ParentMatrix& parent){
+        const gfx::Matrix& world = rs.updateWorld(m_world, parent);
+        gfx::transformPoint(&m_lit.Position.x, &m_bound._center.x, world);
+        gfx::translation(m_marker, m_lit.Position.x, m_lit.Position.y, m_lit.Position.z);
 		
-        pDevice->SetLight(m_index, &m_lit);
-        pDevice->LightEnable(m_index, TRUE);
-        return true;
+        rs.setLight(m_index, asLight(m_lit));
+        rs.lightEnable(m_index, true);
     }
 
-    void draw(IDirect3DDevice9* pDevice){
-        if (NULL == pDevice)
+    void draw(gfx::RenderStateCache& rs){
+        if (NULL == m_pMesh)
             return;
-        D3DXMATRIX m;
-        D3DXMatrixTranslation(&m, m_lit.Position.x, m_lit.Position.y, m_lit.Position.z);
-        pDevice->SetTransform(D3DTS_WORLD, &m);
-        pDevice->SetMaterial(&d3d::WHITE_MTRL);
-        m_pMesh->DrawSubset(0);
+        rs.setTransform(gfx::TRANSFORM_WORLD, m_marker);
+        rs.setMaterial(asMaterial(d3d::WHITE_MTRL));
+        rs.drawMesh(m_pMesh);
+		perf::add(perf::DRAW_CALLS);
     }
 
     D3DXVECTOR3 getPosition(void) const { return D3DXVECTOR3(m_lit.Position); }
 
 private:
     DWORD               m_index;
-    D3DXMATRIX          m_mLocal;
+    gfx::WorldMatrix    m_world;
+    gfx::Matrix         m_marker;   // where the marker mesh is drawn
     D3DLIGHT9           m_lit;
     ID3DXMesh*          m_pMesh;
     d3d::BoundingSphere m_bound;
 };
 
+// -----------------------------------------------------------------------------
+// CDebris class definition
+// -----------------------------------------------------------------------------
+
+// draws every live particle of a sim::ParticleSystem as one point list
+class CDebris {
+private:
+	struct Vertex {
+		float x, y, z;
+		D3DCOLOR color;
+	};
+	enum { FVF = D3DFVF_XYZ | D3DFVF_DIFFUSE };
+
+	Vertex* m_pVertices; // filled each frame; allocated once for the whole pool
+	int     m_capacity;
+
+public:
+	CDebris(void) { m_pVertices = NULL; m_capacity = 0; }
+	~CDebris(void) {}
+
+	bool create(int capacity)
+	{
+		mem::Scope tag(mem::TAG_RENDER);
+		m_pVertices = new Vertex[capacity];
+		m_capacity  = capacity;
+		return true;
+	}
+	void destroy(void)
+	{
+		delete [] m_pVertices;
+		m_pVertices = NULL;
+		m_capacity  = 0;
+	}
+
+	void draw(gfx::RenderStateCache& rs, const gfx::ParentMatrix& parent, const sim::ParticleSystem& ps)
+	{
+		if (NULL == m_pVertices)
+			return;
+		int n = ps.count() < m_capacity ? ps.count() : m_capacity;
+		if (n == 0)
+			return;
+
+		for (int i = 0; i < n; i++) {
+			m_pVertices[i].x     = ps.posX()[i];
+			m_pVertices[i].y     = ps.posY()[i];
+			m_pVertices[i].z     = ps.posZ()[i];
+			m_pVertices[i].color = ps.color()[i];
+		}
+
+		float size = 3.0f;
+		rs.setTransform(gfx::TRANSFORM_WORLD, parent.m);
+		rs.setRenderState(D3DRS_LIGHTING, FALSE);
+		rs.setRenderState(D3DRS_POINTSIZE, *(DWORD*)&size);
+		rs.setFVF(FVF);
+		rs.drawPoints(m_pVertices, n, sizeof(Vertex));
+		rs.setRenderState(D3DRS_LIGHTING, TRUE);
+		perf::add(perf::DRAW_CALLS);
+	}
+};
+
 
 // -----------------------------------------------------------------------------
 // Global variables
 // -----------------------------------------------------------------------------
 CWall	g_legoPlane;
 CWall	g_legowall[3];
-CSphere	g_sphere[54]; //yellow balls (target balls that shoudl be destroyed)
+CSphere	g_target; //yellow ball mesh, drawn at every target ball that is still alive
+CWall	g_brickBox; //unit box mesh, stretched over every brick that is still alive
 CSphere	g_dirS; //red ball (dirS has meaning 'direction Sphere', which make a change on the direction after the intersection with other balls)
 CSphere g_movS; //white ball (movS has meaning 'moving Sphere', which moves at the bottom of plane, not the red ball to fall down at the bottom of the plane.
 CLight	g_light;
+CDebris	g_debrisDraw;
+
+sim::ParticleSystem g_debris; //bits of destroyed targets, bouncing on the plane
+
+audio::SoundBank  g_soundBank; //PCM samples, memory-mapped from arkanoid.bank
+audio::AudioMixer g_mixer; //Display() only posts commands; the output thread mixes
+AudioOutput       g_audioOut;
+
+sim::World g_world; //positions, velocities and targets; Display() only draws what it says
 
 double g_camera_pos[3] = {0.0, 5.0, -8.0};
 
+// startup: WinMain starts the load graph before it makes the window, and
+// Display() uploads its meshes a few per frame once the device is there
+TaskGraph     g_startup;
+int           g_levelTask, g_worldTask, g_debrisTask, g_soundTask, g_deviceTask;
+sim::Level    g_level; //loaded on a worker, then read by the world and the walls
+gfx::MeshData g_ballMesh[gfx::TARGET_LODS]; //[0] is shared by the target, red and white balls; the rest are target LODs
+gfx::MeshData g_lightMesh;
+gfx::MeshData g_boxMesh[5]; //plane, three walls, unit brick
+CWall*        g_boxes[5] = { &g_legoPlane, &g_legowall[0], &g_legowall[1], &g_legowall[2], &g_brickBox };
+bool          g_levelReady = false, g_worldReady = false, g_soundReady = false;
+bool          g_soundOutput = false; //set by the sound task; without it nothing would drain the mixer's queue
+uint64_t      g_startUs = 0, g_firstFrameUs = 0, g_loadedUs = 0;
+int           g_loadWorkers = 0;
+
+// frame budget: Display() times every frame and the governor picks the settings
+QualityGovernor    g_governor;
+IDirect3DSurface9* g_pSceneTarget = NULL; //the scene is drawn into its corner below full resolution, then stretched
+D3DXVECTOR3        g_eye(10.0f, 10.0f, 0.0f);
+
+// the device is reached through the render cache, which drops what it already has
+gfx::RenderStateCache         g_render;
+std::vector<gfx::WorldMatrix> g_targetWorld; //one per target and brick, made when the world loads;
+std::vector<gfx::WorldMatrix> g_brickWorld;  //a frame only remakes the ones whose parent moved
+
 // -----------------------------------------------------------------------------
 // Functions
 // -----------------------------------------------------------------------------
@@ -409,43 +521,147 @@ double g_camera_pos[3] = {0.0, 5.0, -8.0};
 
 void destroyAllLegoBlock(void)
 {
+    g_target.destroy(g_render);
+    g_brickBox.destroy(g_render);
+    g_dirS.destroy(g_render);
+    g_movS.destroy(g_render);
 }
 
-// initialization
-bool Setup(){
+// turns the frame's events into sounds; posting never waits on the audio thread
+void playEventSounds(void)
+{
+	for (int e = 0; e < g_world.eventCount(); e++) {
+		const sim::Event& ev = g_world.events()[e];
+		float pan = sim::toFloat(ev.position.x) / 4.5f; //the camera looks down z, so x is left to right
+		switch (ev.kind) {
+		case sim::EVENT_TARGET_HIT:
+			g_mixer.play(audio::SOUND_HIT, 0.8f, 1.0f + 0.02f * (ev.index % 12), pan);
+			break;
+		case sim::EVENT_BRICK_HIT:
+			g_mixer.play(audio::SOUND_HIT, 0.9f, 0.7f, pan);
+			break;
+		case sim::EVENT_WALL_BOUNCE:
+		case sim::EVENT_PADDLE_HIT:
+			g_mixer.play(audio::SOUND_BOUNCE, 0.6f, 1.0f, pan);
+			break;
+		case sim::EVENT_BALL_LOST:
+			g_mixer.play(audio::SOUND_GAME_OVER, 1.0f, 1.0f, 0.0f);
+			break;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Startup tasks. Workers load and build; main tasks own the device calls.
+// -----------------------------------------------------------------------------
+
+// the layout lives in level.cpp so headless tools run the same level
+bool loadLevelTask(void*)
+{
+	sim::defaultLevel(g_level);
+	if (g_level.walls.size() < 3)
+		return false;
+
+	// walls and the brick box get their size now and their meshes later
+	for (int i = 0; i < 3; i++) {
+		const sim::Aabb& w = g_level.walls[i];
+		g_legowall[i].init(sim::toFloat(w.hi.x - w.lo.x), gfx::gameMeshes[gfx::MESH_WALL0 + i].size[1], sim::toFloat(w.hi.z - w.lo.z), d3d::DARKRED);
+		g_legowall[i].setPosition(sim::toFloat((w.lo.x + w.hi.x) * sim::Scalar(0.5f)), 0.12f, sim::toFloat((w.lo.z + w.hi.z) * sim::Scalar(0.5f)));
+	}
+	const float* brick = gfx::gameMeshes[gfx::MESH_BRICK].size;
+	g_brickBox.init(brick[0], brick[1], brick[2], d3d::MAGENTA);
+	return true;
+}
+
+// targets and bricks stay where the level put them, so their matrices are made here once
+bool loadWorldTask(void*)
+{
+	if (!g_world.init(1 << 20) || !g_world.loadLevel(g_level.desc()))
+		return false;
+
+	mem::Scope tag(mem::TAG_RENDER);
+	gfx::Matrix m;
 	int i;
-	
-    D3DXMatrixIdentity(&g_mWorld);
-    D3DXMatrixIdentity(&g_mView);
-    D3DXMatrixIdentity(&g_mProj);
-		
-	// create plane and set the position
-    if (false == g_legoPlane.create(Device, -1, -1, 9, 0.03f, 6, d3d::GREEN)) return false;
-    g_legoPlane.setPosition(0.0f, -0.0006f / 5, 0.0f);
-	
-	// create walls and set the position
-	if (false == g_legowall[0].create(Device, -1, -1, 9, 0.3f, 0.12f, d3d::DARKRED)) return false;
-	g_legowall[0].setPosition(0.0f, 0.12f, 3.06f);
-	if (false == g_legowall[1].create(Device, -1, -1, 9, 0.3f, 0.12f, d3d::DARKRED)) return false;
-	g_legowall[1].setPosition(0.0f, 0.12f, -3.06f);
-	if (false == g_legowall[2].create(Device, -1, -1, 0.12f, 0.3f, 6.24f, d3d::DARKRED)) return false;
-	g_legowall[2].setPosition(-4.56f, 0.12f, 0.0f);
-
-	// create  balls and set the position 
-	for (i=0;i<54;i++) {//54: number of target balls
-		if (false == g_sphere[i].create(Device, d3d::YELLOW)) return false; 
-		g_sphere[i].setCenter(spherePos[i][0], (float)M_RADIUS , spherePos[i][1]);
-		g_sphere[i].setPower(0,0); //target balls don't have any velocity (dont' move)
+	g_targetWorld.resize(g_world.sphereCount());
+	for (i = 0; i < g_world.sphereCount(); i++) {
+		g_targetWorld[i].init();
+		gfx::translation(m, sim::toFloat(g_world.spheres()[i].x), (float)M_RADIUS, sim::toFloat(g_world.spheres()[i].z));
+		g_targetWorld[i].setLocal(m);
 	}
-	
-    if (false == g_movS.create(Device, d3d::WHITE)) return false;
-	g_movS.setCenter(g_legoPlane.getWidth()*0.5, 0.5, .0f);
-	g_movS.setBottomBall(); //white ball is at the bottom of the plane.
+	g_brickWorld.resize(g_world.brickCount());
+	for (i = 0; i < g_world.brickCount(); i++) {
+		g_brickWorld[i].init();
+		CWall::boxTransform(m, g_world.bricks()[i], 0.12f);
+		g_brickWorld[i].setLocal(m);
+	}
+	return true;
+}
+
+// debris falls onto the top of the plane
+bool createDebrisTask(void*)
+{
+	return g_debris.init(MAX_DEBRIS, g_legoPlane.getPosition().y + g_legoPlane.getHeight() * 0.5f) &&
+		g_debrisDraw.create(g_debris.capacity());
+}
+
+// sounds: the bank is written once and mapped from then on; without it the game is silent
+bool openSoundsTask(void*)
+{
+	if (g_soundBank.open("arkanoid.bank") ||
+		(audio::writeDefaultSoundBank("arkanoid.bank", 22050) && g_soundBank.open("arkanoid.bank"))) {
+		if (g_mixer.init(&g_soundBank, AUDIO_RATE, 32, AUDIO_FRAMES, 0.5f))
+			g_soundOutput = g_audioOut.start(&g_mixer, AUDIO_RATE, AUDIO_FRAMES, 3);
+	}
+	return true;
+}
+
+bool buildBallMeshTask(void*)
+{
+	mem::Scope tag(mem::TAG_RENDER);
+	for (int i = 0; i < gfx::TARGET_LODS; i++)
+		if (!gfx::buildMesh(gfx::gameMeshes[gfx::MESH_TARGET + i], g_ballMesh[i]))
+			return false;
+	return true;
+}
 
-	if (false == g_dirS.create(Device, d3d::RED)) return false;
-	g_dirS.setCenter(g_legoPlane.getWidth() * 0.5, 0.5, .0f);
+bool buildBoxMeshesTask(void*)
+{
+	mem::Scope tag(mem::TAG_RENDER);
+	for (int i = 0; i < 5; i++)
+		g_boxes[i]->buildMesh(g_boxMesh[i]);
+	return true;
+}
+
+bool buildLightMeshTask(void*)
+{
+	mem::Scope tag(mem::TAG_RENDER);
+	return gfx::buildMesh(gfx::gameMeshes[gfx::MESH_LIGHT], g_lightMesh);
+}
+
+bool uploadSphereTask(void* ctx)  { return ((CSphere*)ctx)->create(g_render, g_ballMesh[0]); }
+bool uploadTargetTask(void* ctx)
+{
+	int lod = (int)((gfx::MeshData*)ctx - g_ballMesh);
+	return g_target.create(g_render, g_ballMesh[lod], lod);
+}
+bool uploadLightTask(void*)       { return g_light.createMesh(g_render, g_lightMesh); }
+bool uploadBoxTask(void* ctx)
+{
+	int i = (int)((CWall**)ctx - g_boxes);
+	return g_boxes[i]->create(g_render, g_boxMesh[i]);
+}
+
+// builds the graph and sets the workers going; called before the window exists
+void startLoading(void)
+{
+	// what the tasks read before they run: the plane's size, the colors and the light
+	const float* plane = gfx::gameMeshes[gfx::MESH_PLANE].size;
+	g_legoPlane.init(plane[0], plane[1], plane[2], d3d::GREEN);
+	g_legoPlane.setPosition(0.0f, -0.0006f / 5, 0.0f);
+	g_target.setColor(d3d::YELLOW);
+	g_movS.setColor(d3d::WHITE);
+	g_dirS.setColor(d3d::RED);
 
-	// light setting 
     D3DLIGHT9 lit;
     ::ZeroMemory(&lit, sizeof(lit));
     lit.Type         = D3DLIGHT_POINT;
@@ -457,37 +673,318 @@ bool Setup(){
     lit.Attenuation0 = 0.0f;
     lit.Attenuation1 = 0.9f;
     lit.Attenuation2 = 0.0f;
-    if (false == g_light.create(Device, lit))
-        return false;
-	
+    g_light.create(lit, gfx::gameMeshes[gfx::MESH_LIGHT].size[0]);
+
+	TaskGraph& g = g_startup;
+	g_levelTask  = g.add("level", loadLevelTask, NULL);
+	g_worldTask  = g.add("world", loadWorldTask, NULL);
+	g_debrisTask = g.add("debris", createDebrisTask, NULL);
+	g_soundTask  = g.add("sounds", openSoundsTask, NULL);
+	int balls    = g.add("ball mesh", buildBallMeshTask, NULL);
+	int boxes    = g.add("box meshes", buildBoxMeshesTask, NULL);
+	int light    = g.add("light mesh", buildLightMeshTask, NULL);
+	g_deviceTask = g.addEvent("window and device");
+	g.depend(g_worldTask, g_levelTask);
+	g.depend(boxes, g_levelTask);
+
+	// uploads in the order they show: targets first, the light's marker and
+	// the coarse targets only the quality governor asks for last
+	CSphere* spheres[2] = { &g_dirS, &g_movS };
+	static const char* const sphereNames[2] = { "upload red ball", "upload white ball" };
+	static const char* const lodNames[gfx::TARGET_LODS] = { "upload targets", "upload target lod 1", "upload target lod 2", "upload target lod 3" };
+	static const char* const boxNames[5] = { "upload plane", "upload wall 0", "upload wall 1", "upload wall 2", "upload brick" };
+	int i, task;
+	task = g.add(lodNames[0], uploadTargetTask, &g_ballMesh[0], TaskGraph::ON_MAIN);
+	g.depend(task, balls);
+	g.depend(task, g_deviceTask);
+	for (i = 0; i < 2; i++) {
+		task = g.add(sphereNames[i], uploadSphereTask, spheres[i], TaskGraph::ON_MAIN);
+		g.depend(task, balls);
+		g.depend(task, g_deviceTask);
+	}
+	for (i = 0; i < 5; i++) {
+		task = g.add(boxNames[i], uploadBoxTask, &g_boxes[i], TaskGraph::ON_MAIN);
+		g.depend(task, boxes);
+		g.depend(task, g_deviceTask);
+	}
+	task = g.add("upload light", uploadLightTask, NULL, TaskGraph::ON_MAIN);
+	g.depend(task, light);
+	g.depend(task, g_deviceTask);
+	for (i = 1; i < gfx::TARGET_LODS; i++) {
+		task = g.add(lodNames[i], uploadTargetTask, &g_ballMesh[i], TaskGraph::ON_MAIN);
+		g.depend(task, balls);
+		g.depend(task, g_deviceTask);
+	}
+
+	// the main thread spends the time in CreateWindow and CreateDevice
+	g_loadWorkers = JobSystem::hardwareThreads() - 1;
+	if (g_loadWorkers < 1) g_loadWorkers = 1;
+	if (g_loadWorkers > 4) g_loadWorkers = 4;
+	g.start(g_loadWorkers);
+}
+
+// times from WinMain and every task, to 'startup.txt'
+void writeStartupReport(void)
+{
+	FILE* fp = fopen("startup.txt", "w");
+	if (fp == NULL)
+		return;
+	fprintf(fp, "first frame %8.2f ms   fully loaded %8.2f ms   %d load threads\n",
+		(g_firstFrameUs - g_startUs) / 1000.0, (g_loadedUs - g_startUs) / 1000.0, g_loadWorkers);
+
+	// a serial Setup() did all of the load work after the device and before
+	// its first frame; the tasks' own times say how long that would take here
+	uint64_t work = 0;
+	for (int i = 0; i < g_startup.taskCount(); i++) {
+		TaskGraph::Timing t = g_startup.timing(i);
+		if (t.where != TaskGraph::ON_SIGNAL && t.endUs > t.startUs)
+			work += t.endUs - t.startUs;
+	}
+	uint64_t deviceUs = g_startup.timing(g_deviceTask).endUs - g_startUs;
+	fprintf(fp, "serial      %8.2f ms   (device %.2f ms + load work %.2f ms)   first frame %.2f ms sooner\n",
+		(deviceUs + work) / 1000.0, deviceUs / 1000.0, work / 1000.0,
+		((double)(deviceUs + work) - (double)(g_firstFrameUs - g_startUs)) / 1000.0);
+	if (!g_soundOutput)
+		fprintf(fp, "no sound: the bank, the mixer or the wave output failed to start\n");
+	g_startup.print(fp, g_startUs);
+	fclose(fp);
+}
+
+// this frame's share of the startup uploads; notes what has become usable
+void pumpStartup(void)
+{
+	if (g_loadedUs != 0)
+		return;
+	g_startup.runMain(UPLOAD_BUDGET_US);
+	if (!g_levelReady) g_levelReady = g_startup.succeeded(g_levelTask);
+	if (!g_worldReady) g_worldReady = g_startup.succeeded(g_worldTask) && g_startup.succeeded(g_debrisTask);
+	if (!g_soundReady) g_soundReady = g_startup.isDone(g_soundTask) && g_soundOutput;
+
+	int failed = g_startup.firstFailure();
+	if (failed >= 0) {
+		char text[128];
+		sprintf(text, "Loading - FAILED: %s", g_startup.timing(failed).name);
+		::MessageBox(0, text, 0, 0);
+		::PostQuitMessage(0);
+		g_loadedUs = perf::nowMicroseconds();
+	}
+}
+
+// after Present(): the first frame, and the first one with everything loaded
+void notePresented(void)
+{
+	uint64_t now = perf::nowMicroseconds();
+	if (g_firstFrameUs == 0)
+		g_firstFrameUs = now;
+	if (g_loadedUs == 0 && g_startup.finished()) {
+		g_loadedUs = now;
+		writeStartupReport();
+
+		// the CPU copies are on the card now
+		for (int i = 0; i < gfx::TARGET_LODS; i++)
+			g_ballMesh[i] = gfx::MeshData();
+		g_lightMesh = gfx::MeshData();
+		for (int i = 0; i < 5; i++)
+			g_boxMesh[i] = gfx::MeshData();
+	}
+}
+
+// where the governor ended up and what it decided on the way, to 'quality.txt'
+void writeQualityReport(void)
+{
+	FILE* fp = fopen("quality.txt", "w");
+	if (fp == NULL)
+		return;
+	g_governor.print(fp);
+	fclose(fp);
+}
+
+// the last frame's length, Display() to Display(), so Present() and the
+// message loop count too. Loading frames are left out; the uploads make them long.
+void governQuality(void)
+{
+	static uint64_t lastUs = 0;
+	uint64_t now = perf::nowMicroseconds();
+	if (lastUs != 0 && g_loadedUs != 0)
+		g_governor.update((now - lastUs) / 1000.0f);
+	lastUs = now;
+	perf::set(perf::QUALITY_LEVEL, g_governor.level());
+	perf::set(perf::FRAME_AVERAGE_US, (uint64_t)(g_governor.smoothedMs() * 1000.0f));
+}
+
+// below full resolution the scene is drawn into the corner of g_pSceneTarget;
+// returns the back buffer to stretch it over afterwards, NULL to draw straight there
+IDirect3DSurface9* beginScaledScene(float scale)
+{
+	IDirect3DSurface9* pBackBuffer = NULL;
+	if (scale >= 1.0f || g_pSceneTarget == NULL || FAILED(Device->GetRenderTarget(0, &pBackBuffer)))
+		return NULL;
+	D3DVIEWPORT9 vp = { 0, 0, (DWORD)(Width * scale), (DWORD)(Height * scale), 0.0f, 1.0f };
+	Device->SetRenderTarget(0, g_pSceneTarget);
+	Device->SetViewport(&vp);
+	return pBackBuffer;
+}
+
+void endScaledScene(IDirect3DSurface9* pBackBuffer, float scale)
+{
+	if (pBackBuffer == NULL)
+		return;
+	RECT rect = { 0, 0, (LONG)(Width * scale), (LONG)(Height * scale) };
+	Device->SetRenderTarget(0, pBackBuffer); //the viewport goes back to the whole buffer
+	Device->StretchRect(g_pSceneTarget, &rect, pBackBuffer, NULL, D3DTEXF_LINEAR);
+	pBackBuffer->Release();
+}
+
+static void d3dSetTransform(void* ctx, int state, const gfx::Matrix& m)      { ((IDirect3DDevice9*)ctx)->SetTransform((D3DTRANSFORMSTATETYPE)state, (const D3DMATRIX*)&m); }
+static void d3dMultiplyTransform(void* ctx, int state, const gfx::Matrix& m) { ((IDirect3DDevice9*)ctx)->MultiplyTransform((D3DTRANSFORMSTATETYPE)state, (const D3DMATRIX*)&m); }
+static void d3dSetMaterial(void* ctx, const gfx::Material& m)               { ((IDirect3DDevice9*)ctx)->SetMaterial((const D3DMATERIAL9*)&m); }
+static void d3dSetLight(void* ctx, int index, const gfx::Light& l)          { ((IDirect3DDevice9*)ctx)->SetLight(index, (const D3DLIGHT9*)&l); }
+static void d3dLightEnable(void* ctx, int index, bool on)                   { ((IDirect3DDevice9*)ctx)->LightEnable(index, on ? TRUE : FALSE); }
+static void d3dSetRenderState(void* ctx, int state, uint32_t value)         { ((IDirect3DDevice9*)ctx)->SetRenderState((D3DRENDERSTATETYPE)state, value); }
+static void d3dSetFVF(void* ctx, uint32_t fvf)                              { ((IDirect3DDevice9*)ctx)->SetFVF(fvf); }
+static void d3dDrawMesh(void*, void* mesh)                                  { ((ID3DXMesh*)mesh)->DrawSubset(0); }
+static void d3dDrawPoints(void* ctx, const void* vertices, int count, int stride)
+{
+	((IDirect3DDevice9*)ctx)->DrawPrimitiveUP(D3DPT_POINTLIST, count, vertices, stride);
+}
+
+static void* d3dCreateMesh(void* ctx, const gfx::MeshData& data)
+{
+	return uploadMesh((IDirect3DDevice9*)ctx, data);
+}
+
+static void d3dReleaseMesh(void*, void* mesh)
+{
+	ID3DXMesh* pMesh = (ID3DXMesh*)mesh;
+	mem::releaseMesh(mem::TAG_RENDER, meshCostOf(pMesh));
+	pMesh->Release();
+}
+
+gfx::RenderBackend d3dBackend(IDirect3DDevice9* pDevice)
+{
+	gfx::RenderBackend b;
+	b.ctx               = pDevice;
+	b.setTransform      = d3dSetTransform;
+	b.multiplyTransform = d3dMultiplyTransform;
+	b.setMaterial       = d3dSetMaterial;
+	b.setLight          = d3dSetLight;
+	b.lightEnable       = d3dLightEnable;
+	b.setRenderState    = d3dSetRenderState;
+	b.setFVF            = d3dSetFVF;
+	b.drawMesh          = d3dDrawMesh;
+	b.drawPoints        = d3dDrawPoints;
+	b.createMesh        = d3dCreateMesh;
+	b.releaseMesh       = d3dReleaseMesh;
+	return b;
+}
+
+// brings every world matrix up to date in one pass, before anything is drawn;
+// while nothing has moved each is a version check. The walls belong to the
+// level task until g_levelReady, like everything of the world's
+void updateWorldMatrices(void)
+{
+	g_render.updateWorld(g_legoPlane.transform(), g_mWorld);
+	if (!g_levelReady)
+		return;
+	for (int i = 0; i < 3; i++)
+		g_render.updateWorld(g_legowall[i].transform(), g_mWorld);
+	if (!g_worldReady)
+		return;
+	g_render.updateWorld(g_dirS.transform(), g_mWorld);
+	g_render.updateWorld(g_movS.transform(), g_mWorld);
+	for (int i = 0; i < g_world.sphereCount(); i++)
+		if (g_world.sphereAlive()[i]) g_render.updateWorld(g_targetWorld[i], g_mWorld);
+	for (int i = 0; i < g_world.brickCount(); i++)
+		if (g_world.brickAlive()[i]) g_render.updateWorld(g_brickWorld[i], g_mWorld);
+}
+
+// what the cache passed on and saved this frame, for the live counters
+void publishRenderStats(void)
+{
+	const gfx::RenderStats& rs = g_render.stats();
+	perf::set(perf::DEVICE_CALLS, rs.calls);
+	perf::set(perf::DEVICE_CALLS_SAVED, rs.callsSaved);
+	perf::set(perf::MATRIX_MULTIPLIES, rs.multiplies);
+	perf::set(perf::MULTIPLIES_SAVED, rs.multipliesSaved);
+	g_render.resetStats();
+}
+
+// finer meshes near the eye; the governor's bias coarsens them all
+int targetLod(float x, float z, int bias)
+{
+	float dx = x - g_eye.x, dy = (float)M_RADIUS - g_eye.y, dz = z - g_eye.z;
+	return bias + (dx * dx + dy * dy + dz * dz > LOD_FAR * LOD_FAR ? 1 : 0);
+}
+
+// initialization: what the first frame needs. The rest arrives through g_startup.
+bool Setup(){
+    gfx::setParent(g_mWorld, gfx::identity());
+    g_render.init(d3dBackend(Device));
+    D3DXMatrixIdentity(&g_mView);
+    D3DXMatrixIdentity(&g_mProj);
+
+	// low-poly stand-ins, drawn until the real meshes are uploaded
+	gfx::MeshData data;
+	if (!gfx::buildMesh(gfx::gameMeshes[gfx::MESH_SPHERE_PLACEHOLDER], data)) return false;
+	if (NULL == (CSphere::s_pPlaceholder = (ID3DXMesh*)g_render.createMesh(data))) return false;
+	gfx::buildMesh(gfx::gameMeshes[gfx::MESH_BOX_PLACEHOLDER], data);
+	if (NULL == (CWall::s_pPlaceholder = (ID3DXMesh*)g_render.createMesh(data))) return false;
+
+	// the governor's reduced resolutions draw here; without it the scene stays full size
+	if (FAILED(Device->CreateRenderTarget(Width, Height, D3DFMT_X8R8G8B8, D3DMULTISAMPLE_NONE, 0, FALSE, &g_pSceneTarget, NULL)))
+		g_pSceneTarget = NULL;
+
 	// Position and aim the camera.
-	D3DXVECTOR3 pos(10.0f, 10.0f, 0.0f);
+	D3DXVECTOR3 pos(g_eye);
 	D3DXVECTOR3 target(0.0f, 0.0f, 0.0f);
 	D3DXVECTOR3 up(0.0f, 2.0f, 0.0f);
 	D3DXMatrixLookAtLH(&g_mView, &pos, &target, &up);
-	Device->SetTransform(D3DTS_VIEW, &g_mView);
+	g_render.setTransform(gfx::TRANSFORM_VIEW, asMatrix(g_mView));
 	
 	// Set the projection matrix.
 	D3DXMatrixPerspectiveFovLH(&g_mProj, D3DX_PI / 4,
         (float)Width / (float)Height, 1.0f, 100.0f);
-	Device->SetTransform(D3DTS_PROJECTION, &g_mProj);
+	g_render.setTransform(gfx::TRANSFORM_PROJECTION, asMatrix(g_mProj));
 	
     // Set render states.
-    Device->SetRenderState(D3DRS_LIGHTING, TRUE);
-    Device->SetRenderState(D3DRS_SPECULARENABLE, TRUE);
-    Device->SetRenderState(D3DRS_SHADEMODE, D3DSHADE_GOURAUD);
-	
-	g_light.setLight(Device, g_mWorld);
+    g_render.setRenderState(D3DRS_LIGHTING, TRUE);
+    g_render.setRenderState(D3DRS_SPECULARENABLE, TRUE);
+    g_render.setRenderState(D3DRS_SHADEMODE, D3DSHADE_GOURAUD);
+    g_render.setRenderState(D3DRS_NORMALIZENORMALS, TRUE); //bricks are drawn with a scaled box
+
+	g_startup.signal(g_deviceTask, true);
 	return true;
 }
 
+static void releasePlaceholder(ID3DXMesh*& pMesh)
+{
+	if (pMesh != NULL) {
+		g_render.releaseMesh(pMesh);
+		pMesh = NULL;
+	}
+}
+
 void Cleanup(void){
-    g_legoPlane.destroy();
+    // what the game held at its fullest, per subsystem, before it all goes
+    mem::dumpFile("memory.txt");
+    writeQualityReport();
+
+    g_legoPlane.destroy(g_render);
 	for(int i = 0 ; i < 3; i++) {
-		g_legowall[i].destroy();
+		g_legowall[i].destroy(g_render);
 	}
     destroyAllLegoBlock();
-    g_light.destroy();
+    g_light.destroy(g_render);
+    releasePlaceholder(CSphere::s_pPlaceholder);
+    releasePlaceholder(CWall::s_pPlaceholder);
+    if (g_pSceneTarget != NULL) {
+        g_pSceneTarget->Release();
+        g_pSceneTarget = NULL;
+    }
+    g_debrisDraw.destroy();
+    g_debris.release();
+    g_audioOut.stop();
+    g_soundBank.close();
 }
 
 
@@ -499,52 +996,63 @@ bool Display(float timeDelta)
 
 	if( Device )
 	{
+		// startup uploads, outside the scene; until the world is loaded only the plane and walls show
+		pumpStartup();
+		governQuality();
+		const QualitySettings& quality = g_governor.settings();
+		IDirect3DSurface9* pBackBuffer = beginScaledScene(quality.resolutionScale);
+
 		Device->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0x00afafaf, 1.0f, 0);
 		Device->BeginScene();
 
-		// update the position of each ball. during update, check whether each ball hit by walls.
-		for (i = 0; i < 54; i++) { 
-			g_sphere[i].ballUpdate(timeDelta);
-			g_sphere[i].hitBy(g_dirS);
-		}
-
-		g_dirS.ballUpdate(timeDelta);
-		g_movS.ballUpdate(timeDelta);
-
-		for (i = 0; i < 3; i++) {
-				g_legowall[i].hitBy(g_dirS);
-				g_legowall[i].hitBy(g_movS);
-		}
+		// update the position of each ball, the target hits, the wall bounces and the game-over reset
+		if (g_worldReady) {
+			NoAllocScope noAlloc;
+			g_debris.setBudget(quality.particleBudget);
+			for (i = 0; i < quality.substeps; i++) { //each substep's hits throw debris and play
+				g_world.step(sim::Scalar(timeDelta / quality.substeps));
+				sim::emitDebris(g_debris, g_world, DEBRIS_PER_TARGET, M_RADIUS);
+				if (g_soundReady)
+					playEventSounds();
+			}
+			g_debris.update(timeDelta);
+			assert(noAlloc.count() == 0); //the per-frame update must not touch the heap
 
-		g_movS.hitBy(g_dirS);
-		
-		if (noGame) { g_dirS.setCenter(g_movS.getCenter().x - 2 * M_RADIUS, g_movS.getCenter().y, g_movS.getCenter().z); }
-		if (g_legoPlane.getPosition().x + g_legoPlane.getWidth() * 0.5 <= g_dirS.getCenter().x) { //when red ball is out of the plane
-			noGame = true;
-			g_dirS.setPower(0, 0);
-			g_dirS.setCenter(g_movS.getCenter().x - 2 * M_RADIUS, g_movS.getCenter().y, g_movS.getCenter().z);
-
-			for (i = 0;i < 54;i++) {
-				g_sphere[i].setCenter(spherePos[i][0], M_RADIUS, spherePos[i][1]);
-				g_sphere[i].setPower(0, 0);
-			};
+			const sim::Ball& ball = g_world.ball();
+			const sim::Ball& paddle = g_world.paddle();
+			g_dirS.setCenter(sim::toFloat(ball.pos.x), BALL_HEIGHT, sim::toFloat(ball.pos.z));
+			g_movS.setCenter(sim::toFloat(paddle.pos.x), BALL_HEIGHT, sim::toFloat(paddle.pos.z));
 		}
 
-		// draw plane, walls, and spheres
-		g_legoPlane.draw(Device, g_mWorld);
-		for (i=0;i<3;i++) 	{
-			g_legowall[i].draw(Device, g_mWorld);
+		// draw plane, walls, and spheres; each is one SetTransform with its ready-made matrix
+		updateWorldMatrices();
+		g_light.setLight(g_render, g_mWorld);
+		g_legoPlane.draw(g_render);
+		for (i=0;i<3 && g_levelReady;i++) 	{
+			g_legowall[i].draw(g_render);
 		}
-		for (i = 0;i < 54;i++) {
-			g_sphere[i].draw(Device, g_mWorld);
+		if (g_worldReady) {
+			for (i = 0;i < g_world.sphereCount();i++) {
+				if (!g_world.sphereAlive()[i]) continue;
+				float x = sim::toFloat(g_world.spheres()[i].x), z = sim::toFloat(g_world.spheres()[i].z);
+				g_target.drawAt(g_render, g_targetWorld[i].world, targetLod(x, z, quality.sphereLodBias));
+			}
+			for (i = 0;i < g_world.brickCount();i++) {
+				if (!g_world.brickAlive()[i]) continue;
+				g_brickBox.drawAt(g_render, g_brickWorld[i].world);
+			}
+			g_dirS.draw(g_render);
+			g_movS.draw(g_render);
+			g_debrisDraw.draw(g_render, g_mWorld, g_debris);
 		}
-		g_dirS.draw(Device, g_mWorld);
-		g_movS.draw(Device, g_mWorld);
-        g_light.draw(Device);
+        g_light.draw(g_render);
 		
 		Device->EndScene();
+		endScaledScene(pBackBuffer, quality.resolutionScale);
 		Device->Present(0, 0, 0, 0);
 		Device->SetTexture( 0, NULL );
+		publishRenderStats();
+		notePresented();
 	}
 	return true;
 }
@@ -572,15 +1080,13 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		case VK_RETURN:
 			if (NULL != Device) {
 				wire = !wire;
-				Device->SetRenderState(D3DRS_FILLMODE,
+				g_render.setRenderState(D3DRS_FILLMODE,
 					(wire ? D3DFILL_WIREFRAME : D3DFILL_SOLID));
 			}
 			break;
 		case VK_SPACE:
-			if (noGame) {
-				noGame = false; //when we press space, the game starts
-			}
-			g_dirS.setPower(-3.0f, 0.0);
+			if (g_worldReady)
+				g_world.launch(); //when we press space, the game starts
 		}
 		break;
 	}
@@ -591,25 +1097,13 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		float dx;
 		float dy;
 
-		float left = g_legowall[1].getPosition().z + g_legowall[1].getDepth() * 0.5 + g_movS.getRadius();
-		float right = g_legowall[0].getPosition().z - g_legowall[0].getDepth() * 0.5 - g_movS.getRadius();
-
-		if (LOWORD(wParam) & MK_LBUTTON) {
+		if ((LOWORD(wParam) & MK_LBUTTON) && g_worldReady) {
 
-			D3DXVECTOR3 ballCenters = g_movS.getCenter();
 			dx = old_x - new_x;
 			dy = old_y - new_y;
 
-			float z0 = ballCenters.z + dx * (-0.007f);
-
-			if (z0 < left) {
-				z0 = left;
-			}
-			if (z0 > right) {
-				z0 = right;
-			}
-
-			g_movS.setCenter(ballCenters.x, ballCenters.y, z0);
+			//the world keeps the white ball between the walls
+			g_world.movePaddle(g_world.paddle().pos.z + sim::Scalar(dx * (-0.007f)));
 			old_x = new_x;
 			old_y = new_y;
 
@@ -626,21 +1120,36 @@ int WINAPI WinMain(HINSTANCE hinstance,
 				   PSTR cmdLine,
 				   int showCmd)
 {
+    g_startUs = perf::nowMicroseconds();
     srand(static_cast<unsigned int>(time(NULL)));
+
+	// a kiosk sets its own budget, e.g. -budget 33.3; -budget 0 keeps the settings fixed
+	const char* budget = strstr(cmdLine, "-budget");
+	g_governor.init(QualityGovernor::defaultConfig(budget != NULL ? (float)atof(budget + 7) : FRAME_BUDGET_MS));
+
+	// the level, the world and the meshes' geometry load while the window and device come up
+	startLoading();
 	
 	if(!d3d::InitD3D(hinstance,
 		Width, Height, true, D3DDEVTYPE_HAL, &Device)){
+		g_startup.stop();
 		::MessageBox(0, "InitD3D() - FAILED", 0, 0);
 		return 0;
 	}
 	
 	if(!Setup()){
+		g_startup.stop();
 		::MessageBox(0, "Setup() - FAILED", 0, 0);
 		return 0;
 	}
+
+	// live counters are optional; the game runs the same without them
+	perf::open("arkanoid.counters");
 	
 	d3d::EnterMsgLoop( Display );
 	
+	perf::close();
+	g_startup.stop(); //closed while still loading: waits for the tasks already running
 	Cleanup();
 	
 	Device->Release();